@@ -0,0 +1,433 @@
+/*=======================================================================
+              ROM bin Python module
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// CPython bindings for librombin.
+//
+// Input rom data and images are read in place through the buffer
+// protocol (bytes, bytearray, mmap, NumPy arrays...). Decoded images
+// are returned as a (height, width, 2) uint8 memoryview of index + alpha,
+// which NumPy wraps without copying: numpy.asarray(image).
+// The GIL is released while decoding / encoding.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "lib_rom_bin.h"
+
+#include <string.h>
+
+
+
+// Accepts a mode number or name ("snes-4bpp")
+static int rombin_parse_mode(PyObject * p_mode_obj, int * p_mode)
+{
+    if (PyLong_Check(p_mode_obj)) {
+        long mode = PyLong_AsLong(p_mode_obj);
+
+        if ((mode >= 0) && (mode < BIN_MODE_LAST)) {
+            *p_mode = (int)mode;
+            return 0;
+        }
+    }
+    else if (PyUnicode_Check(p_mode_obj)) {
+        const char * p_name = PyUnicode_AsUTF8(p_mode_obj);
+
+        if ((p_name) && (-1 != (*p_mode = rom_bin_mode_from_name(p_name))))
+            return 0;
+    }
+
+    if (!PyErr_Occurred())
+        PyErr_SetString(PyExc_ValueError, "unknown image mode");
+
+    return -1;
+}
+
+
+
+// Frees the library owned buffers, leaving the ones borrowed from Python alone
+static void rombin_free_structs(rom_gfx_data * p_rom_gfx, app_gfx_data * p_app_gfx, app_color_data * p_colorpal,
+                                int rom_borrowed, int surplus_borrowed)
+{
+    if (rom_borrowed)
+        p_rom_gfx->p_data = NULL;
+    if (surplus_borrowed)
+        p_app_gfx->p_surplus_bytes = NULL;
+
+    rom_bin_free_structs(p_rom_gfx, p_app_gfx, p_colorpal);
+}
+
+
+
+// (palette bytes, surplus bytes) shared by the decoders
+static PyObject * rombin_build_decode_result(app_gfx_data * p_app_gfx, app_color_data * p_colorpal)
+{
+    return Py_BuildValue("(y#y#)",
+                         (const char *)p_colorpal->p_data,
+                         (Py_ssize_t)(p_colorpal->size * p_colorpal->bytes_per_pixel),
+                         (p_app_gfx->p_surplus_bytes) ? (const char *)p_app_gfx->p_surplus_bytes : "",
+                         (Py_ssize_t)((p_app_gfx->p_surplus_bytes) ? p_app_gfx->surplus_bytes_size : 0));
+}
+
+
+
+// Decodes rom_in into p_dest (caller sized) without holding the GIL
+static int rombin_decode_buffer(unsigned char * p_dest, int64_t row_stride, int64_t pixel_stride,
+                                app_gfx_data * p_app_gfx, app_color_data * p_colorpal, rom_gfx_data * p_rom_gfx)
+{
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = rom_bin_decode_into(p_rom_gfx, p_app_gfx, p_colorpal,
+                                 p_dest, row_stride, pixel_stride);
+    Py_END_ALLOW_THREADS
+
+    if (0 != status)
+        PyErr_SetString(PyExc_ValueError, "decode failed");
+
+    return status;
+}
+
+
+
+PyDoc_STRVAR(rombin_query_doc,
+"query(data, mode) -> (width, height)\n\n"
+"Decoded image size for the rom data, without decoding it.");
+
+static PyObject * rombin_query(PyObject * self, PyObject * args)
+{
+    Py_buffer      rom_view;
+    PyObject     * p_mode_obj;
+    rom_gfx_data   rom_gfx;
+    app_gfx_data   app_gfx;
+    app_color_data colorpal;
+    int            image_mode;
+    int            status;
+
+    if (!PyArg_ParseTuple(args, "y*O:query", &rom_view, &p_mode_obj))
+        return NULL;
+
+    if (0 != rombin_parse_mode(p_mode_obj, &image_mode)) {
+        PyBuffer_Release(&rom_view);
+        return NULL;
+    }
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+    rom_gfx.size            = rom_view.len;
+    rom_gfx.p_data          = rom_view.buf;
+    app_gfx.image_mode      = image_mode;
+    app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+
+    status = rom_bin_decode_query(&rom_gfx, &app_gfx);
+
+    PyBuffer_Release(&rom_view);
+
+    if (0 != status) {
+        PyErr_SetString(PyExc_ValueError, "data is too small for this mode");
+        return NULL;
+    }
+
+    return Py_BuildValue("(II)", app_gfx.width, app_gfx.height);
+}
+
+
+
+PyDoc_STRVAR(rombin_decode_doc,
+"decode(data, mode) -> (image, palette, surplus)\n\n"
+"data is any bytes-like object (bytes, mmap, numpy array...), read in place.\n"
+"image is a (height, width, 2) uint8 memoryview of color index + alpha,\n"
+"alpha 0 marks padding past the end of the rom data.\n"
+"palette is the color map as R,G,B bytes. surplus holds the trailing\n"
+"bytes that don't fill a tile, pass it back to encode() to restore them.");
+
+static PyObject * rombin_decode(PyObject * self, PyObject * args)
+{
+    Py_buffer      rom_view;
+    PyObject     * p_mode_obj;
+    PyObject     * p_bytes = NULL;
+    PyObject     * p_flat  = NULL;
+    PyObject     * p_image = NULL;
+    PyObject     * p_tail  = NULL;
+    PyObject     * p_result = NULL;
+    rom_gfx_data   rom_gfx;
+    app_gfx_data   app_gfx;
+    app_color_data colorpal;
+    int            image_mode;
+
+    if (!PyArg_ParseTuple(args, "y*O:decode", &rom_view, &p_mode_obj))
+        return NULL;
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    if (0 != rombin_parse_mode(p_mode_obj, &image_mode))
+        goto done;
+
+    // The library only reads the rom data, so it can use the buffer as-is
+    rom_gfx.size            = rom_view.len;
+    rom_gfx.p_data          = rom_view.buf;
+    app_gfx.image_mode      = image_mode;
+    app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+
+    if (0 != rom_bin_decode_query(&rom_gfx, &app_gfx)) {
+        PyErr_SetString(PyExc_ValueError, "data is too small for this mode");
+        goto done;
+    }
+
+    // Decode straight into the bytearray that backs the result
+    if (NULL == (p_bytes = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t)app_gfx.size)))
+        goto done;
+
+    if (0 != rombin_decode_buffer((unsigned char *)PyByteArray_AS_STRING(p_bytes), 0, 0,
+                                  &app_gfx, &colorpal, &rom_gfx))
+        goto done;
+
+    // Shape it as (height, width, 2) without copying
+    if (NULL == (p_flat = PyMemoryView_FromObject(p_bytes)))
+        goto done;
+
+    p_image = PyObject_CallMethod(p_flat, "cast", "s(III)", "B",
+                                  app_gfx.height, app_gfx.width, (unsigned int)BIN_BITDEPTH_INDEXED_ALPHA);
+    if (NULL == p_image)
+        goto done;
+
+    if (NULL != (p_tail = rombin_build_decode_result(&app_gfx, &colorpal)))
+        p_result = PyTuple_Pack(3, p_image, PyTuple_GET_ITEM(p_tail, 0), PyTuple_GET_ITEM(p_tail, 1));
+
+done:
+    Py_XDECREF(p_tail);
+    Py_XDECREF(p_image);
+    Py_XDECREF(p_flat);
+    Py_XDECREF(p_bytes);
+
+    rombin_free_structs(&rom_gfx, &app_gfx, &colorpal, TRUE, FALSE);
+    PyBuffer_Release(&rom_view);
+
+    return p_result;
+}
+
+
+
+PyDoc_STRVAR(rombin_decode_into_doc,
+"decode_into(data, mode, out) -> (palette, surplus)\n\n"
+"Decodes into a caller supplied writable buffer instead of allocating one,\n"
+"for example a numpy.empty((height, width, 2), numpy.uint8) or a view into\n"
+"a larger atlas. Strided (non C-contiguous) buffers are supported as long\n"
+"as the two bytes of each pixel are adjacent. Use query() for the size.");
+
+static PyObject * rombin_decode_into(PyObject * self, PyObject * args)
+{
+    Py_buffer      rom_view;
+    Py_buffer      out_view;
+    PyObject     * p_mode_obj;
+    PyObject     * p_out_obj;
+    PyObject     * p_result = NULL;
+    rom_gfx_data   rom_gfx;
+    app_gfx_data   app_gfx;
+    app_color_data colorpal;
+    int            image_mode;
+    int            out_held = FALSE;
+
+    if (!PyArg_ParseTuple(args, "y*OO:decode_into", &rom_view, &p_mode_obj, &p_out_obj))
+        return NULL;
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    if (0 != rombin_parse_mode(p_mode_obj, &image_mode))
+        goto done;
+
+    if (0 != PyObject_GetBuffer(p_out_obj, &out_view, PyBUF_WRITABLE | PyBUF_STRIDES))
+        goto done;
+    out_held = TRUE;
+
+    rom_gfx.size            = rom_view.len;
+    rom_gfx.p_data          = rom_view.buf;
+    app_gfx.image_mode      = image_mode;
+    app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+
+    if (0 != rom_bin_decode_query(&rom_gfx, &app_gfx)) {
+        PyErr_SetString(PyExc_ValueError, "data is too small for this mode");
+        goto done;
+    }
+
+    // Expect (height, width, 2) with the pixel's two bytes adjacent
+    if ((out_view.ndim != 3) ||
+        (out_view.itemsize != 1) ||
+        (out_view.shape[0] != app_gfx.height) ||
+        (out_view.shape[1] != app_gfx.width) ||
+        (out_view.shape[2] != BIN_BITDEPTH_INDEXED_ALPHA) ||
+        (out_view.strides[2] != 1) ||
+        (out_view.strides[0] <= 0) ||
+        (out_view.strides[1] < BIN_BITDEPTH_INDEXED_ALPHA)) {
+        PyErr_Format(PyExc_ValueError, "out must be a writable (%u, %u, 2) uint8 buffer",
+                     app_gfx.height, app_gfx.width);
+        goto done;
+    }
+
+    if (0 != rombin_decode_buffer(out_view.buf, out_view.strides[0], out_view.strides[1],
+                                  &app_gfx, &colorpal, &rom_gfx))
+        goto done;
+
+    p_result = rombin_build_decode_result(&app_gfx, &colorpal);
+
+done:
+    rombin_free_structs(&rom_gfx, &app_gfx, &colorpal, TRUE, FALSE);
+
+    if (out_held)
+        PyBuffer_Release(&out_view);
+    PyBuffer_Release(&rom_view);
+
+    return p_result;
+}
+
+
+
+PyDoc_STRVAR(rombin_encode_doc,
+"encode(image, mode, surplus=b'') -> bytes\n\n"
+"image is a (height, width, 2) index + alpha or (height, width) index-only\n"
+"uint8 buffer, read in place (strided views are fine). Fully transparent\n"
+"tiles at the end are dropped, surplus bytes are appended.");
+
+static PyObject * rombin_encode(PyObject * self, PyObject * args, PyObject * kwargs)
+{
+    static char  * keywords[] = { "image", "mode", "surplus", NULL };
+    Py_buffer      image_view;
+    Py_buffer      surplus_view = { 0 };
+    PyObject     * p_image_obj;
+    PyObject     * p_mode_obj;
+    PyObject     * p_result = NULL;
+    rom_gfx_data   rom_gfx;
+    app_gfx_data   app_gfx;
+    app_color_data colorpal;
+    int            image_mode;
+    int            status;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|y*:encode", keywords,
+                                     &p_image_obj, &p_mode_obj, &surplus_view))
+        return NULL;
+
+    if (0 != PyObject_GetBuffer(p_image_obj, &image_view, PyBUF_STRIDES)) {
+        PyBuffer_Release(&surplus_view);
+        return NULL;
+    }
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    if (0 != rombin_parse_mode(p_mode_obj, &image_mode))
+        goto done;
+
+    if ((image_view.itemsize != 1) ||
+        ((image_view.ndim != 2) && (image_view.ndim != 3)) ||
+        ((image_view.ndim == 3) && (image_view.shape[2] != BIN_BITDEPTH_INDEXED_ALPHA) && (image_view.shape[2] != BIN_BITDEPTH_INDEXED)) ||
+        ((image_view.ndim == 3) && (image_view.strides[2] != 1)) ||
+        (image_view.shape[0] <= 0) || (image_view.shape[1] <= 0) ||
+        (image_view.shape[0] > UINT32_MAX) || (image_view.shape[1] > UINT32_MAX) ||
+        (image_view.strides[0] <= 0) || (image_view.strides[1] <= 0)) {
+        PyErr_SetString(PyExc_ValueError, "image must be a (height, width, 2) or (height, width) uint8 buffer");
+        goto done;
+    }
+
+    // Point the library straight at the caller's pixels
+    app_gfx.image_mode           = image_mode;
+    app_gfx.width                = (unsigned int)image_view.shape[1];
+    app_gfx.height               = (unsigned int)image_view.shape[0];
+    app_gfx.bytes_per_pixel      = (image_view.ndim == 3) ? (unsigned char)image_view.shape[2] : BIN_BITDEPTH_INDEXED;
+    app_gfx.row_stride           = image_view.strides[0];
+    app_gfx.pixel_stride         = image_view.strides[1];
+    app_gfx.p_data               = image_view.buf;
+    app_gfx.data_owned_by_caller = TRUE;
+    app_gfx.size                 = (int64_t)app_gfx.width * app_gfx.height * app_gfx.bytes_per_pixel;
+
+    if (surplus_view.buf && (surplus_view.len > 0)) {
+        app_gfx.p_surplus_bytes    = surplus_view.buf;
+        app_gfx.surplus_bytes_size = surplus_view.len;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    status = rom_bin_encode(&rom_gfx, &app_gfx);
+    Py_END_ALLOW_THREADS
+
+    if ((0 != status) || (NULL == rom_gfx.p_data)) {
+        PyErr_SetString(PyExc_ValueError, "encode failed");
+        goto done;
+    }
+
+    p_result = PyBytes_FromStringAndSize((const char *)rom_gfx.p_data, (Py_ssize_t)rom_gfx.size);
+
+done:
+    rombin_free_structs(&rom_gfx, &app_gfx, &colorpal, FALSE, TRUE);
+
+    PyBuffer_Release(&image_view);
+    PyBuffer_Release(&surplus_view);
+
+    return p_result;
+}
+
+
+
+static PyObject * rombin_modes(PyObject * self, PyObject * unused)
+{
+    PyObject * p_dict = PyDict_New();
+    int        c;
+
+    if (NULL == p_dict)
+        return NULL;
+
+    for (c = 0; c < BIN_MODE_LAST; c++) {
+        PyObject * p_value = PyLong_FromLong(c);
+
+        if ((NULL == p_value) ||
+            (0 != PyDict_SetItemString(p_dict, rom_bin_mode_name(c), p_value))) {
+            Py_XDECREF(p_value);
+            Py_DECREF(p_dict);
+            return NULL;
+        }
+        Py_DECREF(p_value);
+    }
+
+    return p_dict;
+}
+
+
+
+static PyMethodDef rombin_methods[] = {
+    { "query",       rombin_query,       METH_VARARGS, rombin_query_doc },
+    { "decode",      rombin_decode,      METH_VARARGS, rombin_decode_doc },
+    { "decode_into", rombin_decode_into, METH_VARARGS, rombin_decode_into_doc },
+    { "encode",      (PyCFunction)(void(*)(void))rombin_encode, METH_VARARGS | METH_KEYWORDS, rombin_encode_doc },
+    { "modes",       rombin_modes,       METH_NOARGS,  "modes() -> {name: number}" },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef rombin_module = {
+    PyModuleDef_HEAD_INIT,
+    "rombin",
+    "ROM tile graphics decode / encode (librombin)",
+    -1,
+    rombin_methods
+};
+
+PyMODINIT_FUNC PyInit_rombin(void)
+{
+    PyObject * p_module = PyModule_Create(&rombin_module);
+
+    if (NULL == p_module)
+        return NULL;
+
+    PyModule_AddIntConstant(p_module, "LIB_VERSION", rom_bin_version());
+
+    return p_module;
+}
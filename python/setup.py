@@ -0,0 +1,49 @@
+# ROM bin Python module
+#
+# Builds the rombin extension straight from the librombin sources,
+# so no installed library is needed:
+#
+#     python3 setup.py build_ext --inplace
+#     pip install .
+
+import glob
+import os
+import re
+
+from setuptools import Extension, setup
+
+SRC_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+
+
+def lib_version():
+    # Kept in step with the library the module is built from
+    with open(os.path.join(SRC_DIR, "lib_rom_bin.h")) as header:
+        text = header.read()
+
+    return ".".join(re.search(r"#define\s+ROM_BIN_VERSION_%s\s+(\d+)" % part, text).group(1)
+                    for part in ("MAJOR", "MINOR", "PATCH"))
+
+
+def lib_sources():
+    sources = ["lib_rom_bin.c", "rom_utils.c", "rom_stats.c"]
+    sources = [os.path.join(SRC_DIR, name) for name in sources]
+    sources += sorted(glob.glob(os.path.join(SRC_DIR, "format_*.c")))
+
+    # setuptools wants paths relative to this directory
+    return [os.path.relpath(path) for path in sources]
+
+
+setup(
+    name="rombin",
+    version=lib_version(),
+    description="ROM tile graphics decode / encode (librombin)",
+    license="GPL-3.0-or-later",
+    ext_modules=[
+        Extension(
+            "rombin",
+            sources=["rombinmodule.c"] + lib_sources(),
+            include_dirs=[os.path.relpath(SRC_DIR)],
+            define_macros=[("_FILE_OFFSET_BITS", "64")],
+        )
+    ],
+)
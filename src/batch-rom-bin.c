@@ -0,0 +1,357 @@
+/*=======================================================================
+              ROM bin load / save plugin for the GIMP
+                 Copyright 2018 - Others & Nathan Osman (webp plugin base)
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "batch-rom-bin.h"
+#include "read-rom-bin.h"
+#include "write-rom-bin.h"
+#include "lib_rom_bin.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <libgimp/gimp.h>
+
+// Default extension for exports written into an output directory
+#define BATCH_ROM_BIN_EXPORT_EXT ".bin"
+
+
+// One file in a batch. The file read/write and the codec
+// run on the worker threads, everything touching GIMP stays
+// on the plug-in's main thread.
+typedef struct batch_rom_bin_item {
+    const gchar * filename;
+    gchar       * out_filename;
+    int           image_mode;
+    int           status;
+    union {
+        read_rom_bin_job  read;
+        write_rom_bin_job write;
+    } job;
+} batch_rom_bin_item;
+
+
+
+static gint batch_rom_bin_compare_names(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+
+
+// Adds the files in the pattern's directory whose names match it, sorted
+static void batch_rom_bin_expand_glob(GPtrArray * p_names, const gchar * pattern)
+{
+    gchar        * dirname  = g_path_get_dirname(pattern);
+    gchar        * basename = g_path_get_basename(pattern);
+    GPatternSpec * spec     = g_pattern_spec_new(basename);
+    GPtrArray    * p_found  = g_ptr_array_new();
+    GDir         * dir;
+    const gchar  * entry;
+    guint          c;
+
+    dir = g_dir_open(dirname, 0, NULL);
+
+    if (dir) {
+        while ((entry = g_dir_read_name(dir)) != NULL) {
+            if (g_pattern_match_string(spec, entry))
+                g_ptr_array_add(p_found, g_build_filename(dirname, entry, NULL));
+        }
+        g_dir_close(dir);
+    }
+
+    // Directory order isn't stable, so sort to keep results repeatable
+    g_ptr_array_sort(p_found, batch_rom_bin_compare_names);
+
+    for (c = 0; c < p_found->len; c++)
+        g_ptr_array_add(p_names, g_ptr_array_index(p_found, c));
+
+    g_ptr_array_free(p_found, TRUE);
+    g_pattern_spec_free(spec);
+    g_free(basename);
+    g_free(dirname);
+}
+
+
+
+// Turns a newline separated list of filenames and/or
+// glob patterns (* and ?) into a NULL terminated list.
+// Free the result with g_strfreev()
+gchar ** batch_rom_bin_expand_filenames(const gchar * filenames)
+{
+    GPtrArray * p_names = g_ptr_array_new();
+    gchar    ** p_lines;
+    gchar    ** p_line;
+
+    if (filenames == NULL)
+        filenames = "";
+
+    p_lines = g_strsplit(filenames, "\n", -1);
+
+    for (p_line = p_lines; *p_line != NULL; p_line++) {
+
+        g_strstrip(*p_line);
+
+        // Skip blank lines (trailing newline, CRLF lists)
+        if (**p_line == '\0')
+            continue;
+
+        if (strpbrk(*p_line, "*?"))
+            batch_rom_bin_expand_glob(p_names, *p_line);
+        else
+            g_ptr_array_add(p_names, g_strdup(*p_line));
+    }
+
+    g_strfreev(p_lines);
+
+    g_ptr_array_add(p_names, NULL);
+
+    return (gchar **)g_ptr_array_free(p_names, FALSE);
+}
+
+
+
+// A single entry in the mode list applies to every file, otherwise
+// there is one per file (checked by the PDB handlers)
+static int batch_rom_bin_get_mode(const gint32 * p_modes, int num_modes, int index)
+{
+    if ((p_modes == NULL) || (num_modes <= 0))
+        return -1;
+
+    return p_modes[(num_modes == 1) ? 0 : index];
+}
+
+
+
+// Runs func on every queued item using one worker per processor,
+// returns once they have all finished
+static int batch_rom_bin_run_parallel(GFunc func, batch_rom_bin_item ** pp_queue, int num_items)
+{
+    GThreadPool * pool;
+    int           c;
+
+    pool = g_thread_pool_new(func, NULL, g_get_num_processors(), FALSE, NULL);
+
+    // No thread support, do them in sequence
+    if (pool == NULL) {
+        for (c = 0; c < num_items; c++)
+            func(pp_queue[c], NULL);
+        return 0;
+    }
+
+    for (c = 0; c < num_items; c++)
+        g_thread_pool_push(pool, pp_queue[c], NULL);
+
+    // Wait for the queue to drain
+    g_thread_pool_free(pool, FALSE, TRUE);
+
+    return 0;
+}
+
+
+
+static void batch_rom_bin_decode_worker(gpointer data, gpointer user_data)
+{
+    batch_rom_bin_item * p_item = (batch_rom_bin_item *)data;
+
+    p_item->status = read_rom_bin_decode(p_item->filename,
+                                         p_item->image_mode,
+                                         &p_item->job.read);
+}
+
+
+
+static void batch_rom_bin_encode_worker(gpointer data, gpointer user_data)
+{
+    batch_rom_bin_item * p_item = (batch_rom_bin_item *)data;
+
+    p_item->status = write_rom_bin_encode(p_item->out_filename,
+                                          &p_item->job.write);
+
+    // Release the image as soon as it's written instead of
+    // holding every image of the batch until the end
+    write_rom_bin_job_free(&p_item->job.write);
+}
+
+
+
+// Loads every file in the NULL terminated list in one pass.
+// Decoding runs in parallel, then the GIMP images are created
+// in list order. p_images receives one image id per file
+// (-1 for files that failed). Returns the number of failures.
+int batch_rom_bin_load(gchar ** p_filenames, const gint32 * p_modes, int num_modes, gint32 * p_images)
+{
+    batch_rom_bin_item  * p_items;
+    batch_rom_bin_item ** pp_queue;
+    int num_files;
+    int failures = 0;
+    int c;
+
+    num_files = g_strv_length(p_filenames);
+    if (num_files == 0)
+        return 0;
+
+    p_items  = g_new0(batch_rom_bin_item, num_files);
+    pp_queue = g_new(batch_rom_bin_item *, num_files);
+
+    for (c = 0; c < num_files; c++) {
+        p_items[c].filename   = p_filenames[c];
+        p_items[c].image_mode = batch_rom_bin_get_mode(p_modes, num_modes, c);
+        p_items[c].status     = -1;
+        pp_queue[c]           = &p_items[c];
+    }
+
+    batch_rom_bin_run_parallel(batch_rom_bin_decode_worker, pp_queue, num_files);
+
+    // Creating images talks to the GIMP core, so it stays on this thread
+    for (c = 0; c < num_files; c++) {
+
+        p_images[c] = -1;
+
+        if (p_items[c].status == 0) {
+            p_images[c] = read_rom_bin_create_image(p_items[c].filename,
+                                                    &p_items[c].job.read);
+            read_rom_bin_job_free(&p_items[c].job.read);
+        }
+        else
+            g_printerr("Batch load failed: %s\n", p_items[c].filename);
+
+        if (p_images[c] == -1)
+            failures++;
+    }
+
+    g_free(pp_queue);
+    g_free(p_items);
+
+    return failures;
+}
+
+
+
+// Builds "<out_dir>/<image name without extension>.bin"
+static gchar * batch_rom_bin_dir_filename(const gchar * out_dir, gint32 image_id)
+{
+    gchar * name;
+    gchar * ext;
+    gchar * filename;
+    gchar * out_filename;
+
+    name = gimp_image_get_name(image_id);
+
+    if ((name == NULL) || (*name == '\0')) {
+        g_free(name);
+        name = g_strdup_printf("image-%d", image_id);
+    }
+
+    // Swap the extension
+    ext = strrchr(name, '.');
+    if (ext)
+        *ext = '\0';
+
+    filename     = g_strconcat(name, BATCH_ROM_BIN_EXPORT_EXT, NULL);
+    out_filename = g_build_filename(out_dir, filename, NULL);
+
+    g_free(filename);
+    g_free(name);
+
+    return out_filename;
+}
+
+
+
+// Exports every image in one pass. out_filenames is either a
+// newline separated list with one filename per image, or a directory.
+// Pixels are fetched from GIMP on this thread, then encoding and
+// writing run in parallel. Returns the number of failures, or
+// -1 if the output filenames don't match the images.
+int batch_rom_bin_export(const gint32 * p_image_ids, int num_images,
+                         const gchar * out_filenames,
+                         const gint32 * p_modes, int num_modes)
+{
+    batch_rom_bin_item  * p_items;
+    batch_rom_bin_item ** pp_queue;
+    gchar ** p_out_names = NULL;
+    gchar  * out_dir     = NULL;
+    int failures = 0;
+    int num_queued = 0;
+    int c;
+
+    if ((num_images <= 0) || (out_filenames == NULL))
+        return -1;
+
+    // A single existing directory takes every export
+    out_dir = g_strstrip(g_strdup(out_filenames));
+
+    if (!g_file_test(out_dir, G_FILE_TEST_IS_DIR)) {
+        g_free(out_dir);
+        out_dir = NULL;
+
+        p_out_names = batch_rom_bin_expand_filenames(out_filenames);
+
+        if (g_strv_length(p_out_names) != (guint)num_images) {
+            g_strfreev(p_out_names);
+            return -1;
+        }
+    }
+
+    p_items  = g_new0(batch_rom_bin_item, num_images);
+    pp_queue = g_new(batch_rom_bin_item *, num_images);
+
+    for (c = 0; c < num_images; c++) {
+        gint32 drawable_id;
+
+        p_items[c].image_mode   = batch_rom_bin_get_mode(p_modes, num_modes, c);
+        p_items[c].status       = -1;
+        p_items[c].out_filename = (out_dir) ? batch_rom_bin_dir_filename(out_dir, p_image_ids[c])
+                                            : g_strdup(p_out_names[c]);
+
+        drawable_id = gimp_image_get_active_drawable(p_image_ids[c]);
+
+        if ((drawable_id == -1) ||
+            (0 != write_rom_bin_get_image(p_image_ids[c], drawable_id,
+                                          p_items[c].image_mode,
+                                          &p_items[c].job.write))) {
+            g_printerr("Batch export failed: %s\n", p_items[c].out_filename);
+            g_free(p_items[c].out_filename);
+            p_items[c].out_filename = NULL;
+            failures++;
+            continue;
+        }
+
+        // Queue only the images that were fetched. The items stay where
+        // they are: each job's arena and stats are pointed to from inside it
+        pp_queue[num_queued++] = &p_items[c];
+    }
+
+    batch_rom_bin_run_parallel(batch_rom_bin_encode_worker, pp_queue, num_queued);
+
+    for (c = 0; c < num_queued; c++) {
+        if (pp_queue[c]->status != 0) {
+            g_printerr("Batch export failed: %s\n", pp_queue[c]->out_filename);
+            failures++;
+        }
+    }
+
+    for (c = 0; c < num_images; c++)
+        g_free(p_items[c].out_filename);
+
+    g_free(pp_queue);
+    g_free(p_items);
+    g_free(out_dir);
+    g_strfreev(p_out_names);
+
+    return failures;
+}
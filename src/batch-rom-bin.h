@@ -0,0 +1,29 @@
+/*=======================================================================
+              ROM bin load / save plugin for the GIMP
+                 Copyright 2018 - Others & Nathan Osman (webp plugin base)
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include <glib.h>
+
+#ifndef BATCH_ROM_BIN_FILE_HEADER
+#define BATCH_ROM_BIN_FILE_HEADER
+
+    gchar ** batch_rom_bin_expand_filenames(const gchar *);
+
+    int batch_rom_bin_load(gchar **, const gint32 *, int, gint32 *);
+    int batch_rom_bin_export(const gint32 *, int, const gchar *, const gint32 *, int);
+
+#endif // BATCH_ROM_BIN_FILE_HEADER
@@ -0,0 +1,710 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Batch conversion of many files on a work-stealing pool.
+//
+// Every file is a task. Large roms are split further into bands of
+// tiles which are decoded in parallel and placed into the shared image,
+// so one huge file doesn't serialize the end of a run. Files are only
+// queued while the estimated memory in flight stays under a budget.
+
+#include "lib_rom_bin.h"
+#include "rom_stats.h"
+#include "cli_batch.h"
+#include "cli_file.h"
+#include "cli_hash.h"
+#include "cli_index.h"
+#include "cli_palette.h"
+#include "cli_png.h"
+#include "cli_pool.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CLI_BATCH_BAND_BYTES  (256 * 1024)  // Approximate rom bytes per band task
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+typedef struct cli_batch {
+    const cli_batch_options * p_options;
+    cli_pool        * p_pool;
+
+    pthread_mutex_t   lock;
+    pthread_cond_t    budget_cond;      // Signalled when a file releases its memory
+    int64_t           bytes_in_flight;
+    int               num_failed;
+    int               num_skipped;
+} cli_batch;
+
+typedef struct cli_batch_file cli_batch_file;
+
+typedef struct cli_batch_band {
+    cli_batch_file * p_file;
+    int64_t          rom_offset;
+    int64_t          rom_size;
+} cli_batch_band;
+
+typedef struct cli_batch_chunk {
+    cli_batch_file * p_file;
+    int64_t          chunk;
+} cli_batch_chunk;
+
+// Runs once the input's hash is known
+typedef void (* cli_batch_hashed_func)(cli_batch_file *, uint64_t);
+
+struct cli_batch_file {
+    cli_batch      * p_batch;
+    const char     * p_in;
+    char           * p_out;
+    char           * p_palette;         // Sidecar palette of a decode, or NULL
+    int64_t          cost;              // Bytes reserved from the budget
+    uint64_t         index_key;         // Set when an index is in use
+    int              skipped;           // Output was already current
+    int              rom_mapped;        // rom_gfx.p_data is a file mapping
+
+    rom_gfx_data     rom_gfx;
+    app_gfx_data     app_gfx;
+    app_color_data   colorpal;
+    rom_stats        stats;
+
+    // Input being hashed in chunks (with an index)
+    const unsigned char * p_hash_data;
+    int64_t               hash_size;
+    uint64_t            * p_digests;
+    cli_batch_chunk     * p_chunks;
+    cli_batch_hashed_func p_hashed;
+
+    pthread_mutex_t  lock;              // Guards the fields below while bands or chunks run
+    cli_batch_band * p_bands;
+    int              bands_left;
+    int64_t          chunks_left;
+    int              status;
+};
+
+
+
+// <out dir or input dir>/<input name without extension>.<ext>
+static char * cli_batch_out_name(const char * p_in, const cli_batch_options * p_options)
+{
+    const char * p_base = strrchr(p_in, '/');
+    const char * p_ext;
+    size_t       dir_len;
+    size_t       base_len;
+    char       * p_out;
+
+    p_base   = (p_base) ? p_base + 1 : p_in;
+    p_ext    = strrchr(p_base, '.');
+    base_len = (p_ext && (p_ext != p_base)) ? (size_t)(p_ext - p_base) : strlen(p_base);
+
+    if (p_options->p_out_dir)
+        dir_len = strlen(p_options->p_out_dir) + 1;
+    else
+        dir_len = (size_t)(p_base - p_in);
+
+    if (NULL == (p_out = malloc(dir_len + base_len + strlen(p_options->p_out_ext) + 2)))
+        return NULL;
+
+    if (p_options->p_out_dir)
+        sprintf(p_out, "%s/", p_options->p_out_dir);
+    else
+        memcpy(p_out, p_in, dir_len);
+
+    memcpy(p_out + dir_len, p_base, base_len);
+    sprintf(p_out + dir_len + base_len, ".%s", p_options->p_out_ext);
+
+    return p_out;
+}
+
+
+
+// Input plus decoded image plus output, from the file headers alone.
+// Files that can't be sized cost nothing, their task reports the error
+static int64_t cli_batch_estimate_cost(const char * p_in, const cli_batch_options * p_options)
+{
+    int64_t      file_size = cli_file_stat_size(p_in);
+    unsigned int width, height;
+
+    if (file_size <= 0)
+        return 0;
+
+    if (p_options->decode) {
+        rom_gfx_data   rom_gfx;
+        app_gfx_data   app_gfx;
+        app_color_data colorpal;
+
+        rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+        rom_gfx.size            = file_size;
+        app_gfx.image_mode      = p_options->image_mode;
+        app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+
+        if (0 != rom_bin_decode_query(&rom_gfx, &app_gfx))
+            return file_size;
+
+        // The PNG is written row by row, so it adds little
+        return file_size + app_gfx.size;
+    }
+
+    if (0 != cli_png_query(p_in, &width, &height))
+        return file_size;
+
+    // At most one encoded byte per pixel
+    return file_size + ((int64_t)width * height * (BIN_BITDEPTH_INDEXED_ALPHA + 1));
+}
+
+
+
+// Blocks until the file fits in the budget. A file larger
+// than the whole budget still runs, just on its own
+static void cli_batch_reserve(cli_batch * p_batch, int64_t cost)
+{
+    pthread_mutex_lock(&p_batch->lock);
+
+    while ((p_batch->bytes_in_flight > 0) &&
+           ((p_batch->bytes_in_flight + cost) > p_batch->p_options->max_bytes))
+        pthread_cond_wait(&p_batch->budget_cond, &p_batch->lock);
+
+    p_batch->bytes_in_flight += cost;
+
+    pthread_mutex_unlock(&p_batch->lock);
+}
+
+
+
+// Last step for every file, from whichever worker finished it
+static void cli_batch_file_done(cli_batch_file * p_file)
+{
+    cli_batch * p_batch = p_file->p_batch;
+
+    rom_stats_set_status(p_file->app_gfx.p_stats, p_file->status);
+    rom_stats_end(p_file->app_gfx.p_stats);
+
+    if ((0 == p_file->status) && !p_file->skipped)
+        cli_index_set(p_batch->p_options->p_index, p_file->index_key, p_file->p_out);
+
+    if (p_file->rom_mapped) {
+        cli_file_unmap(p_file->rom_gfx.p_data, p_file->rom_gfx.size);
+        p_file->rom_gfx.p_data = NULL;
+    }
+
+    rom_bin_free_structs(&p_file->rom_gfx, &p_file->app_gfx, &p_file->colorpal);
+
+    pthread_mutex_lock(&p_batch->lock);
+
+    p_batch->bytes_in_flight -= p_file->cost;
+    if (0 != p_file->status)
+        p_batch->num_failed++;
+    if (p_file->skipped)
+        p_batch->num_skipped++;
+
+    pthread_cond_broadcast(&p_batch->budget_cond);
+    pthread_mutex_unlock(&p_batch->lock);
+
+    pthread_mutex_destroy(&p_file->lock);
+    free(p_file->p_bands);
+    free(p_file->p_palette);
+    free(p_file->p_out);
+    free(p_file);
+}
+
+
+
+// Works out the file's index key, and whether its output is
+// already what this conversion would produce
+static int cli_batch_is_current(cli_batch_file * p_file, uint64_t input_hash)
+{
+    const cli_batch_options * p_options = p_file->p_batch->p_options;
+    char                      params[96];
+    char                    * p_params;
+    uint64_t                  palette_hash = 0;
+    size_t                    size;
+
+    // An unreadable palette fails the file later, never skip it
+    if (p_file->p_palette && (0 != cli_hash_file(p_file->p_palette, &palette_hash)))
+        return 0;
+
+    snprintf(params, sizeof(params), "%s %s %016" PRIx64 " ",
+             (p_options->decode) ? "decode" : "encode", rom_bin_mode_name(p_options->image_mode),
+             palette_hash);
+
+    // The output name is part of the key: one input can feed several outputs
+    size = strlen(params) + strlen(p_file->p_out) + 1;
+    if (NULL == (p_params = malloc(size)))
+        return 0;
+
+    snprintf(p_params, size, "%s%s", params, p_file->p_out);
+    p_file->index_key = cli_index_key(input_hash, p_params);
+    free(p_params);
+
+    p_file->skipped = cli_index_is_current(p_options->p_index, p_file->index_key, p_file->p_out);
+
+    return p_file->skipped;
+}
+
+
+
+static void cli_batch_write_png(cli_batch_file * p_file)
+{
+    if (p_file->p_palette && (0 != cli_palette_load(p_file->p_palette, &p_file->colorpal))) {
+        fprintf(stderr, "%s: can't load palette %s\n", CLI_NAME, p_file->p_palette);
+        p_file->status = -1;
+        return;
+    }
+
+    rom_stats_start(p_file->app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+
+    if (0 != cli_png_write(p_file->p_out, &p_file->app_gfx, &p_file->colorpal)) {
+        fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_file->p_out);
+        p_file->status = -1;
+    }
+
+    rom_stats_stop(p_file->app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+}
+
+
+
+// Copies the tiles of a decoded band to their place in the file's image.
+// The image width depends on the rom size, so a band decodes with its own
+// (narrower) layout and tiles have to be moved one by one
+static void cli_batch_place_band(cli_batch_file * p_file, cli_batch_band * p_band, app_gfx_data * p_band_gfx)
+{
+    const rom_gfx_attrib * p_attrib   = rom_bin_mode_attrib(p_file->app_gfx.image_mode);
+    int64_t                tile_bytes = rom_bin_tile_bytes(p_file->app_gfx.image_mode);
+    int64_t                tile_row_bytes = (int64_t)p_attrib->TILE_PIXEL_WIDTH * BIN_BITDEPTH_INDEXED_ALPHA;
+    int64_t                src_stride = (int64_t)p_band_gfx->width * BIN_BITDEPTH_INDEXED_ALPHA;
+    int64_t                dst_stride = (int64_t)p_file->app_gfx.width * BIN_BITDEPTH_INDEXED_ALPHA;
+    int64_t                src_tiles_per_row = p_band_gfx->width / p_attrib->TILE_PIXEL_WIDTH;
+    int64_t                dst_tiles_per_row = p_file->app_gfx.width / p_attrib->TILE_PIXEL_WIDTH;
+    int64_t                first_tile = p_band->rom_offset / tile_bytes;
+    int64_t                num_tiles  = p_band->rom_size / tile_bytes;
+    int64_t                t;
+    unsigned int           y;
+
+    for (t = 0; t < num_tiles; t++) {
+        int64_t               tile = first_tile + t;
+        const unsigned char * p_src;
+        unsigned char       * p_dst;
+
+        p_src = p_band_gfx->p_data
+                + ((t / src_tiles_per_row) * p_attrib->TILE_PIXEL_HEIGHT * src_stride)
+                + ((t % src_tiles_per_row) * tile_row_bytes);
+        p_dst = p_file->app_gfx.p_data
+                + ((tile / dst_tiles_per_row) * p_attrib->TILE_PIXEL_HEIGHT * dst_stride)
+                + ((tile % dst_tiles_per_row) * tile_row_bytes);
+
+        for (y = 0; y < p_attrib->TILE_PIXEL_HEIGHT; y++)
+            memcpy(p_dst + (y * dst_stride), p_src + (y * src_stride), (size_t)tile_row_bytes);
+    }
+}
+
+
+
+// Decodes one run of tiles of the shared rom data. The last band also
+// carries the surplus bytes, so it ends exactly like the full file would
+static void cli_batch_decode_band(void * p_arg)
+{
+    cli_batch_band * p_band = p_arg;
+    cli_batch_file * p_file = p_band->p_file;
+    rom_gfx_data     rom_gfx;
+    app_gfx_data     app_gfx;
+    app_color_data   colorpal;
+    int              status;
+    int              last;
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    rom_gfx.p_data          = p_file->rom_gfx.p_data + p_band->rom_offset;
+    rom_gfx.size            = p_band->rom_size;
+    app_gfx.image_mode      = p_file->app_gfx.image_mode;
+    app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+
+    status = rom_bin_decode(&rom_gfx, &app_gfx, &colorpal);
+
+    if (0 == status)
+        cli_batch_place_band(p_file, p_band, &app_gfx);
+
+    pthread_mutex_lock(&p_file->lock);
+
+    if (0 != status)
+        p_file->status = -1;
+
+    // Keep one color map, and the surplus bytes from the last band
+    if ((NULL == p_file->colorpal.p_data) && (NULL != colorpal.p_data)) {
+        p_file->colorpal = colorpal;
+        colorpal.p_data  = NULL;
+    }
+
+    if (NULL != app_gfx.p_surplus_bytes) {
+        p_file->app_gfx.p_surplus_bytes    = app_gfx.p_surplus_bytes;
+        p_file->app_gfx.surplus_bytes_size = app_gfx.surplus_bytes_size;
+        app_gfx.p_surplus_bytes = NULL;
+    }
+
+    last = (0 == --p_file->bands_left);
+
+    pthread_mutex_unlock(&p_file->lock);
+
+    // The rom data is the file's, don't free it here
+    rom_gfx.p_data = NULL;
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    if (!last)
+        return;
+
+    rom_stats_stop(p_file->app_gfx.p_stats, ROM_STATS_TIME_DECODE);
+
+    if (0 != p_file->status)
+        fprintf(stderr, "%s: can't decode %s as %s\n", CLI_NAME, p_file->p_in, rom_bin_mode_name(p_file->app_gfx.image_mode));
+    else
+        cli_batch_write_png(p_file);
+
+    cli_batch_file_done(p_file);
+}
+
+
+
+// Splits a rom into bands of tiles and queues them.
+// Returns -1 if the file is too small to be worth splitting
+static int cli_batch_split_bands(cli_batch_file * p_file)
+{
+    const rom_gfx_attrib * p_attrib   = rom_bin_mode_attrib(p_file->app_gfx.image_mode);
+    int64_t                tile_bytes = rom_bin_tile_bytes(p_file->app_gfx.image_mode);
+    int64_t                band_bytes;
+    int64_t                num_bands;
+    int64_t                last_row_bytes;
+    size_t                 image_size;
+    int64_t                c;
+
+    if ((NULL == p_attrib) || (tile_bytes <= 0))
+        return -1;
+
+    band_bytes = (CLI_BATCH_BAND_BYTES / tile_bytes) * tile_bytes;
+    num_bands  = p_file->rom_gfx.size / band_bytes;
+
+    if (num_bands < 2)
+        return -1;
+
+    if ((0 != rom_bin_calc_alloc_size((uint64_t)p_file->app_gfx.width * p_file->app_gfx.height,
+                                      BIN_BITDEPTH_INDEXED_ALPHA, &image_size)) ||
+        (NULL == (p_file->app_gfx.p_data = rom_bin_alloc(image_size))) ||
+        (NULL == (p_file->p_bands = calloc((size_t)num_bands, sizeof(cli_batch_band)))))
+        return -1;
+
+    p_file->app_gfx.size = (int64_t)image_size;
+    p_file->bands_left   = (int)num_bands;
+
+    // Only the last row of tiles can have unused (transparent) tile
+    // slots, clear it and let the bands fill in the real tiles
+    last_row_bytes = (int64_t)p_file->app_gfx.width * BIN_BITDEPTH_INDEXED_ALPHA * p_attrib->TILE_PIXEL_HEIGHT;
+    memset(p_file->app_gfx.p_data + image_size - last_row_bytes, 0, (size_t)last_row_bytes);
+
+    for (c = 0; c < num_bands; c++) {
+        cli_batch_band * p_band = &p_file->p_bands[c];
+
+        p_band->p_file     = p_file;
+        p_band->rom_offset = c * band_bytes;
+
+        // The last band runs to the end of the file
+        if (c == (num_bands - 1))
+            p_band->rom_size = p_file->rom_gfx.size - p_band->rom_offset;
+        else
+            p_band->rom_size = band_bytes;
+    }
+
+    // Stays on this worker's deque unless another one is idle
+    for (c = 0; c < num_bands; c++)
+        cli_pool_submit(p_file->p_batch->p_pool, cli_batch_decode_band, &p_file->p_bands[c]);
+
+    return 0;
+}
+
+
+
+// Pool task: one chunk of the input. The last one to finish combines
+// the digests and carries on with the file
+static void cli_batch_hash_chunk(void * p_arg)
+{
+    cli_batch_chunk * p_chunk = p_arg;
+    cli_batch_file  * p_file  = p_chunk->p_file;
+    uint64_t          hash;
+    int               last;
+
+    p_file->p_digests[p_chunk->chunk] = cli_hash_chunk(p_file->p_hash_data, p_file->hash_size, p_chunk->chunk);
+
+    pthread_mutex_lock(&p_file->lock);
+    last = (0 == --p_file->chunks_left);
+    pthread_mutex_unlock(&p_file->lock);
+
+    if (!last)
+        return;
+
+    hash = cli_hash_combine(p_file->p_digests, cli_hash_num_chunks(p_file->hash_size), p_file->hash_size);
+
+    free(p_file->p_digests);
+    free(p_file->p_chunks);
+    p_file->p_digests = NULL;
+    p_file->p_chunks  = NULL;
+
+    p_file->p_hashed(p_file, hash);
+}
+
+
+
+// Hashes the input on the pool, one task per chunk so a single large
+// file still uses every worker, then calls p_hashed from the last one.
+// Small inputs are hashed right here
+static void cli_batch_hash(cli_batch_file * p_file, const unsigned char * p_data, int64_t size,
+                           cli_batch_hashed_func p_hashed)
+{
+    int64_t num_chunks = cli_hash_num_chunks(size);
+    int64_t c;
+
+    p_file->p_hash_data = p_data;
+    p_file->hash_size   = size;
+    p_file->p_hashed    = p_hashed;
+
+    if ((num_chunks > 1) &&
+        (NULL != (p_file->p_digests = malloc((size_t)num_chunks * sizeof(uint64_t)))) &&
+        (NULL != (p_file->p_chunks  = malloc((size_t)num_chunks * sizeof(cli_batch_chunk))))) {
+        p_file->chunks_left = num_chunks;
+
+        for (c = 0; c < num_chunks; c++) {
+            p_file->p_chunks[c].p_file = p_file;
+            p_file->p_chunks[c].chunk  = c;
+            cli_pool_submit(p_file->p_batch->p_pool, cli_batch_hash_chunk, &p_file->p_chunks[c]);
+        }
+        return;
+    }
+
+    free(p_file->p_digests);
+    p_file->p_digests = NULL;
+
+    p_hashed(p_file, cli_hash_content(p_data, size));
+}
+
+
+
+// Decodes the rom once it is read, or mapped and found to have changed
+static void cli_batch_decode_rom(cli_batch_file * p_file)
+{
+    app_gfx_data * p_app = &p_file->app_gfx;
+
+    if (NULL == p_file->rom_gfx.p_data) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_file->p_in);
+        p_file->status = -1;
+        cli_batch_file_done(p_file);
+        return;
+    }
+
+    rom_stats_stop(p_app->p_stats, ROM_STATS_TIME_FILE_READ);
+    rom_stats_add(p_app->p_stats, ROM_STATS_COUNT_BYTES_COPIED, p_file->rom_gfx.size);
+    rom_stats_start(p_app->p_stats, ROM_STATS_TIME_DECODE);
+
+    // Large roms: the bands finish the file
+    if ((0 == rom_bin_decode_query(&p_file->rom_gfx, p_app)) &&
+        (0 == cli_batch_split_bands(p_file)))
+        return;
+
+    // A failed split may have left its image buffer behind
+    rom_bin_free(p_app->p_data);
+    p_app->p_data = NULL;
+
+    if (0 != rom_bin_decode(&p_file->rom_gfx, p_app, &p_file->colorpal)) {
+        fprintf(stderr, "%s: can't decode %s as %s\n", CLI_NAME, p_file->p_in, rom_bin_mode_name(p_app->image_mode));
+        p_file->status = -1;
+    }
+    else
+        cli_batch_write_png(p_file);
+
+    cli_batch_file_done(p_file);
+}
+
+
+
+static void cli_batch_decode_hashed(cli_batch_file * p_file, uint64_t input_hash)
+{
+    if (cli_batch_is_current(p_file, input_hash))
+        cli_batch_file_done(p_file);
+    else
+        cli_batch_decode_rom(p_file);
+}
+
+
+
+static void cli_batch_decode_file(void * p_arg)
+{
+    cli_batch_file * p_file = p_arg;
+
+    // As with decode, a palette saved next to the input is used
+    p_file->p_palette = cli_palette_find_sidecar(p_file->p_in);
+
+    rom_stats_start(p_file->app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+
+    // With an index the rom is mapped to hash it, and decoded
+    // from the mapping if it changed
+    if (p_file->p_batch->p_options->p_index) {
+        if (0 == cli_file_map(p_file->p_in, &p_file->rom_gfx.p_data, &p_file->rom_gfx.size)) {
+            p_file->rom_mapped = 1;
+
+            cli_batch_hash(p_file, p_file->rom_gfx.p_data, p_file->rom_gfx.size, cli_batch_decode_hashed);
+            return;
+        }
+    }
+    else
+        cli_file_pread(p_file->p_in, &p_file->rom_gfx.p_data, &p_file->rom_gfx.size);
+
+    cli_batch_decode_rom(p_file);
+}
+
+
+
+// Encoding trims trailing transparent tiles across the whole image,
+// so it isn't split into bands
+static void cli_batch_encode_png(cli_batch_file * p_file)
+{
+    app_gfx_data * p_app = &p_file->app_gfx;
+
+    if (0 != cli_png_read(p_file->p_in, p_app)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_file->p_in);
+        p_file->status = -1;
+    }
+    else {
+        rom_stats_stop(p_app->p_stats, ROM_STATS_TIME_FILE_READ);
+
+        if (0 != rom_bin_encode(&p_file->rom_gfx, p_app)) {
+            fprintf(stderr, "%s: can't encode %s as %s\n", CLI_NAME, p_file->p_in, rom_bin_mode_name(p_app->image_mode));
+            p_file->status = -1;
+        }
+        else {
+            rom_stats_start(p_app->p_stats, ROM_STATS_TIME_FILE_WRITE);
+
+            if (0 != cli_file_write(p_file->p_out, p_file->rom_gfx.p_data, p_file->rom_gfx.size)) {
+                fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_file->p_out);
+                p_file->status = -1;
+            }
+
+            rom_stats_stop(p_app->p_stats, ROM_STATS_TIME_FILE_WRITE);
+            rom_stats_add(p_app->p_stats, ROM_STATS_COUNT_BYTES_COPIED, p_file->rom_gfx.size);
+        }
+    }
+
+    cli_batch_file_done(p_file);
+}
+
+
+
+// The png was mapped only to hash it, cli_png_read reads it again
+static void cli_batch_encode_hashed(cli_batch_file * p_file, uint64_t input_hash)
+{
+    cli_file_unmap((unsigned char *)p_file->p_hash_data, p_file->hash_size);
+    p_file->p_hash_data = NULL;
+
+    if (cli_batch_is_current(p_file, input_hash))
+        cli_batch_file_done(p_file);
+    else
+        cli_batch_encode_png(p_file);
+}
+
+
+
+static void cli_batch_encode_file(void * p_arg)
+{
+    cli_batch_file * p_file = p_arg;
+    unsigned char  * p_data;
+    int64_t          size;
+
+    rom_stats_start(p_file->app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+
+    if (p_file->p_batch->p_options->p_index &&
+        (0 == cli_file_map(p_file->p_in, &p_data, &size))) {
+        cli_batch_hash(p_file, p_data, size, cli_batch_encode_hashed);
+        return;
+    }
+
+    cli_batch_encode_png(p_file);
+}
+
+
+
+// Converts every file, returns the number that failed
+int cli_batch_run(char ** pp_filenames, int num_files, const cli_batch_options * p_options)
+{
+    cli_batch batch;
+    int       c;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.p_options = p_options;
+
+    if (NULL == (batch.p_pool = cli_pool_new(p_options->num_threads))) {
+        fprintf(stderr, "%s: can't start worker threads\n", CLI_NAME);
+        return num_files;
+    }
+
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.budget_cond, NULL);
+
+    for (c = 0; c < num_files; c++) {
+        cli_batch_file * p_file = calloc(1, sizeof(cli_batch_file));
+
+        if ((NULL == p_file) ||
+            (NULL == (p_file->p_out = cli_batch_out_name(pp_filenames[c], p_options)))) {
+            fprintf(stderr, "%s: out of memory for %s\n", CLI_NAME, pp_filenames[c]);
+            free(p_file);
+
+            pthread_mutex_lock(&batch.lock);
+            batch.num_failed++;
+            pthread_mutex_unlock(&batch.lock);
+            continue;
+        }
+
+        p_file->p_batch = &batch;
+        p_file->p_in    = pp_filenames[c];
+        p_file->cost    = cli_batch_estimate_cost(p_file->p_in, p_options);
+        pthread_mutex_init(&p_file->lock, NULL);
+
+        rom_bin_init_structs(&p_file->rom_gfx, &p_file->app_gfx, &p_file->colorpal);
+        p_file->app_gfx.image_mode      = p_options->image_mode;
+        p_file->app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+        p_file->app_gfx.p_stats         = rom_stats_begin(&p_file->stats,
+                                                          (p_options->decode) ? "decode" : "encode",
+                                                          p_file->p_in, p_options->image_mode);
+
+        cli_batch_reserve(&batch, p_file->cost);
+
+        cli_pool_submit(batch.p_pool,
+                        (p_options->decode) ? cli_batch_decode_file : cli_batch_encode_file,
+                        p_file);
+    }
+
+    cli_pool_wait(batch.p_pool);
+    cli_pool_free(batch.p_pool);
+
+    pthread_cond_destroy(&batch.budget_cond);
+    pthread_mutex_destroy(&batch.lock);
+
+    if (batch.num_skipped > 0)
+        printf("%d of %d files unchanged\n", batch.num_skipped, num_files);
+
+    if (batch.num_failed > 0)
+        fprintf(stderr, "%s: %d of %d files failed\n", CLI_NAME, batch.num_failed, num_files);
+
+    return batch.num_failed;
+}
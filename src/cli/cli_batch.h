@@ -0,0 +1,38 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_BATCH_HEADER
+#define CLI_BATCH_HEADER
+
+#include "cli_index.h"
+
+#include <stdint.h>
+
+    typedef struct cli_batch_options {
+        int          decode;          // Non-zero: rom -> png, otherwise png -> rom
+        int          image_mode;
+        int          num_threads;     // 0 = one per processor
+        int64_t      max_bytes;       // Approximate memory in flight across all files
+        const char * p_out_dir;       // NULL = next to each input file
+        const char * p_out_ext;       // Replaces the input extension
+        cli_index  * p_index;         // Skip unchanged inputs, NULL = convert everything
+    } cli_batch_options;
+
+    int cli_batch_run(char **, int, const cli_batch_options *);
+
+#endif // CLI_BATCH_HEADER
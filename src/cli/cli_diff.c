@@ -0,0 +1,284 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Tile level diff of two roms (or two windows of them) in one mode.
+//
+// Tiles are compared as encoded bytes, which is the same as comparing
+// their pixels. The windows are split in blocks that are checked on the
+// pool: a block equal as a whole (a vectorized memcmp) is skipped, the
+// others are compared tile by tile, 8 bytes at a time.
+
+#include "lib_rom_bin.h"
+#include "cli_diff.h"
+#include "cli_file.h"
+#include "cli_png.h"
+#include "cli_pool.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+// Work unit for the pool
+#define CLI_DIFF_BLOCK_BYTES  (256 * 1024)
+
+typedef struct cli_diff {
+    const unsigned char * p_a;        // Start of each window
+    const unsigned char * p_b;
+    int64_t               length;
+    int64_t               tile_bytes;
+    int64_t               num_tiles;
+    unsigned char       * p_changed;  // One flag per tile
+} cli_diff;
+
+typedef struct cli_diff_block {
+    cli_diff * p_diff;
+    int64_t    first_tile;
+    int64_t    num_tiles;
+} cli_diff_block;
+
+
+
+static int cli_diff_tile_changed(const unsigned char * p_a, const unsigned char * p_b, int64_t len)
+{
+    uint64_t a;
+    uint64_t b;
+
+    for (; len >= 8; len -= 8, p_a += 8, p_b += 8) {
+        memcpy(&a, p_a, 8);
+        memcpy(&b, p_b, 8);
+        if (a != b)
+            return 1;
+    }
+
+    return (len > 0) && (0 != memcmp(p_a, p_b, (size_t)len));
+}
+
+
+
+// Pool task
+static void cli_diff_block_run(void * p_arg)
+{
+    cli_diff_block * p_block = p_arg;
+    cli_diff       * p_diff  = p_block->p_diff;
+    int64_t          start   = p_block->first_tile * p_diff->tile_bytes;
+    int64_t          end     = start + (p_block->num_tiles * p_diff->tile_bytes);
+    int64_t          tile;
+
+    // The last tile may be cut short by the end of the window
+    if (end > p_diff->length)
+        end = p_diff->length;
+
+    if (0 == memcmp(p_diff->p_a + start, p_diff->p_b + start, (size_t)(end - start)))
+        return;
+
+    for (tile = p_block->first_tile; tile < p_block->first_tile + p_block->num_tiles; tile++) {
+        int64_t pos = tile * p_diff->tile_bytes;
+        int64_t len = (pos + p_diff->tile_bytes > end) ? end - pos : p_diff->tile_bytes;
+
+        p_diff->p_changed[tile] = (unsigned char)cli_diff_tile_changed(p_diff->p_a + pos, p_diff->p_b + pos, len);
+    }
+}
+
+
+
+static int cli_diff_compare(cli_diff * p_diff, int num_threads)
+{
+    cli_diff_block * p_blocks;
+    cli_pool       * p_pool;
+    int64_t          tiles_per_block = CLI_DIFF_BLOCK_BYTES / p_diff->tile_bytes;
+    int64_t          num_blocks = (p_diff->num_tiles + tiles_per_block - 1) / tiles_per_block;
+    int64_t          c;
+
+    if (NULL == (p_blocks = malloc((size_t)num_blocks * sizeof(cli_diff_block))))
+        return -1;
+
+    if (NULL == (p_pool = cli_pool_new(num_threads))) {
+        fprintf(stderr, "%s: can't start worker threads\n", CLI_NAME);
+        free(p_blocks);
+        return -1;
+    }
+
+    for (c = 0; c < num_blocks; c++) {
+        p_blocks[c].p_diff     = p_diff;
+        p_blocks[c].first_tile = c * tiles_per_block;
+        p_blocks[c].num_tiles  = (c + 1 < num_blocks) ? tiles_per_block
+                                                      : p_diff->num_tiles - (c * tiles_per_block);
+        cli_pool_submit(p_pool, cli_diff_block_run, &p_blocks[c]);
+    }
+
+    cli_pool_wait(p_pool);
+    cli_pool_free(p_pool);
+    free(p_blocks);
+
+    return 0;
+}
+
+
+
+// Decodes the second window and writes it with the unchanged tiles
+// dimmed and the changed ones outlined in red
+static int cli_diff_highlight(cli_diff * p_diff, int image_mode, const char * p_filename)
+{
+    const rom_gfx_attrib * p_attrib = rom_bin_mode_attrib(image_mode);
+    rom_gfx_data           rom_gfx;
+    app_gfx_data           app_gfx;
+    app_color_data         colorpal;
+    unsigned char        * p_rgba;
+    unsigned int           x, y;
+    int                    status = -1;
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    rom_gfx.p_data          = (unsigned char *)p_diff->p_b;
+    rom_gfx.size            = p_diff->length;
+    app_gfx.image_mode      = image_mode;
+    app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+
+    if (0 != rom_bin_decode(&rom_gfx, &app_gfx, &colorpal)) {
+        fprintf(stderr, "%s: can't decode as %s\n", CLI_NAME, rom_bin_mode_name(image_mode));
+        rom_gfx.p_data = NULL;
+        rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+        return -1;
+    }
+
+    p_rgba = malloc((size_t)app_gfx.width * app_gfx.height * 4);
+
+    for (y = 0; p_rgba && (y < app_gfx.height); y++) {
+        for (x = 0; x < app_gfx.width; x++) {
+            const unsigned char * p_pixel = app_gfx.p_data + (((size_t)y * app_gfx.width) + x) * 2;
+            const unsigned char * p_color = colorpal.p_data + ((size_t)p_pixel[0] * colorpal.bytes_per_pixel);
+            unsigned char       * p_out   = p_rgba + (((size_t)y * app_gfx.width) + x) * 4;
+            unsigned int          tile_x  = x % p_attrib->TILE_PIXEL_WIDTH;
+            unsigned int          tile_y  = y % p_attrib->TILE_PIXEL_HEIGHT;
+            int64_t               tile    = ((int64_t)(y / p_attrib->TILE_PIXEL_HEIGHT) * (app_gfx.width / p_attrib->TILE_PIXEL_WIDTH))
+                                          + (x / p_attrib->TILE_PIXEL_WIDTH);
+            int                   changed = (tile < p_diff->num_tiles) && p_diff->p_changed[tile];
+
+            p_out[3] = p_pixel[1];
+
+            if (changed && ((tile_x == 0) || (tile_y == 0) ||
+                            (tile_x == p_attrib->TILE_PIXEL_WIDTH - 1) ||
+                            (tile_y == p_attrib->TILE_PIXEL_HEIGHT - 1))) {
+                p_out[0] = 0xFF;
+                p_out[1] = 0x00;
+                p_out[2] = 0x00;
+                p_out[3] = 0xFF;
+            }
+            else if (changed) {
+                p_out[0] = p_color[0];
+                p_out[1] = p_color[1];
+                p_out[2] = p_color[2];
+            }
+            else {
+                p_out[0] = p_color[0] / 4;
+                p_out[1] = p_color[1] / 4;
+                p_out[2] = p_color[2] / 4;
+            }
+        }
+    }
+
+    if (NULL == p_rgba)
+        fprintf(stderr, "%s: out of memory\n", CLI_NAME);
+    else if (0 != cli_png_write_rgba(p_filename, app_gfx.width, app_gfx.height, p_rgba))
+        fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_filename);
+    else
+        status = 0;
+
+    free(p_rgba);
+
+    // The rom data belongs to the mapping
+    rom_gfx.p_data = NULL;
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    return status;
+}
+
+
+
+// Prints the changed tiles, with their offset in each rom
+int cli_diff_run(const char * p_name_a, const char * p_name_b, const cli_diff_options * p_options)
+{
+    cli_diff        diff;
+    unsigned char * p_data_a = NULL;
+    unsigned char * p_data_b = NULL;
+    int64_t         size_a = 0;
+    int64_t         size_b = 0;
+    int64_t         num_changed = 0;
+    int64_t         tile;
+    int             status = -1;
+
+    memset(&diff, 0, sizeof(diff));
+
+    if ((0 != cli_file_map(p_name_a, &p_data_a, &size_a)) ||
+        (0 != cli_file_map(p_name_b, &p_data_b, &size_b))) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, (p_data_a) ? p_name_b : p_name_a);
+        goto done;
+    }
+
+    if ((p_options->offset_a >= size_a) || (p_options->offset_b >= size_b)) {
+        fprintf(stderr, "%s: offset past the end of the rom\n", CLI_NAME);
+        goto done;
+    }
+
+    // The window is as long as both roms allow
+    diff.length = size_a - p_options->offset_a;
+    if (diff.length > size_b - p_options->offset_b)
+        diff.length = size_b - p_options->offset_b;
+    if ((p_options->length > 0) && (diff.length > p_options->length))
+        diff.length = p_options->length;
+
+    diff.p_a        = p_data_a + p_options->offset_a;
+    diff.p_b        = p_data_b + p_options->offset_b;
+    diff.tile_bytes = rom_bin_tile_bytes(p_options->image_mode);
+    diff.num_tiles  = (diff.length + diff.tile_bytes - 1) / diff.tile_bytes;
+
+    if (NULL == (diff.p_changed = calloc((size_t)diff.num_tiles, 1)))
+        goto done;
+
+    if (0 != cli_diff_compare(&diff, p_options->num_threads))
+        goto done;
+
+    printf("%8s %10s %10s\n", "tile", "offset_a", "offset_b");
+
+    for (tile = 0; tile < diff.num_tiles; tile++) {
+        if (!diff.p_changed[tile])
+            continue;
+
+        printf("%8" PRId64 " %#10" PRIx64 " %#10" PRIx64 "\n", tile,
+               p_options->offset_a + (tile * diff.tile_bytes), p_options->offset_b + (tile * diff.tile_bytes));
+        num_changed++;
+    }
+
+    printf("%" PRId64 " of %" PRId64 " tiles changed\n", num_changed, diff.num_tiles);
+
+    status = 0;
+
+    if (p_options->p_highlight && (0 != cli_diff_highlight(&diff, p_options->image_mode, p_options->p_highlight)))
+        status = -1;
+
+done:
+    free(diff.p_changed);
+    cli_file_unmap(p_data_a, size_a);
+    cli_file_unmap(p_data_b, size_b);
+
+    return status;
+}
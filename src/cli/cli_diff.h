@@ -0,0 +1,35 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_DIFF_HEADER
+#define CLI_DIFF_HEADER
+
+#include <stdint.h>
+
+    typedef struct cli_diff_options {
+        int          image_mode;
+        int64_t      offset_a;        // Start of the window in each rom
+        int64_t      offset_b;
+        int64_t      length;          // 0 = as far as both roms go
+        int          num_threads;     // 0 = one per processor
+        const char * p_highlight;     // PNG of the second rom with the changes marked, NULL = none
+    } cli_diff_options;
+
+    int cli_diff_run(const char *, const char *, const cli_diff_options *);
+
+#endif // CLI_DIFF_HEADER
@@ -0,0 +1,290 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "cli_file.h"
+#include "lib_rom_bin.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+
+
+// Get the file size without 32-bit ftell() truncation
+static int64_t cli_file_size(FILE * file)
+{
+    int64_t size;
+
+#ifdef _WIN32
+    _fseeki64(file, 0, SEEK_END);
+    size = _ftelli64(file);
+    _fseeki64(file, 0, SEEK_SET);
+#else
+    fseeko(file, 0, SEEK_END);
+    size = ftello(file);
+    fseeko(file, 0, SEEK_SET);
+#endif
+
+    return size;
+}
+
+
+
+// Reads a whole file into a buffer from rom_bin_alloc(),
+// so it can be handed to the library as rom data
+int cli_file_read(const char * filename, unsigned char ** pp_data, int64_t * p_size)
+{
+    FILE * file;
+    size_t alloc_size;
+
+    *pp_data = NULL;
+    *p_size  = 0;
+
+    file = fopen(filename, "rb");
+    if (!file)
+        return -1;
+
+    *p_size = cli_file_size(file);
+
+    if ((*p_size <= 0) ||
+        (0 != rom_bin_calc_alloc_size((uint64_t)*p_size, 1, &alloc_size)) ||
+        (NULL == (*pp_data = rom_bin_alloc(alloc_size))) ||
+        (1 != fread(*pp_data, alloc_size, 1, file))) {
+
+        fclose(file);
+        rom_bin_free(*pp_data);
+        *pp_data = NULL;
+        return -1;
+    }
+
+    fclose(file);
+
+    return 0;
+}
+
+
+
+// File size without opening it, -1 if it can't be read
+int64_t cli_file_stat_size(const char * filename)
+{
+    struct stat info;
+
+    if ((0 != stat(filename, &info)) || !S_ISREG(info.st_mode))
+        return -1;
+
+    return (int64_t)info.st_size;
+}
+
+
+
+// cli_file_read() for the batch workers: one descriptor and positional
+// reads straight into the buffer, with no stdio buffering or shared
+// file position. The kernel is told the whole file is about to be read
+int cli_file_pread(const char * filename, unsigned char ** pp_data, int64_t * p_size)
+{
+#ifdef _WIN32
+    return cli_file_read(filename, pp_data, p_size);
+#else
+    struct stat info;
+    size_t      alloc_size;
+    int64_t     offset = 0;
+    int         fd;
+
+    *pp_data = NULL;
+    *p_size  = 0;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    if ((0 != fstat(fd, &info)) ||
+        (info.st_size <= 0) ||
+        (0 != rom_bin_calc_alloc_size((uint64_t)info.st_size, 1, &alloc_size)) ||
+        (NULL == (*pp_data = rom_bin_alloc(alloc_size)))) {
+        close(fd);
+        return -1;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, info.st_size, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    while (offset < (int64_t)info.st_size) {
+        ssize_t count = pread(fd, *pp_data + offset, (size_t)(info.st_size - offset), (off_t)offset);
+
+        if ((count < 0) && (errno == EINTR))
+            continue;
+
+        // Error, or the file shrank underneath us
+        if (count <= 0) {
+            close(fd);
+            rom_bin_free(*pp_data);
+            *pp_data = NULL;
+            return -1;
+        }
+
+        offset += count;
+    }
+
+    close(fd);
+
+    *p_size = (int64_t)info.st_size;
+
+    return 0;
+#endif
+}
+
+
+
+// Maps a whole file read-only, so several jobs can share one copy of a
+// rom without reading it. Falls back to reading it where there's no mmap
+int cli_file_map(const char * filename, unsigned char ** pp_data, int64_t * p_size)
+{
+#ifdef _WIN32
+    return cli_file_read(filename, pp_data, p_size);
+#else
+    struct stat info;
+    void      * p_map;
+    int         fd;
+
+    *pp_data = NULL;
+    *p_size  = 0;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    if ((0 != fstat(fd, &info)) || (info.st_size <= 0)) {
+        close(fd);
+        return -1;
+    }
+
+    p_map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (MAP_FAILED == p_map)
+        return -1;
+
+    *pp_data = p_map;
+    *p_size  = (int64_t)info.st_size;
+
+    return 0;
+#endif
+}
+
+
+
+void cli_file_unmap(unsigned char * p_data, int64_t size)
+{
+    if (NULL == p_data)
+        return;
+
+#ifdef _WIN32
+    rom_bin_free(p_data);
+#else
+    munmap(p_data, (size_t)size);
+#endif
+}
+
+
+
+int cli_file_write(const char * filename, const unsigned char * p_data, int64_t size)
+{
+    FILE * file;
+    int    status = 0;
+
+    file = fopen(filename, "wb");
+    if (!file)
+        return -1;
+
+    if ((size > 0) && (1 != fwrite(p_data, (size_t)size, 1, file)))
+        status = -1;
+
+    if (0 != fclose(file))
+        status = -1;
+
+    return status;
+}
+
+
+
+// <dir>/<name>, or just name if it's absolute or dir is empty. Free with free()
+char * cli_file_path_join(const char * p_dir, const char * p_name)
+{
+    size_t dir_len = (p_dir) ? strlen(p_dir) : 0;
+    char * p_path;
+
+    if ((p_name[0] == '/') || (dir_len == 0))
+        dir_len = 0;
+
+    if (NULL == (p_path = malloc(dir_len + strlen(p_name) + 2)))
+        return NULL;
+
+    if (dir_len > 0)
+        sprintf(p_path, "%s%s%s", p_dir, (p_dir[dir_len - 1] == '/') ? "" : "/", p_name);
+    else
+        strcpy(p_path, p_name);
+
+    return p_path;
+}
+
+
+
+// Folder part of a path, "" for a bare file name. Free with free()
+char * cli_file_dir_name(const char * p_path)
+{
+    const char * p_slash = strrchr(p_path, '/');
+    size_t       len     = (p_slash) ? (size_t)(p_slash - p_path) + 1 : 0;
+    char       * p_dir;
+
+    if (NULL == (p_dir = malloc(len + 1)))
+        return NULL;
+
+    memcpy(p_dir, p_path, len);
+    p_dir[len] = '\0';
+
+    return p_dir;
+}
+
+
+
+// Creates a folder, fine if it already exists
+int cli_file_make_dir(const char * p_dir)
+{
+    struct stat info;
+
+    if ((0 == stat(p_dir, &info)) && S_ISDIR(info.st_mode))
+        return 0;
+
+#ifdef _WIN32
+    return _mkdir(p_dir);
+#else
+    return mkdir(p_dir, 0777);
+#endif
+}
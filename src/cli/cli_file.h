@@ -0,0 +1,36 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_FILE_HEADER
+#define CLI_FILE_HEADER
+
+#include <stdint.h>
+
+    int cli_file_read(const char *, unsigned char **, int64_t *);
+    int cli_file_pread(const char *, unsigned char **, int64_t *);
+    int64_t cli_file_stat_size(const char *);
+
+    int  cli_file_map(const char *, unsigned char **, int64_t *);
+    void cli_file_unmap(unsigned char *, int64_t);
+
+    char * cli_file_path_join(const char *, const char *);
+    char * cli_file_dir_name(const char *);
+    int    cli_file_make_dir(const char *);
+    int cli_file_write(const char *, const unsigned char *, int64_t);
+
+#endif // CLI_FILE_HEADER
@@ -0,0 +1,754 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Finds where the tiles of an image are stored in a rom.
+//
+// The image's tiles are encoded in every mode (or the one asked for)
+// and all those byte patterns are looked for in a single pass over the
+// rom: each offset's first 8 bytes go through a bit filter, then a hash
+// table of patterns, and only candidates are compared in full. The rom
+// is split in chunks scanned on the pool. Hits are then grouped into
+// places, and each place reports how many different image tiles it has.
+//
+// The fuzzy search (a maximum distance) is for art stored with another
+// palette order. The rom is decoded in each mode at every alignment and
+// each tile's index plane is relabeled by first occurrence (the first
+// color seen becomes 0, the next new one 1...), which is the same for
+// any permutation of the palette. Planes are compared to the image's by
+// the number of pixels that differ, 8 pixels per 64-bit word.
+
+#include "lib_rom_bin.h"
+#include "cli_file.h"
+#include "cli_find.h"
+#include "cli_png.h"
+#include "cli_pool.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+#define CLI_FIND_CHUNK_BYTES  (1024 * 1024)
+#define CLI_FIND_FILTER_BITS  20
+
+// Hits closer than this many tiles of the image apart are the same place
+#define CLI_FIND_SITE_GAP     4
+
+// Every mode has 8x8 tiles
+#define CLI_FIND_TILE_PIXELS  64
+
+typedef struct cli_find_pattern {
+    const unsigned char * p_bytes;
+    int64_t               tile_bytes;
+    uint64_t              key;          // First 8 bytes
+    int                   image_mode;
+    int                   tile;         // Tile of the image
+} cli_find_pattern;
+
+typedef struct cli_find_hit {
+    int64_t offset;
+    int     pattern;
+    int     distance;
+} cli_find_hit;
+
+typedef struct cli_find_site {
+    int64_t offset;
+    int     image_mode;
+    int     num_tiles;                  // Different image tiles found
+    int     num_hits;
+    int64_t distance;                   // Total over the hits
+} cli_find_site;
+
+typedef struct cli_find {
+    const unsigned char * p_rom;
+    int64_t               rom_size;
+    int                   num_tiles;    // Tiles in the image
+
+    cli_find_pattern    * p_patterns;
+    int                   num_patterns;
+    unsigned char       * p_encoded[BIN_MODE_LAST];
+
+    int                 * p_table;      // Pattern indices, -1 = empty
+    uint64_t              table_mask;
+    uint64_t            * p_filter;     // One bit per key hash
+
+    // Fuzzy search
+    int                   max_distance;
+    unsigned char       * p_planes;     // Relabeled index plane of each image tile
+    int                   first_pattern[BIN_MODE_LAST];
+    int                   num_mode_patterns[BIN_MODE_LAST];
+} cli_find;
+
+// One per chunk (and mode, when fuzzy), filled by the pool
+typedef struct cli_find_chunk {
+    cli_find     * p_find;
+    int            image_mode;
+    int64_t        start;
+    int64_t        end;
+    cli_find_hit * p_hits;
+    int64_t        num_hits;
+    int64_t        max_hits;
+} cli_find_chunk;
+
+
+
+static uint64_t cli_find_read_key(const unsigned char * p_bytes)
+{
+    uint64_t key;
+
+    memcpy(&key, p_bytes, 8);
+
+    return key;
+}
+
+
+
+static uint64_t cli_find_hash(uint64_t key)
+{
+    return key * 0x9E3779B97F4A7C15ULL;
+}
+
+
+
+// Encodes the image in one mode and adds its tiles as patterns. Tiles
+// with transparent pixels, colors the mode can't hold, or a single
+// color (they'd match everywhere) are left out
+static int cli_find_add_mode(cli_find * p_find, app_gfx_data * p_app_gfx, int image_mode)
+{
+    const rom_gfx_attrib * p_attrib = rom_bin_mode_attrib(image_mode);
+    rom_gfx_data           rom_gfx;
+    int64_t                tile_bytes = rom_bin_tile_bytes(image_mode);
+    unsigned int           tiles_per_row;
+    unsigned int           x, y;
+    int                    tile;
+    int                    c;
+
+    if ((p_app_gfx->width % p_attrib->TILE_PIXEL_WIDTH) || (p_app_gfx->height % p_attrib->TILE_PIXEL_HEIGHT))
+        return 0;
+
+    memset(&rom_gfx, 0, sizeof(rom_gfx));
+    p_app_gfx->image_mode = image_mode;
+
+    if (0 != rom_bin_encode(&rom_gfx, p_app_gfx)) {
+        rom_bin_free(rom_gfx.p_data);
+        return 0;
+    }
+
+    p_find->p_encoded[image_mode] = rom_gfx.p_data;
+    tiles_per_row = p_app_gfx->width / p_attrib->TILE_PIXEL_WIDTH;
+
+    for (tile = 0; tile < p_find->num_tiles; tile++) {
+        const unsigned char * p_first = p_app_gfx->p_data +
+            ((((size_t)(tile / tiles_per_row) * p_attrib->TILE_PIXEL_HEIGHT * p_app_gfx->width) +
+              ((size_t)(tile % tiles_per_row) * p_attrib->TILE_PIXEL_WIDTH)) * 2);
+        int                   usable = 0;
+        int                   skip   = 0;
+
+        for (y = 0; !skip && (y < p_attrib->TILE_PIXEL_HEIGHT); y++)
+            for (x = 0; x < p_attrib->TILE_PIXEL_WIDTH; x++) {
+                const unsigned char * p_pixel = p_first + (((size_t)y * p_app_gfx->width) + x) * 2;
+
+                if ((p_pixel[1] == 0) || (p_pixel[0] >= (1u << p_attrib->BITS_PER_PIXEL)))
+                    skip = 1;
+                else if (p_pixel[0] != p_first[0])
+                    usable = 1;
+            }
+
+        if (skip || !usable || ((tile + 1) * tile_bytes > rom_gfx.size))
+            continue;
+
+        // A tile repeated in the image is looked for once
+        for (c = p_find->num_patterns - 1; c >= 0; c--)
+            if ((p_find->p_patterns[c].image_mode == image_mode) &&
+                (0 == memcmp(p_find->p_patterns[c].p_bytes, rom_gfx.p_data + (tile * tile_bytes), (size_t)tile_bytes)))
+                break;
+        if (c >= 0)
+            continue;
+
+        p_find->p_patterns[p_find->num_patterns].p_bytes    = rom_gfx.p_data + (tile * tile_bytes);
+        p_find->p_patterns[p_find->num_patterns].tile_bytes = tile_bytes;
+        p_find->p_patterns[p_find->num_patterns].key        = cli_find_read_key(rom_gfx.p_data + (tile * tile_bytes));
+        p_find->p_patterns[p_find->num_patterns].image_mode = image_mode;
+        p_find->p_patterns[p_find->num_patterns].tile       = tile;
+        p_find->num_patterns++;
+    }
+
+    return 0;
+}
+
+
+
+static int cli_find_build_table(cli_find * p_find)
+{
+    uint64_t size = 16;
+    int      c;
+
+    while (size < (uint64_t)p_find->num_patterns * 2)
+        size *= 2;
+
+    p_find->table_mask = size - 1;
+    p_find->p_table    = malloc(size * sizeof(int));
+    p_find->p_filter   = calloc(((size_t)1 << CLI_FIND_FILTER_BITS) / 64, sizeof(uint64_t));
+
+    if ((NULL == p_find->p_table) || (NULL == p_find->p_filter))
+        return -1;
+
+    memset(p_find->p_table, -1, size * sizeof(int));
+
+    for (c = 0; c < p_find->num_patterns; c++) {
+        uint64_t hash = cli_find_hash(p_find->p_patterns[c].key);
+        uint64_t slot = (hash >> 32) & p_find->table_mask;
+        uint64_t bit  = hash >> (64 - CLI_FIND_FILTER_BITS);
+
+        p_find->p_filter[bit / 64] |= 1ULL << (bit % 64);
+
+        while (p_find->p_table[slot] != -1)
+            slot = (slot + 1) & p_find->table_mask;
+        p_find->p_table[slot] = c;
+    }
+
+    return 0;
+}
+
+
+
+static int cli_find_add_hit(cli_find_chunk * p_chunk, int64_t offset, int pattern, int distance)
+{
+    if (p_chunk->num_hits == p_chunk->max_hits) {
+        int64_t        max_hits = (p_chunk->max_hits) ? p_chunk->max_hits * 2 : 64;
+        cli_find_hit * p_grown  = realloc(p_chunk->p_hits, (size_t)max_hits * sizeof(cli_find_hit));
+
+        if (NULL == p_grown)
+            return -1;
+
+        p_chunk->p_hits   = p_grown;
+        p_chunk->max_hits = max_hits;
+    }
+
+    p_chunk->p_hits[p_chunk->num_hits].offset  = offset;
+    p_chunk->p_hits[p_chunk->num_hits].pattern  = pattern;
+    p_chunk->p_hits[p_chunk->num_hits].distance = distance;
+    p_chunk->num_hits++;
+
+    return 0;
+}
+
+
+
+// Pool task: every start offset of the chunk against every pattern
+static void cli_find_scan_chunk(void * p_arg)
+{
+    cli_find_chunk * p_chunk = p_arg;
+    cli_find       * p_find  = p_chunk->p_find;
+    int64_t          offset;
+
+    for (offset = p_chunk->start; offset < p_chunk->end; offset++) {
+        uint64_t key  = cli_find_read_key(p_find->p_rom + offset);
+        uint64_t hash = cli_find_hash(key);
+        uint64_t bit  = hash >> (64 - CLI_FIND_FILTER_BITS);
+        uint64_t slot;
+
+        if (0 == (p_find->p_filter[bit / 64] & (1ULL << (bit % 64))))
+            continue;
+
+        for (slot = (hash >> 32) & p_find->table_mask;
+             p_find->p_table[slot] != -1;
+             slot = (slot + 1) & p_find->table_mask) {
+            const cli_find_pattern * p_pattern = &p_find->p_patterns[p_find->p_table[slot]];
+
+            if ((p_pattern->key == key) &&
+                (offset + p_pattern->tile_bytes <= p_find->rom_size) &&
+                (0 == memcmp(p_find->p_rom + offset, p_pattern->p_bytes, (size_t)p_pattern->tile_bytes)))
+                cli_find_add_hit(p_chunk, offset, p_find->p_table[slot], 0);
+        }
+    }
+}
+
+
+
+// First occurrence relabeling, a row at a time so most rom tiles can be
+// ruled out after their first row
+typedef struct cli_find_labels {
+    unsigned char label[256];                   // 0xFF = not seen yet
+    unsigned char used[CLI_FIND_TILE_PIXELS];   // Colors in order of appearance
+    int           num_used;
+} cli_find_labels;
+
+
+
+static void cli_find_labels_init(cli_find_labels * p_labels)
+{
+    memset(p_labels->label, 0xFF, sizeof(p_labels->label));
+    p_labels->num_used = 0;
+}
+
+
+
+// Only the entries used by the last tile need clearing
+static void cli_find_labels_reset(cli_find_labels * p_labels)
+{
+    while (p_labels->num_used > 0)
+        p_labels->label[p_labels->used[--p_labels->num_used]] = 0xFF;
+}
+
+
+
+static void cli_find_relabel_row(cli_find_labels * p_labels, const unsigned char * p_pixel,
+                                 int64_t pixel_stride, unsigned char * p_row)
+{
+    int x;
+
+    for (x = 0; x < 8; x++, p_pixel += pixel_stride) {
+        if (p_labels->label[*p_pixel] == 0xFF) {
+            p_labels->label[*p_pixel] = (unsigned char)p_labels->num_used;
+            p_labels->used[p_labels->num_used++] = *p_pixel;
+        }
+
+        p_row[x] = p_labels->label[*p_pixel];
+    }
+}
+
+
+
+// Pixels that differ in a row of 8: a byte of the XOR is non-zero where
+// they differ, which sets its top bit below without carrying into the
+// next byte. The multiply adds up the top bits
+static int cli_find_row_distance(const unsigned char * p_a, const unsigned char * p_b)
+{
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+    uint64_t       diff = cli_find_read_key(p_a) ^ cli_find_read_key(p_b);
+
+    diff = ((((diff & low7) + low7) | diff) & ~low7) >> 7;
+
+    return (int)((diff * 0x0101010101010101ULL) >> 56);
+}
+
+
+
+// Image tiles as relabeled planes, the same patterns for every mode
+// that has room for their colors
+static int cli_find_add_planes(cli_find * p_find, app_gfx_data * p_app_gfx, int image_mode_wanted)
+{
+    unsigned int    tiles_per_row = p_app_gfx->width / 8;
+    cli_find_labels labels;
+    int             num_colors;
+    int             image_mode;
+    int          tile;
+    int          c;
+
+    if (NULL == (p_find->p_planes = malloc((size_t)p_find->num_tiles * CLI_FIND_TILE_PIXELS)))
+        return -1;
+
+    for (image_mode = 0; image_mode < BIN_MODE_LAST; image_mode++) {
+        const rom_gfx_attrib * p_attrib = rom_bin_mode_attrib(image_mode);
+
+        p_find->first_pattern[image_mode] = p_find->num_patterns;
+
+        if ((image_mode_wanted != -1) && (image_mode_wanted != image_mode))
+            continue;
+
+        for (tile = 0; tile < p_find->num_tiles; tile++) {
+            const unsigned char * p_first = p_app_gfx->p_data +
+                ((((size_t)(tile / tiles_per_row) * 8 * p_app_gfx->width) + ((size_t)(tile % tiles_per_row) * 8)) * 2);
+            unsigned char       * p_plane = p_find->p_planes + ((size_t)tile * CLI_FIND_TILE_PIXELS);
+            int                   opaque  = 1;
+            int                   y, x;
+
+            for (y = 0; y < 8; y++)
+                for (x = 0; x < 8; x++)
+                    if (0 == p_first[(((size_t)y * p_app_gfx->width) + x) * 2 + 1])
+                        opaque = 0;
+
+            cli_find_labels_init(&labels);
+            for (y = 0; y < 8; y++)
+                cli_find_relabel_row(&labels, p_first + ((size_t)y * p_app_gfx->width * 2), 2, p_plane + (y * 8));
+            num_colors = labels.num_used;
+
+            if (!opaque || (num_colors < 2) || (num_colors > (1 << p_attrib->BITS_PER_PIXEL)))
+                continue;
+
+            // A tile repeated in the image is looked for once
+            for (c = p_find->first_pattern[image_mode]; c < p_find->num_patterns; c++)
+                if (0 == memcmp(p_find->p_patterns[c].p_bytes, p_plane, CLI_FIND_TILE_PIXELS))
+                    break;
+            if (c < p_find->num_patterns)
+                continue;
+
+            p_find->p_patterns[p_find->num_patterns].p_bytes    = p_plane;
+            p_find->p_patterns[p_find->num_patterns].tile_bytes = CLI_FIND_TILE_PIXELS;
+            p_find->p_patterns[p_find->num_patterns].image_mode = image_mode;
+            p_find->p_patterns[p_find->num_patterns].tile       = tile;
+            p_find->num_patterns++;
+        }
+
+        p_find->num_mode_patterns[image_mode] = p_find->num_patterns - p_find->first_pattern[image_mode];
+    }
+
+    return 0;
+}
+
+
+
+static int cli_find_compare_hits(const void * p_a, const void * p_b)
+{
+    const cli_find_hit * p_hit_a = p_a;
+    const cli_find_hit * p_hit_b = p_b;
+
+    return (p_hit_a->offset > p_hit_b->offset) - (p_hit_a->offset < p_hit_b->offset);
+}
+
+
+
+// Pool task: decodes the chunk at each alignment (a tile can start at
+// any byte) and keeps the closest image tile for each rom tile
+static void cli_find_fuzzy_chunk(void * p_arg)
+{
+    cli_find_chunk      * p_chunk    = p_arg;
+    cli_find            * p_find     = p_chunk->p_find;
+    int                   image_mode = p_chunk->image_mode;
+    int64_t               tile_bytes = rom_bin_tile_bytes(image_mode);
+    const cli_find_pattern * p_patterns = p_find->p_patterns + p_find->first_pattern[image_mode];
+    int                   num_patterns = p_find->num_mode_patterns[image_mode];
+    unsigned char       * p_pixels = NULL;
+    size_t                pixels_size = 0;
+    unsigned char         plane[8];      // One row
+    int                 * p_candidates;  // Image tiles still close enough
+    int                 * p_distances;
+    cli_find_labels       labels;
+    int64_t               align;
+
+    p_candidates = malloc((size_t)num_patterns * sizeof(int));
+    p_distances  = malloc((size_t)num_patterns * sizeof(int));
+
+    if ((NULL == p_candidates) || (NULL == p_distances)) {
+        free(p_candidates);
+        free(p_distances);
+        return;
+    }
+
+    cli_find_labels_init(&labels);
+
+    for (align = 0; align < tile_bytes; align++) {
+        rom_gfx_data   rom_gfx;
+        app_gfx_data   app_gfx;
+        app_color_data colorpal;
+        int64_t        start = p_chunk->start + align;
+        int64_t        len   = p_chunk->end - p_chunk->start;
+        int64_t        tile;
+        unsigned int   tiles_per_row;
+
+        if (start + tile_bytes > p_find->rom_size)
+            break;
+
+        if (len > p_find->rom_size - start)
+            len = p_find->rom_size - start;
+        len -= len % tile_bytes;
+
+        rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+        rom_gfx.p_data          = (unsigned char *)p_find->p_rom + start;
+        rom_gfx.size            = len;
+        app_gfx.image_mode      = image_mode;
+        app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED;
+
+        if (0 == rom_bin_decode_query(&rom_gfx, &app_gfx)) {
+            if (pixels_size < (size_t)app_gfx.size) {
+                free(p_pixels);
+                pixels_size = (size_t)app_gfx.size;
+                p_pixels    = malloc(pixels_size);
+            }
+
+            if (p_pixels && (0 == rom_bin_decode_into(&rom_gfx, &app_gfx, &colorpal, p_pixels, 0, 0))) {
+                tiles_per_row = app_gfx.width / 8;
+
+                for (tile = 0; tile < len / tile_bytes; tile++) {
+                    const unsigned char * p_tile = p_pixels + (((size_t)(tile / tiles_per_row) * 8 * app_gfx.width) +
+                                                               ((size_t)(tile % tiles_per_row) * 8));
+                    int best_distance = p_find->max_distance + 1;
+                    int best = -1;
+                    int num_candidates = num_patterns;
+                    int c, kept, y;
+
+                    // Row by row, dropping the image tiles already too far
+                    // off. Most rom tiles are ruled out in a row or two
+                    cli_find_labels_reset(&labels);
+
+                    for (c = 0; c < num_patterns; c++) {
+                        p_candidates[c] = c;
+                        p_distances[c]  = 0;
+                    }
+
+                    for (y = 0; (y < 8) && (num_candidates > 0); y++) {
+                        cli_find_relabel_row(&labels, p_tile + ((size_t)y * app_gfx.width), 1, plane);
+
+                        for (c = 0, kept = 0; c < num_candidates; c++) {
+                            int distance = p_distances[c] +
+                                           cli_find_row_distance(plane, p_patterns[p_candidates[c]].p_bytes + (y * 8));
+
+                            if (distance <= p_find->max_distance) {
+                                p_candidates[kept] = p_candidates[c];
+                                p_distances[kept++] = distance;
+                            }
+                        }
+
+                        num_candidates = kept;
+                    }
+
+                    for (c = 0; c < num_candidates; c++)
+                        if (p_distances[c] < best_distance) {
+                            best_distance = p_distances[c];
+                            best = p_candidates[c];
+                        }
+
+                    if (best != -1)
+                        cli_find_add_hit(p_chunk, start + (tile * tile_bytes),
+                                         p_find->first_pattern[image_mode] + best, best_distance);
+                }
+            }
+        }
+
+        // The rom data belongs to the mapping
+        rom_gfx.p_data = NULL;
+        rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+    }
+
+    free(p_pixels);
+    free(p_candidates);
+    free(p_distances);
+
+    // Alignments add hits out of order, places need them by offset
+    if (p_chunk->num_hits > 1)
+        qsort(p_chunk->p_hits, (size_t)p_chunk->num_hits, sizeof(cli_find_hit), cli_find_compare_hits);
+}
+
+
+
+static int cli_find_compare_sites(const void * p_a, const void * p_b)
+{
+    const cli_find_site * p_site_a = p_a;
+    const cli_find_site * p_site_b = p_b;
+
+    if (p_site_a->num_tiles != p_site_b->num_tiles)
+        return (p_site_a->num_tiles > p_site_b->num_tiles) ? -1 : 1;
+    if (p_site_a->distance * p_site_b->num_hits != p_site_b->distance * p_site_a->num_hits)
+        return (p_site_a->distance * p_site_b->num_hits < p_site_b->distance * p_site_a->num_hits) ? -1 : 1;
+    if (p_site_a->offset != p_site_b->offset)
+        return (p_site_a->offset < p_site_b->offset) ? -1 : 1;
+
+    return p_site_a->image_mode - p_site_b->image_mode;
+}
+
+
+
+// Groups the hits of each mode into places. Chunks are in rom order and
+// so are the hits in each, so one pass per mode is enough
+static int64_t cli_find_group_sites(cli_find * p_find, cli_find_chunk * p_chunks, int64_t num_chunks,
+                                    cli_find_site * p_sites)
+{
+    unsigned char * p_seen;
+    int64_t         num_sites = 0;
+    int             image_mode;
+
+    if (NULL == (p_seen = malloc((size_t)p_find->num_tiles)))
+        return -1;
+
+    for (image_mode = 0; image_mode < BIN_MODE_LAST; image_mode++) {
+        int64_t         gap = rom_bin_tile_bytes(image_mode) * p_find->num_tiles * CLI_FIND_SITE_GAP;
+        cli_find_site * p_site = NULL;
+        int64_t         last = 0;
+        int64_t         c, h;
+
+        for (c = 0; c < num_chunks; c++)
+            for (h = 0; h < p_chunks[c].num_hits; h++) {
+                const cli_find_hit     * p_hit     = &p_chunks[c].p_hits[h];
+                const cli_find_pattern * p_pattern = &p_find->p_patterns[p_hit->pattern];
+
+                if (p_pattern->image_mode != image_mode)
+                    continue;
+
+                if ((NULL == p_site) || (p_hit->offset - last > gap)) {
+                    p_site = &p_sites[num_sites++];
+                    p_site->offset     = p_hit->offset;
+                    p_site->image_mode = image_mode;
+                    p_site->num_tiles  = 0;
+                    p_site->num_hits   = 0;
+                    p_site->distance   = 0;
+                    memset(p_seen, 0, (size_t)p_find->num_tiles);
+                }
+
+                if (!p_seen[p_pattern->tile]) {
+                    p_seen[p_pattern->tile] = 1;
+                    p_site->num_tiles++;
+                }
+
+                p_site->num_hits++;
+                p_site->distance += p_hit->distance;
+                last = p_hit->offset;
+            }
+    }
+
+    free(p_seen);
+
+    return num_sites;
+}
+
+
+
+// Reports the places in the rom holding the most tiles of the image
+int cli_find_run(const char * p_image, const char * p_rom, const cli_find_options * p_options)
+{
+    cli_find         find;
+    app_gfx_data     app_gfx;
+    rom_gfx_data     rom_gfx;
+    app_color_data   colorpal;
+    unsigned char  * p_rom_data = NULL;
+    int64_t          rom_size = 0;
+    cli_find_chunk * p_chunks = NULL;
+    cli_find_site  * p_sites = NULL;
+    cli_pool       * p_pool;
+    int64_t          num_chunks = 0;
+    int64_t          num_tasks = 0;
+    int64_t          num_hits = 0;
+    int64_t          num_sites;
+    int64_t          scan_end;
+    int64_t          c;
+    int              image_mode;
+    int              status = -1;
+
+    memset(&find, 0, sizeof(find));
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    if (0 != cli_png_read(p_image, &app_gfx)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_image);
+        goto done;
+    }
+
+    if (0 != cli_file_map(p_rom, &p_rom_data, &rom_size)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_rom);
+        goto done;
+    }
+
+    // Every mode uses 8x8 tiles (at most BIN_MODE_LAST patterns per tile)
+    find.num_tiles  = (int)((app_gfx.width / 8) * (app_gfx.height / 8));
+    find.p_rom      = p_rom_data;
+    find.rom_size   = rom_size;
+    find.p_patterns = malloc(((size_t)find.num_tiles * BIN_MODE_LAST + 1) * sizeof(cli_find_pattern));
+
+    if (NULL == find.p_patterns)
+        goto done;
+
+    find.max_distance = p_options->max_distance;
+
+    if (find.max_distance < 0) {
+        for (image_mode = 0; image_mode < BIN_MODE_LAST; image_mode++)
+            if ((p_options->image_mode == -1) || (p_options->image_mode == image_mode))
+                cli_find_add_mode(&find, &app_gfx, image_mode);
+    }
+    else if (0 != cli_find_add_planes(&find, &app_gfx, p_options->image_mode))
+        goto done;
+
+    if (0 == find.num_patterns) {
+        fprintf(stderr, "%s: %s has no tiles to look for (8x8, not blank, no transparency)\n", CLI_NAME, p_image);
+        goto done;
+    }
+
+    if ((find.max_distance < 0) && (0 != cli_find_build_table(&find)))
+        goto done;
+
+    // Patterns are at least 8 bytes, no start offset past that
+    scan_end   = (rom_size >= 8) ? rom_size - 7 : 0;
+    num_chunks = (scan_end + CLI_FIND_CHUNK_BYTES - 1) / CLI_FIND_CHUNK_BYTES;
+
+    // The fuzzy search scans once per mode
+    if ((NULL == (p_chunks = calloc(((size_t)num_chunks * BIN_MODE_LAST) + 1, sizeof(cli_find_chunk)))) ||
+        (NULL == (p_pool = cli_pool_new(p_options->num_threads))))
+        goto done;
+
+    for (c = 0; c < num_chunks; c++) {
+        cli_find_chunk chunk;
+
+        memset(&chunk, 0, sizeof(chunk));
+        chunk.p_find = &find;
+        chunk.start  = c * CLI_FIND_CHUNK_BYTES;
+        chunk.end    = ((c + 1) * CLI_FIND_CHUNK_BYTES < scan_end) ? (c + 1) * CLI_FIND_CHUNK_BYTES : scan_end;
+
+        if (find.max_distance < 0) {
+            p_chunks[num_tasks] = chunk;
+            cli_pool_submit(p_pool, cli_find_scan_chunk, &p_chunks[num_tasks++]);
+            continue;
+        }
+
+        for (image_mode = 0; image_mode < BIN_MODE_LAST; image_mode++) {
+            if (0 == find.num_mode_patterns[image_mode])
+                continue;
+
+            chunk.image_mode    = image_mode;
+            p_chunks[num_tasks] = chunk;
+            cli_pool_submit(p_pool, cli_find_fuzzy_chunk, &p_chunks[num_tasks++]);
+        }
+    }
+
+    cli_pool_wait(p_pool);
+    cli_pool_free(p_pool);
+
+    for (c = 0; c < num_tasks; c++)
+        num_hits += p_chunks[c].num_hits;
+
+    // At most one place per hit
+    if ((NULL == (p_sites = malloc((size_t)(num_hits + 1) * sizeof(cli_find_site)))) ||
+        (-1 == (num_sites = cli_find_group_sites(&find, p_chunks, num_tasks, p_sites))))
+        goto done;
+
+    qsort(p_sites, (size_t)num_sites, sizeof(cli_find_site), cli_find_compare_sites);
+
+    printf("%10s %-14s %9s %6s %8s\n", "offset", "mode", "tiles", "hits", "distance");
+
+    for (c = 0; (c < num_sites) && ((p_options->max_sites <= 0) || (c < p_options->max_sites)); c++) {
+        char tiles[24];
+
+        snprintf(tiles, sizeof(tiles), "%d/%d", p_sites[c].num_tiles, find.num_tiles);
+        printf("%#10" PRIx64 " %-14s %9s %6d %8.1f\n", p_sites[c].offset,
+               rom_bin_mode_name(p_sites[c].image_mode), tiles, p_sites[c].num_hits,
+               (double)p_sites[c].distance / p_sites[c].num_hits);
+    }
+
+    printf("%" PRId64 " places, %" PRId64 " tile matches, %d patterns from %d tiles\n",
+           num_sites, num_hits, find.num_patterns, find.num_tiles);
+
+    status = 0;
+
+done:
+    for (c = 0; c < num_tasks; c++)
+        free(p_chunks[c].p_hits);
+    for (image_mode = 0; image_mode < BIN_MODE_LAST; image_mode++)
+        rom_bin_free(find.p_encoded[image_mode]);
+
+    free(p_chunks);
+    free(p_sites);
+    free(find.p_patterns);
+    free(find.p_table);
+    free(find.p_filter);
+    free(find.p_planes);
+    cli_file_unmap(p_rom_data, rom_size);
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    return status;
+}
@@ -0,0 +1,31 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_FIND_HEADER
+#define CLI_FIND_HEADER
+
+    typedef struct cli_find_options {
+        int          image_mode;      // -1 = try every mode
+        int          num_threads;     // 0 = one per processor
+        int          max_sites;       // Report at most this many places
+        int          max_distance;    // -1 = exact bytes, otherwise the pixels that may differ
+    } cli_find_options;
+
+    int cli_find_run(const char *, const char *, const cli_find_options *);
+
+#endif // CLI_FIND_HEADER
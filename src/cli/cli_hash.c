@@ -0,0 +1,202 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Content hashes for the incremental rebuild index.
+// XXH64, see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+
+#include "cli_hash.h"
+#include "cli_file.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define XXH_PRIME64_1  0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3  0x165667B19E3779F9ULL
+#define XXH_PRIME64_4  0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5  0x27D4EB2F165667C5ULL
+
+#define XXH_ROTL64(x, r)  (((x) << (r)) | ((x) >> (64 - (r))))
+
+
+
+// Unaligned little-endian reads, the compiler turns these into plain loads
+static uint64_t cli_hash_read64(const unsigned char * p)
+{
+    return  (uint64_t)p[0]        | ((uint64_t)p[1] << 8)  |
+           ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+           ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static uint32_t cli_hash_read32(const unsigned char * p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+
+static uint64_t cli_hash_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc  = XXH_ROTL64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static uint64_t cli_hash_merge_round(uint64_t acc, uint64_t val)
+{
+    acc ^= cli_hash_round(0, val);
+    return (acc * XXH_PRIME64_1) + XXH_PRIME64_4;
+}
+
+
+
+uint64_t cli_hash_xxh64(const void * p_input, size_t len, uint64_t seed)
+{
+    const unsigned char * p   = p_input;
+    const unsigned char * end = p + len;
+    uint64_t              h64;
+
+    if (len >= 32) {
+        const unsigned char * limit = end - 32;
+        uint64_t              v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t              v2 = seed + XXH_PRIME64_2;
+        uint64_t              v3 = seed;
+        uint64_t              v4 = seed - XXH_PRIME64_1;
+
+        do {
+            v1 = cli_hash_round(v1, cli_hash_read64(p));      p += 8;
+            v2 = cli_hash_round(v2, cli_hash_read64(p));      p += 8;
+            v3 = cli_hash_round(v3, cli_hash_read64(p));      p += 8;
+            v4 = cli_hash_round(v4, cli_hash_read64(p));      p += 8;
+        } while (p <= limit);
+
+        h64 = XXH_ROTL64(v1, 1) + XXH_ROTL64(v2, 7) + XXH_ROTL64(v3, 12) + XXH_ROTL64(v4, 18);
+        h64 = cli_hash_merge_round(h64, v1);
+        h64 = cli_hash_merge_round(h64, v2);
+        h64 = cli_hash_merge_round(h64, v3);
+        h64 = cli_hash_merge_round(h64, v4);
+    }
+    else
+        h64 = seed + XXH_PRIME64_5;
+
+    h64 += (uint64_t)len;
+
+    // Tail
+    while ((p + 8) <= end) {
+        h64 ^= cli_hash_round(0, cli_hash_read64(p));
+        h64  = (XXH_ROTL64(h64, 27) * XXH_PRIME64_1) + XXH_PRIME64_4;
+        p   += 8;
+    }
+
+    if ((p + 4) <= end) {
+        h64 ^= (uint64_t)cli_hash_read32(p) * XXH_PRIME64_1;
+        h64  = (XXH_ROTL64(h64, 23) * XXH_PRIME64_2) + XXH_PRIME64_3;
+        p   += 4;
+    }
+
+    while (p < end) {
+        h64 ^= (*p) * XXH_PRIME64_5;
+        h64  = XXH_ROTL64(h64, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    // Avalanche
+    h64 ^= h64 >> 33;
+    h64 *= XXH_PRIME64_2;
+    h64 ^= h64 >> 29;
+    h64 *= XXH_PRIME64_3;
+    h64 ^= h64 >> 32;
+
+    return h64;
+}
+
+
+
+int64_t cli_hash_num_chunks(int64_t size)
+{
+    return (size + CLI_HASH_CHUNK_BYTES - 1) / CLI_HASH_CHUNK_BYTES;
+}
+
+
+
+// Digest of one chunk, seeded with its index so swapped chunks differ
+uint64_t cli_hash_chunk(const unsigned char * p_data, int64_t size, int64_t chunk)
+{
+    int64_t offset = chunk * CLI_HASH_CHUNK_BYTES;
+    int64_t length = size - offset;
+
+    if (length > CLI_HASH_CHUNK_BYTES)
+        length = CLI_HASH_CHUNK_BYTES;
+
+    return cli_hash_xxh64(p_data + offset, (size_t)length, (uint64_t)chunk);
+}
+
+
+
+// Hash of the chunk digests in order, seeded with the total size
+uint64_t cli_hash_combine(const uint64_t * p_digests, int64_t num_chunks, int64_t size)
+{
+    unsigned char bytes[8];
+    uint64_t      h64 = (uint64_t)size;
+    int64_t       c;
+    int           b;
+
+    for (c = 0; c < num_chunks; c++) {
+        for (b = 0; b < 8; b++)
+            bytes[b] = (unsigned char)(p_digests[c] >> (b * 8));
+
+        h64 = cli_hash_xxh64(bytes, sizeof(bytes), h64);
+    }
+
+    return h64;
+}
+
+
+
+// Same result as hashing the chunks on several threads and combining them
+uint64_t cli_hash_content(const unsigned char * p_data, int64_t size)
+{
+    uint64_t digest;
+    uint64_t h64 = (uint64_t)size;
+    int64_t  c;
+
+    for (c = 0; c < cli_hash_num_chunks(size); c++) {
+        digest = cli_hash_chunk(p_data, size, c);
+        h64    = cli_hash_combine(&digest, 1, (int64_t)h64);
+    }
+
+    return h64;
+}
+
+
+
+int cli_hash_file(const char * p_filename, uint64_t * p_hash)
+{
+    unsigned char * p_data;
+    int64_t         size;
+
+    if (0 != cli_file_map(p_filename, &p_data, &size))
+        return -1;
+
+    *p_hash = cli_hash_content(p_data, size);
+
+    cli_file_unmap(p_data, size);
+
+    return 0;
+}
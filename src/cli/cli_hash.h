@@ -0,0 +1,37 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_HASH_HEADER
+#define CLI_HASH_HEADER
+
+#include <stddef.h>
+#include <stdint.h>
+
+    // Large inputs are hashed as independent chunks that can run in
+    // parallel, then the chunk digests are hashed together
+    #define CLI_HASH_CHUNK_BYTES  (4 * 1024 * 1024)
+
+    uint64_t cli_hash_xxh64(const void *, size_t, uint64_t);
+
+    int64_t  cli_hash_num_chunks(int64_t);
+    uint64_t cli_hash_chunk(const unsigned char *, int64_t, int64_t);
+    uint64_t cli_hash_combine(const uint64_t *, int64_t, int64_t);
+    uint64_t cli_hash_content(const unsigned char *, int64_t);
+    int      cli_hash_file(const char *, uint64_t *);
+
+#endif // CLI_HASH_HEADER
@@ -0,0 +1,272 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Incremental rebuild index: maps a job key (input content hash, job
+// parameters, library version) to the hash of the output it produced.
+// A job whose key is known and whose output still hashes the same is
+// skipped. Stored as text, one "<key> <output hash> <output>" per line.
+
+#include "lib_rom_bin.h"
+#include "cli_hash.h"
+#include "cli_index.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CLI_INDEX_HEADER_LINE  "rom-bin-index 1"
+
+typedef struct cli_index_entry {
+    uint64_t   key;
+    uint64_t   output_hash;
+    char     * p_output;      // NULL = free slot
+} cli_index_entry;
+
+struct cli_index {
+    pthread_mutex_t   lock;      // Jobs look up and record from the workers
+    cli_index_entry * p_entries;
+    size_t            capacity;  // Power of 2
+    size_t            count;
+};
+
+
+
+static cli_index_entry * cli_index_find(cli_index * p_index, uint64_t key)
+{
+    size_t slot = (size_t)(key & (p_index->capacity - 1));
+
+    while (p_index->p_entries[slot].p_output && (p_index->p_entries[slot].key != key))
+        slot = (slot + 1) & (p_index->capacity - 1);
+
+    return &p_index->p_entries[slot];
+}
+
+
+
+// Keeps the table at most half full
+static int cli_index_grow(cli_index * p_index)
+{
+    cli_index_entry * p_old = p_index->p_entries;
+    size_t            old_capacity = p_index->capacity;
+    size_t            c;
+
+    if (NULL == (p_index->p_entries = calloc(old_capacity * 2, sizeof(cli_index_entry)))) {
+        p_index->p_entries = p_old;
+        return -1;
+    }
+
+    p_index->capacity = old_capacity * 2;
+
+    for (c = 0; c < old_capacity; c++)
+        if (p_old[c].p_output)
+            *cli_index_find(p_index, p_old[c].key) = p_old[c];
+
+    free(p_old);
+
+    return 0;
+}
+
+
+
+static int cli_index_put(cli_index * p_index, uint64_t key, uint64_t output_hash, const char * p_output)
+{
+    cli_index_entry * p_entry;
+    char            * p_copy;
+
+    if (((p_index->count + 1) * 2 > p_index->capacity) && (0 != cli_index_grow(p_index)))
+        return -1;
+
+    if (NULL == (p_copy = strdup(p_output)))
+        return -1;
+
+    p_entry = cli_index_find(p_index, key);
+
+    if (p_entry->p_output)
+        free(p_entry->p_output);
+    else
+        p_index->count++;
+
+    p_entry->key         = key;
+    p_entry->output_hash = output_hash;
+    p_entry->p_output    = p_copy;
+
+    return 0;
+}
+
+
+
+// A missing file gives an empty index, so the first run creates it
+cli_index * cli_index_load(const char * p_filename)
+{
+    cli_index * p_index;
+    FILE      * file;
+    char        line[4096 + 64];
+
+    if (NULL == (p_index = calloc(1, sizeof(cli_index))))
+        return NULL;
+
+    p_index->capacity = 256;
+    if (NULL == (p_index->p_entries = calloc(p_index->capacity, sizeof(cli_index_entry)))) {
+        free(p_index);
+        return NULL;
+    }
+
+    pthread_mutex_init(&p_index->lock, NULL);
+
+    if (NULL == (file = fopen(p_filename, "r")))
+        return p_index;
+
+    // An index from another format version is just ignored
+    if (fgets(line, sizeof(line), file) &&
+        (0 == strncmp(line, CLI_INDEX_HEADER_LINE "\n", sizeof(CLI_INDEX_HEADER_LINE)))) {
+
+        while (fgets(line, sizeof(line), file)) {
+            uint64_t key, output_hash;
+            int      name_start = 0;
+            char   * p_newline  = strchr(line, '\n');
+
+            if (p_newline)
+                *p_newline = '\0';
+
+            if ((2 == sscanf(line, "%" SCNx64 " %" SCNx64 " %n", &key, &output_hash, &name_start)) &&
+                (name_start > 0) && (line[name_start] != '\0'))
+                cli_index_put(p_index, key, output_hash, line + name_start);
+        }
+    }
+
+    fclose(file);
+
+    return p_index;
+}
+
+
+
+// Written to a temporary file first, so an interrupted run can't leave
+// a truncated index behind
+int cli_index_save(cli_index * p_index, const char * p_filename)
+{
+    FILE   * file;
+    char   * p_temp;
+    size_t   c;
+    int      status = 0;
+
+    if (NULL == (p_temp = malloc(strlen(p_filename) + 5)))
+        return -1;
+
+    sprintf(p_temp, "%s.tmp", p_filename);
+
+    if (NULL == (file = fopen(p_temp, "w"))) {
+        free(p_temp);
+        return -1;
+    }
+
+    fprintf(file, CLI_INDEX_HEADER_LINE "\n");
+
+    for (c = 0; c < p_index->capacity; c++)
+        if (p_index->p_entries[c].p_output)
+            fprintf(file, "%016" PRIx64 " %016" PRIx64 " %s\n",
+                    p_index->p_entries[c].key,
+                    p_index->p_entries[c].output_hash,
+                    p_index->p_entries[c].p_output);
+
+    if (0 != fclose(file))
+        status = -1;
+
+    if ((0 == status) && (0 != rename(p_temp, p_filename)))
+        status = -1;
+
+    if (0 != status)
+        remove(p_temp);
+
+    free(p_temp);
+
+    return status;
+}
+
+
+
+void cli_index_free(cli_index * p_index)
+{
+    size_t c;
+
+    if (NULL == p_index)
+        return;
+
+    for (c = 0; c < p_index->capacity; c++)
+        free(p_index->p_entries[c].p_output);
+
+    pthread_mutex_destroy(&p_index->lock);
+    free(p_index->p_entries);
+    free(p_index);
+}
+
+
+
+// Key for a job: its input content hash, a description of everything
+// else that changes the output (mode, range, palette hash, output name...)
+// and the library version, since a codec fix changes outputs too
+uint64_t cli_index_key(uint64_t input_hash, const char * p_params)
+{
+    uint64_t key = cli_hash_xxh64(p_params, strlen(p_params), input_hash);
+
+    return key ^ ((uint64_t)rom_bin_version() * 0x9E3779B97F4A7C15ULL);
+}
+
+
+
+// True if the job already ran and its output is still what it wrote
+int cli_index_is_current(cli_index * p_index, uint64_t key, const char * p_output)
+{
+    cli_index_entry * p_entry;
+    uint64_t          recorded_hash;
+    uint64_t          output_hash;
+    int               known;
+
+    if (NULL == p_index)
+        return 0;
+
+    pthread_mutex_lock(&p_index->lock);
+
+    p_entry       = cli_index_find(p_index, key);
+    known         = (NULL != p_entry->p_output) && (0 == strcmp(p_entry->p_output, p_output));
+    recorded_hash = p_entry->output_hash;
+
+    pthread_mutex_unlock(&p_index->lock);
+
+    // The output may have been deleted or edited since
+    return known &&
+           (0 == cli_hash_file(p_output, &output_hash)) &&
+           (output_hash == recorded_hash);
+}
+
+
+
+// Records a finished job by hashing the output it wrote
+void cli_index_set(cli_index * p_index, uint64_t key, const char * p_output)
+{
+    uint64_t output_hash;
+
+    if ((NULL == p_index) || (0 != cli_hash_file(p_output, &output_hash)))
+        return;
+
+    pthread_mutex_lock(&p_index->lock);
+    cli_index_put(p_index, key, output_hash, p_output);
+    pthread_mutex_unlock(&p_index->lock);
+}
@@ -0,0 +1,34 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_INDEX_HEADER
+#define CLI_INDEX_HEADER
+
+#include <stdint.h>
+
+    typedef struct cli_index cli_index;
+
+    cli_index * cli_index_load(const char *);
+    int         cli_index_save(cli_index *, const char *);
+    void        cli_index_free(cli_index *);
+
+    uint64_t    cli_index_key(uint64_t, const char *);
+    int         cli_index_is_current(cli_index *, uint64_t, const char *);
+    void        cli_index_set(cli_index *, uint64_t, const char *);
+
+#endif // CLI_INDEX_HEADER
@@ -0,0 +1,445 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Small JSON reader for job manifests. Strict RFC 8259 apart from
+// allowing // line comments, which manifests tend to want
+
+#include "cli_json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CLI_JSON_MAX_DEPTH  64
+
+typedef struct cli_json_parser {
+    const char * p_text;
+    const char * p_pos;
+    char       * p_error;
+    size_t       error_size;
+    int          depth;
+} cli_json_parser;
+
+static cli_json * cli_json_parse_value(cli_json_parser *);
+
+
+
+// Records the first error only, with the line it happened on
+static void cli_json_error(cli_json_parser * p_parser, const char * p_message)
+{
+    const char * p_scan;
+    int          line = 1;
+
+    if ((NULL == p_parser->p_error) || (p_parser->p_error[0] != '\0'))
+        return;
+
+    for (p_scan = p_parser->p_text; p_scan < p_parser->p_pos; p_scan++)
+        if (*p_scan == '\n')
+            line++;
+
+    snprintf(p_parser->p_error, p_parser->error_size, "line %d: %s", line, p_message);
+}
+
+
+
+static void cli_json_skip_space(cli_json_parser * p_parser)
+{
+    for (;;) {
+        while ((*p_parser->p_pos == ' ') || (*p_parser->p_pos == '\t') ||
+               (*p_parser->p_pos == '\r') || (*p_parser->p_pos == '\n'))
+            p_parser->p_pos++;
+
+        if ((p_parser->p_pos[0] != '/') || (p_parser->p_pos[1] != '/'))
+            return;
+
+        while ((*p_parser->p_pos != '\0') && (*p_parser->p_pos != '\n'))
+            p_parser->p_pos++;
+    }
+}
+
+
+
+static cli_json * cli_json_new(cli_json_type type)
+{
+    cli_json * p_node = calloc(1, sizeof(cli_json));
+
+    if (p_node)
+        p_node->type = type;
+
+    return p_node;
+}
+
+
+
+static void cli_json_put_utf8(char ** pp_out, unsigned long code)
+{
+    char * p_out = *pp_out;
+
+    if (code < 0x80)
+        *p_out++ = (char)code;
+    else if (code < 0x800) {
+        *p_out++ = (char)(0xC0 | (code >> 6));
+        *p_out++ = (char)(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000) {
+        *p_out++ = (char)(0xE0 | (code >> 12));
+        *p_out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *p_out++ = (char)(0x80 | (code & 0x3F));
+    }
+    else {
+        *p_out++ = (char)(0xF0 | (code >> 18));
+        *p_out++ = (char)(0x80 | ((code >> 12) & 0x3F));
+        *p_out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *p_out++ = (char)(0x80 | (code & 0x3F));
+    }
+
+    *pp_out = p_out;
+}
+
+
+
+static int cli_json_read_hex4(const char * p_hex, unsigned long * p_code)
+{
+    char   digits[5];
+    char * p_end;
+
+    memcpy(digits, p_hex, 4);
+    digits[4] = '\0';
+
+    *p_code = strtoul(digits, &p_end, 16);
+
+    return ((p_end == digits + 4) && (NULL == strpbrk(digits, "+- "))) ? 0 : -1;
+}
+
+
+
+// Decodes a quoted string. Escapes never grow the text,
+// so the input length bounds the output
+static char * cli_json_parse_string(cli_json_parser * p_parser)
+{
+    const char * p_pos = p_parser->p_pos + 1;
+    const char * p_end = p_pos;
+    char       * p_string;
+    char       * p_out;
+
+    while ((*p_end != '"') && (*p_end != '\0')) {
+        if ((p_end[0] == '\\') && (p_end[1] != '\0'))
+            p_end++;
+        p_end++;
+    }
+
+    if (*p_end != '"') {
+        cli_json_error(p_parser, "unterminated string");
+        return NULL;
+    }
+
+    if (NULL == (p_string = malloc((size_t)(p_end - p_pos) + 1)))
+        return NULL;
+
+    p_out = p_string;
+
+    while (p_pos < p_end) {
+        unsigned long code;
+
+        if ((unsigned char)*p_pos < 0x20) {
+            cli_json_error(p_parser, "control character in string");
+            free(p_string);
+            return NULL;
+        }
+
+        if (*p_pos != '\\') {
+            *p_out++ = *p_pos++;
+            continue;
+        }
+
+        p_pos++;
+        switch (*p_pos++) {
+            case '"':  *p_out++ = '"';  break;
+            case '\\': *p_out++ = '\\'; break;
+            case '/':  *p_out++ = '/';  break;
+            case 'b':  *p_out++ = '\b'; break;
+            case 'f':  *p_out++ = '\f'; break;
+            case 'n':  *p_out++ = '\n'; break;
+            case 'r':  *p_out++ = '\r'; break;
+            case 't':  *p_out++ = '\t'; break;
+
+            case 'u':
+                if (((p_end - p_pos) < 4) || (0 != cli_json_read_hex4(p_pos, &code))) {
+                    cli_json_error(p_parser, "bad \\u escape");
+                    free(p_string);
+                    return NULL;
+                }
+                p_pos += 4;
+
+                // Surrogate pair
+                if ((code >= 0xD800) && (code < 0xDC00) && ((p_end - p_pos) >= 6) &&
+                    (p_pos[0] == '\\') && (p_pos[1] == 'u')) {
+                    unsigned long low;
+
+                    if ((0 == cli_json_read_hex4(p_pos + 2, &low)) && (low >= 0xDC00) && (low < 0xE000)) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        p_pos += 6;
+                    }
+                }
+
+                cli_json_put_utf8(&p_out, code);
+                break;
+
+            default:
+                cli_json_error(p_parser, "bad escape in string");
+                free(p_string);
+                return NULL;
+        }
+    }
+
+    *p_out = '\0';
+    p_parser->p_pos = p_end + 1;
+
+    return p_string;
+}
+
+
+
+static cli_json * cli_json_parse_number(cli_json_parser * p_parser)
+{
+    const char * p_digits = p_parser->p_pos + ((*p_parser->p_pos == '-') ? 1 : 0);
+    cli_json   * p_node;
+    char       * p_end;
+    double       number;
+
+    number = strtod(p_parser->p_pos, &p_end);
+
+    // strtod also takes hex, inf and nan, JSON doesn't
+    if ((p_end == p_parser->p_pos) ||
+        (*p_digits < '0') || (*p_digits > '9') ||
+        (NULL != memchr(p_parser->p_pos, 'x', (size_t)(p_end - p_parser->p_pos))) ||
+        (NULL != memchr(p_parser->p_pos, 'X', (size_t)(p_end - p_parser->p_pos)))) {
+        cli_json_error(p_parser, "bad number");
+        return NULL;
+    }
+
+    if (NULL == (p_node = cli_json_new(CLI_JSON_NUMBER)))
+        return NULL;
+
+    p_node->number  = number;
+    p_parser->p_pos = p_end;
+
+    return p_node;
+}
+
+
+
+// Arrays and objects: values separated by commas, objects with "key": first
+static cli_json * cli_json_parse_container(cli_json_parser * p_parser, cli_json_type type)
+{
+    const char  close = (type == CLI_JSON_OBJECT) ? '}' : ']';
+    cli_json  * p_node;
+    cli_json ** pp_tail;
+
+    if (++p_parser->depth > CLI_JSON_MAX_DEPTH) {
+        cli_json_error(p_parser, "nested too deep");
+        return NULL;
+    }
+
+    if (NULL == (p_node = cli_json_new(type)))
+        return NULL;
+
+    pp_tail = &p_node->p_child;
+    p_parser->p_pos++;
+    cli_json_skip_space(p_parser);
+
+    if (*p_parser->p_pos == close) {
+        p_parser->p_pos++;
+        p_parser->depth--;
+        return p_node;
+    }
+
+    for (;;) {
+        char     * p_key = NULL;
+        cli_json * p_value;
+
+        if (type == CLI_JSON_OBJECT) {
+            if (*p_parser->p_pos != '"') {
+                cli_json_error(p_parser, "expected a member name");
+                break;
+            }
+
+            if (NULL == (p_key = cli_json_parse_string(p_parser)))
+                break;
+
+            cli_json_skip_space(p_parser);
+            if (*p_parser->p_pos != ':') {
+                cli_json_error(p_parser, "expected ':'");
+                free(p_key);
+                break;
+            }
+
+            p_parser->p_pos++;
+        }
+
+        if (NULL == (p_value = cli_json_parse_value(p_parser))) {
+            free(p_key);
+            break;
+        }
+
+        p_value->p_key = p_key;
+        *pp_tail = p_value;
+        pp_tail  = &p_value->p_next;
+
+        cli_json_skip_space(p_parser);
+
+        if (*p_parser->p_pos == ',') {
+            p_parser->p_pos++;
+            cli_json_skip_space(p_parser);
+            continue;
+        }
+
+        if (*p_parser->p_pos == close) {
+            p_parser->p_pos++;
+            p_parser->depth--;
+            return p_node;
+        }
+
+        cli_json_error(p_parser, (type == CLI_JSON_OBJECT) ? "expected ',' or '}'" : "expected ',' or ']'");
+        break;
+    }
+
+    cli_json_free(p_node);
+
+    return NULL;
+}
+
+
+
+static cli_json * cli_json_parse_value(cli_json_parser * p_parser)
+{
+    cli_json * p_node = NULL;
+
+    cli_json_skip_space(p_parser);
+
+    switch (*p_parser->p_pos) {
+        case '{':
+            return cli_json_parse_container(p_parser, CLI_JSON_OBJECT);
+
+        case '[':
+            return cli_json_parse_container(p_parser, CLI_JSON_ARRAY);
+
+        case '"':
+            if (NULL == (p_node = cli_json_new(CLI_JSON_STRING)))
+                return NULL;
+
+            if (NULL == (p_node->p_string = cli_json_parse_string(p_parser))) {
+                free(p_node);
+                return NULL;
+            }
+            return p_node;
+
+        case 't':
+        case 'f':
+        case 'n':
+            if (0 == strncmp(p_parser->p_pos, "true", 4)) {
+                p_node = cli_json_new(CLI_JSON_BOOL);
+                if (p_node)
+                    p_node->boolean = 1;
+                p_parser->p_pos += 4;
+            }
+            else if (0 == strncmp(p_parser->p_pos, "false", 5)) {
+                p_node = cli_json_new(CLI_JSON_BOOL);
+                p_parser->p_pos += 5;
+            }
+            else if (0 == strncmp(p_parser->p_pos, "null", 4)) {
+                p_node = cli_json_new(CLI_JSON_NULL);
+                p_parser->p_pos += 4;
+            }
+            else
+                cli_json_error(p_parser, "unexpected word");
+
+            return p_node;
+
+        default:
+            return cli_json_parse_number(p_parser);
+    }
+}
+
+
+
+// Parses a whole document. On failure returns NULL with a message
+// in p_error (if given)
+cli_json * cli_json_parse(const char * p_text, char * p_error, size_t error_size)
+{
+    cli_json_parser parser;
+    cli_json      * p_root;
+
+    parser.p_text     = p_text;
+    parser.p_pos      = p_text;
+    parser.p_error    = (error_size > 0) ? p_error : NULL;
+    parser.error_size = error_size;
+    parser.depth      = 0;
+
+    if (parser.p_error)
+        parser.p_error[0] = '\0';
+
+    p_root = cli_json_parse_value(&parser);
+
+    if (p_root) {
+        cli_json_skip_space(&parser);
+
+        if (*parser.p_pos != '\0') {
+            cli_json_error(&parser, "trailing text after the document");
+            cli_json_free(p_root);
+            return NULL;
+        }
+    }
+    else
+        cli_json_error(&parser, "out of memory");
+
+    return p_root;
+}
+
+
+
+void cli_json_free(cli_json * p_node)
+{
+    while (p_node) {
+        cli_json * p_next = p_node->p_next;
+
+        cli_json_free(p_node->p_child);
+        free(p_node->p_key);
+        free(p_node->p_string);
+        free(p_node);
+
+        p_node = p_next;
+    }
+}
+
+
+
+// Object member by name, NULL if missing or not an object
+const cli_json * cli_json_get(const cli_json * p_object, const char * p_key)
+{
+    const cli_json * p_member;
+
+    if ((NULL == p_object) || (p_object->type != CLI_JSON_OBJECT))
+        return NULL;
+
+    for (p_member = p_object->p_child; p_member; p_member = p_member->p_next)
+        if (0 == strcmp(p_member->p_key, p_key))
+            return p_member;
+
+    return NULL;
+}
@@ -0,0 +1,48 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_JSON_HEADER
+#define CLI_JSON_HEADER
+
+#include <stddef.h>
+
+    typedef enum cli_json_type {
+        CLI_JSON_NULL,
+        CLI_JSON_BOOL,
+        CLI_JSON_NUMBER,
+        CLI_JSON_STRING,
+        CLI_JSON_ARRAY,
+        CLI_JSON_OBJECT
+    } cli_json_type;
+
+    // Array elements and object members are a linked list of children
+    typedef struct cli_json {
+        cli_json_type     type;
+        char            * p_key;      // Member name when inside an object
+        char            * p_string;
+        double            number;
+        int               boolean;
+        struct cli_json * p_child;
+        struct cli_json * p_next;
+    } cli_json;
+
+    cli_json       * cli_json_parse(const char *, char *, size_t);
+    void             cli_json_free(cli_json *);
+    const cli_json * cli_json_get(const cli_json *, const char *);
+
+#endif // CLI_JSON_HEADER
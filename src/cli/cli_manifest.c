@@ -0,0 +1,810 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Job manifests: many regions of many roms, each decoded with its own
+// mode and palette to its own PNG.
+//
+//   {
+//       "output_dir": "gfx",                    // optional, default: next to the manifest
+//       "input":      "game.sfc",               // optional defaults for the jobs below
+//       "mode":       "snes-4bpp",
+//       "jobs": [
+//           { "offset": "0x48000", "length": 8192, "output": "font.png" },
+//           { "offset": 294912, "mode": "snes-2bpp", "palette": "hud.pal", "output": "hud.png" }
+//       ]
+//   }
+//
+// Relative input and palette paths are relative to the manifest. A job
+// without a length runs to the end of the file, and no two jobs may write
+// the same output. Every input is mapped once and shared by its jobs, and
+// jobs that would decode the same bytes the same way share one decode.
+// Everything runs on the batch pool.
+//
+// With an index, inputs are hashed (large ones in parallel chunks) and a
+// decode whose jobs' outputs are all still current is skipped.
+
+#include "lib_rom_bin.h"
+#include "rom_stats.h"
+#include "cli_file.h"
+#include "cli_hash.h"
+#include "cli_index.h"
+#include "cli_json.h"
+#include "cli_manifest.h"
+#include "cli_palette.h"
+#include "cli_png.h"
+#include "cli_pool.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+typedef struct cli_manifest_input {
+    char          * p_path;
+    unsigned char * p_data;     // Mapped, read-only
+    int64_t         size;
+    uint64_t        hash;       // Content hash, when an index is used
+    uint64_t      * p_digests;  // Chunk hashes, while hashing
+} cli_manifest_input;
+
+// Pool task: hashes one chunk of an input
+typedef struct cli_manifest_chunk {
+    cli_manifest_input * p_input;
+    int64_t              chunk;
+} cli_manifest_chunk;
+
+typedef struct cli_manifest_job cli_manifest_job;
+
+// One decode, shared by every job with the same input, range, mode and palette
+typedef struct cli_manifest_work {
+    cli_manifest_input * p_input;
+    int64_t              offset;
+    int64_t              length;
+    int                  image_mode;
+    const char         * p_palette;
+    cli_manifest_job   * p_jobs;
+    cli_index          * p_index;    // Records the outputs, NULL = no index
+    int64_t              decode_ns;
+} cli_manifest_work;
+
+struct cli_manifest_job {
+    int                  index;      // Position in the manifest
+    char               * p_output;
+    char               * p_palette;
+    int64_t              offset;
+    int64_t              length;
+    int                  image_mode;
+    cli_manifest_input * p_input;
+    cli_manifest_work  * p_work;
+    cli_manifest_job   * p_next_in_work;
+
+    uint64_t             index_key;
+
+    // Results for the report
+    int                  status;
+    int                  shared;     // Reused another job's decode
+    int                  skipped;    // Output was already current
+    unsigned int         width;
+    unsigned int         height;
+    int64_t              output_size;
+    int64_t              write_ns;
+};
+
+typedef struct cli_manifest {
+    char               * p_dir;      // Folder of the manifest file
+    char               * p_out_dir;
+    cli_manifest_input * p_inputs;
+    int                  num_inputs;
+    cli_manifest_job   * p_jobs;
+    int                  num_jobs;
+    int                  num_loaded;
+    cli_manifest_work  * p_works;
+    int                  num_works;
+} cli_manifest;
+
+
+
+// Numbers, or strings so offsets can be written in hex ("0x48000")
+static int cli_manifest_get_int(const cli_json * p_value, int64_t * p_result)
+{
+    char * p_end;
+
+    if (p_value->type == CLI_JSON_NUMBER) {
+        if ((p_value->number < 0) || (p_value->number != (double)(int64_t)p_value->number))
+            return -1;
+        *p_result = (int64_t)p_value->number;
+        return 0;
+    }
+
+    if (p_value->type == CLI_JSON_STRING) {
+        *p_result = (int64_t)strtoll(p_value->p_string, &p_end, 0);
+        if ((p_end != p_value->p_string) && (*p_end == '\0') && (*p_result >= 0))
+            return 0;
+    }
+
+    return -1;
+}
+
+
+
+// Mode name or number
+static int cli_manifest_get_mode(const cli_json * p_value)
+{
+    if (p_value->type == CLI_JSON_STRING)
+        return rom_bin_mode_from_name(p_value->p_string);
+
+    if ((p_value->type == CLI_JSON_NUMBER) &&
+        (p_value->number >= 0) && (p_value->number < BIN_MODE_LAST) &&
+        (p_value->number == (double)(int)p_value->number))
+        return (int)p_value->number;
+
+    return -1;
+}
+
+
+
+// Job member, or the manifest level default
+static const cli_json * cli_manifest_member(const cli_json * p_job, const cli_json * p_root, const char * p_key)
+{
+    const cli_json * p_value = cli_json_get(p_job, p_key);
+
+    return (p_value) ? p_value : cli_json_get(p_root, p_key);
+}
+
+
+
+// Each input file is mapped only once, however many jobs use it
+static cli_manifest_input * cli_manifest_find_input(cli_manifest * p_manifest, char * p_path)
+{
+    cli_manifest_input * p_input;
+    int                  c;
+
+    for (c = 0; c < p_manifest->num_inputs; c++)
+        if (0 == strcmp(p_manifest->p_inputs[c].p_path, p_path)) {
+            free(p_path);
+            return &p_manifest->p_inputs[c];
+        }
+
+    p_input = &p_manifest->p_inputs[p_manifest->num_inputs];
+
+    if (0 != cli_file_map(p_path, &p_input->p_data, &p_input->size)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_path);
+        free(p_path);
+        return NULL;
+    }
+
+    p_input->p_path = p_path;
+    p_manifest->num_inputs++;
+
+    return p_input;
+}
+
+
+
+static int cli_manifest_load_job(cli_manifest * p_manifest, const cli_json * p_root,
+                                 const cli_json * p_entry, cli_manifest_job * p_job)
+{
+    const cli_json * p_value;
+    char           * p_path;
+
+    if (p_entry->type != CLI_JSON_OBJECT) {
+        fprintf(stderr, "%s: job %d is not an object\n", CLI_NAME, p_job->index);
+        return -1;
+    }
+
+    // Input
+    p_value = cli_manifest_member(p_entry, p_root, "input");
+    if ((NULL == p_value) || (p_value->type != CLI_JSON_STRING)) {
+        fprintf(stderr, "%s: job %d has no input\n", CLI_NAME, p_job->index);
+        return -1;
+    }
+
+    if ((NULL == (p_path = cli_file_path_join(p_manifest->p_dir, p_value->p_string))) ||
+        (NULL == (p_job->p_input = cli_manifest_find_input(p_manifest, p_path))))
+        return -1;
+
+    // Mode
+    p_value = cli_manifest_member(p_entry, p_root, "mode");
+    if ((NULL == p_value) || (-1 == (p_job->image_mode = cli_manifest_get_mode(p_value)))) {
+        fprintf(stderr, "%s: job %d has no valid mode\n", CLI_NAME, p_job->index);
+        return -1;
+    }
+
+    // Range, the whole file by default
+    p_job->offset = 0;
+    p_value = cli_json_get(p_entry, "offset");
+    if (p_value && (0 != cli_manifest_get_int(p_value, &p_job->offset))) {
+        fprintf(stderr, "%s: job %d has a bad offset\n", CLI_NAME, p_job->index);
+        return -1;
+    }
+
+    p_job->length = p_job->p_input->size - p_job->offset;
+    p_value = cli_json_get(p_entry, "length");
+    if (p_value && (0 != cli_manifest_get_int(p_value, &p_job->length))) {
+        fprintf(stderr, "%s: job %d has a bad length\n", CLI_NAME, p_job->index);
+        return -1;
+    }
+
+    if ((p_job->offset >= p_job->p_input->size) ||
+        (p_job->length <= 0) ||
+        (p_job->length > (p_job->p_input->size - p_job->offset))) {
+        fprintf(stderr, "%s: job %d is outside of %s\n", CLI_NAME, p_job->index, p_job->p_input->p_path);
+        return -1;
+    }
+
+    // Palette, optional
+    p_value = cli_manifest_member(p_entry, p_root, "palette");
+    if (p_value && (p_value->type == CLI_JSON_STRING) &&
+        (NULL == (p_job->p_palette = cli_file_path_join(p_manifest->p_dir, p_value->p_string))))
+        return -1;
+
+    // Output
+    p_value = cli_json_get(p_entry, "output");
+    if ((NULL == p_value) || (p_value->type != CLI_JSON_STRING)) {
+        fprintf(stderr, "%s: job %d has no output\n", CLI_NAME, p_job->index);
+        return -1;
+    }
+
+    if (NULL == (p_job->p_output = cli_file_path_join(p_manifest->p_out_dir, p_value->p_string)))
+        return -1;
+
+    return 0;
+}
+
+
+
+static int cli_manifest_same_work(const cli_manifest_work * p_work, const cli_manifest_job * p_job)
+{
+    return (p_work->p_input    == p_job->p_input) &&
+           (p_work->offset     == p_job->offset) &&
+           (p_work->length     == p_job->length) &&
+           (p_work->image_mode == p_job->image_mode) &&
+           (((NULL == p_work->p_palette) && (NULL == p_job->p_palette)) ||
+            (p_work->p_palette && p_job->p_palette && (0 == strcmp(p_work->p_palette, p_job->p_palette))));
+}
+
+
+
+// Groups jobs that decode the same thing. Looked up through a hash of
+// the parameters, manifests can list thousands of jobs
+static int cli_manifest_group_jobs(cli_manifest * p_manifest)
+{
+    int   table_size = 1;
+    int * p_table;
+    int   c;
+
+    while (table_size < (p_manifest->num_jobs * 2))
+        table_size *= 2;
+
+    if ((NULL == (p_table = malloc(table_size * sizeof(int)))) ||
+        (NULL == (p_manifest->p_works = calloc(p_manifest->num_jobs, sizeof(cli_manifest_work))))) {
+        free(p_table);
+        return -1;
+    }
+
+    memset(p_table, -1, table_size * sizeof(int));
+
+    for (c = 0; c < p_manifest->num_jobs; c++) {
+        cli_manifest_job * p_job = &p_manifest->p_jobs[c];
+        uint64_t           hash  = 14695981039346656037ULL;
+        const char       * p_char;
+        int                slot;
+
+        // FNV-1a over the parameters
+        hash = (hash ^ (uint64_t)(p_job->p_input - p_manifest->p_inputs)) * 1099511628211ULL;
+        hash = (hash ^ (uint64_t)p_job->offset)     * 1099511628211ULL;
+        hash = (hash ^ (uint64_t)p_job->length)     * 1099511628211ULL;
+        hash = (hash ^ (uint64_t)p_job->image_mode) * 1099511628211ULL;
+        for (p_char = p_job->p_palette; p_char && *p_char; p_char++)
+            hash = (hash ^ (unsigned char)*p_char) * 1099511628211ULL;
+
+        for (slot = (int)(hash & (table_size - 1)); p_table[slot] != -1; slot = (slot + 1) & (table_size - 1))
+            if (cli_manifest_same_work(&p_manifest->p_works[p_table[slot]], p_job))
+                break;
+
+        if (p_table[slot] == -1) {
+            cli_manifest_work * p_work = &p_manifest->p_works[p_manifest->num_works];
+
+            p_work->p_input    = p_job->p_input;
+            p_work->offset     = p_job->offset;
+            p_work->length     = p_job->length;
+            p_work->image_mode = p_job->image_mode;
+            p_work->p_palette  = p_job->p_palette;
+            p_table[slot] = p_manifest->num_works++;
+        }
+        else
+            p_job->shared = 1;
+
+        // Jobs stay in manifest order within their work
+        p_job->p_work = &p_manifest->p_works[p_table[slot]];
+        p_job->p_next_in_work = NULL;
+        {
+            cli_manifest_job ** pp_tail = &p_job->p_work->p_jobs;
+
+            while (*pp_tail)
+                pp_tail = &(*pp_tail)->p_next_in_work;
+            *pp_tail = p_job;
+        }
+    }
+
+    free(p_table);
+
+    return 0;
+}
+
+
+
+// Two jobs writing the same file would race each other, and with an
+// index they would invalidate each other's entry on every run
+static int cli_manifest_check_outputs(cli_manifest * p_manifest)
+{
+    int   table_size = 1;
+    int * p_table;
+    int   status = 0;
+    int   c;
+
+    while (table_size < (p_manifest->num_jobs * 2))
+        table_size *= 2;
+
+    if (NULL == (p_table = malloc(table_size * sizeof(int))))
+        return -1;
+
+    memset(p_table, -1, table_size * sizeof(int));
+
+    for (c = 0; c < p_manifest->num_jobs; c++) {
+        const char * p_output = p_manifest->p_jobs[c].p_output;
+        uint64_t     hash     = 14695981039346656037ULL;
+        const char * p_char;
+        int          slot;
+
+        for (p_char = p_output; *p_char; p_char++)
+            hash = (hash ^ (unsigned char)*p_char) * 1099511628211ULL;
+
+        for (slot = (int)(hash & (table_size - 1)); p_table[slot] != -1; slot = (slot + 1) & (table_size - 1))
+            if (0 == strcmp(p_manifest->p_jobs[p_table[slot]].p_output, p_output))
+                break;
+
+        if (p_table[slot] == -1)
+            p_table[slot] = c;
+        else {
+            fprintf(stderr, "%s: jobs %d and %d both write %s\n", CLI_NAME,
+                    p_manifest->p_jobs[p_table[slot]].index, p_manifest->p_jobs[c].index, p_output);
+            status = -1;
+        }
+    }
+
+    free(p_table);
+
+    return status;
+}
+
+
+
+static int cli_manifest_load(cli_manifest * p_manifest, const char * p_filename)
+{
+    unsigned char  * p_data;
+    int64_t          size;
+    char           * p_text;
+    char             error[128];
+    cli_json       * p_root;
+    const cli_json * p_jobs;
+    const cli_json * p_entry;
+    const cli_json * p_value;
+    int              status = -1;
+
+    if (0 != cli_file_read(p_filename, &p_data, &size)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_filename);
+        return -1;
+    }
+
+    // The parser wants a terminated string
+    p_text = malloc((size_t)size + 1);
+    if (p_text) {
+        memcpy(p_text, p_data, (size_t)size);
+        p_text[size] = '\0';
+    }
+    rom_bin_free(p_data);
+
+    if (NULL == p_text)
+        return -1;
+
+    p_root = cli_json_parse(p_text, error, sizeof(error));
+    free(p_text);
+
+    if (NULL == p_root) {
+        fprintf(stderr, "%s: %s: %s\n", CLI_NAME, p_filename, error);
+        return -1;
+    }
+
+    p_jobs = cli_json_get(p_root, "jobs");
+    if ((NULL == p_jobs) || (p_jobs->type != CLI_JSON_ARRAY) || (NULL == p_jobs->p_child)) {
+        fprintf(stderr, "%s: %s has no \"jobs\" list\n", CLI_NAME, p_filename);
+        goto done;
+    }
+
+    for (p_entry = p_jobs->p_child; p_entry; p_entry = p_entry->p_next)
+        p_manifest->num_jobs++;
+
+    p_manifest->p_dir = cli_file_dir_name(p_filename);
+
+    p_value = cli_json_get(p_root, "output_dir");
+    if (p_value && (p_value->type == CLI_JSON_STRING))
+        p_manifest->p_out_dir = cli_file_path_join(p_manifest->p_dir, p_value->p_string);
+    else if (p_manifest->p_dir)
+        p_manifest->p_out_dir = strdup(p_manifest->p_dir);
+
+    // At most one input per job
+    p_manifest->p_inputs = calloc(p_manifest->num_jobs, sizeof(cli_manifest_input));
+    p_manifest->p_jobs   = calloc(p_manifest->num_jobs, sizeof(cli_manifest_job));
+
+    if ((NULL == p_manifest->p_dir) || (NULL == p_manifest->p_out_dir) ||
+        (NULL == p_manifest->p_inputs) || (NULL == p_manifest->p_jobs))
+        goto done;
+
+    // Load every job so all the mistakes get reported at once
+    status = 0;
+
+    for (p_entry = p_jobs->p_child; p_entry; p_entry = p_entry->p_next) {
+        cli_manifest_job * p_job = &p_manifest->p_jobs[p_manifest->num_loaded];
+
+        p_job->index = p_manifest->num_loaded++;
+
+        if (0 != cli_manifest_load_job(p_manifest, p_root, p_entry, p_job))
+            status = -1;
+    }
+
+    if ((0 == status) && (0 != cli_manifest_check_outputs(p_manifest)))
+        status = -1;
+
+    if ((0 == status) && (0 != cli_manifest_group_jobs(p_manifest)))
+        status = -1;
+
+done:
+    cli_json_free(p_root);
+
+    return status;
+}
+
+
+
+static void cli_manifest_free(cli_manifest * p_manifest)
+{
+    int c;
+
+    for (c = 0; c < p_manifest->num_inputs; c++) {
+        cli_file_unmap(p_manifest->p_inputs[c].p_data, p_manifest->p_inputs[c].size);
+        free(p_manifest->p_inputs[c].p_path);
+        free(p_manifest->p_inputs[c].p_digests);
+    }
+
+    for (c = 0; c < p_manifest->num_loaded; c++) {
+        free(p_manifest->p_jobs[c].p_output);
+        free(p_manifest->p_jobs[c].p_palette);
+    }
+
+    free(p_manifest->p_works);
+    free(p_manifest->p_jobs);
+    free(p_manifest->p_inputs);
+    free(p_manifest->p_out_dir);
+    free(p_manifest->p_dir);
+}
+
+
+
+// Pool task: decodes once, then writes the PNG of every job sharing it
+static void cli_manifest_run_work(void * p_arg)
+{
+    cli_manifest_work * p_work = p_arg;
+    cli_manifest_job  * p_job;
+    rom_gfx_data        rom_gfx;
+    app_gfx_data        app_gfx;
+    app_color_data      colorpal;
+    rom_stats           stats;
+    int                 status = 0;
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    // Decode straight from the shared mapping
+    rom_gfx.p_data          = p_work->p_input->p_data + p_work->offset;
+    rom_gfx.size            = p_work->length;
+    app_gfx.image_mode      = p_work->image_mode;
+    app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+    app_gfx.p_stats         = rom_stats_begin(&stats, "extract", p_work->p_jobs->p_output, p_work->image_mode);
+
+    p_work->decode_ns = rom_stats_now_ns();
+
+    if (0 != rom_bin_decode(&rom_gfx, &app_gfx, &colorpal)) {
+        fprintf(stderr, "%s: can't decode %s at 0x%" PRIx64 " as %s\n", CLI_NAME,
+                p_work->p_input->p_path, p_work->offset, rom_bin_mode_name(p_work->image_mode));
+        status = -1;
+    }
+    else if (p_work->p_palette && (0 != cli_palette_load(p_work->p_palette, &colorpal))) {
+        fprintf(stderr, "%s: can't load palette %s\n", CLI_NAME, p_work->p_palette);
+        status = -1;
+    }
+
+    p_work->decode_ns = rom_stats_now_ns() - p_work->decode_ns;
+
+    for (p_job = p_work->p_jobs; p_job; p_job = p_job->p_next_in_work) {
+        p_job->status = status;
+        if (0 != status)
+            continue;
+
+        p_job->width    = app_gfx.width;
+        p_job->height   = app_gfx.height;
+        p_job->write_ns = rom_stats_now_ns();
+
+        rom_stats_start(app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+
+        if (0 != cli_png_write(p_job->p_output, &app_gfx, &colorpal)) {
+            fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_job->p_output);
+            p_job->status = -1;
+        }
+
+        rom_stats_stop(app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+
+        p_job->write_ns    = rom_stats_now_ns() - p_job->write_ns;
+        p_job->output_size = cli_file_stat_size(p_job->p_output);
+
+        if (0 == p_job->status)
+            cli_index_set(p_work->p_index, p_job->index_key, p_job->p_output);
+    }
+
+    rom_stats_set_status(app_gfx.p_stats, status);
+    rom_stats_end(app_gfx.p_stats);
+
+    // The rom data belongs to the mapping
+    rom_gfx.p_data = NULL;
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+}
+
+
+
+static void cli_manifest_json_string(FILE * file, const char * p_string)
+{
+    fputc('"', file);
+
+    for (; *p_string; p_string++) {
+        if ((*p_string == '"') || (*p_string == '\\'))
+            fprintf(file, "\\%c", *p_string);
+        else if ((unsigned char)*p_string < 0x20)
+            fprintf(file, "\\u%04x", (unsigned char)*p_string);
+        else
+            fputc(*p_string, file);
+    }
+
+    fputc('"', file);
+}
+
+
+
+// One line per job on stdout, plus the same as JSON if asked for
+static int cli_manifest_report(cli_manifest * p_manifest, const char * p_report)
+{
+    FILE * file = NULL;
+    int    c;
+
+    printf("%-8s %10s %10s %-14s %11s %10s %9s %9s  %s\n",
+           "status", "offset", "length", "mode", "size", "bytes", "decode_ms", "write_ms", "output");
+
+    for (c = 0; c < p_manifest->num_jobs; c++) {
+        cli_manifest_job * p_job = &p_manifest->p_jobs[c];
+        char               size[24];
+
+        if (p_job->skipped)
+            snprintf(size, sizeof(size), "-");
+        else
+            snprintf(size, sizeof(size), "%ux%u", p_job->width, p_job->height);
+
+        printf("%-8s %#10" PRIx64 " %10" PRId64 " %-14s %11s %10" PRId64 " %9.2f %9.2f  %s\n",
+               (0 != p_job->status) ? "failed" : (p_job->skipped) ? "skipped" :
+               (p_job->shared) ? "shared" : "ok",
+               p_job->offset, p_job->length, rom_bin_mode_name(p_job->image_mode), size,
+               (p_job->output_size > 0) ? p_job->output_size : 0,
+               p_job->p_work->decode_ns / 1e6, p_job->write_ns / 1e6, p_job->p_output);
+    }
+
+    if (NULL == p_report)
+        return 0;
+
+    if (NULL == (file = fopen(p_report, "w"))) {
+        fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_report);
+        return -1;
+    }
+
+    fprintf(file, "[\n");
+
+    for (c = 0; c < p_manifest->num_jobs; c++) {
+        cli_manifest_job * p_job = &p_manifest->p_jobs[c];
+
+        fprintf(file, "  {\"output\":");
+        cli_manifest_json_string(file, p_job->p_output);
+        fprintf(file, ",\"input\":");
+        cli_manifest_json_string(file, p_job->p_input->p_path);
+        fprintf(file, ",\"offset\":%" PRId64 ",\"length\":%" PRId64 ",\"mode\":\"%s\","
+                      "\"status\":%d,\"shared\":%s,\"skipped\":%s,\"width\":%u,\"height\":%u,\"bytes\":%" PRId64 ","
+                      "\"decode_us\":%" PRId64 ",\"write_us\":%" PRId64 "}%s\n",
+                p_job->offset, p_job->length, rom_bin_mode_name(p_job->image_mode),
+                p_job->status, (p_job->shared) ? "true" : "false",
+                (p_job->skipped) ? "true" : "false", p_job->width, p_job->height,
+                (p_job->output_size > 0) ? p_job->output_size : 0,
+                p_job->p_work->decode_ns / 1000, p_job->write_ns / 1000,
+                ((c + 1) < p_manifest->num_jobs) ? "," : "");
+    }
+
+    fprintf(file, "]\n");
+
+    return (0 == fclose(file)) ? 0 : -1;
+}
+
+
+
+// Pool task
+static void cli_manifest_hash_chunk(void * p_arg)
+{
+    cli_manifest_chunk * p_chunk = p_arg;
+    cli_manifest_input * p_input = p_chunk->p_input;
+
+    p_input->p_digests[p_chunk->chunk] = cli_hash_chunk(p_input->p_data, p_input->size, p_chunk->chunk);
+}
+
+
+
+// Hashes every input on the pool, one task per chunk so a single
+// large rom still uses every worker
+static int cli_manifest_hash_inputs(cli_manifest * p_manifest, cli_pool * p_pool)
+{
+    cli_manifest_chunk * p_chunks;
+    int64_t              num_chunks = 0;
+    int64_t              next = 0;
+    int64_t              chunk;
+    int                  c;
+
+    for (c = 0; c < p_manifest->num_inputs; c++) {
+        cli_manifest_input * p_input = &p_manifest->p_inputs[c];
+
+        p_input->p_digests = malloc((size_t)cli_hash_num_chunks(p_input->size) * sizeof(uint64_t));
+        if (NULL == p_input->p_digests)
+            return -1;
+
+        num_chunks += cli_hash_num_chunks(p_input->size);
+    }
+
+    if (NULL == (p_chunks = malloc((size_t)num_chunks * sizeof(cli_manifest_chunk))))
+        return -1;
+
+    for (c = 0; c < p_manifest->num_inputs; c++)
+        for (chunk = 0; chunk < cli_hash_num_chunks(p_manifest->p_inputs[c].size); chunk++) {
+            p_chunks[next].p_input = &p_manifest->p_inputs[c];
+            p_chunks[next].chunk   = chunk;
+            cli_pool_submit(p_pool, cli_manifest_hash_chunk, &p_chunks[next++]);
+        }
+
+    cli_pool_wait(p_pool);
+    free(p_chunks);
+
+    for (c = 0; c < p_manifest->num_inputs; c++) {
+        cli_manifest_input * p_input = &p_manifest->p_inputs[c];
+
+        p_input->hash = cli_hash_combine(p_input->p_digests, cli_hash_num_chunks(p_input->size), p_input->size);
+    }
+
+    return 0;
+}
+
+
+
+// Works out the index key of each job of a work. True if they are
+// all current, so the decode isn't needed at all
+static int cli_manifest_work_is_current(cli_manifest_work * p_work, cli_index * p_index)
+{
+    cli_manifest_job * p_job;
+    uint64_t           palette_hash = 0;
+    int                current = 1;
+    char             * p_params;
+    size_t             size;
+
+    // An unreadable palette fails the work later, never skip it
+    if (p_work->p_palette && (0 != cli_hash_file(p_work->p_palette, &palette_hash)))
+        current = 0;
+
+    p_work->p_index = p_index;
+
+    for (p_job = p_work->p_jobs; p_job; p_job = p_job->p_next_in_work) {
+        size = strlen(p_job->p_output) + 96;
+        if (NULL == (p_params = malloc(size)))
+            return 0;
+
+        snprintf(p_params, size, "extract %" PRId64 " %" PRId64 " %s %016" PRIx64 " %s",
+                 p_job->offset, p_job->length, rom_bin_mode_name(p_job->image_mode),
+                 palette_hash, p_job->p_output);
+
+        p_job->index_key = cli_index_key(p_job->p_input->hash, p_params);
+        free(p_params);
+
+        if (!cli_index_is_current(p_index, p_job->index_key, p_job->p_output))
+            current = 0;
+    }
+
+    if (!current)
+        return 0;
+
+    for (p_job = p_work->p_jobs; p_job; p_job = p_job->p_next_in_work) {
+        p_job->skipped     = 1;
+        p_job->output_size = cli_file_stat_size(p_job->p_output);
+    }
+
+    return 1;
+}
+
+
+
+// Runs every job of a manifest, returns the number that failed
+// (or -1 if the manifest itself couldn't be used)
+int cli_manifest_run(const char * p_filename, const cli_manifest_options * p_options)
+{
+    cli_manifest manifest;
+    cli_pool   * p_pool;
+    int          num_failed = 0;
+    int          c;
+
+    memset(&manifest, 0, sizeof(manifest));
+
+    if (0 != cli_manifest_load(&manifest, p_filename)) {
+        cli_manifest_free(&manifest);
+        return -1;
+    }
+
+    // An output folder named in the manifest may not exist yet
+    if ((manifest.p_out_dir[0] != '\0') && (0 != cli_file_make_dir(manifest.p_out_dir)))
+        fprintf(stderr, "%s: can't create %s\n", CLI_NAME, manifest.p_out_dir);
+
+    if (NULL == (p_pool = cli_pool_new(p_options->num_threads))) {
+        fprintf(stderr, "%s: can't start worker threads\n", CLI_NAME);
+        cli_manifest_free(&manifest);
+        return -1;
+    }
+
+    if (p_options->p_index && (0 != cli_manifest_hash_inputs(&manifest, p_pool))) {
+        fprintf(stderr, "%s: out of memory\n", CLI_NAME);
+        cli_pool_free(p_pool);
+        cli_manifest_free(&manifest);
+        return -1;
+    }
+
+    for (c = 0; c < manifest.num_works; c++)
+        if (!(p_options->p_index && cli_manifest_work_is_current(&manifest.p_works[c], p_options->p_index)))
+            cli_pool_submit(p_pool, cli_manifest_run_work, &manifest.p_works[c]);
+
+    cli_pool_wait(p_pool);
+    cli_pool_free(p_pool);
+
+    for (c = 0; c < manifest.num_jobs; c++)
+        if (0 != manifest.p_jobs[c].status)
+            num_failed++;
+
+    if (0 != cli_manifest_report(&manifest, p_options->p_report))
+        num_failed++;
+
+    cli_manifest_free(&manifest);
+
+    return num_failed;
+}
@@ -0,0 +1,32 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_MANIFEST_HEADER
+#define CLI_MANIFEST_HEADER
+
+#include "cli_index.h"
+
+    typedef struct cli_manifest_options {
+        int          num_threads;     // 0 = one per processor
+        const char * p_report;        // JSON report file, NULL = none
+        cli_index  * p_index;         // Skip current jobs, NULL = run everything
+    } cli_manifest_options;
+
+    int cli_manifest_run(const char *, const cli_manifest_options *);
+
+#endif // CLI_MANIFEST_HEADER
@@ -0,0 +1,369 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "cli_palette.h"
+#include "cli_file.h"
+
+#include "cli_hash.h"
+#include "cli_png.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+// Swatch size in the PNG written by cli_palette_scan_run()
+#define CLI_PALETTE_SWATCH     8
+
+// Parsed palettes kept for later loads
+#define CLI_PALETTE_CACHE_SIZE 16
+
+
+
+// Parsed palettes, keyed by the hash of the file's contents, so jobs
+// that share a palette (ex: a manifest's) parse it once. What a file is
+// read as also depends on its extension, which is part of the key
+typedef struct cli_palette_cache_entry {
+    uint64_t      hash;
+    int64_t       size;
+    char          extension[8];    // Lowercase, "" if none
+    int           num_colors;
+    unsigned char colors[256 * 3];
+} cli_palette_cache_entry;
+
+static cli_palette_cache_entry cli_palette_cache[CLI_PALETTE_CACHE_SIZE];
+static int                     cli_palette_cache_used = 0;
+static int                     cli_palette_cache_next = 0;    // Replaced next when full
+static pthread_mutex_t         cli_palette_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Sidecar palettes looked for next to an input, in this order
+static const char * const cli_palette_sidecars[] = {
+    ".pal", ".act", ".gpl", ".zst", ".gs0", ".ss0"
+};
+
+
+
+static void cli_palette_cache_extension(const char * filename, char * p_extension)
+{
+    const char * p_slash = strrchr(filename, '/');
+    const char * p_dot   = strrchr(filename, '.');
+    size_t       c = 0;
+
+    if (p_dot && (!p_slash || (p_dot > p_slash)))
+        for (; p_dot[c] && (c < 7); c++)
+            p_extension[c] = (char)tolower((unsigned char)p_dot[c]);
+
+    p_extension[c] = '\0';
+}
+
+
+
+// Returns FALSE on a miss
+static int cli_palette_cache_get(uint64_t hash, int64_t size, const char * p_extension,
+                                 cli_palette_cache_entry * p_entry)
+{
+    int found = FALSE;
+    int c;
+
+    pthread_mutex_lock(&cli_palette_cache_lock);
+
+    for (c = 0; c < cli_palette_cache_used; c++)
+        if ((cli_palette_cache[c].hash == hash) && (cli_palette_cache[c].size == size) &&
+            (0 == strcmp(cli_palette_cache[c].extension, p_extension))) {
+            *p_entry = cli_palette_cache[c];
+            found = TRUE;
+            break;
+        }
+
+    pthread_mutex_unlock(&cli_palette_cache_lock);
+
+    return found;
+}
+
+
+
+static void cli_palette_cache_put(const cli_palette_cache_entry * p_entry)
+{
+    pthread_mutex_lock(&cli_palette_cache_lock);
+
+    if (cli_palette_cache_used < CLI_PALETTE_CACHE_SIZE)
+        cli_palette_cache[cli_palette_cache_used++] = *p_entry;
+    else {
+        cli_palette_cache[cli_palette_cache_next] = *p_entry;
+        cli_palette_cache_next = (cli_palette_cache_next + 1) % CLI_PALETTE_CACHE_SIZE;
+    }
+
+    pthread_mutex_unlock(&cli_palette_cache_lock);
+}
+
+
+
+// Replaces the decoded color map with one from a palette file: JASC,
+// GIMP, RIFF or .act palettes, emulator save states, or raw R,G,B byte
+// triplets in a .pal (see rom_bin_palette_parse()). A "format:" prefix (ex:
+// "bgr555:colors.bin") reads raw colors in a console's format instead.
+// Files that only hold a few colors replace the first ones
+int cli_palette_load(const char * filename, app_color_data * p_colorpal)
+{
+    cli_palette_cache_entry entry;
+    app_color_data          parsed;
+    const char            * p_colon = strchr(filename, ':');
+    unsigned char         * p_data;
+    int64_t                 size;
+    int                     format = -1;
+    int                     c;
+
+    if ((NULL == p_colorpal->p_data) || (p_colorpal->bytes_per_pixel != 3))
+        return -1;
+
+    // Only a known format name counts as a prefix, the rest is a path
+    if ((NULL != p_colon) && (p_colon - filename < 16)) {
+        char name[16];
+
+        memcpy(name, filename, (size_t)(p_colon - filename));
+        name[p_colon - filename] = '\0';
+
+        if (-1 != (format = rom_bin_palette_format_from_name(name)))
+            filename = p_colon + 1;
+    }
+
+    if (0 != cli_file_map(filename, &p_data, &size))
+        return -1;
+
+    entry.hash = cli_hash_content(p_data, size) ^ (uint64_t)(format + 1);
+    entry.size = size;
+    cli_palette_cache_extension(filename, entry.extension);
+
+    if (!cli_palette_cache_get(entry.hash, size, entry.extension, &entry)) {
+        parsed.p_data          = entry.colors;
+        parsed.bytes_per_pixel = 3;
+        parsed.size            = 256;
+        parsed.index           = 0;
+
+        if (-1 != format) {
+            entry.num_colors = (int)(size / rom_bin_palette_color_bytes(format));
+            if (entry.num_colors > 256)
+                entry.num_colors = 256;
+            if (0 != rom_bin_palette_decode(format, p_data, size, &parsed))
+                entry.num_colors = -1;
+        }
+        else
+            entry.num_colors = rom_bin_palette_parse(filename, p_data, size, &parsed);
+
+        if (entry.num_colors > 0)
+            cli_palette_cache_put(&entry);
+    }
+
+    cli_file_unmap(p_data, size);
+
+    if (entry.num_colors <= 0)
+        return -1;
+
+    c = (entry.num_colors < p_colorpal->size) ? entry.num_colors : p_colorpal->size;
+    memcpy(p_colorpal->p_data, entry.colors, (size_t)c * 3);
+
+    return 0;
+}
+
+
+
+// A palette stored next to an input with the same name (ex: level.pal
+// or level.zst for level.bin), NULL if there is none. Free the result
+char * cli_palette_find_sidecar(const char * filename)
+{
+    const char * p_slash = strrchr(filename, '/');
+    const char * p_dot   = strrchr(filename, '.');
+    size_t       base_len;
+    char       * p_path;
+    size_t       c;
+
+    // Only a dot in the file name starts an extension
+    if ((NULL == p_dot) || (p_slash && (p_dot < p_slash)))
+        base_len = strlen(filename);
+    else
+        base_len = (size_t)(p_dot - filename);
+
+    if (NULL == (p_path = malloc(base_len + 8)))
+        return NULL;
+
+    memcpy(p_path, filename, base_len);
+
+    for (c = 0; c < sizeof(cli_palette_sidecars) / sizeof(cli_palette_sidecars[0]); c++) {
+        strcpy(p_path + base_len, cli_palette_sidecars[c]);
+
+        if ((cli_file_stat_size(p_path) > 0) && (0 != strcmp(p_path, filename)))
+            return p_path;
+    }
+
+    free(p_path);
+
+    return NULL;
+}
+
+
+
+// Replaces the decoded color map with colors stored in the rom itself,
+// given as "[format:]offset" (ex: "0x1F200" or "genesis:0x1F200").
+// The format defaults to the one of the image mode's console
+int cli_palette_from_rom(const char * p_spec, const unsigned char * p_rom, int64_t rom_size,
+                         int image_mode, app_color_data * p_colorpal)
+{
+    const char * p_colon = strchr(p_spec, ':');
+    const char * p_offset = p_spec;
+    char       * p_end;
+    int64_t      offset;
+    int          format;
+
+    if (NULL != p_colon) {
+        char name[16];
+
+        if ((size_t)(p_colon - p_spec) >= sizeof(name))
+            return -1;
+
+        memcpy(name, p_spec, (size_t)(p_colon - p_spec));
+        name[p_colon - p_spec] = '\0';
+
+        format   = rom_bin_palette_format_from_name(name);
+        p_offset = p_colon + 1;
+    }
+    else
+        format = rom_bin_palette_format_for_mode(image_mode);
+
+    offset = (int64_t)strtoll(p_offset, &p_end, 0);
+
+    if ((-1 == format) || (p_end == p_offset) || (*p_end != '\0') ||
+        (offset < 0) || (offset >= rom_size))
+        return -1;
+
+    return rom_bin_palette_decode(format, p_rom + offset, rom_size - offset, p_colorpal);
+}
+
+
+
+// One row of swatches per hit
+static int cli_palette_write_swatches(const char * filename, const unsigned char * p_rom,
+                                      const rom_bin_palette_hit * p_hits, int num_hits)
+{
+    unsigned char   colors[256 * 3];
+    app_color_data  colorpal;
+    unsigned char * p_rgba;
+    unsigned int    width  = 0;
+    unsigned int    height = (unsigned int)num_hits * CLI_PALETTE_SWATCH;
+    unsigned int    x, y;
+    int             status;
+    int             c;
+
+    for (c = 0; c < num_hits; c++)
+        if ((unsigned int)p_hits[c].num_colors * CLI_PALETTE_SWATCH > width)
+            width = (unsigned int)p_hits[c].num_colors * CLI_PALETTE_SWATCH;
+
+    if (NULL == (p_rgba = calloc((size_t)width * height, 4)))
+        return -1;
+
+    colorpal.p_data          = colors;
+    colorpal.bytes_per_pixel = 3;
+    colorpal.size            = 256;
+
+    for (c = 0; c < num_hits; c++) {
+        rom_bin_palette_decode(p_hits[c].format, p_rom + p_hits[c].offset,
+                               p_hits[c].num_colors * rom_bin_palette_color_bytes(p_hits[c].format), &colorpal);
+
+        for (y = 0; y < CLI_PALETTE_SWATCH; y++)
+            for (x = 0; x < (unsigned int)p_hits[c].num_colors * CLI_PALETTE_SWATCH; x++) {
+                unsigned char * p_pixel = p_rgba + ((((size_t)c * CLI_PALETTE_SWATCH + y) * width + x) * 4);
+
+                memcpy(p_pixel, colors + ((x / CLI_PALETTE_SWATCH) * 3), 3);
+                p_pixel[3] = 0xFF;
+            }
+    }
+
+    status = cli_png_write_rgba(filename, width, height, p_rgba);
+
+    free(p_rgba);
+
+    return status;
+}
+
+
+
+// Lists the blocks of a rom that look most like palettes, best first
+int cli_palette_scan_run(const char * p_rom, const cli_palette_scan_options * p_options)
+{
+    unsigned char       * p_rom_data;
+    int64_t               rom_size;
+    rom_bin_palette_hit * p_hits;
+    unsigned char         colors[256 * 3];
+    app_color_data        colorpal;
+    int                   num_hits;
+    int                   status = 0;
+    int                   c, k;
+
+    if (0 != cli_file_map(p_rom, &p_rom_data, &rom_size)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_rom);
+        return -1;
+    }
+
+    if (NULL == (p_hits = malloc((size_t)p_options->max_hits * sizeof(rom_bin_palette_hit)))) {
+        cli_file_unmap(p_rom_data, rom_size);
+        return -1;
+    }
+
+    num_hits = rom_bin_find_palettes(p_rom_data, rom_size, p_options->format, p_options->num_colors,
+                                     p_hits, p_options->max_hits);
+
+    if (num_hits < 0) {
+        fprintf(stderr, "%s: out of memory scanning %s\n", CLI_NAME, p_rom);
+        status = -1;
+    }
+    else {
+        colorpal.p_data          = colors;
+        colorpal.bytes_per_pixel = 3;
+        colorpal.size            = 256;
+
+        printf("    offset format  score colors\n");
+
+        for (c = 0; c < num_hits; c++) {
+            printf("%#10llx %-7s %5d ", (unsigned long long)p_hits[c].offset,
+                   rom_bin_palette_format_name(p_hits[c].format), p_hits[c].score);
+
+            // The first colors, enough to tell them apart
+            rom_bin_palette_decode(p_hits[c].format, p_rom_data + p_hits[c].offset,
+                                   p_hits[c].num_colors * rom_bin_palette_color_bytes(p_hits[c].format), &colorpal);
+
+            for (k = 0; (k < p_hits[c].num_colors) && (k < 8); k++)
+                printf(" %02x%02x%02x", colors[k * 3], colors[(k * 3) + 1], colors[(k * 3) + 2]);
+
+            printf("%s\n", (p_hits[c].num_colors > 8) ? " ..." : "");
+        }
+
+        if (p_options->p_swatches && (num_hits > 0) &&
+            (0 != cli_palette_write_swatches(p_options->p_swatches, p_rom_data, p_hits, num_hits))) {
+            fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_options->p_swatches);
+            status = -1;
+        }
+    }
+
+    free(p_hits);
+    cli_file_unmap(p_rom_data, rom_size);
+
+    return status;
+}
@@ -0,0 +1,37 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_PALETTE_HEADER
+#define CLI_PALETTE_HEADER
+
+#include "lib_rom_bin.h"
+
+    typedef struct cli_palette_scan_options {
+        int          format;       // -1 = every format
+        int          num_colors;
+        int          max_hits;
+        const char * p_swatches;   // PNG of the colors of each hit, or NULL
+    } cli_palette_scan_options;
+
+    int    cli_palette_load(const char *, app_color_data *);
+    char * cli_palette_find_sidecar(const char *);
+    int    cli_palette_from_rom(const char *, const unsigned char *, int64_t, int, app_color_data *);
+
+    int    cli_palette_scan_run(const char *, const cli_palette_scan_options *);
+
+#endif // CLI_PALETTE_HEADER
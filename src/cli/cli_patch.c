@@ -0,0 +1,102 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "lib_rom_bin.h"
+#include "rom_stats.h"
+#include "cli_file.h"
+#include "cli_patch.h"
+#include "cli_png.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+
+
+// Encodes the image and writes what it changes in the rom as an IPS / BPS
+// patch. The rom itself is left alone
+int cli_patch_run(const char * p_image, const char * p_rom, const char * p_out,
+                  const cli_patch_options * p_options)
+{
+    rom_gfx_data    rom_gfx;
+    app_gfx_data    app_gfx;
+    app_color_data  colorpal;
+    rom_stats       stats;
+    unsigned char * p_source = NULL;
+    int64_t         source_size = 0;
+    unsigned char * p_patch = NULL;
+    int64_t         patch_size;
+    int64_t         start_ns;
+    int             status = -1;
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    app_gfx.image_mode = p_options->image_mode;
+    app_gfx.p_stats    = rom_stats_begin(&stats, "patch", p_out, p_options->image_mode);
+
+    rom_stats_start(app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+
+    if (0 != cli_png_read(p_image, &app_gfx))
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_image);
+    else if (0 != cli_file_map(p_rom, &p_source, &source_size))
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_rom);
+    else if (p_options->offset > source_size)
+        fprintf(stderr, "%s: offset 0x%" PRIx64 " is past the end of %s\n", CLI_NAME, p_options->offset, p_rom);
+    else if (0 != rom_bin_encode(&rom_gfx, &app_gfx))
+        fprintf(stderr, "%s: can't encode %s as %s\n", CLI_NAME, p_image, rom_bin_mode_name(p_options->image_mode));
+    else {
+        rom_stats_stop(app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+
+        start_ns = rom_stats_now_ns();
+
+        if (0 != rom_bin_make_patch(p_options->format, p_source, source_size,
+                                    rom_gfx.p_data, rom_gfx.size, p_options->offset,
+                                    &p_patch, &patch_size))
+            fprintf(stderr, "%s: can't make a patch for %s at 0x%" PRIx64 "%s\n", CLI_NAME, p_rom, p_options->offset,
+                    (p_options->format == ROM_BIN_PATCH_IPS) ? " (IPS is limited to 16 MiB)" : "");
+        else {
+            start_ns = rom_stats_now_ns() - start_ns;
+
+            rom_stats_start(app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+
+            if (0 != cli_file_write(p_out, p_patch, patch_size))
+                fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_out);
+            else {
+                printf("%s: %" PRId64 " byte patch for %" PRId64 " encoded bytes at 0x%" PRIx64 " (%.2f ms)\n",
+                       p_out, patch_size, rom_gfx.size, p_options->offset, start_ns / 1e6);
+                status = 0;
+            }
+
+            rom_stats_stop(app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+            rom_stats_add(app_gfx.p_stats, ROM_STATS_COUNT_BYTES_COPIED, patch_size);
+        }
+    }
+
+    rom_stats_set_status(app_gfx.p_stats, status);
+    rom_stats_end(app_gfx.p_stats);
+
+    rom_bin_free(p_patch);
+    cli_file_unmap(p_source, source_size);
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    return status;
+}
@@ -0,0 +1,451 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "cli_png.h"
+#include "lib_rom_bin.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <png.h>
+
+// Decoded images are stored as a palette PNG with one extra, fully
+// transparent entry for the padding pixels past the end of the rom data.
+// 256 color modes have no spare entry, so those are stored as
+// gray + alpha with the color index in the gray channel.
+
+
+
+static int cli_png_row_stride(app_gfx_data * p_app_gfx)
+{
+    if (p_app_gfx->row_stride)
+        return (int)p_app_gfx->row_stride;
+
+    return p_app_gfx->width * p_app_gfx->bytes_per_pixel;
+}
+
+
+
+// Writes the decoded image, color map and surplus bytes
+int cli_png_write(const char * filename, app_gfx_data * p_app_gfx, app_color_data * p_colorpal)
+{
+    FILE        * file;
+    png_structp   png_ptr;
+    png_infop     info_ptr;
+    png_color     palette[256];
+    png_byte      trans[256];
+    png_unknown_chunk surplus_chunk;
+    unsigned char * p_row   = NULL;
+    unsigned char * p_pixel;
+    int64_t       pixel_stride;
+    int           num_colors;
+    int           use_palette;
+    unsigned int  x, y;
+    int           c;
+
+    num_colors   = p_colorpal->size;
+    use_palette  = (num_colors < 256);
+    pixel_stride = (p_app_gfx->pixel_stride) ? p_app_gfx->pixel_stride : p_app_gfx->bytes_per_pixel;
+
+    file = fopen(filename, "wb");
+    if (!file)
+        return -1;
+
+    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    info_ptr = (png_ptr) ? png_create_info_struct(png_ptr) : NULL;
+
+    if ((NULL == info_ptr) ||
+        (NULL == (p_row = malloc((size_t)p_app_gfx->width * 2)))) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(file);
+        return -1;
+    }
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        free(p_row);
+        fclose(file);
+        return -1;
+    }
+
+    png_init_io(png_ptr, file);
+
+    png_set_IHDR(png_ptr, info_ptr,
+                 p_app_gfx->width, p_app_gfx->height,
+                 8,
+                 (use_palette) ? PNG_COLOR_TYPE_PALETTE : PNG_COLOR_TYPE_GRAY_ALPHA,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+
+    if (use_palette) {
+        // Color map entries, then the transparent one
+        for (c = 0; c < num_colors; c++) {
+            palette[c].red   = p_colorpal->p_data[(c * p_colorpal->bytes_per_pixel)];
+            palette[c].green = p_colorpal->p_data[(c * p_colorpal->bytes_per_pixel) + 1];
+            palette[c].blue  = p_colorpal->p_data[(c * p_colorpal->bytes_per_pixel) + 2];
+            trans[c]         = 0xFF;
+        }
+        palette[num_colors].red = palette[num_colors].green = palette[num_colors].blue = 0;
+        trans[num_colors] = 0x00;
+
+        png_set_PLTE(png_ptr, info_ptr, palette, num_colors + 1);
+        png_set_tRNS(png_ptr, info_ptr, trans, num_colors + 1, NULL);
+    }
+
+    // Keep the surplus bytes with the image so encoding restores them
+    if ((p_app_gfx->surplus_bytes_size > 0) && (p_app_gfx->p_surplus_bytes)) {
+        memcpy(surplus_chunk.name, CLI_PNG_SURPLUS_CHUNK, 5);
+        surplus_chunk.data     = p_app_gfx->p_surplus_bytes;
+        surplus_chunk.size     = (size_t)p_app_gfx->surplus_bytes_size;
+        surplus_chunk.location = PNG_AFTER_IDAT;
+
+        png_set_keep_unknown_chunks(png_ptr, PNG_HANDLE_CHUNK_ALWAYS,
+                                    (png_const_bytep)CLI_PNG_SURPLUS_CHUNK, 1);
+        png_set_unknown_chunks(png_ptr, info_ptr, &surplus_chunk, 1);
+    }
+
+    png_write_info(png_ptr, info_ptr);
+
+    for (y = 0; y < p_app_gfx->height; y++) {
+
+        p_pixel = p_app_gfx->p_data + ((int64_t)y * cli_png_row_stride(p_app_gfx));
+
+        for (x = 0; x < p_app_gfx->width; x++) {
+            unsigned char index = p_pixel[0];
+            unsigned char alpha = (p_app_gfx->bytes_per_pixel == BIN_BITDEPTH_INDEXED_ALPHA) ? p_pixel[1] : 0xFF;
+
+            if (use_palette)
+                p_row[x] = (alpha) ? index : num_colors;
+            else {
+                p_row[(x * 2)]     = index;
+                p_row[(x * 2) + 1] = alpha;
+            }
+
+            p_pixel += pixel_stride;
+        }
+
+        png_write_row(png_ptr, p_row);
+    }
+
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    free(p_row);
+
+    if (0 != fclose(file))
+        return -1;
+
+    return 0;
+}
+
+
+
+// Writes a true color image (8 bit RGBA, packed rows), for renders and
+// previews that aren't meant to be encoded again
+int cli_png_write_rgba(const char * filename, unsigned int width, unsigned int height, const unsigned char * p_rgba)
+{
+    FILE        * file;
+    png_structp   png_ptr;
+    png_infop     info_ptr;
+    unsigned int  y;
+
+    file = fopen(filename, "wb");
+    if (!file)
+        return -1;
+
+    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    info_ptr = (png_ptr) ? png_create_info_struct(png_ptr) : NULL;
+
+    if (NULL == info_ptr) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(file);
+        return -1;
+    }
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(file);
+        return -1;
+    }
+
+    png_init_io(png_ptr, file);
+
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8,
+                 PNG_COLOR_TYPE_RGB_ALPHA,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+
+    png_write_info(png_ptr, info_ptr);
+
+    for (y = 0; y < height; y++)
+        png_write_row(png_ptr, (png_const_bytep)(p_rgba + ((size_t)y * width * 4)));
+
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    if (0 != fclose(file))
+        return -1;
+
+    return 0;
+}
+
+
+
+// Writes an 8 bit palette image (one color index per byte, packed rows)
+// with up to 256 colors, for composed screens that keep their indexes
+int cli_png_write_indexed(const char * filename, unsigned int width, unsigned int height,
+                          const unsigned char * p_indexes, const app_color_data * p_colorpal)
+{
+    FILE        * file;
+    png_structp   png_ptr;
+    png_infop     info_ptr;
+    png_color     palette[256];
+    int           num_colors = (p_colorpal->size < 256) ? p_colorpal->size : 256;
+    unsigned int  y;
+    int           c;
+
+    if ((num_colors <= 0) || (p_colorpal->bytes_per_pixel < 3))
+        return -1;
+
+    file = fopen(filename, "wb");
+    if (!file)
+        return -1;
+
+    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    info_ptr = (png_ptr) ? png_create_info_struct(png_ptr) : NULL;
+
+    if (NULL == info_ptr) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(file);
+        return -1;
+    }
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(file);
+        return -1;
+    }
+
+    png_init_io(png_ptr, file);
+
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8,
+                 PNG_COLOR_TYPE_PALETTE,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+
+    for (c = 0; c < num_colors; c++) {
+        palette[c].red   = p_colorpal->p_data[(c * p_colorpal->bytes_per_pixel)];
+        palette[c].green = p_colorpal->p_data[(c * p_colorpal->bytes_per_pixel) + 1];
+        palette[c].blue  = p_colorpal->p_data[(c * p_colorpal->bytes_per_pixel) + 2];
+    }
+
+    png_set_PLTE(png_ptr, info_ptr, palette, num_colors);
+
+    png_write_info(png_ptr, info_ptr);
+
+    for (y = 0; y < height; y++)
+        png_write_row(png_ptr, (png_const_bytep)(p_indexes + ((size_t)y * width)));
+
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    if (0 != fclose(file))
+        return -1;
+
+    return 0;
+}
+
+
+
+// Copies the surplus bytes chunk (if any) into the app image
+static int cli_png_read_surplus(png_structp png_ptr, png_infop info_ptr, app_gfx_data * p_app_gfx)
+{
+    png_unknown_chunkp p_chunks;
+    int                num_chunks;
+    int                c;
+
+    num_chunks = png_get_unknown_chunks(png_ptr, info_ptr, &p_chunks);
+
+    for (c = 0; c < num_chunks; c++) {
+        if ((0 == memcmp(p_chunks[c].name, CLI_PNG_SURPLUS_CHUNK, 4)) &&
+            (p_chunks[c].size > 0) &&
+            (NULL == p_app_gfx->p_surplus_bytes)) {
+
+            if (NULL == (p_app_gfx->p_surplus_bytes = rom_bin_alloc(p_chunks[c].size)))
+                return -1;
+
+            memcpy(p_app_gfx->p_surplus_bytes, p_chunks[c].data, p_chunks[c].size);
+            p_app_gfx->surplus_bytes_size = (int64_t)p_chunks[c].size;
+        }
+    }
+
+    return 0;
+}
+
+
+
+// Image size from the IHDR chunk, without decoding anything
+int cli_png_query(const char * filename, unsigned int * p_width, unsigned int * p_height)
+{
+    FILE        * file;
+    unsigned char header[24];   // Signature, IHDR length + name, width, height
+    int           status = -1;
+
+    file = fopen(filename, "rb");
+    if (!file)
+        return -1;
+
+    if ((1 == fread(header, sizeof(header), 1, file)) &&
+        (0 == png_sig_cmp(header, 0, 8)) &&
+        (0 == memcmp(header + 12, "IHDR", 4))) {
+        *p_width  = png_get_uint_32(header + 16);
+        *p_height = png_get_uint_32(header + 20);
+        status = 0;
+    }
+
+    fclose(file);
+
+    return status;
+}
+
+
+
+// Reads an indexed PNG (palette, or gray + alpha as written above)
+// into a 2 byte per pixel (index, alpha) app image ready for encoding.
+// Buffers come from rom_bin_alloc() so rom_bin_free_structs() releases them
+int cli_png_read(const char * filename, app_gfx_data * p_app_gfx)
+{
+    FILE        * file;
+    png_structp   png_ptr;
+    png_infop     info_ptr, end_ptr;
+    png_bytep     p_trans = NULL;
+    int           num_trans = 0;
+    png_color_16p p_trans_color;
+    png_uint_32   width, height;
+    int           bit_depth, color_type;
+    unsigned char * volatile p_row = NULL;  // allocated after setjmp
+    unsigned char * p_pixel;
+    size_t        alloc_size;
+    unsigned int  x, y;
+    int           status = -1;
+
+    file = fopen(filename, "rb");
+    if (!file)
+        return -1;
+
+    png_ptr  = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    info_ptr = (png_ptr) ? png_create_info_struct(png_ptr) : NULL;
+    end_ptr  = (png_ptr) ? png_create_info_struct(png_ptr) : NULL;
+
+    if ((NULL == info_ptr) || (NULL == end_ptr)) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_ptr);
+        fclose(file);
+        return -1;
+    }
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_ptr);
+        free(p_row);
+        fclose(file);
+        return -1;
+    }
+
+    png_init_io(png_ptr, file);
+    png_set_keep_unknown_chunks(png_ptr, PNG_HANDLE_CHUNK_ALWAYS,
+                                (png_const_bytep)CLI_PNG_SURPLUS_CHUNK, 1);
+    png_read_info(png_ptr, info_ptr);
+
+    png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, NULL, NULL, NULL);
+
+    // Only indexed data can be encoded
+    if (((color_type != PNG_COLOR_TYPE_PALETTE) &&
+         (color_type != PNG_COLOR_TYPE_GRAY) &&
+         (color_type != PNG_COLOR_TYPE_GRAY_ALPHA)) ||
+        (bit_depth > 8)) {
+        fprintf(stderr, "%s: must be an indexed (palette) or 8 bit gray PNG\n", filename);
+        goto done;
+    }
+
+    // Unpack 1/2/4 bit indexes to one per byte, keeping the index values
+    if (bit_depth < 8)
+        png_set_packing(png_ptr);
+
+    if (color_type == PNG_COLOR_TYPE_PALETTE)
+        png_get_tRNS(png_ptr, info_ptr, &p_trans, &num_trans, &p_trans_color);
+
+    png_read_update_info(png_ptr, info_ptr);
+
+    p_app_gfx->width           = width;
+    p_app_gfx->height          = height;
+    p_app_gfx->bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+    p_app_gfx->row_stride      = 0;
+    p_app_gfx->pixel_stride    = 0;
+
+    if ((0 != rom_bin_calc_alloc_size((uint64_t)width * height, BIN_BITDEPTH_INDEXED_ALPHA, &alloc_size)) ||
+        (NULL == (p_app_gfx->p_data = rom_bin_alloc(alloc_size))) ||
+        (NULL == (p_row = malloc(png_get_rowbytes(png_ptr, info_ptr)))))
+        goto done;
+
+    p_app_gfx->size = (int64_t)alloc_size;
+
+    for (y = 0; y < height; y++) {
+
+        png_read_row(png_ptr, p_row, NULL);
+
+        p_pixel = p_app_gfx->p_data + ((int64_t)y * width * BIN_BITDEPTH_INDEXED_ALPHA);
+
+        for (x = 0; x < width; x++) {
+            if (color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+                p_pixel[0] = p_row[(x * 2)];
+                p_pixel[1] = p_row[(x * 2) + 1];
+            }
+            else {
+                p_pixel[0] = p_row[x];
+
+                // Palette entries with alpha 0 mark padding past the rom data
+                if ((color_type == PNG_COLOR_TYPE_PALETTE) &&
+                    (p_row[x] < num_trans) && (p_trans[p_row[x]] == 0))
+                    p_pixel[0] = p_pixel[1] = 0x00;
+                else
+                    p_pixel[1] = 0xFF;
+            }
+
+            p_pixel += BIN_BITDEPTH_INDEXED_ALPHA;
+        }
+    }
+
+    png_read_end(png_ptr, end_ptr);
+
+    // The chunk may be before or after the image data
+    if ((0 != cli_png_read_surplus(png_ptr, info_ptr, p_app_gfx)) ||
+        (0 != cli_png_read_surplus(png_ptr, end_ptr, p_app_gfx)))
+        goto done;
+
+    status = 0;
+
+done:
+    png_destroy_read_struct(&png_ptr, &info_ptr, &end_ptr);
+    free(p_row);
+    fclose(file);
+
+    return status;
+}
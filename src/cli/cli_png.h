@@ -0,0 +1,35 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_PNG_HEADER
+#define CLI_PNG_HEADER
+
+#include "lib_rom_bin.h"
+
+    // Private PNG chunk holding the surplus (non-tile) bytes of the
+    // rom, the file equivalent of the plug-in's ROM-BIN-SURPLUS-BYTES parasite
+    #define CLI_PNG_SURPLUS_CHUNK "rbSb"
+
+    int cli_png_write(const char *, app_gfx_data *, app_color_data *);
+    int cli_png_read(const char *, app_gfx_data *);
+    int cli_png_query(const char *, unsigned int *, unsigned int *);
+
+    int cli_png_write_rgba(const char *, unsigned int, unsigned int, const unsigned char *);
+    int cli_png_write_indexed(const char *, unsigned int, unsigned int, const unsigned char *, const app_color_data *);
+
+#endif // CLI_PNG_HEADER
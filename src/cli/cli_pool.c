@@ -0,0 +1,355 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Work-stealing thread pool for the batch converter.
+//
+// Each worker owns a deque of tasks. Tasks submitted from inside a task
+// (ex: the bands of a large file) go onto the current worker's own deque
+// and are popped newest first, which keeps that file's data in cache.
+// Idle workers steal the oldest task from the other deques, so a few
+// very large files can't leave cores idle while small ones are done.
+
+#include "cli_pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CLI_POOL_DEQUE_INITIAL_SIZE  64  // Grows by doubling, must be a power of 2
+
+typedef struct cli_pool_task {
+    cli_pool_task_fn   fn;
+    void             * p_arg;
+} cli_pool_task;
+
+// Ring buffer, the owner uses the tail, thieves the head
+typedef struct cli_pool_deque {
+    pthread_mutex_t   lock;
+    cli_pool_task   * p_tasks;
+    size_t            capacity;
+    size_t            head;
+    size_t            tail;
+} cli_pool_deque;
+
+typedef struct cli_pool_worker {
+    cli_pool        * p_pool;
+    int               index;
+    pthread_t         thread;
+    cli_pool_deque    deque;
+} cli_pool_worker;
+
+struct cli_pool {
+    int               num_workers;
+    cli_pool_worker * p_workers;
+
+    pthread_mutex_t   lock;
+    pthread_cond_t    work_cond;   // Signalled when a task is queued or on shutdown
+    pthread_cond_t    idle_cond;   // Signalled when the last pending task finishes
+    int64_t           queued;      // Tasks sitting in a deque
+    int64_t           pending;     // Tasks submitted and not finished yet
+    int               shutdown;
+    unsigned int      next_worker; // Round robin target for submits from outside the pool
+};
+
+// Worker the calling thread belongs to, NULL outside the pool
+static __thread cli_pool_worker * p_current_worker = NULL;
+
+
+
+int cli_num_processors(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (int)count : 1;
+}
+
+
+
+static int cli_pool_deque_push(cli_pool_deque * p_deque, cli_pool_task task)
+{
+    pthread_mutex_lock(&p_deque->lock);
+
+    // Full: double the ring, unwrapping it into the new buffer
+    if ((p_deque->tail - p_deque->head) == p_deque->capacity) {
+        size_t          new_capacity = p_deque->capacity * 2;
+        cli_pool_task * p_new_tasks  = malloc(new_capacity * sizeof(cli_pool_task));
+        size_t          c;
+
+        if (NULL == p_new_tasks) {
+            pthread_mutex_unlock(&p_deque->lock);
+            return -1;
+        }
+
+        for (c = 0; c < p_deque->capacity; c++)
+            p_new_tasks[c] = p_deque->p_tasks[(p_deque->head + c) & (p_deque->capacity - 1)];
+
+        free(p_deque->p_tasks);
+        p_deque->p_tasks  = p_new_tasks;
+        p_deque->head     = 0;
+        p_deque->tail     = p_deque->capacity;
+        p_deque->capacity = new_capacity;
+    }
+
+    p_deque->p_tasks[p_deque->tail & (p_deque->capacity - 1)] = task;
+    p_deque->tail++;
+
+    pthread_mutex_unlock(&p_deque->lock);
+
+    return 0;
+}
+
+
+
+// Owner end: newest task first
+static int cli_pool_deque_pop(cli_pool_deque * p_deque, cli_pool_task * p_task)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&p_deque->lock);
+
+    if (p_deque->tail != p_deque->head) {
+        p_deque->tail--;
+        *p_task = p_deque->p_tasks[p_deque->tail & (p_deque->capacity - 1)];
+        found = 1;
+    }
+
+    pthread_mutex_unlock(&p_deque->lock);
+
+    return found;
+}
+
+
+
+// Thief end: oldest task first
+static int cli_pool_deque_steal(cli_pool_deque * p_deque, cli_pool_task * p_task)
+{
+    int found = 0;
+
+    // Don't queue up behind the owner, just try the next deque
+    if (0 != pthread_mutex_trylock(&p_deque->lock))
+        return 0;
+
+    if (p_deque->tail != p_deque->head) {
+        *p_task = p_deque->p_tasks[p_deque->head & (p_deque->capacity - 1)];
+        p_deque->head++;
+        found = 1;
+    }
+
+    pthread_mutex_unlock(&p_deque->lock);
+
+    return found;
+}
+
+
+
+// Own deque first, then the others starting with the next worker along
+static int cli_pool_take_task(cli_pool_worker * p_worker, cli_pool_task * p_task)
+{
+    cli_pool * p_pool = p_worker->p_pool;
+    int        c;
+
+    if (cli_pool_deque_pop(&p_worker->deque, p_task))
+        return 1;
+
+    for (c = 1; c < p_pool->num_workers; c++)
+        if (cli_pool_deque_steal(&p_pool->p_workers[(p_worker->index + c) % p_pool->num_workers].deque, p_task))
+            return 1;
+
+    return 0;
+}
+
+
+
+static void * cli_pool_worker_main(void * p_arg)
+{
+    cli_pool_worker * p_worker = p_arg;
+    cli_pool        * p_pool   = p_worker->p_pool;
+    cli_pool_task     task;
+
+    p_current_worker = p_worker;
+
+    for (;;) {
+        if (cli_pool_take_task(p_worker, &task)) {
+
+            pthread_mutex_lock(&p_pool->lock);
+            p_pool->queued--;
+            pthread_mutex_unlock(&p_pool->lock);
+
+            task.fn(task.p_arg);
+
+            pthread_mutex_lock(&p_pool->lock);
+            if (0 == --p_pool->pending)
+                pthread_cond_broadcast(&p_pool->idle_cond);
+            pthread_mutex_unlock(&p_pool->lock);
+            continue;
+        }
+
+        // Nothing found: sleep until something is queued. A task that's
+        // counted but not pushed yet, or just taken by another worker,
+        // only costs a rescan
+        pthread_mutex_lock(&p_pool->lock);
+
+        while ((0 == p_pool->queued) && !p_pool->shutdown)
+            pthread_cond_wait(&p_pool->work_cond, &p_pool->lock);
+
+        if ((0 == p_pool->queued) && p_pool->shutdown) {
+            pthread_mutex_unlock(&p_pool->lock);
+            break;
+        }
+
+        pthread_mutex_unlock(&p_pool->lock);
+    }
+
+    return NULL;
+}
+
+
+
+// 0 threads = one per processor
+cli_pool * cli_pool_new(int num_threads)
+{
+    cli_pool * p_pool;
+    int        c;
+
+    if (num_threads <= 0)
+        num_threads = cli_num_processors();
+
+    if (NULL == (p_pool = calloc(1, sizeof(cli_pool))))
+        return NULL;
+
+    if (NULL == (p_pool->p_workers = calloc(num_threads, sizeof(cli_pool_worker)))) {
+        free(p_pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&p_pool->lock, NULL);
+    pthread_cond_init(&p_pool->work_cond, NULL);
+    pthread_cond_init(&p_pool->idle_cond, NULL);
+
+    for (c = 0; c < num_threads; c++) {
+        cli_pool_worker * p_worker = &p_pool->p_workers[c];
+
+        p_worker->p_pool         = p_pool;
+        p_worker->index          = c;
+        p_worker->deque.capacity = CLI_POOL_DEQUE_INITIAL_SIZE;
+        p_worker->deque.p_tasks  = malloc(CLI_POOL_DEQUE_INITIAL_SIZE * sizeof(cli_pool_task));
+        pthread_mutex_init(&p_worker->deque.lock, NULL);
+
+        if ((NULL == p_worker->deque.p_tasks) ||
+            (0 != pthread_create(&p_worker->thread, NULL, cli_pool_worker_main, p_worker))) {
+            free(p_worker->deque.p_tasks);
+            pthread_mutex_destroy(&p_worker->deque.lock);
+            break;
+        }
+
+        p_pool->num_workers++;
+    }
+
+    // Run with however many threads could be started
+    if (0 == p_pool->num_workers) {
+        cli_pool_free(p_pool);
+        return NULL;
+    }
+
+    return p_pool;
+}
+
+
+
+// Queues a task. From inside a task it goes onto the calling worker's
+// deque, otherwise the workers are filled round robin. If the task
+// can't be queued it is run right away on the calling thread
+void cli_pool_submit(cli_pool * p_pool, cli_pool_task_fn fn, void * p_arg)
+{
+    cli_pool_task     task = { fn, p_arg };
+    cli_pool_worker * p_worker;
+
+    // Counted before it's visible so a worker can't take it first
+    pthread_mutex_lock(&p_pool->lock);
+    p_pool->pending++;
+    p_pool->queued++;
+
+    if ((NULL != p_current_worker) && (p_current_worker->p_pool == p_pool))
+        p_worker = p_current_worker;
+    else
+        p_worker = &p_pool->p_workers[p_pool->next_worker++ % p_pool->num_workers];
+
+    pthread_mutex_unlock(&p_pool->lock);
+
+    if (0 != cli_pool_deque_push(&p_worker->deque, task)) {
+        pthread_mutex_lock(&p_pool->lock);
+        p_pool->queued--;
+        pthread_mutex_unlock(&p_pool->lock);
+
+        fn(p_arg);
+
+        pthread_mutex_lock(&p_pool->lock);
+        if (0 == --p_pool->pending)
+            pthread_cond_broadcast(&p_pool->idle_cond);
+        pthread_mutex_unlock(&p_pool->lock);
+        return;
+    }
+
+    pthread_mutex_lock(&p_pool->lock);
+    pthread_cond_signal(&p_pool->work_cond);
+    pthread_mutex_unlock(&p_pool->lock);
+}
+
+
+
+// Blocks until every submitted task, including the ones
+// they submitted in turn, has finished
+void cli_pool_wait(cli_pool * p_pool)
+{
+    pthread_mutex_lock(&p_pool->lock);
+
+    while (0 != p_pool->pending)
+        pthread_cond_wait(&p_pool->idle_cond, &p_pool->lock);
+
+    pthread_mutex_unlock(&p_pool->lock);
+}
+
+
+
+void cli_pool_free(cli_pool * p_pool)
+{
+    int c;
+
+    if (NULL == p_pool)
+        return;
+
+    pthread_mutex_lock(&p_pool->lock);
+    p_pool->shutdown = 1;
+    pthread_cond_broadcast(&p_pool->work_cond);
+    pthread_mutex_unlock(&p_pool->lock);
+
+    for (c = 0; c < p_pool->num_workers; c++) {
+        pthread_join(p_pool->p_workers[c].thread, NULL);
+        pthread_mutex_destroy(&p_pool->p_workers[c].deque.lock);
+        free(p_pool->p_workers[c].deque.p_tasks);
+    }
+
+    pthread_cond_destroy(&p_pool->idle_cond);
+    pthread_cond_destroy(&p_pool->work_cond);
+    pthread_mutex_destroy(&p_pool->lock);
+
+    free(p_pool->p_workers);
+    free(p_pool);
+}
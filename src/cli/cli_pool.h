@@ -0,0 +1,33 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_POOL_HEADER
+#define CLI_POOL_HEADER
+
+    typedef void (*cli_pool_task_fn)(void *);
+
+    typedef struct cli_pool cli_pool;
+
+    cli_pool * cli_pool_new(int);
+    void       cli_pool_submit(cli_pool *, cli_pool_task_fn, void *);
+    void       cli_pool_wait(cli_pool *);
+    void       cli_pool_free(cli_pool *);
+
+    int        cli_num_processors(void);
+
+#endif // CLI_POOL_HEADER
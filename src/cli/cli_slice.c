@@ -0,0 +1,327 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Tilemap export: the way back from "tilemap -i". An edited screen (8 bit
+// indexed PNG, each index = palette bank * colors per bank + color) is
+// cut into 8x8 tiles, which become unique tiles plus a console tilemap.
+//
+// Each screen tile's bank comes from its nonzero indexes, which must all
+// be in one bank. Tiles are then deduplicated through a hash index of
+// the unique tiles: a screen tile is looked up as is and in its three
+// flipped orientations, a hit is stored as that unique tile with the
+// matching flip bits, a miss adds a unique tile. Each screen tile costs
+// four hashes and lookups, so the whole export is linear in the image.
+//
+// The unique tiles are encoded with the mode's codec and checked against
+// the tile budget (what the map format can address, or -l).
+
+#include "lib_rom_bin.h"
+#include "cli_file.h"
+#include "cli_hash.h"
+#include "cli_png.h"
+#include "cli_slice.h"
+#include "cli_tilemap.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+#define CLI_SLICE_TILE_PIXELS  64
+
+// Problem tiles listed before giving up on the rest
+#define CLI_SLICE_MAX_ERRORS   8
+
+// Tile numbers and palette banks each map format can address
+static const struct {
+    int64_t      max_tiles;
+    unsigned int max_banks;
+    int          flips;
+} cli_slice_limits[] = {
+    [CLI_TILEMAP_SNES]    = { 1024, 8,  TRUE  },
+    [CLI_TILEMAP_GBA]     = { 1024, 16, TRUE  },
+    [CLI_TILEMAP_GENESIS] = { 2048, 4,  TRUE  },
+    [CLI_TILEMAP_SMS]     = { 512,  2,  TRUE  },
+    [CLI_TILEMAP_BYTE]    = { 256,  1,  FALSE },
+};
+
+typedef struct cli_slice {
+    unsigned char * p_tiles;       // Unique tiles, 64 color indexes each
+    int64_t         num_tiles;
+    int64_t       * p_table;       // Hash index: unique tile + 1, 0 = empty
+    uint64_t      * p_hashes;      // Hash of each unique tile
+    int64_t         table_mask;
+} cli_slice;
+
+
+
+// One of the four orientations of a tile
+static void cli_slice_flip(const unsigned char * p_tile, int hflip, int vflip, unsigned char * p_out)
+{
+    int x, y;
+
+    for (y = 0; y < 8; y++) {
+        const unsigned char * p_row = p_tile + (((vflip) ? (7 - y) : y) * 8);
+
+        for (x = 0; x < 8; x++)
+            p_out[(y * 8) + x] = p_row[(hflip) ? (7 - x) : x];
+    }
+}
+
+
+
+// Unique tile holding these pixels, -1 if there is none
+static int64_t cli_slice_lookup(const cli_slice * p_slice, const unsigned char * p_tile, uint64_t hash)
+{
+    int64_t slot;
+
+    for (slot = (int64_t)(hash & (uint64_t)p_slice->table_mask);
+         p_slice->p_table[slot];
+         slot = (slot + 1) & p_slice->table_mask) {
+        int64_t tile = p_slice->p_table[slot] - 1;
+
+        if ((p_slice->p_hashes[tile] == hash) &&
+            (0 == memcmp(p_slice->p_tiles + (tile * CLI_SLICE_TILE_PIXELS), p_tile, CLI_SLICE_TILE_PIXELS)))
+            return tile;
+    }
+
+    return -1;
+}
+
+
+
+static int64_t cli_slice_add(cli_slice * p_slice, const unsigned char * p_tile, uint64_t hash)
+{
+    int64_t tile = p_slice->num_tiles++;
+    int64_t slot;
+
+    memcpy(p_slice->p_tiles + (tile * CLI_SLICE_TILE_PIXELS), p_tile, CLI_SLICE_TILE_PIXELS);
+    p_slice->p_hashes[tile] = hash;
+
+    for (slot = (int64_t)(hash & (uint64_t)p_slice->table_mask);
+         p_slice->p_table[slot];
+         slot = (slot + 1) & p_slice->table_mask)
+        ;
+
+    p_slice->p_table[slot] = tile + 1;
+
+    return tile;
+}
+
+
+
+// Finds (or adds) the unique tile for one screen tile and fills in its
+// map entry. Orientations are tried as is, h, v, then both
+static void cli_slice_place(cli_slice * p_slice, const unsigned char * p_tile, int flips,
+                            cli_tilemap_entry * p_entry)
+{
+    unsigned char flipped[CLI_SLICE_TILE_PIXELS];
+    uint64_t      hash = cli_hash_xxh64(p_tile, CLI_SLICE_TILE_PIXELS, 0);
+    int64_t       tile;
+    int           orientation;
+
+    if (-1 != (tile = cli_slice_lookup(p_slice, p_tile, hash))) {
+        p_entry->tile = (unsigned int)tile;
+        return;
+    }
+
+    for (orientation = 1; flips && (orientation < 4); orientation++) {
+        cli_slice_flip(p_tile, orientation & 1, orientation >> 1, flipped);
+
+        if (-1 != (tile = cli_slice_lookup(p_slice, flipped, cli_hash_xxh64(flipped, CLI_SLICE_TILE_PIXELS, 0)))) {
+            // Flipping the unique tile back gives this one
+            p_entry->tile  = (unsigned int)tile;
+            p_entry->hflip = (unsigned char)(orientation & 1);
+            p_entry->vflip = (unsigned char)(orientation >> 1);
+            return;
+        }
+    }
+
+    p_entry->tile = (unsigned int)cli_slice_add(p_slice, p_tile, hash);
+}
+
+
+
+// The unique tiles in the mode's format, one tile per image row
+static int cli_slice_encode(const cli_slice * p_slice, int image_mode, const char * p_out)
+{
+    rom_gfx_data   rom_gfx;
+    app_gfx_data   app_gfx;
+    app_color_data colorpal;
+    int            status = -1;
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    app_gfx.image_mode           = image_mode;
+    app_gfx.width                = 8;
+    app_gfx.height               = (unsigned int)(p_slice->num_tiles * 8);
+    app_gfx.bytes_per_pixel      = BIN_BITDEPTH_INDEXED;
+    app_gfx.p_data               = p_slice->p_tiles;
+    app_gfx.data_owned_by_caller = TRUE;
+    app_gfx.size                 = p_slice->num_tiles * CLI_SLICE_TILE_PIXELS;
+
+    if (0 != rom_bin_encode(&rom_gfx, &app_gfx))
+        fprintf(stderr, "%s: can't encode the tiles as %s\n", CLI_NAME, rom_bin_mode_name(image_mode));
+    else if (0 != cli_file_write(p_out, rom_gfx.p_data, rom_gfx.size))
+        fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_out);
+    else
+        status = 0;
+
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    return status;
+}
+
+
+
+int cli_slice_run(const char * p_in, const char * p_tiles_out, const char * p_map_out,
+                  const cli_slice_options * p_options)
+{
+    const rom_gfx_attrib * p_attrib = rom_bin_mode_attrib(p_options->image_mode);
+    app_gfx_data           app_gfx;
+    cli_slice              slice;
+    unsigned char          tile[CLI_SLICE_TILE_PIXELS];
+    unsigned char        * p_map = NULL;
+    unsigned int           map_width, map_height;
+    unsigned int           tx, ty, x, y;
+    int64_t                num_screen_tiles;
+    int64_t                num_entries;       // Wide SNES / GBA maps are padded to whole blocks
+    int64_t                max_tiles;
+    int64_t                table_size;
+    int                    entry_bytes = cli_tilemap_entry_bytes(p_options->map_format);
+    int                    bank_colors;
+    int                    num_errors = 0;
+    int                    status = -1;
+
+    memset(&slice, 0, sizeof(slice));
+    memset(&app_gfx, 0, sizeof(app_gfx));
+
+    if (0 != cli_png_read(p_in, &app_gfx)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_in);
+        return -1;
+    }
+
+    if ((app_gfx.width % 8) || (app_gfx.height % 8) || (0 == app_gfx.width) || (0 == app_gfx.height)) {
+        fprintf(stderr, "%s: %s isn't a whole number of 8x8 tiles\n", CLI_NAME, p_in);
+        goto done;
+    }
+
+    map_width        = app_gfx.width / 8;
+    map_height       = app_gfx.height / 8;
+    num_screen_tiles = (int64_t)map_width * map_height;
+    bank_colors      = (p_attrib->BITS_PER_PIXEL < 8) ? (1 << p_attrib->BITS_PER_PIXEL) : 0;
+
+    // A power of two at least twice the worst case (every tile unique)
+    for (table_size = 16; table_size < num_screen_tiles * 2; table_size *= 2)
+        ;
+
+    slice.table_mask = table_size - 1;
+    slice.p_tiles    = malloc((size_t)num_screen_tiles * CLI_SLICE_TILE_PIXELS);
+    slice.p_hashes   = malloc((size_t)num_screen_tiles * sizeof(uint64_t));
+    slice.p_table    = calloc((size_t)table_size, sizeof(int64_t));
+    num_entries      = cli_tilemap_map_entries(p_options->map_format, map_width, map_height);
+    p_map            = calloc((size_t)num_entries, (size_t)entry_bytes);
+
+    if ((NULL == slice.p_tiles) || (NULL == slice.p_hashes) || (NULL == slice.p_table) || (NULL == p_map)) {
+        fprintf(stderr, "%s: out of memory\n", CLI_NAME);
+        goto done;
+    }
+
+    for (ty = 0; ty < map_height; ty++)
+        for (tx = 0; tx < map_width; tx++) {
+            cli_tilemap_entry entry;
+            int               bank = -1;
+            int               mixed = FALSE;
+
+            memset(&entry, 0, sizeof(entry));
+
+            // Split each index into bank and color
+            for (y = 0; y < 8; y++)
+                for (x = 0; x < 8; x++) {
+                    unsigned char index = app_gfx.p_data[((((size_t)ty * 8 + y) * app_gfx.width) + ((size_t)tx * 8) + x) *
+                                                         BIN_BITDEPTH_INDEXED_ALPHA];
+
+                    if (bank_colors && index) {
+                        if ((bank != -1) && (bank != index / bank_colors))
+                            mixed = TRUE;
+
+                        bank  = index / bank_colors;
+                        index = index % bank_colors;
+                    }
+
+                    tile[(y * 8) + x] = index;
+                }
+
+            if (mixed || ((bank != -1) && ((unsigned int)bank >= cli_slice_limits[p_options->map_format].max_banks))) {
+                if (num_errors++ < CLI_SLICE_MAX_ERRORS)
+                    fprintf(stderr, "%s: tile %u,%u uses %s\n", CLI_NAME, tx, ty,
+                            (mixed) ? "colors of more than one palette bank" : "a palette bank the map can't hold");
+                continue;
+            }
+
+            entry.bank = (bank == -1) ? 0 : (unsigned int)bank;
+
+            cli_slice_place(&slice, tile, cli_slice_limits[p_options->map_format].flips, &entry);
+            entry.tile += (unsigned int)p_options->tile_base;
+
+            cli_tilemap_write_entry(p_options->map_format, &entry,
+                                    p_map + (cli_tilemap_entry_index(p_options->map_format, map_width, tx, ty) * entry_bytes));
+        }
+
+    if (num_errors) {
+        fprintf(stderr, "%s: %d tiles can't be mapped\n", CLI_NAME, num_errors);
+        goto done;
+    }
+
+    // VRAM budget
+    max_tiles = cli_slice_limits[p_options->map_format].max_tiles;
+    if ((p_options->max_tiles > 0) && (p_options->max_tiles < max_tiles))
+        max_tiles = p_options->max_tiles;
+
+    if (p_options->tile_base + slice.num_tiles > max_tiles) {
+        fprintf(stderr, "%s: %" PRId64 " unique tiles from tile %" PRId64 " don't fit in %" PRId64 "\n",
+                CLI_NAME, slice.num_tiles, p_options->tile_base, max_tiles);
+        goto done;
+    }
+
+    if (0 != cli_slice_encode(&slice, p_options->image_mode, p_tiles_out))
+        goto done;
+
+    if (0 != cli_file_write(p_map_out, p_map, num_entries * entry_bytes)) {
+        fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_map_out);
+        goto done;
+    }
+
+    printf("%ux%u entries, %" PRId64 " unique tiles of %" PRId64 " (budget %" PRId64 ")\n",
+           map_width, map_height, slice.num_tiles, num_screen_tiles, max_tiles - p_options->tile_base);
+
+    status = 0;
+
+done:
+    free(p_map);
+    free(slice.p_table);
+    free(slice.p_hashes);
+    free(slice.p_tiles);
+    rom_bin_free(app_gfx.p_data);
+    rom_bin_free(app_gfx.p_surplus_bytes);
+
+    return status;
+}
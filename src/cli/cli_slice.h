@@ -0,0 +1,33 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_SLICE_HEADER
+#define CLI_SLICE_HEADER
+
+#include <stdint.h>
+
+    typedef struct cli_slice_options {
+        int     image_mode;
+        int     map_format;     // See cli_tilemap.h
+        int64_t tile_base;      // Added to the map's tile numbers
+        int64_t max_tiles;      // Tile budget, 0 = what the map format can address
+    } cli_slice_options;
+
+    int cli_slice_run(const char *, const char *, const char *, const cli_slice_options *);
+
+#endif // CLI_SLICE_HEADER
@@ -0,0 +1,494 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Metasprite render: assembles sprite frames from tables of OAM style
+// entries (position, tile, size, flips, palette per piece) and draws a
+// whole animation set into one atlas image.
+//
+// The tile data is decoded once into the tile cache and every piece of
+// every frame copies from it. Entries are read first, so the atlas cells
+// can share one origin: coordinates are taken relative to the first
+// piece of the first frame, wrapping at the console's coordinate range,
+// which works for both hardware OAM (screen positions) and the signed
+// offsets games keep in their metasprite tables. Frames keep their
+// relative placement, so an animation lines up from cell to cell.
+//
+// Earlier entries are on top, as on the consoles (Genesis link order is
+// not followed, entries are taken in table order).
+
+#include "lib_rom_bin.h"
+#include "cli_file.h"
+#include "cli_palette.h"
+#include "cli_png.h"
+#include "cli_sprites.h"
+#include "cli_tiles.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+static const struct {
+    const char * p_name;
+    int          entry_bytes;
+    int          x_range;      // Coordinates wrap at these
+    int          y_range;
+    int          first_color;  // Color ram index of sprite palette 0
+} cli_sprites_formats[] = {
+    [CLI_SPRITES_SNES]    = { "snes",    4, 256, 256,  128 },
+    [CLI_SPRITES_GBA]     = { "gba",     8, 512, 256,  0   },
+    [CLI_SPRITES_GENESIS] = { "genesis", 8, 512, 1024, 0   },
+    [CLI_SPRITES_NES]     = { "nes",     4, 256, 256,  16  },
+};
+
+// GBA sprite sizes in tiles, by shape (square, wide, tall) and size
+static const unsigned char cli_sprites_gba_sizes[3][4][2] = {
+    { { 1, 1 }, { 2, 2 }, { 4, 4 }, { 8, 8 } },
+    { { 2, 1 }, { 4, 1 }, { 4, 2 }, { 8, 4 } },
+    { { 1, 2 }, { 1, 4 }, { 2, 4 }, { 4, 8 } },
+};
+
+typedef struct cli_sprites_piece {
+    int           x, y;           // Relative to the shared origin
+    unsigned int  tile;
+    unsigned int  width;          // In tiles
+    unsigned int  height;
+    unsigned int  bank;
+    unsigned char hflip;
+    unsigned char vflip;
+    unsigned char hidden;
+} cli_sprites_piece;
+
+typedef struct cli_sprites_frame {
+    int64_t first_piece;
+    int     num_pieces;
+} cli_sprites_frame;
+
+
+
+const char * cli_sprites_format_name(int format)
+{
+    if ((format >= 0) && (format < CLI_SPRITES_LAST))
+        return cli_sprites_formats[format].p_name;
+
+    return NULL;
+}
+
+
+
+// Returns -1 for an unknown name
+int cli_sprites_format_from_name(const char * p_name)
+{
+    int c;
+
+    for (c = 0; c < CLI_SPRITES_LAST; c++)
+        if (0 == strcmp(p_name, cli_sprites_formats[c].p_name))
+            return c;
+
+    return -1;
+}
+
+
+
+// Raw coordinates, sizes and attributes of one entry
+static void cli_sprites_read_entry(const cli_sprites_options * p_options, const unsigned char * p_entry,
+                                   cli_sprites_piece * p_piece)
+{
+    unsigned int attr0, attr1, attr2;
+
+    memset(p_piece, 0, sizeof(cli_sprites_piece));
+    p_piece->width = p_piece->height = 1;
+
+    switch (p_options->format) {
+        case CLI_SPRITES_SNES:
+            p_piece->x     = p_entry[0];
+            p_piece->y     = p_entry[1];
+            p_piece->tile  = p_entry[2] | ((unsigned int)(p_entry[3] & 0x01) << 8);
+            p_piece->bank  = (p_entry[3] >> 1) & 0x07;
+            p_piece->hflip = (p_entry[3] >> 6) & 0x01;
+            p_piece->vflip = (p_entry[3] >> 7) & 0x01;
+
+            // The size bit is in the high table, not in the entry
+            if (p_options->tall)
+                p_piece->width = p_piece->height = 2;
+            break;
+
+        case CLI_SPRITES_GBA:
+            attr0 = p_entry[0] | ((unsigned int)p_entry[1] << 8);
+            attr1 = p_entry[2] | ((unsigned int)p_entry[3] << 8);
+            attr2 = p_entry[4] | ((unsigned int)p_entry[5] << 8);
+
+            p_piece->y      = attr0 & 0xFF;
+            p_piece->x      = attr1 & 0x1FF;
+            p_piece->tile   = attr2 & 0x3FF;
+            p_piece->bank   = (attr2 >> 12) & 0x0F;
+            p_piece->hidden = ((attr0 & 0x0300) == 0x0200) || (((attr0 >> 14) & 0x03) == 3);
+
+            // Flip bits are affine parameters for rotated sprites
+            if (!(attr0 & 0x0100)) {
+                p_piece->hflip = (attr1 >> 12) & 0x01;
+                p_piece->vflip = (attr1 >> 13) & 0x01;
+            }
+
+            if (!p_piece->hidden) {
+                p_piece->width  = cli_sprites_gba_sizes[(attr0 >> 14) & 0x03][(attr1 >> 14) & 0x03][0];
+                p_piece->height = cli_sprites_gba_sizes[(attr0 >> 14) & 0x03][(attr1 >> 14) & 0x03][1];
+            }
+            break;
+
+        case CLI_SPRITES_GENESIS:
+            attr2 = ((unsigned int)p_entry[4] << 8) | p_entry[5];
+
+            p_piece->y      = (((unsigned int)p_entry[0] << 8) | p_entry[1]) & 0x3FF;
+            p_piece->x      = (((unsigned int)p_entry[6] << 8) | p_entry[7]) & 0x1FF;
+            p_piece->width  = ((p_entry[2] >> 2) & 0x03) + 1;
+            p_piece->height = (p_entry[2] & 0x03) + 1;
+            p_piece->tile   = attr2 & 0x7FF;
+            p_piece->hflip  = (attr2 >> 11) & 0x01;
+            p_piece->vflip  = (attr2 >> 12) & 0x01;
+            p_piece->bank   = (attr2 >> 13) & 0x03;
+            break;
+
+        default:
+            p_piece->y     = p_entry[0];
+            p_piece->tile  = p_entry[1];
+            p_piece->bank  = p_entry[2] & 0x03;
+            p_piece->hflip = (p_entry[2] >> 6) & 0x01;
+            p_piece->vflip = (p_entry[2] >> 7) & 0x01;
+            p_piece->x     = p_entry[3];
+
+            // 8x16: bit 0 picks the pattern table, the pair starts even
+            if (p_options->tall) {
+                p_piece->tile   = (p_piece->tile & 0xFE) | ((p_piece->tile & 0x01) << 8);
+                p_piece->height = 2;
+            }
+            break;
+    }
+}
+
+
+
+// Tile number of the (tx, ty) tile of a piece, before flipping
+static unsigned int cli_sprites_piece_tile(int format, int bpp8, const cli_sprites_piece * p_piece,
+                                           unsigned int tx, unsigned int ty)
+{
+    switch (format) {
+        // 16 tiles per row of sprite tiles, wrapping within the row
+        case CLI_SPRITES_SNES:
+            return ((p_piece->tile & ~0x0Fu) | ((p_piece->tile + tx) & 0x0F)) + (ty * 16);
+
+        // One dimensional mapping: the piece's tiles in a row (the entry
+        // counts 32 byte units, two per 8bpp tile)
+        case CLI_SPRITES_GBA:
+            return ((bpp8) ? (p_piece->tile / 2) : p_piece->tile) + (ty * p_piece->width) + tx;
+
+        // Column by column
+        case CLI_SPRITES_GENESIS:
+            return p_piece->tile + (tx * p_piece->height) + ty;
+    }
+
+    return p_piece->tile + ty;
+}
+
+
+
+// Difference of two coordinates in a range that wraps, as -range/2 .. range/2 - 1
+static int cli_sprites_wrap(int value, int origin, int range)
+{
+    int delta = (value - origin) % range;
+
+    if (delta < 0)
+        delta += range;
+    if (delta >= range / 2)
+        delta -= range;
+
+    return delta;
+}
+
+
+
+static void cli_sprites_draw_piece(unsigned char * p_cell, unsigned int atlas_width, const cli_tiles * p_tiles,
+                                   const cli_sprites_options * p_options, const cli_sprites_piece * p_piece,
+                                   int bank_colors, int first_color)
+{
+    unsigned int tx, ty, x, y;
+    unsigned int bank_offset = (unsigned int)first_color + ((bank_colors) ? (p_piece->bank * (unsigned int)bank_colors) : 0);
+
+    for (ty = 0; ty < p_piece->height; ty++)
+        for (tx = 0; tx < p_piece->width; tx++) {
+            // A flipped piece also mirrors the order of its tiles
+            unsigned int          src_tx = (p_piece->hflip) ? (p_piece->width - 1 - tx) : tx;
+            unsigned int          src_ty = (p_piece->vflip) ? (p_piece->height - 1 - ty) : ty;
+            const unsigned char * p_tile;
+            int64_t               tile;
+
+            tile = (int64_t)cli_sprites_piece_tile(p_options->format, (p_tiles->colors == 256), p_piece, src_tx, src_ty) -
+                   p_options->tile_base;
+
+            if (NULL == (p_tile = cli_tiles_get(p_tiles, tile)))
+                continue;
+
+            for (y = 0; y < 8; y++) {
+                const unsigned char * p_row = p_tile + (((p_piece->vflip) ? (7 - y) : y) * 8);
+                unsigned char       * p_out = p_cell + (((size_t)(p_piece->y + (ty * 8) + y) * atlas_width) +
+                                                        (size_t)p_piece->x + (tx * 8));
+
+                for (x = 0; x < 8; x++) {
+                    unsigned char pixel = p_row[(p_piece->hflip) ? (7 - x) : x];
+
+                    // Color 0 is transparent
+                    if (pixel)
+                        p_out[x] = (unsigned char)(pixel + bank_offset);
+                }
+            }
+        }
+}
+
+
+
+// Colors for the whole color ram: the palette file, colors stored in the
+// rom, or else a gray ramp per bank
+static int cli_sprites_colors(const cli_sprites_options * p_options, const unsigned char * p_rom, int64_t rom_size,
+                              int bank_colors, app_color_data * p_colorpal)
+{
+    int c;
+
+    for (c = 0; c < 256; c++) {
+        int level = (bank_colors > 1) ? (((c % bank_colors) * 255) / (bank_colors - 1)) : c;
+
+        memset(p_colorpal->p_data + (c * 3), level, 3);
+    }
+
+    if (p_options->p_palette && (0 != cli_palette_load(p_options->p_palette, p_colorpal))) {
+        fprintf(stderr, "%s: can't load palette %s\n", CLI_NAME, p_options->p_palette);
+        return -1;
+    }
+
+    if (p_options->p_rom_palette &&
+        (0 != cli_palette_from_rom(p_options->p_rom_palette, p_rom, rom_size, p_options->image_mode, p_colorpal))) {
+        fprintf(stderr, "%s: no palette at \"%s\"\n", CLI_NAME, p_options->p_rom_palette);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+int cli_sprites_run(const char * p_rom, const char * p_out, const cli_sprites_options * p_options)
+{
+    int                 entry_bytes = cli_sprites_formats[p_options->format].entry_bytes;
+    unsigned char     * p_rom_data;
+    int64_t             rom_size;
+    int64_t             tiles_length;
+    int64_t             pos;
+    int64_t             num_pieces  = 0;
+    int64_t             num_visible = 0;
+    cli_sprites_piece * p_pieces = NULL;
+    cli_sprites_frame * p_frames = NULL;
+    cli_tiles           tiles;
+    unsigned char       colors[256 * 3];
+    app_color_data      colorpal;
+    unsigned char     * p_atlas = NULL;
+    unsigned char     * p_rgba  = NULL;
+    unsigned int        atlas_width, atlas_height;
+    unsigned int        cell_width, cell_height;
+    unsigned int        columns;
+    int                 min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    int                 origin_x = 0, origin_y = 0;
+    int                 first_color;
+    int                 bank_colors;
+    int                 status = -1;
+    int                 f, p;
+    int64_t             c;
+
+    memset(&tiles, 0, sizeof(tiles));
+
+    if (0 != cli_file_map(p_rom, &p_rom_data, &rom_size)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_rom);
+        return -1;
+    }
+
+    if ((p_options->tiles_offset >= rom_size) || (p_options->table_offset >= rom_size)) {
+        fprintf(stderr, "%s: offset past the end of the rom\n", CLI_NAME);
+        goto done;
+    }
+
+    // Every entry of every frame, read first for the shared bounds
+    if (NULL == (p_frames = calloc((size_t)p_options->num_frames, sizeof(cli_sprites_frame))))
+        goto done;
+
+    for (f = 0, pos = p_options->table_offset; f < p_options->num_frames; f++) {
+        int64_t frame_start = pos;
+        int     count       = p_options->num_pieces;
+
+        if ((0 == count) && (pos < rom_size))
+            count = p_rom_data[pos++];
+
+        if (pos + ((int64_t)count * entry_bytes) > rom_size) {
+            fprintf(stderr, "%s: frame %d runs past the end of the rom\n", CLI_NAME, f);
+            goto done;
+        }
+
+        p_frames[f].first_piece = num_pieces;
+        p_frames[f].num_pieces  = count;
+        num_pieces += count;
+
+        pos = (p_options->frame_stride) ? (frame_start + p_options->frame_stride) : (pos + ((int64_t)count * entry_bytes));
+    }
+
+    if ((num_pieces > 0) && (NULL == (p_pieces = malloc((size_t)num_pieces * sizeof(cli_sprites_piece)))))
+        goto done;
+
+    for (f = 0, pos = p_options->table_offset; f < p_options->num_frames; f++) {
+        int64_t frame_start = pos;
+
+        if (0 == p_options->num_pieces)
+            pos++;
+
+        for (p = 0; p < p_frames[f].num_pieces; p++, pos += entry_bytes) {
+            cli_sprites_piece * p_piece = &p_pieces[p_frames[f].first_piece + p];
+
+            cli_sprites_read_entry(p_options, p_rom_data + pos, p_piece);
+
+            if ((f == 0) && (p == 0)) {
+                origin_x = p_piece->x;
+                origin_y = p_piece->y;
+            }
+
+            p_piece->x = cli_sprites_wrap(p_piece->x, origin_x, cli_sprites_formats[p_options->format].x_range);
+            p_piece->y = cli_sprites_wrap(p_piece->y, origin_y, cli_sprites_formats[p_options->format].y_range);
+
+            if (p_piece->hidden)
+                continue;
+
+            if (0 == num_visible++) {
+                min_x = max_x = p_piece->x;
+                min_y = max_y = p_piece->y;
+            }
+
+            if (p_piece->x < min_x)
+                min_x = p_piece->x;
+            if (p_piece->y < min_y)
+                min_y = p_piece->y;
+            if (p_piece->x + (int)(p_piece->width * 8) > max_x)
+                max_x = p_piece->x + (int)(p_piece->width * 8);
+            if (p_piece->y + (int)(p_piece->height * 8) > max_y)
+                max_y = p_piece->y + (int)(p_piece->height * 8);
+        }
+
+        if (p_options->frame_stride)
+            pos = frame_start + p_options->frame_stride;
+    }
+
+    if (0 == num_visible) {
+        fprintf(stderr, "%s: no sprites to draw\n", CLI_NAME);
+        goto done;
+    }
+
+    // Tiles the entries point to, decoded once for every frame
+    tiles_length = rom_size - p_options->tiles_offset;
+    if ((p_options->tiles_length > 0) && (p_options->tiles_length < tiles_length))
+        tiles_length = p_options->tiles_length;
+
+    if (0 != cli_tiles_decode(&tiles, p_options->image_mode, p_rom_data + p_options->tiles_offset, tiles_length)) {
+        fprintf(stderr, "%s: can't decode the tiles as %s\n", CLI_NAME, rom_bin_mode_name(p_options->image_mode));
+        goto done;
+    }
+
+    bank_colors = (tiles.colors < 256) ? tiles.colors : 0;
+    first_color = (p_options->first_color >= 0) ? p_options->first_color : cli_sprites_formats[p_options->format].first_color;
+    if (0 == bank_colors)
+        first_color = 0;
+
+    // One cell per frame, in rows of about the same width as height
+    cell_width  = (unsigned int)(max_x - min_x);
+    cell_height = (unsigned int)(max_y - min_y);
+
+    columns = (unsigned int)p_options->columns;
+    if (0 == columns)
+        for (columns = 1; (int64_t)columns * columns < p_options->num_frames; columns++)
+            ;
+    if (columns > (unsigned int)p_options->num_frames)
+        columns = (unsigned int)p_options->num_frames;
+
+    atlas_width  = columns * cell_width;
+    atlas_height = ((p_options->num_frames + columns - 1) / columns) * cell_height;
+
+    if (NULL == (p_atlas = calloc((size_t)atlas_width * atlas_height, 1))) {
+        fprintf(stderr, "%s: out of memory\n", CLI_NAME);
+        goto done;
+    }
+
+    // Last entry first, so earlier ones end up on top
+    for (f = 0; f < p_options->num_frames; f++) {
+        unsigned char * p_cell = p_atlas + (((size_t)(f / columns) * cell_height * atlas_width) +
+                                            ((size_t)(f % columns) * cell_width));
+
+        for (p = p_frames[f].num_pieces - 1; p >= 0; p--) {
+            cli_sprites_piece piece = p_pieces[p_frames[f].first_piece + p];
+
+            if (piece.hidden)
+                continue;
+
+            piece.x -= min_x;
+            piece.y -= min_y;
+
+            cli_sprites_draw_piece(p_cell, atlas_width, &tiles, p_options, &piece, bank_colors, first_color);
+        }
+    }
+
+    colorpal.p_data          = colors;
+    colorpal.bytes_per_pixel = 3;
+    colorpal.size            = 256;
+    colorpal.index           = 0;
+
+    if (0 != cli_sprites_colors(p_options, p_rom_data, rom_size, bank_colors, &colorpal))
+        goto done;
+
+    if (p_options->indexed)
+        status = cli_png_write_indexed(p_out, atlas_width, atlas_height, p_atlas, &colorpal);
+    else if (NULL != (p_rgba = malloc((size_t)atlas_width * atlas_height * 4))) {
+        // Nothing drawn is transparent
+        for (c = 0; c < (int64_t)atlas_width * atlas_height; c++) {
+            memcpy(p_rgba + (c * 4), colors + (p_atlas[c] * 3), 3);
+            p_rgba[(c * 4) + 3] = (p_atlas[c]) ? 0xFF : 0x00;
+        }
+
+        status = cli_png_write_rgba(p_out, atlas_width, atlas_height, p_rgba);
+    }
+
+    if (0 != status)
+        fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_out);
+    else
+        printf("%d frames of %ux%u, %" PRId64 " pieces, %" PRId64 " tiles decoded\n", p_options->num_frames,
+               cell_width, cell_height, num_pieces, tiles.num_tiles);
+
+done:
+    free(p_rgba);
+    free(p_atlas);
+    free(p_pieces);
+    free(p_frames);
+    cli_tiles_free(&tiles);
+    cli_file_unmap(p_rom_data, rom_size);
+
+    return status;
+}
@@ -0,0 +1,57 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_SPRITES_HEADER
+#define CLI_SPRITES_HEADER
+
+#include <stdint.h>
+
+    // Sprite attribute (OAM) entry layouts
+    enum cli_sprites_formats {
+        CLI_SPRITES_SNES,      // x, y, tile, vhoopppN (4 bytes)
+        CLI_SPRITES_GBA,       // attr0, attr1, attr2 (+ affine), little endian (8 bytes)
+        CLI_SPRITES_GENESIS,   // y, size / link, attributes, x, big endian (8 bytes)
+        CLI_SPRITES_NES,       // y, tile, vhp---pp, x (4 bytes)
+
+        CLI_SPRITES_LAST
+    };
+
+    typedef struct cli_sprites_options {
+        int          image_mode;
+        int          format;
+        int64_t      tiles_offset;     // Tile data in the rom
+        int64_t      tiles_length;     // 0 = to the end of the rom
+        int64_t      table_offset;     // First frame's entries
+        int          num_pieces;       // Entries per frame, 0 = a count byte starts each frame
+        int          num_frames;
+        int64_t      frame_stride;     // Bytes from frame to frame, 0 = right after the last entry
+        int          tall;             // SNES: 16x16 pieces (the size bit is in the high table), NES: 8x16
+        int64_t      tile_base;        // Subtracted from the entries' tile numbers
+        int          first_color;      // Color ram index of sprite palette 0, -1 = the console's
+        int          columns;          // Frames per atlas row, 0 = about square
+        const char * p_palette;        // Palette file, NULL = none
+        const char * p_rom_palette;    // "[format:]offset" in the rom, NULL = none
+        int          indexed;          // 8 bit indexed PNG instead of RGBA
+    } cli_sprites_options;
+
+    const char * cli_sprites_format_name(int);
+    int          cli_sprites_format_from_name(const char *);
+
+    int cli_sprites_run(const char *, const char *, const cli_sprites_options *);
+
+#endif // CLI_SPRITES_HEADER
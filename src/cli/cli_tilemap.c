@@ -0,0 +1,411 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Tilemap render: composes a background screen from a console tilemap
+// and the tiles it points to.
+//
+// The tile data is decoded once into the tile cache, so map entries
+// that reuse a tile (most of them, on a typical screen) only copy its
+// 64 indexes, flipped as the entry says. Each entry's palette bank is
+// added to the tile's indexes, giving indexes into the whole color ram
+// (ex: bank 3 of a 4bpp tile uses colors 48 - 63). Index 0 of every bank
+// is transparent on these consoles, so it stays 0 (the backdrop).
+//
+// The screen is written as RGB, or as an 8 bit indexed PNG that keeps
+// the bank in each index, which cli_slice turns back into tiles + map.
+
+#include "lib_rom_bin.h"
+#include "cli_file.h"
+#include "cli_palette.h"
+#include "cli_png.h"
+#include "cli_tilemap.h"
+#include "cli_tiles.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+// Entries shown when the map's size isn't given: one 32 x 32 screen
+#define CLI_TILEMAP_DEFAULT_ENTRIES  (32 * 32)
+
+// SNES and GBA maps wider than this are stored as 32 x 32 blocks
+#define CLI_TILEMAP_BLOCK            32
+
+static const char * const cli_tilemap_format_names[] = {
+    [CLI_TILEMAP_SNES]    = "snes",
+    [CLI_TILEMAP_GBA]     = "gba",
+    [CLI_TILEMAP_GENESIS] = "genesis",
+    [CLI_TILEMAP_SMS]     = "sms",
+    [CLI_TILEMAP_BYTE]    = "byte",
+};
+
+
+
+const char * cli_tilemap_format_name(int format)
+{
+    if ((format >= 0) && (format < CLI_TILEMAP_LAST))
+        return cli_tilemap_format_names[format];
+
+    return NULL;
+}
+
+
+
+// Returns -1 for an unknown name
+int cli_tilemap_format_from_name(const char * p_name)
+{
+    int c;
+
+    for (c = 0; c < CLI_TILEMAP_LAST; c++)
+        if (0 == strcmp(p_name, cli_tilemap_format_names[c]))
+            return c;
+
+    return -1;
+}
+
+
+
+int cli_tilemap_entry_bytes(int format)
+{
+    return (format == CLI_TILEMAP_BYTE) ? 1 : 2;
+}
+
+
+
+void cli_tilemap_read_entry(int format, const unsigned char * p_entry, cli_tilemap_entry * p_out)
+{
+    unsigned int value;
+
+    memset(p_out, 0, sizeof(cli_tilemap_entry));
+
+    if (format == CLI_TILEMAP_GENESIS)
+        value = ((unsigned int)p_entry[0] << 8) | p_entry[1];
+    else if (format == CLI_TILEMAP_BYTE)
+        value = p_entry[0];
+    else
+        value = p_entry[0] | ((unsigned int)p_entry[1] << 8);
+
+    switch (format) {
+        case CLI_TILEMAP_SNES:
+            p_out->tile     = value & 0x3FF;
+            p_out->bank     = (value >> 10) & 0x07;
+            p_out->priority = (value >> 13) & 0x01;
+            p_out->hflip    = (value >> 14) & 0x01;
+            p_out->vflip    = (value >> 15) & 0x01;
+            break;
+
+        case CLI_TILEMAP_GBA:
+            p_out->tile     = value & 0x3FF;
+            p_out->hflip    = (value >> 10) & 0x01;
+            p_out->vflip    = (value >> 11) & 0x01;
+            p_out->bank     = (value >> 12) & 0x0F;
+            break;
+
+        case CLI_TILEMAP_GENESIS:
+            p_out->tile     = value & 0x7FF;
+            p_out->hflip    = (value >> 11) & 0x01;
+            p_out->vflip    = (value >> 12) & 0x01;
+            p_out->bank     = (value >> 13) & 0x03;
+            p_out->priority = (value >> 15) & 0x01;
+            break;
+
+        case CLI_TILEMAP_SMS:
+            p_out->tile     = value & 0x1FF;
+            p_out->hflip    = (value >> 9) & 0x01;
+            p_out->vflip    = (value >> 10) & 0x01;
+            p_out->bank     = (value >> 11) & 0x01;
+            p_out->priority = (value >> 12) & 0x01;
+            break;
+
+        default:
+            p_out->tile     = value;
+            break;
+    }
+}
+
+
+
+// Fields too large for the format are cut to its bits
+void cli_tilemap_write_entry(int format, const cli_tilemap_entry * p_entry, unsigned char * p_out)
+{
+    unsigned int value;
+
+    switch (format) {
+        case CLI_TILEMAP_SNES:
+            value = (p_entry->tile & 0x3FF) | ((p_entry->bank & 0x07) << 10) |
+                    ((p_entry->priority & 0x01) << 13) | ((p_entry->hflip & 0x01) << 14) | ((p_entry->vflip & 0x01) << 15);
+            break;
+
+        case CLI_TILEMAP_GBA:
+            value = (p_entry->tile & 0x3FF) | ((p_entry->hflip & 0x01) << 10) |
+                    ((p_entry->vflip & 0x01) << 11) | ((p_entry->bank & 0x0F) << 12);
+            break;
+
+        case CLI_TILEMAP_GENESIS:
+            value = (p_entry->tile & 0x7FF) | ((p_entry->hflip & 0x01) << 11) | ((p_entry->vflip & 0x01) << 12) |
+                    ((p_entry->bank & 0x03) << 13) | ((p_entry->priority & 0x01) << 15);
+            break;
+
+        case CLI_TILEMAP_SMS:
+            value = (p_entry->tile & 0x1FF) | ((p_entry->hflip & 0x01) << 9) | ((p_entry->vflip & 0x01) << 10) |
+                    ((p_entry->bank & 0x01) << 11) | ((p_entry->priority & 0x01) << 12);
+            break;
+
+        default:
+            p_out[0] = (unsigned char)p_entry->tile;
+            return;
+    }
+
+    if (format == CLI_TILEMAP_GENESIS) {
+        p_out[0] = (unsigned char)(value >> 8);
+        p_out[1] = (unsigned char)value;
+    }
+    else {
+        p_out[0] = (unsigned char)value;
+        p_out[1] = (unsigned char)(value >> 8);
+    }
+}
+
+
+
+// Where the entry for screen position (x, y), in tiles, is stored
+int64_t cli_tilemap_entry_index(int format, unsigned int map_width, unsigned int x, unsigned int y)
+{
+    if (((format == CLI_TILEMAP_SNES) || (format == CLI_TILEMAP_GBA)) &&
+        (map_width > CLI_TILEMAP_BLOCK) && (0 == map_width % CLI_TILEMAP_BLOCK)) {
+        int64_t block = (x / CLI_TILEMAP_BLOCK) + ((int64_t)(y / CLI_TILEMAP_BLOCK) * (map_width / CLI_TILEMAP_BLOCK));
+
+        return (block * CLI_TILEMAP_BLOCK * CLI_TILEMAP_BLOCK) +
+               ((y % CLI_TILEMAP_BLOCK) * CLI_TILEMAP_BLOCK) + (x % CLI_TILEMAP_BLOCK);
+    }
+
+    return ((int64_t)y * map_width) + x;
+}
+
+
+
+// Entries stored for a map of width x height, which is more than that
+// when it is made of whole 32 x 32 blocks
+int64_t cli_tilemap_map_entries(int format, unsigned int map_width, unsigned int map_height)
+{
+    if (((format == CLI_TILEMAP_SNES) || (format == CLI_TILEMAP_GBA)) &&
+        (map_width > CLI_TILEMAP_BLOCK) && (0 == map_width % CLI_TILEMAP_BLOCK))
+        map_height = ((map_height + CLI_TILEMAP_BLOCK - 1) / CLI_TILEMAP_BLOCK) * CLI_TILEMAP_BLOCK;
+
+    return (int64_t)map_width * map_height;
+}
+
+
+
+// Places one map entry's tile on the screen
+static void cli_tilemap_put_tile(unsigned char * p_screen, unsigned int screen_width,
+                                 const unsigned char * p_tile, const cli_tilemap_entry * p_entry, int bank_colors)
+{
+    unsigned int bank_offset = (bank_colors) ? (p_entry->bank * (unsigned int)bank_colors) : 0;
+    int          x, y;
+
+    for (y = 0; y < 8; y++) {
+        const unsigned char * p_row = p_tile + (((p_entry->vflip) ? (7 - y) : y) * 8);
+        unsigned char       * p_out = p_screen + ((size_t)y * screen_width);
+
+        if (p_entry->hflip)
+            for (x = 0; x < 8; x++)
+                p_out[x] = (p_row[7 - x]) ? (unsigned char)(p_row[7 - x] + bank_offset) : 0;
+        else
+            for (x = 0; x < 8; x++)
+                p_out[x] = (p_row[x]) ? (unsigned char)(p_row[x] + bank_offset) : 0;
+    }
+}
+
+
+
+// Colors for the whole color ram: the palette file, colors stored in the
+// rom, or else a gray ramp per bank
+static int cli_tilemap_colors(const cli_tilemap_options * p_options, const unsigned char * p_rom, int64_t rom_size,
+                              int bank_colors, app_color_data * p_colorpal)
+{
+    int c;
+
+    for (c = 0; c < 256; c++) {
+        int level = (bank_colors > 1) ? (((c % bank_colors) * 255) / (bank_colors - 1)) : c;
+
+        memset(p_colorpal->p_data + (c * 3), level, 3);
+    }
+
+    if (p_options->p_palette && (0 != cli_palette_load(p_options->p_palette, p_colorpal))) {
+        fprintf(stderr, "%s: can't load palette %s\n", CLI_NAME, p_options->p_palette);
+        return -1;
+    }
+
+    if (p_options->p_rom_palette &&
+        (0 != cli_palette_from_rom(p_options->p_rom_palette, p_rom, rom_size, p_options->image_mode, p_colorpal))) {
+        fprintf(stderr, "%s: no palette at \"%s\"\n", CLI_NAME, p_options->p_rom_palette);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+int cli_tilemap_run(const char * p_rom, const char * p_out, const cli_tilemap_options * p_options)
+{
+    unsigned char       * p_rom_data = NULL;
+    unsigned char       * p_map_data = NULL;
+    int64_t               rom_size = 0;
+    int64_t               map_size = 0;
+    const unsigned char * p_map;
+    int64_t               num_entries;
+    int64_t               tiles_length;
+    int                   entry_bytes = cli_tilemap_entry_bytes(p_options->map_format);
+    cli_tiles             tiles;
+    unsigned char         colors[256 * 3];
+    app_color_data        colorpal;
+    unsigned char       * p_screen = NULL;
+    unsigned char       * p_rgba   = NULL;
+    unsigned int          map_width;
+    unsigned int          map_height;
+    unsigned int          screen_width;
+    unsigned int          x, y;
+    int                   bank_colors;
+    int64_t               num_missing = 0;
+    int                   status = -1;
+    int64_t               c;
+
+    memset(&tiles, 0, sizeof(tiles));
+
+    if (0 != cli_file_map(p_rom, &p_rom_data, &rom_size)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_rom);
+        return -1;
+    }
+
+    if (p_options->p_map_file && (0 != cli_file_map(p_options->p_map_file, &p_map_data, &map_size))) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_options->p_map_file);
+        goto done;
+    }
+
+    if (NULL == p_options->p_map_file) {
+        p_map_data = p_rom_data;
+        map_size   = rom_size;
+    }
+
+    if ((p_options->tiles_offset >= rom_size) || (p_options->map_offset >= map_size)) {
+        fprintf(stderr, "%s: offset past the end of the data\n", CLI_NAME);
+        goto done;
+    }
+
+    // The map's extent
+    p_map       = p_map_data + p_options->map_offset;
+    num_entries = (map_size - p_options->map_offset) / entry_bytes;
+
+    if (p_options->num_entries > 0) {
+        if (p_options->num_entries < num_entries)
+            num_entries = p_options->num_entries;
+    }
+    else if ((NULL == p_options->p_map_file) && (num_entries > CLI_TILEMAP_DEFAULT_ENTRIES))
+        num_entries = CLI_TILEMAP_DEFAULT_ENTRIES;
+
+    map_width = (p_options->map_width) ? p_options->map_width : 32;
+    if (num_entries < map_width)
+        map_width = (unsigned int)num_entries;
+
+    map_height   = (unsigned int)(num_entries / map_width);
+    screen_width = map_width * 8;
+
+    // Every tile the map can point to, decoded once
+    tiles_length = rom_size - p_options->tiles_offset;
+    if ((p_options->tiles_length > 0) && (p_options->tiles_length < tiles_length))
+        tiles_length = p_options->tiles_length;
+
+    if ((num_entries <= 0) ||
+        (0 != cli_tiles_decode(&tiles, p_options->image_mode, p_rom_data + p_options->tiles_offset, tiles_length))) {
+        fprintf(stderr, "%s: can't decode the tiles as %s\n", CLI_NAME, rom_bin_mode_name(p_options->image_mode));
+        goto done;
+    }
+
+    // 8bpp tiles already index the whole color ram
+    bank_colors = (tiles.colors < 256) ? tiles.colors : 0;
+
+    colorpal.p_data          = colors;
+    colorpal.bytes_per_pixel = 3;
+    colorpal.size            = 256;
+    colorpal.index           = 0;
+
+    if (0 != cli_tilemap_colors(p_options, p_rom_data, rom_size, bank_colors, &colorpal))
+        goto done;
+
+    if (NULL == (p_screen = calloc((size_t)screen_width * map_height, 8))) {
+        fprintf(stderr, "%s: out of memory\n", CLI_NAME);
+        goto done;
+    }
+
+    for (y = 0; y < map_height; y++)
+        for (x = 0; x < map_width; x++) {
+            int64_t               index = cli_tilemap_entry_index(p_options->map_format, map_width, x, y);
+            cli_tilemap_entry     entry;
+            const unsigned char * p_tile;
+
+            if (index >= num_entries)
+                continue;
+
+            cli_tilemap_read_entry(p_options->map_format, p_map + (index * entry_bytes), &entry);
+
+            if (NULL == (p_tile = cli_tiles_get(&tiles, (int64_t)entry.tile - p_options->tile_base))) {
+                num_missing++;
+                continue;
+            }
+
+            cli_tilemap_put_tile(p_screen + (((size_t)y * 8 * screen_width) + ((size_t)x * 8)),
+                                 screen_width, p_tile, &entry, bank_colors);
+        }
+
+    if (p_options->indexed)
+        status = cli_png_write_indexed(p_out, screen_width, map_height * 8, p_screen, &colorpal);
+    else if (NULL != (p_rgba = malloc((size_t)screen_width * map_height * 8 * 4))) {
+        for (c = 0; c < (int64_t)screen_width * map_height * 8; c++) {
+            memcpy(p_rgba + (c * 4), colors + (p_screen[c] * 3), 3);
+            p_rgba[(c * 4) + 3] = 0xFF;
+        }
+
+        status = cli_png_write_rgba(p_out, screen_width, map_height * 8, p_rgba);
+    }
+
+    if (0 != status)
+        fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_out);
+    else {
+        printf("%ux%u entries, %" PRId64 " tiles decoded", map_width, map_height, tiles.num_tiles);
+        if (num_missing)
+            printf(", %" PRId64 " entries past the last tile", num_missing);
+        printf("\n");
+    }
+
+done:
+    free(p_rgba);
+    free(p_screen);
+    cli_tiles_free(&tiles);
+
+    if (p_map_data && (p_map_data != p_rom_data))
+        cli_file_unmap(p_map_data, map_size);
+    cli_file_unmap(p_rom_data, rom_size);
+
+    return status;
+}
@@ -0,0 +1,69 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_TILEMAP_HEADER
+#define CLI_TILEMAP_HEADER
+
+#include <stdint.h>
+
+    // Tilemap entry layouts
+    enum cli_tilemap_formats {
+        CLI_TILEMAP_SNES,      // vhopppcc cccccccc, little endian
+        CLI_TILEMAP_GBA,       // ppppvhcc cccccccc, little endian
+        CLI_TILEMAP_GENESIS,   // pccvhnnn nnnnnnnn, big endian
+        CLI_TILEMAP_SMS,       // ---pcvhn nnnnnnnn, little endian (also Game Gear)
+        CLI_TILEMAP_BYTE,      // One byte tile numbers (NES name tables)
+
+        CLI_TILEMAP_LAST
+    };
+
+    typedef struct cli_tilemap_entry {
+        unsigned int  tile;
+        unsigned int  bank;      // Palette
+        unsigned char hflip;
+        unsigned char vflip;
+        unsigned char priority;
+    } cli_tilemap_entry;
+
+    typedef struct cli_tilemap_options {
+        int          image_mode;
+        int          map_format;
+        int64_t      tiles_offset;     // Tile data in the rom
+        int64_t      tiles_length;     // 0 = to the end of the rom
+        const char * p_map_file;       // NULL = the map is in the rom too
+        int64_t      map_offset;
+        int64_t      num_entries;      // 0 = a 32 x 32 screen, or the whole map file
+        unsigned int map_width;        // Entries per row
+        int64_t      tile_base;        // Subtracted from the entries' tile numbers
+        const char * p_palette;        // Palette file, NULL = none
+        const char * p_rom_palette;    // "[format:]offset" in the rom, NULL = none
+        int          indexed;          // 8 bit indexed PNG instead of RGB
+    } cli_tilemap_options;
+
+    const char * cli_tilemap_format_name(int);
+    int          cli_tilemap_format_from_name(const char *);
+    int          cli_tilemap_entry_bytes(int);
+
+    void    cli_tilemap_read_entry(int, const unsigned char *, cli_tilemap_entry *);
+    void    cli_tilemap_write_entry(int, const cli_tilemap_entry *, unsigned char *);
+    int64_t cli_tilemap_entry_index(int, unsigned int, unsigned int, unsigned int);
+    int64_t cli_tilemap_map_entries(int, unsigned int, unsigned int);
+
+    int cli_tilemap_run(const char *, const char *, const cli_tilemap_options *);
+
+#endif // CLI_TILEMAP_HEADER
@@ -0,0 +1,109 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Tile cache shared by the renders (tilemaps, sprites): the tile data is
+// decoded once with the mode's codec, then rearranged so each tile's 64
+// color indexes are contiguous and can be copied (or flipped) directly.
+
+#include "lib_rom_bin.h"
+#include "cli_tiles.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+
+int cli_tiles_decode(cli_tiles * p_tiles, int image_mode, const unsigned char * p_data, int64_t size)
+{
+    const rom_gfx_attrib * p_attrib = rom_bin_mode_attrib(image_mode);
+    rom_gfx_data           rom_gfx;
+    app_gfx_data           app_gfx;
+    app_color_data         colorpal;
+    unsigned char        * p_image = NULL;
+    unsigned int           tiles_per_row;
+    int64_t                tile_bytes = rom_bin_tile_bytes(image_mode);
+    int64_t                tile;
+    int                    status = -1;
+    int                    y;
+
+    memset(p_tiles, 0, sizeof(cli_tiles));
+
+    if ((NULL == p_attrib) || (size < tile_bytes))
+        return -1;
+
+    p_tiles->image_mode = image_mode;
+    p_tiles->colors     = 1 << p_attrib->BITS_PER_PIXEL;
+    p_tiles->num_tiles  = size / tile_bytes;
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    // The codecs only read the rom data
+    rom_gfx.p_data          = (unsigned char *)p_data;
+    rom_gfx.size            = p_tiles->num_tiles * tile_bytes;
+    app_gfx.image_mode      = image_mode;
+    app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED;
+
+    if ((0 == rom_bin_decode_query(&rom_gfx, &app_gfx)) &&
+        (NULL != (p_image = malloc((size_t)app_gfx.size))) &&
+        (NULL != (p_tiles->p_pixels = malloc((size_t)p_tiles->num_tiles * CLI_TILES_PIXELS))) &&
+        (0 == rom_bin_decode_into(&rom_gfx, &app_gfx, &colorpal, p_image, 0, 0))) {
+
+        // Tiles are laid out left to right, top to bottom in the image
+        tiles_per_row = app_gfx.width / 8;
+
+        for (tile = 0; tile < p_tiles->num_tiles; tile++) {
+            const unsigned char * p_src = p_image + (((size_t)(tile / tiles_per_row) * 8 * app_gfx.width) +
+                                                     ((size_t)(tile % tiles_per_row) * 8));
+
+            for (y = 0; y < 8; y++)
+                memcpy(p_tiles->p_pixels + (tile * CLI_TILES_PIXELS) + (y * 8), p_src + ((size_t)y * app_gfx.width), 8);
+        }
+
+        status = 0;
+    }
+
+    // The rom data belongs to the caller
+    rom_gfx.p_data = NULL;
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+    free(p_image);
+
+    if (0 != status)
+        cli_tiles_free(p_tiles);
+
+    return status;
+}
+
+
+
+void cli_tiles_free(cli_tiles * p_tiles)
+{
+    free(p_tiles->p_pixels);
+    p_tiles->p_pixels  = NULL;
+    p_tiles->num_tiles = 0;
+}
+
+
+
+// A tile's 64 color indexes, NULL past the last tile
+const unsigned char * cli_tiles_get(const cli_tiles * p_tiles, int64_t tile)
+{
+    if ((tile < 0) || (tile >= p_tiles->num_tiles))
+        return NULL;
+
+    return p_tiles->p_pixels + (tile * CLI_TILES_PIXELS);
+}
@@ -0,0 +1,40 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_TILES_HEADER
+#define CLI_TILES_HEADER
+
+#include <stdint.h>
+
+    // Tiles decoded once to color indexes, 8x8 bytes per tile one after
+    // the other, for renders that place the same tile many times
+    #define CLI_TILES_PIXELS  64
+
+    typedef struct cli_tiles {
+        int             image_mode;
+        int             colors;       // Per tile (2 ^ bits per pixel)
+        int64_t         num_tiles;
+        unsigned char * p_pixels;
+    } cli_tiles;
+
+    int  cli_tiles_decode(cli_tiles *, int, const unsigned char *, int64_t);
+    void cli_tiles_free(cli_tiles *);
+
+    const unsigned char * cli_tiles_get(const cli_tiles *, int64_t);
+
+#endif // CLI_TILES_HEADER
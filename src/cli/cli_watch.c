@@ -0,0 +1,298 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Watch mode: keeps a rom in step with a PNG while it is being edited.
+//
+// Each time the image is saved it is encoded in memory and compared to
+// the previous encoding tile by tile. Only the runs of tiles that changed
+// are written into the rom, in place, so a save costs a few small writes
+// whatever the size of the rom. The first pass compares against what the
+// rom already holds.
+
+#include "lib_rom_bin.h"
+#include "cli_png.h"
+#include "cli_watch.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+#ifdef __linux__
+
+#include "rom_stats.h"
+#include "cli_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Editors often write a file in several steps, wait for them to settle
+#define CLI_WATCH_SETTLE_MS  30
+
+typedef struct cli_watch {
+    const char    * p_image;
+    const char    * p_rom;
+    const char    * p_image_name;   // Name within its folder, to match events
+    int64_t         offset;
+    int             image_mode;
+    int64_t         tile_bytes;
+    int             rom_fd;
+    unsigned char * p_tiles;        // Last encoding written to the rom
+    int64_t         size;
+} cli_watch;
+
+
+
+// Encodes the image, the caller frees the result with rom_bin_free()
+static int cli_watch_encode(cli_watch * p_watch, unsigned char ** pp_data, int64_t * p_size)
+{
+    rom_gfx_data   rom_gfx;
+    app_gfx_data   app_gfx;
+    app_color_data colorpal;
+    int            status = -1;
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    app_gfx.image_mode = p_watch->image_mode;
+
+    if (0 != cli_png_read(p_watch->p_image, &app_gfx))
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_watch->p_image);
+    else if (0 != rom_bin_encode(&rom_gfx, &app_gfx))
+        fprintf(stderr, "%s: can't encode %s as %s\n", CLI_NAME,
+                p_watch->p_image, rom_bin_mode_name(p_watch->image_mode));
+    else {
+        // Keep the encoded data, free the rest
+        *pp_data       = rom_gfx.p_data;
+        *p_size        = rom_gfx.size;
+        rom_gfx.p_data = NULL;
+        status = 0;
+    }
+
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    return status;
+}
+
+
+
+// Writes the runs of tiles that differ from the last encoding. Anything
+// past the end of the last encoding counts as changed
+static int cli_watch_patch(cli_watch * p_watch, const unsigned char * p_data, int64_t size,
+                           int64_t * p_num_changed, int64_t * p_bytes_written)
+{
+    int64_t run_start = -1;
+    int64_t pos;
+    int64_t len;
+
+    *p_num_changed   = 0;
+    *p_bytes_written = 0;
+
+    // Goes one tile past the end to write out the last run
+    for (pos = 0; (pos < size) || (run_start != -1); pos += p_watch->tile_bytes) {
+        int changed = 0;
+
+        if (pos < size) {
+            len = (size - pos < p_watch->tile_bytes) ? size - pos : p_watch->tile_bytes;
+
+            changed = (pos + len > p_watch->size) ||
+                      (0 != memcmp(p_data + pos, p_watch->p_tiles + pos, (size_t)len));
+        }
+
+        if (changed) {
+            (*p_num_changed)++;
+            if (run_start == -1)
+                run_start = pos;
+            continue;
+        }
+
+        // End of a run of changed tiles, one write for all of them
+        if (run_start != -1) {
+            len = ((pos < size) ? pos : size) - run_start;
+
+            if (len != pwrite(p_watch->rom_fd, p_data + run_start, (size_t)len, p_watch->offset + run_start)) {
+                fprintf(stderr, "%s: can't write %s: %s\n", CLI_NAME, p_watch->p_rom, strerror(errno));
+                return -1;
+            }
+
+            *p_bytes_written += len;
+            run_start = -1;
+        }
+    }
+
+    return 0;
+}
+
+
+
+// The rom bytes the image covers are the first "previous" encoding,
+// so the first update only writes real differences
+static int cli_watch_read_rom(cli_watch * p_watch, int64_t size)
+{
+    ssize_t num_read;
+
+    if (NULL == (p_watch->p_tiles = rom_bin_alloc((size_t)size)))
+        return -1;
+
+    num_read = pread(p_watch->rom_fd, p_watch->p_tiles, (size_t)size, p_watch->offset);
+    p_watch->size = (num_read > 0) ? num_read : 0;
+
+    return 0;
+}
+
+
+
+// Encodes the image again and patches the rom with what changed
+static void cli_watch_update(cli_watch * p_watch)
+{
+    unsigned char * p_data;
+    int64_t         size;
+    int64_t         num_changed;
+    int64_t         bytes_written;
+    int64_t         start_ns = rom_stats_now_ns();
+
+    if (0 != cli_watch_encode(p_watch, &p_data, &size))
+        return;
+
+    if ((NULL == p_watch->p_tiles) && (0 != cli_watch_read_rom(p_watch, size))) {
+        rom_bin_free(p_data);
+        return;
+    }
+
+    if (0 != cli_watch_patch(p_watch, p_data, size, &num_changed, &bytes_written)) {
+        rom_bin_free(p_data);
+        return;
+    }
+
+    printf("%s: %" PRId64 " of %" PRId64 " tiles changed, %" PRId64 " bytes written at 0x%" PRIx64 " (%.2f ms)\n",
+           p_watch->p_image, num_changed, (size + p_watch->tile_bytes - 1) / p_watch->tile_bytes,
+           bytes_written, p_watch->offset, (rom_stats_now_ns() - start_ns) / 1e6);
+    fflush(stdout);
+
+    rom_bin_free(p_watch->p_tiles);
+    p_watch->p_tiles = p_data;
+    p_watch->size    = size;
+}
+
+
+
+// True for the events that mean the image was saved. Editors that save
+// to a temporary file and rename it show up as a move
+static int cli_watch_saved(cli_watch * p_watch, int notify_fd, int timeout_ms)
+{
+    char                         buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event * p_event;
+    struct pollfd                poll_fd;
+    ssize_t                      len;
+    int                          saved = 0;
+
+    poll_fd.fd     = notify_fd;
+    poll_fd.events = POLLIN;
+
+    if (poll(&poll_fd, 1, timeout_ms) <= 0)
+        return 0;
+
+    if ((len = read(notify_fd, buffer, sizeof(buffer))) <= 0)
+        return 0;
+
+    for (p_event = (const struct inotify_event *)buffer;
+         (const char *)p_event < buffer + len;
+         p_event = (const struct inotify_event *)((const char *)p_event + sizeof(*p_event) + p_event->len))
+        if (p_event->len && (0 == strcmp(p_event->name, p_watch->p_image_name)))
+            saved = 1;
+
+    return saved;
+}
+
+
+
+int cli_watch_run(const char * p_image, const char * p_rom, const cli_watch_options * p_options)
+{
+    cli_watch watch;
+    char    * p_dir;
+    int       notify_fd;
+
+    memset(&watch, 0, sizeof(watch));
+    watch.p_image      = p_image;
+    watch.p_rom        = p_rom;
+    watch.offset       = p_options->offset;
+    watch.image_mode   = p_options->image_mode;
+    watch.tile_bytes   = rom_bin_tile_bytes(p_options->image_mode);
+    watch.p_image_name = (strrchr(p_image, '/')) ? strrchr(p_image, '/') + 1 : p_image;
+
+    if (watch.tile_bytes <= 0)
+        return -1;
+
+    if (-1 == (watch.rom_fd = open(p_rom, O_RDWR))) {
+        fprintf(stderr, "%s: can't open %s: %s\n", CLI_NAME, p_rom, strerror(errno));
+        return -1;
+    }
+
+    // Watch the folder, saving by rename replaces the watched file
+    p_dir = cli_file_dir_name(p_image);
+
+    if ((NULL == p_dir) ||
+        (-1 == (notify_fd = inotify_init1(IN_CLOEXEC))) ||
+        (-1 == inotify_add_watch(notify_fd, (p_dir[0] != '\0') ? p_dir : ".", IN_CLOSE_WRITE | IN_MOVED_TO))) {
+        fprintf(stderr, "%s: can't watch %s: %s\n", CLI_NAME, p_image, strerror(errno));
+        free(p_dir);
+        close(watch.rom_fd);
+        return -1;
+    }
+
+    free(p_dir);
+
+    // Bring the rom up to date, then follow the saves. A save that can't
+    // be read (ex: still being written) is retried on the next one
+    cli_watch_update(&watch);
+
+    printf("Watching %s, Ctrl+C to stop\n", p_image);
+    fflush(stdout);
+
+    for (;;) {
+        if (!cli_watch_saved(&watch, notify_fd, -1))
+            continue;
+
+        while (cli_watch_saved(&watch, notify_fd, CLI_WATCH_SETTLE_MS))
+            ;
+
+        cli_watch_update(&watch);
+    }
+
+    return 0;
+}
+
+#else
+
+int cli_watch_run(const char * p_image, const char * p_rom, const cli_watch_options * p_options)
+{
+    (void)p_image;
+    (void)p_rom;
+    (void)p_options;
+
+    fprintf(stderr, "%s: watch needs inotify, it is only available on Linux\n", CLI_NAME);
+
+    return -1;
+}
+
+#endif // __linux__
@@ -0,0 +1,31 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#ifndef CLI_WATCH_HEADER
+#define CLI_WATCH_HEADER
+
+#include <stdint.h>
+
+    typedef struct cli_watch_options {
+        int          image_mode;
+        int64_t      offset;          // Where the tiles go in the rom
+    } cli_watch_options;
+
+    int cli_watch_run(const char *, const char *, const cli_watch_options *);
+
+#endif // CLI_WATCH_HEADER
@@ -0,0 +1,1088 @@
+/*=======================================================================
+              ROM bin command line tool
+                 Copyright 2018 - Others
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "lib_rom_bin.h"
+#include "rom_stats.h"
+#include "cli_batch.h"
+#include "cli_diff.h"
+#include "cli_file.h"
+#include "cli_find.h"
+#include "cli_index.h"
+#include "cli_manifest.h"
+#include "cli_palette.h"
+#include "cli_patch.h"
+#include "cli_slice.h"
+#include "cli_sprites.h"
+#include "cli_tilemap.h"
+#include "cli_png.h"
+#include "cli_watch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char CLI_NAME[] = "rom-bin-cli";
+
+#define CLI_BATCH_DEFAULT_MAX_MB  512  // Memory budget for files in flight
+#define CLI_FIND_DEFAULT_SITES    20   // Places listed by find
+#define CLI_PALETTE_DEFAULT_HITS  20   // Candidates listed by palettes
+
+
+
+static void cli_usage(void)
+{
+    fprintf(stderr,
+            "usage: %s <command> [options]\n"
+            "\n"
+            "  decode -m <mode> [-p <palette>] [-P [<format>:]<offset>] <in.bin> <out.png>\n"
+            "                                        ROM tiles to an indexed PNG. Colors come\n"
+            "                                        from a palette file or save state (-p,\n"
+            "                                        default: <in>.pal/.act/.gpl/.zst/.gs0/.ss0\n"
+            "                                        if there is one), or from that offset of\n"
+            "                                        <in.bin> (-P)\n"
+            "  encode -m <mode> <in.png> <out.bin>   Indexed PNG back to ROM tiles\n"
+            "  batch <decode|encode> -m <mode> [options] <files...>\n"
+            "      -j <threads>   Worker threads (default: one per processor)\n"
+            "      -o <dir>       Output folder (default: next to each input)\n"
+            "      -x <ext>       Output extension (default: png / bin)\n"
+            "      -M <MiB>       Approximate memory budget (default: %d)\n"
+            "      -l <list>      Read more input names from a file, one per line\n"
+            "      -i <index>     Skip inputs whose output is current in this index\n"
+            "  extract [-j <threads>] [-r <report.json>] [-i <index>] <manifest.json>\n"
+            "                                        Run the decode jobs of a manifest\n"
+            "  watch -m <mode> [-a <offset>] <in.png> <rom.bin>\n"
+            "                                        Patch the changed tiles into the rom\n"
+            "                                        each time the PNG is saved\n"
+            "  patch -m <mode> [-a <offset>] [-f ips|bps] <in.png> <rom.bin> <out>\n"
+            "                                        Write what the PNG changes in the rom\n"
+            "                                        as a patch (format from <out> by default)\n"
+            "  diff -m <mode> [options] <a.bin> <b.bin>\n"
+            "                                        List the tiles that differ\n"
+            "      -a <offset>    Start in the first rom\n"
+            "      -b <offset>    Start in the second rom\n"
+            "      -n <length>    Bytes to compare (default: as far as both go)\n"
+            "      -j <threads>   Worker threads (default: one per processor)\n"
+            "      -o <out.png>   Second rom with the changed tiles outlined\n"
+            "  find [-m <mode>] [-j <threads>] [-n <count>] [-d <pixels>] <tiles.png> <rom.bin>\n"
+            "                                        Where the image's tiles are in the rom,\n"
+            "                                        in every mode unless -m is given. With -d,\n"
+            "                                        tiles may use another palette order and\n"
+            "                                        differ by up to that many pixels\n"
+            "  palettes [options] <rom.bin>          Where the rom's palettes may be\n"
+            "      -f <format>    bgr555, genesis, gg or sms (default: all)\n"
+            "      -m <mode>      Format and size of the mode's palettes\n"
+            "      -c <colors>    Colors per palette (default: 16)\n"
+            "      -n <count>     Candidates listed (default: %d)\n"
+            "      -o <out.png>   Swatches of each candidate's colors\n"
+            "  tilemap -m <mode> -f <format> -M <map> [options] <rom.bin> <out.png>\n"
+            "                                        Compose a screen from a tilemap and its\n"
+            "                                        tiles, with each entry's palette and flips\n"
+            "      -f <format>    snes, gba, genesis, sms or byte\n"
+            "      -M <map>       Offset of the map in the rom, or <file>[@<offset>]\n"
+            "      -t <offset>    Start of the tiles in the rom (default: 0)\n"
+            "      -T <length>    Bytes of tiles (default: to the end of the rom)\n"
+            "      -n <entries>   Map entries (default: 32 x 32, or the whole map file)\n"
+            "      -w <entries>   Entries per row (default: 32)\n"
+            "      -b <tile>      Tile number of the first tile (default: 0)\n"
+            "      -p <palette>   Palette file or save state with the color ram\n"
+            "      -P [<format>:]<offset>  Color ram stored in the rom\n"
+            "      -i             8 bit indexed PNG instead of RGB\n"
+            "  slice -m <mode> -f <format> [-b <tile>] [-l <tiles>] <screen.png> <tiles.bin> <map.bin>\n"
+            "                                        Cut an indexed screen (as written by\n"
+            "                                        tilemap -i) into unique tiles and a map,\n"
+            "                                        reusing flipped tiles. -b numbers the\n"
+            "                                        tiles from <tile>, -l caps their count\n"
+            "  sprites -m <mode> -f <format> -O <table> [options] <rom.bin> <atlas.png>\n"
+            "                                        Assemble metasprite frames from a table\n"
+            "                                        of sprite (OAM) entries, one atlas cell\n"
+            "                                        per frame\n"
+            "      -f <format>    snes, gba, genesis or nes\n"
+            "      -O <offset>    Start of the first frame's entries\n"
+            "      -c <pieces>    Entries per frame (default: a count byte before each frame)\n"
+            "      -n <frames>    Frames in the table (default: 1)\n"
+            "      -S <bytes>     Frame to frame distance (default: right after the last entry)\n"
+            "      -s             Tall pieces: 16x16 on the SNES, 8x16 on the NES\n"
+            "      -t <offset>    Start of the tiles in the rom (default: 0)\n"
+            "      -T <length>    Bytes of tiles (default: to the end of the rom)\n"
+            "      -b <tile>      Tile number of the first tile (default: 0)\n"
+            "      -C <index>     Color of sprite palette 0 (default: 128 snes, 16 nes, else 0)\n"
+            "      -w <frames>    Frames per atlas row (default: about square)\n"
+            "      -p <palette>   Palette file or save state with the color ram\n"
+            "      -P [<format>:]<offset>  Color ram stored in the rom\n"
+            "      -i             8 bit indexed PNG instead of RGBA\n"
+            "  modes                                 List the image modes\n"
+            "  version                               Print the librombin version\n"
+            "\n"
+            "Set ROM_BIN_STATS=1 for per-operation timings on stderr.\n",
+            CLI_NAME, CLI_BATCH_DEFAULT_MAX_MB, CLI_PALETTE_DEFAULT_HITS);
+}
+
+
+
+// Accepts a mode name (see "modes") or its number
+static int cli_parse_mode(const char * p_arg)
+{
+    char * p_end;
+    long   mode;
+
+    mode = rom_bin_mode_from_name(p_arg);
+    if (mode != -1)
+        return (int)mode;
+
+    mode = strtol(p_arg, &p_end, 10);
+    if ((*p_arg != '\0') && (*p_end == '\0') && (mode >= 0) && (mode < BIN_MODE_LAST))
+        return (int)mode;
+
+    return -1;
+}
+
+
+
+// Splits "-m <mode> <in> <out>" in any order, plus "-p <palette file>"
+// and "-P <palette in the rom>" when pp_palettes is given
+static int cli_parse_convert_args(int argc, char ** argv, int * p_mode, const char ** pp_in, const char ** pp_out,
+                                  const char ** pp_palettes)
+{
+    int c;
+
+    *p_mode = -1;
+    *pp_in  = NULL;
+    *pp_out = NULL;
+
+    if (pp_palettes)
+        pp_palettes[0] = pp_palettes[1] = NULL;
+
+    for (c = 0; c < argc; c++) {
+        if (!strcmp(argv[c], "-m") && ((c + 1) < argc)) {
+            if (-1 == (*p_mode = cli_parse_mode(argv[++c]))) {
+                fprintf(stderr, "%s: unknown mode \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (pp_palettes && !strcmp(argv[c], "-p") && ((c + 1) < argc))
+            pp_palettes[0] = argv[++c];
+        else if (pp_palettes && !strcmp(argv[c], "-P") && ((c + 1) < argc))
+            pp_palettes[1] = argv[++c];
+        else if (NULL == *pp_in)
+            *pp_in = argv[c];
+        else if (NULL == *pp_out)
+            *pp_out = argv[c];
+        else
+            return -1;
+    }
+
+    if ((*p_mode == -1) || (NULL == *pp_in) || (NULL == *pp_out))
+        return -1;
+
+    return 0;
+}
+
+
+
+static int cli_decode(int argc, char ** argv)
+{
+    rom_gfx_data   rom_gfx;
+    app_gfx_data   app_gfx;
+    app_color_data colorpal;
+    rom_stats      stats;
+    const char   * p_in;
+    const char   * p_out;
+    const char   * p_palettes[2];    // File, offset in the rom
+    char         * p_sidecar = NULL;
+    int            image_mode;
+    int            status = -1;
+
+    if (0 != cli_parse_convert_args(argc, argv, &image_mode, &p_in, &p_out, p_palettes)) {
+        cli_usage();
+        return -1;
+    }
+
+    // Without either, a palette saved next to the input is used
+    if ((NULL == p_palettes[0]) && (NULL == p_palettes[1]))
+        p_palettes[0] = p_sidecar = cli_palette_find_sidecar(p_in);
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    app_gfx.image_mode      = image_mode;
+    app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+    app_gfx.p_stats         = rom_stats_begin(&stats, "decode", p_in, image_mode);
+
+    rom_stats_start(app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+
+    if (0 != cli_file_read(p_in, &rom_gfx.p_data, &rom_gfx.size))
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_in);
+    else {
+        rom_stats_stop(app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+        rom_stats_add(app_gfx.p_stats, ROM_STATS_COUNT_BYTES_COPIED, rom_gfx.size);
+
+        if (0 != rom_bin_decode(&rom_gfx, &app_gfx, &colorpal))
+            fprintf(stderr, "%s: can't decode %s as %s\n", CLI_NAME, p_in, rom_bin_mode_name(image_mode));
+        else if (p_palettes[0] && (0 != cli_palette_load(p_palettes[0], &colorpal)))
+            fprintf(stderr, "%s: can't load palette %s\n", CLI_NAME, p_palettes[0]);
+        else if (p_palettes[1] &&
+                 (0 != cli_palette_from_rom(p_palettes[1], rom_gfx.p_data, rom_gfx.size, image_mode, &colorpal)))
+            fprintf(stderr, "%s: no palette at \"%s\" in %s\n", CLI_NAME, p_palettes[1], p_in);
+        else {
+            rom_stats_start(app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+
+            if (0 != cli_png_write(p_out, &app_gfx, &colorpal))
+                fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_out);
+            else
+                status = 0;
+
+            rom_stats_stop(app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+        }
+    }
+
+    rom_stats_set_status(app_gfx.p_stats, status);
+    rom_stats_end(app_gfx.p_stats);
+
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+    free(p_sidecar);
+
+    return status;
+}
+
+
+
+static int cli_encode(int argc, char ** argv)
+{
+    rom_gfx_data   rom_gfx;
+    app_gfx_data   app_gfx;
+    app_color_data colorpal;
+    rom_stats      stats;
+    const char   * p_in;
+    const char   * p_out;
+    int            image_mode;
+    int            status = -1;
+
+    if (0 != cli_parse_convert_args(argc, argv, &image_mode, &p_in, &p_out, NULL)) {
+        cli_usage();
+        return -1;
+    }
+
+    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    app_gfx.image_mode = image_mode;
+    app_gfx.p_stats    = rom_stats_begin(&stats, "encode", p_out, image_mode);
+
+    rom_stats_start(app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+
+    if (0 != cli_png_read(p_in, &app_gfx))
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_in);
+    else {
+        rom_stats_stop(app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+
+        if (0 != rom_bin_encode(&rom_gfx, &app_gfx))
+            fprintf(stderr, "%s: can't encode %s as %s\n", CLI_NAME, p_in, rom_bin_mode_name(image_mode));
+        else {
+            rom_stats_start(app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+
+            if (0 != cli_file_write(p_out, rom_gfx.p_data, rom_gfx.size))
+                fprintf(stderr, "%s: can't write %s\n", CLI_NAME, p_out);
+            else
+                status = 0;
+
+            rom_stats_stop(app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+            rom_stats_add(app_gfx.p_stats, ROM_STATS_COUNT_BYTES_COPIED, rom_gfx.size);
+        }
+    }
+
+    rom_stats_set_status(app_gfx.p_stats, status);
+    rom_stats_end(app_gfx.p_stats);
+
+    rom_bin_free_structs(&rom_gfx, &app_gfx, &colorpal);
+
+    return status;
+}
+
+
+
+// Grows the input name array as needed
+static int cli_add_name(char *** ppp_names, int * p_num_names, int * p_max_names, char * p_name)
+{
+    if (*p_num_names == *p_max_names) {
+        char ** pp_grown = realloc(*ppp_names, (size_t)(*p_max_names * 2) * sizeof(char *));
+
+        if (NULL == pp_grown)
+            return -1;
+
+        *ppp_names    = pp_grown;
+        *p_max_names *= 2;
+    }
+
+    (*ppp_names)[(*p_num_names)++] = p_name;
+
+    return 0;
+}
+
+
+
+// Appends the lines of a list file to the input names. The names
+// point into the returned text, which is kept until the batch is done
+static char * cli_read_list(const char * p_list, char *** ppp_names, int * p_num_names, int * p_max_names)
+{
+    unsigned char * p_data;
+    int64_t         size;
+    char          * p_text;
+    char          * p_line;
+
+    if (0 != cli_file_read(p_list, &p_data, &size)) {
+        fprintf(stderr, "%s: can't read %s\n", CLI_NAME, p_list);
+        return NULL;
+    }
+
+    // Copy with a terminator, the last line may not have a newline
+    if (NULL == (p_text = malloc((size_t)size + 1))) {
+        rom_bin_free(p_data);
+        return NULL;
+    }
+
+    memcpy(p_text, p_data, (size_t)size);
+    p_text[size] = '\0';
+    rom_bin_free(p_data);
+
+    for (p_line = strtok(p_text, "\r\n"); p_line; p_line = strtok(NULL, "\r\n")) {
+
+        if (0 != cli_add_name(ppp_names, p_num_names, p_max_names, p_line)) {
+            free(p_text);
+            return NULL;
+        }
+    }
+
+    return p_text;
+}
+
+
+
+static int cli_batch(int argc, char ** argv)
+{
+    cli_batch_options options;
+    char           ** pp_names;
+    char            * p_list_text = NULL;
+    const char      * p_index_name = NULL;
+    int               num_names = 0;
+    int               max_names;
+    int               status = -1;
+    int               c;
+
+    if (argc < 1) {
+        cli_usage();
+        return -1;
+    }
+
+    memset(&options, 0, sizeof(options));
+    options.image_mode = -1;
+    options.max_bytes  = (int64_t)CLI_BATCH_DEFAULT_MAX_MB * 1024 * 1024;
+
+    if      (!strcmp(argv[0], "decode")) options.decode = 1;
+    else if (!strcmp(argv[0], "encode")) options.decode = 0;
+    else {
+        cli_usage();
+        return -1;
+    }
+
+    options.p_out_ext = (options.decode) ? "png" : "bin";
+
+    max_names = argc + 1;
+    if (NULL == (pp_names = malloc((size_t)max_names * sizeof(char *))))
+        return -1;
+
+    for (c = 1; c < argc; c++) {
+        const char * p_option = argv[c];
+        const char * p_value;
+
+        // Anything that isn't an option is an input file
+        if ((p_option[0] != '-') || (p_option[1] == '\0') || (p_option[2] != '\0')) {
+            if (0 != cli_add_name(&pp_names, &num_names, &max_names, argv[c]))
+                goto done;
+            continue;
+        }
+
+        // All options take a value
+        if ((c + 1) >= argc) {
+            cli_usage();
+            goto done;
+        }
+        p_value = argv[++c];
+
+        switch (p_option[1]) {
+            case 'm':
+                if (-1 == (options.image_mode = cli_parse_mode(p_value))) {
+                    fprintf(stderr, "%s: unknown mode \"%s\"\n", CLI_NAME, p_value);
+                    goto done;
+                }
+                break;
+
+            case 'j': options.num_threads = atoi(p_value);                      break;
+            case 'o': options.p_out_dir   = p_value;                            break;
+            case 'x': options.p_out_ext   = p_value;                            break;
+            case 'M': options.max_bytes   = (int64_t)atoi(p_value) * 1024 * 1024; break;
+            case 'i': p_index_name        = p_value;                            break;
+
+            case 'l':
+                // Only one list, the names point into its text
+                if ((NULL != p_list_text) ||
+                    (NULL == (p_list_text = cli_read_list(p_value, &pp_names, &num_names, &max_names))))
+                    goto done;
+                break;
+
+            default:
+                cli_usage();
+                goto done;
+        }
+    }
+
+    if ((options.image_mode == -1) || (num_names == 0)) {
+        cli_usage();
+        goto done;
+    }
+
+    if (p_index_name && (NULL == (options.p_index = cli_index_load(p_index_name)))) {
+        fprintf(stderr, "%s: can't load index %s\n", CLI_NAME, p_index_name);
+        goto done;
+    }
+
+    if (0 == cli_batch_run(pp_names, num_names, &options))
+        status = 0;
+
+    if (p_index_name && (0 != cli_index_save(options.p_index, p_index_name))) {
+        fprintf(stderr, "%s: can't write index %s\n", CLI_NAME, p_index_name);
+        status = -1;
+    }
+
+done:
+    cli_index_free(options.p_index);
+    free(p_list_text);
+    free(pp_names);
+
+    return status;
+}
+
+
+
+static int cli_extract(int argc, char ** argv)
+{
+    cli_manifest_options options;
+    const char         * p_manifest = NULL;
+    const char         * p_index_name = NULL;
+    int                  status;
+    int                  c;
+
+    memset(&options, 0, sizeof(options));
+
+    for (c = 0; c < argc; c++) {
+        if (!strcmp(argv[c], "-j") && ((c + 1) < argc))
+            options.num_threads = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-r") && ((c + 1) < argc))
+            options.p_report = argv[++c];
+        else if (!strcmp(argv[c], "-i") && ((c + 1) < argc))
+            p_index_name = argv[++c];
+        else if (NULL == p_manifest)
+            p_manifest = argv[c];
+        else {
+            cli_usage();
+            return -1;
+        }
+    }
+
+    if (NULL == p_manifest) {
+        cli_usage();
+        return -1;
+    }
+
+    if (p_index_name && (NULL == (options.p_index = cli_index_load(p_index_name)))) {
+        fprintf(stderr, "%s: can't load index %s\n", CLI_NAME, p_index_name);
+        return -1;
+    }
+
+    status = (0 == cli_manifest_run(p_manifest, &options)) ? 0 : -1;
+
+    if (p_index_name && (0 != cli_index_save(options.p_index, p_index_name))) {
+        fprintf(stderr, "%s: can't write index %s\n", CLI_NAME, p_index_name);
+        status = -1;
+    }
+
+    cli_index_free(options.p_index);
+
+    return status;
+}
+
+
+
+// Offsets can be decimal or 0x hex
+static int cli_parse_offset(const char * p_arg, int64_t * p_offset)
+{
+    char * p_end;
+
+    *p_offset = (int64_t)strtoll(p_arg, &p_end, 0);
+
+    if ((p_end == p_arg) || (*p_end != '\0') || (*p_offset < 0)) {
+        fprintf(stderr, "%s: bad offset \"%s\"\n", CLI_NAME, p_arg);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+static int cli_watch(int argc, char ** argv)
+{
+    cli_watch_options options;
+    const char      * p_in;
+    const char      * p_out;
+    char           ** pp_args;
+    int               num_args = 0;
+    int               status = -1;
+    int               c;
+
+    memset(&options, 0, sizeof(options));
+
+    // Take out the offset, the rest is a plain conversion command line
+    if (NULL == (pp_args = malloc((size_t)(argc + 1) * sizeof(char *))))
+        return -1;
+
+    for (c = 0; c < argc; c++) {
+        if (!strcmp(argv[c], "-a") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.offset))
+                goto done;
+        }
+        else
+            pp_args[num_args++] = argv[c];
+    }
+
+    if (0 != cli_parse_convert_args(num_args, pp_args, &options.image_mode, &p_in, &p_out, NULL)) {
+        cli_usage();
+        goto done;
+    }
+
+    status = cli_watch_run(p_in, p_out, &options);
+
+done:
+    free(pp_args);
+
+    return status;
+}
+
+
+
+static int cli_patch(int argc, char ** argv)
+{
+    cli_patch_options options;
+    const char      * p_names[3] = { NULL, NULL, NULL };
+    const char      * p_format = NULL;
+    const char      * p_ext;
+    int               num_names = 0;
+    int               c;
+
+    memset(&options, 0, sizeof(options));
+    options.image_mode = -1;
+
+    for (c = 0; c < argc; c++) {
+        if (!strcmp(argv[c], "-m") && ((c + 1) < argc)) {
+            if (-1 == (options.image_mode = cli_parse_mode(argv[++c]))) {
+                fprintf(stderr, "%s: unknown mode \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[c], "-a") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.offset))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-f") && ((c + 1) < argc))
+            p_format = argv[++c];
+        else if (num_names < 3)
+            p_names[num_names++] = argv[c];
+        else {
+            cli_usage();
+            return -1;
+        }
+    }
+
+    if ((options.image_mode == -1) || (num_names != 3)) {
+        cli_usage();
+        return -1;
+    }
+
+    // Without -f, go by the output extension, IPS if it is neither
+    options.format = ROM_BIN_PATCH_IPS;
+
+    if (p_format) {
+        if (!strcmp(p_format, "bps"))
+            options.format = ROM_BIN_PATCH_BPS;
+        else if (strcmp(p_format, "ips")) {
+            cli_usage();
+            return -1;
+        }
+    }
+    else if ((p_ext = strrchr(p_names[2], '.')) && (!strcmp(p_ext, ".bps") || !strcmp(p_ext, ".BPS")))
+        options.format = ROM_BIN_PATCH_BPS;
+
+    return cli_patch_run(p_names[0], p_names[1], p_names[2], &options);
+}
+
+
+
+static int cli_diff(int argc, char ** argv)
+{
+    cli_diff_options options;
+    const char     * p_names[2] = { NULL, NULL };
+    int              num_names = 0;
+    int              c;
+
+    memset(&options, 0, sizeof(options));
+    options.image_mode = -1;
+
+    for (c = 0; c < argc; c++) {
+        const char * p_option = argv[c];
+
+        if ((p_option[0] != '-') || (p_option[1] == '\0') || (p_option[2] != '\0')) {
+            if (num_names == 2) {
+                cli_usage();
+                return -1;
+            }
+            p_names[num_names++] = p_option;
+            continue;
+        }
+
+        // All options take a value
+        if ((c + 1) >= argc) {
+            cli_usage();
+            return -1;
+        }
+        c++;
+
+        switch (p_option[1]) {
+            case 'm':
+                if (-1 == (options.image_mode = cli_parse_mode(argv[c]))) {
+                    fprintf(stderr, "%s: unknown mode \"%s\"\n", CLI_NAME, argv[c]);
+                    return -1;
+                }
+                break;
+
+            case 'a': if (0 != cli_parse_offset(argv[c], &options.offset_a)) return -1; break;
+            case 'b': if (0 != cli_parse_offset(argv[c], &options.offset_b)) return -1; break;
+            case 'n': if (0 != cli_parse_offset(argv[c], &options.length))   return -1; break;
+            case 'j': options.num_threads = atoi(argv[c]); break;
+            case 'o': options.p_highlight = argv[c];       break;
+
+            default:
+                cli_usage();
+                return -1;
+        }
+    }
+
+    if ((options.image_mode == -1) || (num_names != 2)) {
+        cli_usage();
+        return -1;
+    }
+
+    return cli_diff_run(p_names[0], p_names[1], &options);
+}
+
+
+
+static int cli_find(int argc, char ** argv)
+{
+    cli_find_options options;
+    const char     * p_names[2] = { NULL, NULL };
+    int              num_names = 0;
+    int              c;
+
+    memset(&options, 0, sizeof(options));
+    options.image_mode   = -1;
+    options.max_sites    = CLI_FIND_DEFAULT_SITES;
+    options.max_distance = -1;
+
+    for (c = 0; c < argc; c++) {
+        if (!strcmp(argv[c], "-m") && ((c + 1) < argc)) {
+            if (-1 == (options.image_mode = cli_parse_mode(argv[++c]))) {
+                fprintf(stderr, "%s: unknown mode \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[c], "-j") && ((c + 1) < argc))
+            options.num_threads = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-n") && ((c + 1) < argc))
+            options.max_sites = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-d") && ((c + 1) < argc)) {
+            if ((options.max_distance = atoi(argv[++c])) < 0) {
+                cli_usage();
+                return -1;
+            }
+        }
+        else if (num_names < 2)
+            p_names[num_names++] = argv[c];
+        else {
+            cli_usage();
+            return -1;
+        }
+    }
+
+    if (num_names != 2) {
+        cli_usage();
+        return -1;
+    }
+
+    return cli_find_run(p_names[0], p_names[1], &options);
+}
+
+
+
+static int cli_palettes(int argc, char ** argv)
+{
+    cli_palette_scan_options options;
+    const char             * p_rom = NULL;
+    int                      c;
+
+    memset(&options, 0, sizeof(options));
+    options.format     = -1;
+    options.num_colors = 16;
+    options.max_hits   = CLI_PALETTE_DEFAULT_HITS;
+
+    for (c = 0; c < argc; c++) {
+        if (!strcmp(argv[c], "-f") && ((c + 1) < argc)) {
+            if (-1 == (options.format = rom_bin_palette_format_from_name(argv[++c]))) {
+                fprintf(stderr, "%s: unknown palette format \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[c], "-m") && ((c + 1) < argc)) {
+            int image_mode;
+
+            if (-1 == (image_mode = cli_parse_mode(argv[++c]))) {
+                fprintf(stderr, "%s: unknown mode \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+
+            if (-1 == (options.format = rom_bin_palette_format_for_mode(image_mode))) {
+                fprintf(stderr, "%s: %s has no color palettes\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+
+            options.num_colors = (int)rom_bin_mode_attrib(image_mode)->DECODED_NUM_COLORS;
+        }
+        else if (!strcmp(argv[c], "-c") && ((c + 1) < argc))
+            options.num_colors = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-n") && ((c + 1) < argc))
+            options.max_hits = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-o") && ((c + 1) < argc))
+            options.p_swatches = argv[++c];
+        else if (NULL == p_rom)
+            p_rom = argv[c];
+        else {
+            cli_usage();
+            return -1;
+        }
+    }
+
+    if ((NULL == p_rom) || (options.num_colors < 4) || (options.num_colors > 256) || (options.max_hits < 1)) {
+        cli_usage();
+        return -1;
+    }
+
+    return cli_palette_scan_run(p_rom, &options);
+}
+
+
+
+// "-M" of tilemap: a number is an offset in the rom, anything else a
+// file name with an optional "@offset"
+static int cli_parse_map_source(char * p_arg, cli_tilemap_options * p_options)
+{
+    char * p_end;
+    char * p_at;
+
+    p_options->map_offset = (int64_t)strtoll(p_arg, &p_end, 0);
+    if ((p_end != p_arg) && (*p_end == '\0'))
+        return (p_options->map_offset >= 0) ? 0 : -1;
+
+    p_options->map_offset = 0;
+    p_options->p_map_file = p_arg;
+
+    if (NULL != (p_at = strrchr(p_arg, '@'))) {
+        *p_at = '\0';
+        return cli_parse_offset(p_at + 1, &p_options->map_offset);
+    }
+
+    return 0;
+}
+
+
+
+static int cli_tilemap(int argc, char ** argv)
+{
+    cli_tilemap_options options;
+    const char        * p_names[2] = { NULL, NULL };
+    int                 num_names = 0;
+    int                 have_map = FALSE;
+    int                 c;
+
+    memset(&options, 0, sizeof(options));
+    options.image_mode = -1;
+    options.map_format = -1;
+
+    for (c = 0; c < argc; c++) {
+        if (!strcmp(argv[c], "-m") && ((c + 1) < argc)) {
+            if (-1 == (options.image_mode = cli_parse_mode(argv[++c]))) {
+                fprintf(stderr, "%s: unknown mode \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[c], "-f") && ((c + 1) < argc)) {
+            if (-1 == (options.map_format = cli_tilemap_format_from_name(argv[++c]))) {
+                fprintf(stderr, "%s: unknown tilemap format \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[c], "-M") && ((c + 1) < argc)) {
+            if (0 != cli_parse_map_source(argv[++c], &options))
+                return -1;
+            have_map = TRUE;
+        }
+        else if (!strcmp(argv[c], "-t") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.tiles_offset))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-T") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.tiles_length))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-n") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.num_entries))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-w") && ((c + 1) < argc))
+            options.map_width = (unsigned int)atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-b") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.tile_base))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-p") && ((c + 1) < argc))
+            options.p_palette = argv[++c];
+        else if (!strcmp(argv[c], "-P") && ((c + 1) < argc))
+            options.p_rom_palette = argv[++c];
+        else if (!strcmp(argv[c], "-i"))
+            options.indexed = TRUE;
+        else if (num_names < 2)
+            p_names[num_names++] = argv[c];
+        else {
+            cli_usage();
+            return -1;
+        }
+    }
+
+    if ((num_names != 2) || (options.image_mode == -1) || (options.map_format == -1) || !have_map) {
+        cli_usage();
+        return -1;
+    }
+
+    return cli_tilemap_run(p_names[0], p_names[1], &options);
+}
+
+
+
+static int cli_slice(int argc, char ** argv)
+{
+    cli_slice_options options;
+    const char      * p_names[3] = { NULL, NULL, NULL };
+    int               num_names = 0;
+    int               c;
+
+    memset(&options, 0, sizeof(options));
+    options.image_mode = -1;
+    options.map_format = -1;
+
+    for (c = 0; c < argc; c++) {
+        if (!strcmp(argv[c], "-m") && ((c + 1) < argc)) {
+            if (-1 == (options.image_mode = cli_parse_mode(argv[++c]))) {
+                fprintf(stderr, "%s: unknown mode \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[c], "-f") && ((c + 1) < argc)) {
+            if (-1 == (options.map_format = cli_tilemap_format_from_name(argv[++c]))) {
+                fprintf(stderr, "%s: unknown tilemap format \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[c], "-b") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.tile_base))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-l") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.max_tiles))
+                return -1;
+        }
+        else if (num_names < 3)
+            p_names[num_names++] = argv[c];
+        else {
+            cli_usage();
+            return -1;
+        }
+    }
+
+    if ((num_names != 3) || (options.image_mode == -1) || (options.map_format == -1)) {
+        cli_usage();
+        return -1;
+    }
+
+    return cli_slice_run(p_names[0], p_names[1], p_names[2], &options);
+}
+
+
+
+static int cli_sprites(int argc, char ** argv)
+{
+    cli_sprites_options options;
+    const char        * p_names[2] = { NULL, NULL };
+    int                 num_names = 0;
+    int                 have_table = FALSE;
+    int                 c;
+
+    memset(&options, 0, sizeof(options));
+    options.image_mode  = -1;
+    options.format      = -1;
+    options.num_frames  = 1;
+    options.first_color = -1;
+
+    for (c = 0; c < argc; c++) {
+        if (!strcmp(argv[c], "-m") && ((c + 1) < argc)) {
+            if (-1 == (options.image_mode = cli_parse_mode(argv[++c]))) {
+                fprintf(stderr, "%s: unknown mode \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[c], "-f") && ((c + 1) < argc)) {
+            if (-1 == (options.format = cli_sprites_format_from_name(argv[++c]))) {
+                fprintf(stderr, "%s: unknown sprite format \"%s\"\n", CLI_NAME, argv[c]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[c], "-O") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.table_offset))
+                return -1;
+            have_table = TRUE;
+        }
+        else if (!strcmp(argv[c], "-c") && ((c + 1) < argc))
+            options.num_pieces = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-n") && ((c + 1) < argc))
+            options.num_frames = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-S") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.frame_stride))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-s"))
+            options.tall = TRUE;
+        else if (!strcmp(argv[c], "-t") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.tiles_offset))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-T") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.tiles_length))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-b") && ((c + 1) < argc)) {
+            if (0 != cli_parse_offset(argv[++c], &options.tile_base))
+                return -1;
+        }
+        else if (!strcmp(argv[c], "-C") && ((c + 1) < argc))
+            options.first_color = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-w") && ((c + 1) < argc))
+            options.columns = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-p") && ((c + 1) < argc))
+            options.p_palette = argv[++c];
+        else if (!strcmp(argv[c], "-P") && ((c + 1) < argc))
+            options.p_rom_palette = argv[++c];
+        else if (!strcmp(argv[c], "-i"))
+            options.indexed = TRUE;
+        else if (num_names < 2)
+            p_names[num_names++] = argv[c];
+        else {
+            cli_usage();
+            return -1;
+        }
+    }
+
+    if ((num_names != 2) || (options.image_mode == -1) || (options.format == -1) || !have_table ||
+        (options.num_pieces < 0) || (options.num_frames < 1) || (options.columns < 0) || (options.first_color > 255)) {
+        cli_usage();
+        return -1;
+    }
+
+    return cli_sprites_run(p_names[0], p_names[1], &options);
+}
+
+
+
+static int cli_modes(void)
+{
+    int c;
+
+    for (c = 0; c < BIN_MODE_LAST; c++)
+        printf("%2d  %s\n", c, rom_bin_mode_name(c));
+
+    return 0;
+}
+
+
+
+static int cli_version(void)
+{
+    int version = rom_bin_version();
+
+    printf("librombin %d.%d.%d\n", version / 10000, (version / 100) % 100, version % 100);
+
+    return 0;
+}
+
+
+
+int main(int argc, char ** argv)
+{
+    int status;
+
+    if (argc < 2) {
+        cli_usage();
+        return EXIT_FAILURE;
+    }
+
+    // Command arguments start after the command name
+    if      (!strcmp(argv[1], "decode"))   status = cli_decode(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "encode"))   status = cli_encode(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "batch"))    status = cli_batch(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "extract"))  status = cli_extract(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "watch"))    status = cli_watch(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "patch"))    status = cli_patch(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "diff"))     status = cli_diff(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "find"))     status = cli_find(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "palettes")) status = cli_palettes(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "tilemap"))  status = cli_tilemap(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "slice"))    status = cli_slice(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "sprites"))  status = cli_sprites(argc - 2, argv + 2);
+    else if (!strcmp(argv[1], "modes"))    status = cli_modes();
+    else if (!strcmp(argv[1], "version"))  status = cli_version();
+    else {
+        cli_usage();
+        status = -1;
+    }
+
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
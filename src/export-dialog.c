@@ -37,6 +37,60 @@ struct rom_bin_data {
     int       * image_mode;
 };
 
+// Display names for each image mode
+static const struct {
+    int           image_mode;
+    const gchar * name;
+} image_mode_names[] = {
+    { BIN_MODE_NES_1BPP,      "1bpp NES" },
+    { BIN_MODE_NES_2BPP,      "2bpp NES" },
+    { BIN_MODE_SNESGB_2BPP,   "2bpp SNES/GB" },
+    { BIN_MODE_NGPC_2BPP,     "2bpp NGPC" },
+
+    { BIN_MODE_SNES_3BPP,     "3bpp SNES" },
+
+    { BIN_MODE_GBA_4BPP,      "4bpp GBA" },
+    { BIN_MODE_SNES_4BPP,     "4bpp SNES" },
+    { BIN_MODE_GGSMSWSC_4BPP, "4bpp GG/SMS/WSC" },
+    { BIN_MODE_GENS_4BPP,     "4bpp GEN" },
+
+    { BIN_MODE_GBA_8BPP,      "8bpp GBA" },
+    { BIN_MODE_SNES_8BPP,     "8bpp SNES" }
+};
+
+// Modes offered for each extension hint, in display order
+static const int ext_modes_snes[] = { BIN_MODE_SNESGB_2BPP, BIN_MODE_SNES_3BPP,
+                                      BIN_MODE_SNES_4BPP, BIN_MODE_SNES_8BPP };
+static const int ext_modes_gba[]  = { BIN_MODE_GBA_4BPP, BIN_MODE_GBA_8BPP };
+static const int ext_modes_generic[] = { BIN_MODE_NES_1BPP, BIN_MODE_NES_2BPP,
+                                         BIN_MODE_SNESGB_2BPP, BIN_MODE_NGPC_2BPP,
+                                         BIN_MODE_SNES_3BPP,
+                                         BIN_MODE_GBA_4BPP, BIN_MODE_SNES_4BPP,
+                                         BIN_MODE_GGSMSWSC_4BPP, BIN_MODE_GENS_4BPP,
+                                         BIN_MODE_GBA_8BPP, BIN_MODE_SNES_8BPP };
+
+static const gchar * image_mode_to_name(int image_mode)
+{
+    guint c;
+
+    for (c = 0; c < G_N_ELEMENTS(image_mode_names); c++)
+        if (image_mode_names[c].image_mode == image_mode)
+            return image_mode_names[c].name;
+
+    return NULL;
+}
+
+static int image_mode_from_name(const gchar * name)
+{
+    guint c;
+
+    for (c = 0; c < G_N_ELEMENTS(image_mode_names); c++)
+        if (!(g_strcmp0(name, image_mode_names[c].name)))
+            return image_mode_names[c].image_mode;
+
+    return -1;
+}
+
 void on_response(GtkDialog *, gint, gpointer);
 
 void on_response(GtkDialog * dialog,
@@ -52,38 +106,8 @@ void on_response(GtkDialog * dialog,
     gchar *string = gtk_combo_box_text_get_active_text( GTK_COMBO_BOX_TEXT(image_mode_combo) );
 
     // TODO: Using the dialog on import is disabled for now- remove support for import prompting?
-    // TODO: convert strings to centralized definition
     // Match the string up to an output mode
-    if (!(g_strcmp0(string, "1bpp NES")))
-        *(data->image_mode) = BIN_MODE_NES_1BPP;
-    else if (!(g_strcmp0(string, "2bpp NES")))
-        *(data->image_mode) = BIN_MODE_NES_2BPP;
-    else if (!(g_strcmp0(string, "2bpp SNES/GB")))
-        *(data->image_mode) = BIN_MODE_SNESGB_2BPP;
-    else if (!(g_strcmp0(string, "2bpp NGPC")))
-        *(data->image_mode) = BIN_MODE_NGPC_2BPP;
-
-    else if (!(g_strcmp0(string, "3bpp SNES")))
-        *(data->image_mode) = BIN_MODE_SNES_3BPP;
-
-
-    else if (!(g_strcmp0(string, "4bpp GBA")))
-        *(data->image_mode) = BIN_MODE_GBA_4BPP;
-    else if (!(g_strcmp0(string, "4bpp SNES")))
-        *(data->image_mode) = BIN_MODE_SNES_4BPP;
-    else if (!(g_strcmp0(string, "4bpp GG/SMS/WSC")))
-        *(data->image_mode) = BIN_MODE_GGSMSWSC_4BPP;
-    else if (!(g_strcmp0(string, "4bpp GEN")))
-        *(data->image_mode) = BIN_MODE_GENS_4BPP;
-
-    else if (!(g_strcmp0(string, "8bpp GBA")))
-        *(data->image_mode) = BIN_MODE_GBA_8BPP;
-    else if (!(g_strcmp0(string, "8bpp SNES")))
-        *(data->image_mode) = BIN_MODE_SNES_8BPP;
-    else
-        *(data->image_mode) = -1; //
-
-    g_print( "Selected: >> %s <<\n", ( string ? string : "NULL" ) );
+    *(data->image_mode) = image_mode_from_name(string);
 
     // Free string
     g_free( string );
@@ -106,6 +130,10 @@ int import_export_dialog(int * image_mode, const gchar * name, int ext_mode)
 
     GtkWidget * image_mode_combo;
 
+    const int * p_modes;
+    guint       num_modes;
+    guint       c;
+    gint        active = 0;
 
     // Create the export dialog
 
@@ -155,38 +183,30 @@ int import_export_dialog(int * image_mode, const gchar * name, int ext_mode)
     image_mode_combo = gtk_combo_box_text_new();
 
     // Add the mode select entries
-    // TODO: convert strings to centralized definition
     if (ext_mode == BIN_EXT_MODE_SNES) {
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "2bpp SNES/GB");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "3bpp SNES");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "4bpp SNES");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "8bpp SNES");
+        p_modes   = ext_modes_snes;
+        num_modes = G_N_ELEMENTS(ext_modes_snes);
     }
     else if (ext_mode == BIN_EXT_MODE_GBA) {
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "4bpp GBA");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "8bpp GBA");
+        p_modes   = ext_modes_gba;
+        num_modes = G_N_ELEMENTS(ext_modes_gba);
     }
     else {
         // Implied: BIN_EXT_MODE_GENERIC
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "1bpp NES");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "2bpp NES");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "2bpp SNES/GB");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "2bpp NGPC");
-
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "3bpp SNES");
-
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "4bpp GBA");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "4bpp SNES");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "4bpp GG/SMS/WSC");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "4bpp GEN");
-
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "8bpp GBA");
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo), "8bpp SNES");
+        p_modes   = ext_modes_generic;
+        num_modes = G_N_ELEMENTS(ext_modes_generic);
     }
 
-    // Select default value
+    // Select the incoming mode (last used) if it's offered, otherwise the first one
     // TODO: try to auto-detect image mode based on number of colors? (export only)
-    gtk_combo_box_set_active(GTK_COMBO_BOX(image_mode_combo), 0);
+    for (c = 0; c < num_modes; c++) {
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(image_mode_combo),
+                                       image_mode_to_name(p_modes[c]));
+        if (p_modes[c] == *image_mode)
+            active = c;
+    }
+
+    gtk_combo_box_set_active(GTK_COMBO_BOX(image_mode_combo), active);
 
     // Add it to the box for display and show it
     gtk_box_pack_start(GTK_BOX(vbox), image_mode_combo, FALSE, FALSE, 6);
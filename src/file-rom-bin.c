@@ -26,6 +26,7 @@
 #include "lib_rom_bin.h"
 #include "read-rom-bin.h"
 #include "write-rom-bin.h"
+#include "batch-rom-bin.h"
 #include "export-dialog.h"
 
 const char LOAD_PROCEDURE[]                 = "file-rom-bin-load";
@@ -35,6 +36,10 @@ const char LOAD_PROCEDURE_GGSMS4BPP_GGSMS[] = "file-bin-bin-load-ggsms4bpp-ggsms
 const char LOAD_PROCEDURE_SNES[]            = "file-bin-bin-load-snes";
 const char LOAD_PROCEDURE_GBA[]             = "file-bin-bin-load-gba";
 
+// Same as LOAD_PROCEDURE with the image mode as an argument, for scripts.
+// Kept apart since GIMP fills missing arguments with 0 (a valid mode)
+const char LOAD_MODE_PROCEDURE[]            = "file-rom-bin-load-mode";
+
 const char SAVE_PROCEDURE[]                 = "file-rom-bin-save";
 const char SAVE_PROCEDURE_NES2BPP_CHRNES[]  = "file-rom-bin-save-nes2bpp-chrnes";
 const char SAVE_PROCEDURE_GB2BPP_GB[]       = "file-rom-bin-save-gb2bpp-gb";
@@ -42,11 +47,20 @@ const char SAVE_PROCEDURE_GGSMS4BPP_GGSMS[] = "file-bin-bin-save-ggsms4bpp-ggsms
 const char SAVE_PROCEDURE_SNES[]            = "file-bin-bin-save-snes";
 const char SAVE_PROCEDURE_GBA[]             = "file-bin-bin-save-gba";
 
+const char BATCH_LOAD_PROCEDURE[]           = "file-rom-bin-batch-load";
+const char BATCH_EXPORT_PROCEDURE[]         = "file-rom-bin-batch-export";
+
+// Resident mode: an extension that stays running and serves
+// temporary procedures, so repeated calls skip the process startup
+const char RESIDENT_PROCEDURE[]             = "extension-rom-bin-resident";
+const char RESIDENT_ENV_VAR[]               = "ROM_BIN_RESIDENT";
+
 const char BINARY_NAME[]    = "file-rom-bin";
 
 // Predeclare our entrypoints
 static void query(void);
 static void run(const gchar *, gint, const GimpParam *, gint *, GimpParam **);
+static void run_resident_proc(const gchar *, gint, const GimpParam *, gint *, GimpParam **);
 
 // Declare our plugin entry points
 GimpPlugInInfo PLUG_IN_INFO = {
@@ -58,34 +72,124 @@ GimpPlugInInfo PLUG_IN_INFO = {
 
 MAIN()
 
-// The query function
-static void query(void)
+// Image mode last used by a procedure, or the default if there isn't a valid one
+static int get_last_image_mode(const gchar * name, int default_mode)
 {
-    // Load arguments
-    static const GimpParamDef load_arguments[] =
-    {
-        { GIMP_PDB_INT32,  "run-mode",     "Interactive, non-interactive" },
-        { GIMP_PDB_STRING, "filename",     "The name of the file to load" },
-        { GIMP_PDB_STRING, "raw-filename", "The name entered" }
-    };
+    gint32 image_mode;
+
+    if (gimp_get_data_size(name) == sizeof(image_mode)) {
+        gimp_get_data(name, &image_mode);
+
+        if ((image_mode >= 0) && (image_mode < BIN_MODE_LAST))
+            return image_mode;
+    }
+
+    return default_mode;
+}
+
+// Remembered per procedure so .sfc, .gba and .bin each keep their own
+static void set_last_image_mode(const gchar * name, int image_mode)
+{
+    gint32 last_mode = image_mode;
+
+    gimp_set_data(name, &last_mode, sizeof(last_mode));
+}
+
+// Load arguments
+static const GimpParamDef load_arguments[] =
+{
+    { GIMP_PDB_INT32,  "run-mode",     "Interactive, non-interactive" },
+    { GIMP_PDB_STRING, "filename",     "The name of the file to load" },
+    { GIMP_PDB_STRING, "raw-filename", "The name entered" }
+};
+
+// Load with a mode arguments
+static const GimpParamDef load_mode_arguments[] =
+{
+    { GIMP_PDB_INT32,  "run-mode",     "Interactive, non-interactive" },
+    { GIMP_PDB_STRING, "filename",     "The name of the file to load" },
+    { GIMP_PDB_STRING, "raw-filename", "The name entered" },
+    { GIMP_PDB_INT32,  "image-mode",   "ROM image format (non-interactive, -1 uses the last one)" }
+};
+
+// Load return values
+static const GimpParamDef load_return_values[] =
+{
+    { GIMP_PDB_IMAGE, "image", "Output image" }
+};
+
+// Save arguments
+static const GimpParamDef save_arguments[] =
+{
+    { GIMP_PDB_INT32,    "run-mode",     "Interactive, non-interactive" },
+    { GIMP_PDB_IMAGE,    "image",        "Input image" },
+    { GIMP_PDB_DRAWABLE, "drawable",     "Drawable to save" },
+    { GIMP_PDB_STRING,   "filename",     "The name of the file to save the image in" },
+    { GIMP_PDB_STRING,   "raw-filename", "The name entered" },
+    { GIMP_PDB_FLOAT,    "image_mode",  "ROM image format (used for non-interactive runs)" }
+};
+
+// Batch load arguments
+static const GimpParamDef batch_load_arguments[] =
+{
+    { GIMP_PDB_INT32,      "run-mode",    "Non-interactive only" },
+    { GIMP_PDB_STRING,     "filenames",   "Newline separated files to load, may use * and ? patterns" },
+    { GIMP_PDB_INT32,      "num-modes",   "Number of image modes (1 applies to every file)" },
+    { GIMP_PDB_INT32ARRAY, "image-modes", "ROM image format per file" }
+};
+
+// Batch load return values
+static const GimpParamDef batch_load_return_values[] =
+{
+    { GIMP_PDB_INT32,      "num-images",  "Number of files matched" },
+    { GIMP_PDB_INT32ARRAY, "images",      "Output image per file, -1 if it failed to load" }
+};
+
+// Batch export arguments
+static const GimpParamDef batch_export_arguments[] =
+{
+    { GIMP_PDB_INT32,      "run-mode",    "Non-interactive only" },
+    { GIMP_PDB_INT32,      "num-images",  "Number of images" },
+    { GIMP_PDB_INT32ARRAY, "images",      "Input images, the active drawable of each is saved" },
+    { GIMP_PDB_STRING,     "filenames",   "Newline separated file per image, or an output directory" },
+    { GIMP_PDB_INT32,      "num-modes",   "Number of image modes (1 applies to every image)" },
+    { GIMP_PDB_INT32ARRAY, "image-modes", "ROM image format per image" }
+};
+
+
+
+// Temporary procedures served in resident mode and the
+// regular procedure each one runs
+static const struct {
+    const char         * temp_name;
+    const char         * name;
+    const GimpParamDef * p_args;
+    gint                 num_args;
+    const GimpParamDef * p_return_vals;
+    gint                 num_return_vals;
+} resident_procs[] = {
+    { "file-rom-bin-resident-load",         LOAD_PROCEDURE,
+      load_arguments,         G_N_ELEMENTS(load_arguments),
+      load_return_values,     G_N_ELEMENTS(load_return_values) },
+    { "file-rom-bin-resident-load-mode",    LOAD_MODE_PROCEDURE,
+      load_mode_arguments,    G_N_ELEMENTS(load_mode_arguments),
+      load_return_values,     G_N_ELEMENTS(load_return_values) },
+    { "file-rom-bin-resident-save",         SAVE_PROCEDURE,
+      save_arguments,         G_N_ELEMENTS(save_arguments),
+      NULL,                   0 },
+    { "file-rom-bin-resident-batch-load",   BATCH_LOAD_PROCEDURE,
+      batch_load_arguments,   G_N_ELEMENTS(batch_load_arguments),
+      batch_load_return_values, G_N_ELEMENTS(batch_load_return_values) },
+    { "file-rom-bin-resident-batch-export", BATCH_EXPORT_PROCEDURE,
+      batch_export_arguments, G_N_ELEMENTS(batch_export_arguments),
+      NULL,                   0 }
+};
 
-    // Load return values
-    static const GimpParamDef load_return_values[] =
-    {
-        { GIMP_PDB_IMAGE, "image", "Output image" }
-    };
 
-    // Save arguments
-    static const GimpParamDef save_arguments[] =
-    {
-        { GIMP_PDB_INT32,    "run-mode",     "Interactive, non-interactive" },
-        { GIMP_PDB_IMAGE,    "image",        "Input image" },
-        { GIMP_PDB_DRAWABLE, "drawable",     "Drawable to save" },
-        { GIMP_PDB_STRING,   "filename",     "The name of the file to save the image in" },
-        { GIMP_PDB_STRING,   "raw-filename", "The name entered" },
-        { GIMP_PDB_FLOAT,    "image_mode",  "ROM image format" }
-    };
 
+// The query function
+static void query(void)
+{
     // Install the load procedure for ".bin" files
     gimp_install_procedure(LOAD_PROCEDURE,
                            "Loads images in the ROM bin file format",
@@ -101,6 +205,21 @@ static void query(void)
                            load_arguments,
                            load_return_values);
 
+    // Install the load procedure that takes the image mode (not a file handler)
+    gimp_install_procedure(LOAD_MODE_PROCEDURE,
+                           "Loads images in the ROM bin file format with a given image mode",
+                           "Loads images in the ROM bin file format, decoded in the image mode given (-1 for the last one used)",
+                           "--",
+                           "Copyright --",
+                           "2018",
+                           NULL,
+                           NULL,
+                           GIMP_PLUGIN,
+                           G_N_ELEMENTS(load_mode_arguments),
+                           G_N_ELEMENTS(load_return_values),
+                           load_mode_arguments,
+                           load_return_values);
+
     // Install the load procedure for ".chr" files (only NES chr 2bpp)
     gimp_install_procedure(LOAD_PROCEDURE_NES2BPP_CHRNES,
                            "Loads images in the NES .chr and .nes 2-bpp file format",
@@ -262,6 +381,54 @@ static void query(void)
                            save_arguments,
                            NULL);
 
+    // End SAVE, Begin BATCH
+
+    // Loads many files in one plug-in run (Script-Fu etc)
+    gimp_install_procedure(BATCH_LOAD_PROCEDURE,
+                           "Loads many files in the ROM bin image format",
+                           "Loads a list of files (or * ? patterns) in the ROM bin image format in one call, decoding them in parallel",
+                           "--",
+                           "Copyright --",
+                           "2018",
+                           NULL,
+                           NULL,
+                           GIMP_PLUGIN,
+                           G_N_ELEMENTS(batch_load_arguments),
+                           G_N_ELEMENTS(batch_load_return_values),
+                           batch_load_arguments,
+                           batch_load_return_values);
+
+    // Exports many images in one plug-in run (Script-Fu etc)
+    gimp_install_procedure(BATCH_EXPORT_PROCEDURE,
+                           "Saves many images in the ROM bin image format",
+                           "Saves a list of INDEXED images in the ROM bin image format in one call, encoding them in parallel",
+                           "--",
+                           "Copyright --",
+                           "2018",
+                           NULL,
+                           NULL,
+                           GIMP_PLUGIN,
+                           G_N_ELEMENTS(batch_export_arguments),
+                           0,
+                           batch_export_arguments,
+                           NULL);
+
+    // End BATCH, Begin RESIDENT
+
+    // Zero argument extensions get started along with GIMP.
+    // It exits right away unless resident mode is enabled
+    gimp_install_procedure(RESIDENT_PROCEDURE,
+                           "Keeps the ROM bin plug-in resident",
+                           "When ROM_BIN_RESIDENT is set in the environment this stays running and serves the file-rom-bin-resident-* procedures, avoiding a plug-in startup per call",
+                           "--",
+                           "Copyright --",
+                           "2018",
+                           NULL,
+                           NULL,
+                           GIMP_EXTENSION,
+                           0, 0,
+                           NULL, NULL);
+
 
     // Register the load handlers
     gimp_register_load_handler(LOAD_PROCEDURE, "bin", "");
@@ -287,6 +454,58 @@ static void query(void)
     //gimp_register_file_handler_mime(SAVE_PROCEDURE_NES2BPP_CHRNES, "image/chr");
 }
 
+// Serves the temporary procedures until GIMP quits
+static void run_resident(void)
+{
+    guint c;
+
+    // Opt-in only, otherwise don't keep a process around
+    if (g_getenv(RESIDENT_ENV_VAR) == NULL)
+        return;
+
+    for (c = 0; c < G_N_ELEMENTS(resident_procs); c++)
+        gimp_install_temp_proc(resident_procs[c].temp_name,
+                               "Resident version of the ROM bin procedure of the same name",
+                               "Same arguments and results, served without starting a new plug-in process",
+                               "--",
+                               "Copyright --",
+                               "2018",
+                               NULL,
+                               NULL,
+                               GIMP_TEMPORARY,
+                               resident_procs[c].num_args,
+                               resident_procs[c].num_return_vals,
+                               resident_procs[c].p_args,
+                               resident_procs[c].p_return_vals,
+                               run_resident_proc);
+
+    // Let GIMP continue, then handle calls as they come in
+    gimp_extension_ack();
+
+    while (TRUE)
+        gimp_extension_process(0);
+}
+
+// Runs the regular procedure for a resident one
+static void run_resident_proc(const gchar * name,
+         gint nparams,
+         const GimpParam * param,
+         gint * nreturn_vals,
+         GimpParam ** return_vals)
+{
+    guint c;
+
+    for (c = 0; c < G_N_ELEMENTS(resident_procs); c++) {
+        if (!strcmp(name, resident_procs[c].temp_name)) {
+            run(resident_procs[c].name, nparams, param, nreturn_vals, return_vals);
+            return;
+        }
+    }
+
+    // Unknown name, let run() report the calling error
+    run(name, nparams, param, nreturn_vals, return_vals);
+}
+
 // The run function
 static void run(const gchar * name,
          gint nparams,
@@ -295,20 +514,33 @@ static void run(const gchar * name,
          GimpParam ** return_vals)
 {
     // Create the return value.
-    static GimpParam return_values[2];
+    static GimpParam return_values[3];
     *nreturn_vals = 1;
     *return_vals  = return_values;
 
     GimpRunMode   run_mode;
-    run_mode      = param[0].data.d_int32;
 
     // Set the return value to success by default
     return_values[0].type          = GIMP_PDB_STATUS;
     return_values[0].data.d_status = GIMP_PDB_SUCCESS;
 
+    // The resident extension takes no arguments (not even run-mode)
+    if (!strcmp(name, RESIDENT_PROCEDURE)) {
+        run_resident();
+        return;
+    }
+
+    run_mode      = param[0].data.d_int32;
+
+#if GIMP_CHECK_VERSION(2,10,0)
+    // Pixel transfers go through GeglBuffers
+    gegl_init(NULL, NULL);
+#endif
+
 
     // Check to see if this is the load procedure
     if( !strcmp(name, LOAD_PROCEDURE) ||
+        !strcmp(name, LOAD_MODE_PROCEDURE) ||
         !strcmp(name, LOAD_PROCEDURE_NES2BPP_CHRNES) ||
         !strcmp(name, LOAD_PROCEDURE_GB2BPP_GB) ||
         !strcmp(name, LOAD_PROCEDURE_GGSMS4BPP_GGSMS) ||
@@ -317,18 +549,18 @@ static void run(const gchar * name,
     {
         int new_image_id;
         int image_mode = -1;
+        int load_mode  = !strcmp(name, LOAD_MODE_PROCEDURE);
+
+        // The mode procedure shares its last used mode with the .bin loader
+        const gchar * last_name = (load_mode) ? LOAD_PROCEDURE : name;
 
         // Check to make sure all parameters were supplied
-        if(nparams != 3) {
+        if(nparams != ((load_mode) ? 4 : 3)) {
             return_values[0].data.d_status = GIMP_PDB_CALLING_ERROR;
             return;
         }
 
 
-        // Try to export the image
-        gimp_ui_init(BINARY_NAME, FALSE);
-
-
         // Determine image file format, by load type or user dialog
         // * .chr and .nes files auto-default to NES 2bpp,
         // * .gb files auto-default to SNESGB 2bpp,
@@ -349,21 +581,31 @@ static void run(const gchar * name,
             if      (!strcmp(name, LOAD_PROCEDURE_SNES)) ext_mode = BIN_EXT_MODE_SNES;
             else if (!strcmp(name, LOAD_PROCEDURE_GBA))  ext_mode = BIN_EXT_MODE_GBA;
 
+            // Start from the last used mode, default to SNES 4bpp
+            image_mode = get_last_image_mode(last_name, BIN_MODE_SNES_4BPP);
+
             // Only show settings dialog during interactive mode
             // - Thumbnail preview creation happens in GIMP_RUN_NONINTERACTIVE mode
-            // - TODO: GIMP_RUN_WITH_LAST_VALS
             if (GIMP_RUN_INTERACTIVE == run_mode) {
 
+                gimp_ui_init(BINARY_NAME, FALSE);
+
                 // Show the import/export dialog
                 if(!import_export_dialog(&image_mode, name, ext_mode)) {
                     return_values[0].data.d_status = GIMP_PDB_CANCEL;
                     return;
                 }
             }
-            else if (GIMP_RUN_NONINTERACTIVE == run_mode) {
+            else if ((GIMP_RUN_NONINTERACTIVE == run_mode) && load_mode) {
 
-                // Default to SNES 4bpp for non-interactive mode
-                image_mode = BIN_MODE_SNES_4BPP;
+                // Use the requested mode, -1 keeps the last one
+                if (param[3].data.d_int32 != -1)
+                    image_mode = param[3].data.d_int32;
+
+                if ((image_mode < 0) || (image_mode >= BIN_MODE_LAST)) {
+                    return_values[0].data.d_status = GIMP_PDB_CALLING_ERROR;
+                    return;
+                }
             }
         }
 
@@ -378,6 +620,9 @@ static void run(const gchar * name,
             return;
         }
 
+        if (GIMP_RUN_NONINTERACTIVE != run_mode)
+            set_last_image_mode(last_name, image_mode);
+
         // Fill in the second return value
         *nreturn_vals = 2;
 
@@ -396,7 +641,7 @@ static void run(const gchar * name,
         gint32 image_id, drawable_id;
         int status = 1;
         int image_mode = -1;
-        GimpExportReturn export_ret;
+        GimpExportReturn export_ret = GIMP_EXPORT_IGNORE;
 
         // Check to make sure all of the parameters were supplied
         if(nparams != 6)
@@ -408,58 +653,139 @@ static void run(const gchar * name,
         image_id    = param[1].data.d_int32;
         drawable_id = param[2].data.d_int32;
 
-        // Try to export the image
-        gimp_ui_init(BINARY_NAME, FALSE);
-        export_ret = gimp_export_image(&image_id,
-                                       &drawable_id,
-                                       "BIN",
-                                       GIMP_EXPORT_CAN_HANDLE_INDEXED |
-                                       GIMP_EXPORT_CAN_HANDLE_ALPHA);
+        // Only call the export dialog if it is "bin" and not NES 2bpp ".chr" mode
+        if(!strcmp(name, SAVE_PROCEDURE_NES2BPP_CHRNES))
+            image_mode = BIN_MODE_NES_2BPP;
+        else if(!strcmp(name, SAVE_PROCEDURE_GB2BPP_GB))
+            image_mode = BIN_MODE_SNESGB_2BPP;
+        else if(!strcmp(name, SAVE_PROCEDURE_GGSMS4BPP_GGSMS))
+            image_mode = BIN_MODE_GGSMSWSC_4BPP;
+        else if (GIMP_RUN_NONINTERACTIVE == run_mode)
+            image_mode = (int)param[5].data.d_float;
+        else
+            image_mode = get_last_image_mode(name, -1);
+
+        // Non-interactive callers hand over a ready (INDEXED) drawable,
+        // so skip the UI and the export conversion entirely
+        if (GIMP_RUN_NONINTERACTIVE != run_mode) {
+
+            // Try to export the image
+            gimp_ui_init(BINARY_NAME, FALSE);
+            export_ret = gimp_export_image(&image_id,
+                                           &drawable_id,
+                                           "BIN",
+                                           GIMP_EXPORT_CAN_HANDLE_INDEXED |
+                                           GIMP_EXPORT_CAN_HANDLE_ALPHA);
+
+            if (export_ret == GIMP_EXPORT_CANCEL) {
+                return_values[0].data.d_status = GIMP_PDB_CANCEL;
+                return;
+            }
+        }
 
-        switch(export_ret)
-        {
-            case GIMP_EXPORT_EXPORT:
-            case GIMP_EXPORT_IGNORE:
-
-                // Only call the export dialog if it is "bin" and not NES 2bpp ".chr" mode
-              if(!strcmp(name, SAVE_PROCEDURE_NES2BPP_CHRNES)) {
-                image_mode = BIN_MODE_NES_2BPP;
-              }
-              else if(!strcmp(name, SAVE_PROCEDURE_GB2BPP_GB)) {
-                image_mode = BIN_MODE_SNESGB_2BPP;
-              }
-              else if(!strcmp(name, SAVE_PROCEDURE_GGSMS4BPP_GGSMS)) {
-                image_mode = BIN_MODE_GGSMSWSC_4BPP;
-              }
-              else {
-                int ext_mode = BIN_EXT_MODE_GENERIC;
-
-                // SNES/GBA have multiple formats. Instead of forcing one, pass a hint to filter the dialog
-                if      (!strcmp(name, SAVE_PROCEDURE_SNES)) ext_mode = BIN_EXT_MODE_SNES;
-                else if (!strcmp(name, SAVE_PROCEDURE_GBA))  ext_mode = BIN_EXT_MODE_GBA;
-
-                // Now get the settings
-                if(!import_export_dialog(&image_mode, name, ext_mode))
-                {
-                    return_values[0].data.d_status = GIMP_PDB_CANCEL;
-                    return;
-                }
-              }
+        // Ask for the mode when it's not fixed by the extension,
+        // or when there is no last value to reuse
+        if ((GIMP_RUN_INTERACTIVE == run_mode) ||
+            ((GIMP_RUN_WITH_LAST_VALS == run_mode) && (image_mode == -1))) {
+
+            int ext_mode = BIN_EXT_MODE_GENERIC;
 
-                status = write_rom_bin(param[3].data.d_string,
-                                       image_id, drawable_id, image_mode);
-                gimp_image_delete(image_id);
+            if(!strcmp(name, SAVE_PROCEDURE_NES2BPP_CHRNES) ||
+               !strcmp(name, SAVE_PROCEDURE_GB2BPP_GB) ||
+               !strcmp(name, SAVE_PROCEDURE_GGSMS4BPP_GGSMS))
+                ext_mode = -1;
+
+            // SNES/GBA have multiple formats. Instead of forcing one, pass a hint to filter the dialog
+            else if (!strcmp(name, SAVE_PROCEDURE_SNES)) ext_mode = BIN_EXT_MODE_SNES;
+            else if (!strcmp(name, SAVE_PROCEDURE_GBA))  ext_mode = BIN_EXT_MODE_GBA;
 
-                break;
+            // Now get the settings
+            if((ext_mode != -1) &&
+               !import_export_dialog(&image_mode, name, ext_mode))
+            {
+                if (export_ret == GIMP_EXPORT_EXPORT)
+                    gimp_image_delete(image_id);
 
-            case GIMP_EXPORT_CANCEL:
                 return_values[0].data.d_status = GIMP_PDB_CANCEL;
                 return;
+            }
         }
 
+        if ((image_mode < 0) || (image_mode >= BIN_MODE_LAST))
+            status = 0;
+        else
+            status = write_rom_bin(param[3].data.d_string,
+                                   image_id, drawable_id, image_mode);
+
+        // Only delete the temporary copy made by the export, never the caller's image
+        if (export_ret == GIMP_EXPORT_EXPORT)
+            gimp_image_delete(image_id);
+
+        if (status && (GIMP_RUN_NONINTERACTIVE != run_mode))
+            set_last_image_mode(name, image_mode);
+
         if(!status)
             return_values[0].data.d_status = GIMP_PDB_EXECUTION_ERROR;
     }
+    else if(!strcmp(name, BATCH_LOAD_PROCEDURE))
+    {
+        gchar ** p_filenames;
+        gint32 * p_images;
+        int num_files;
+
+        // Check to make sure all parameters were supplied
+        if(nparams != 4) {
+            return_values[0].data.d_status = GIMP_PDB_CALLING_ERROR;
+            return;
+        }
+
+        p_filenames = batch_rom_bin_expand_filenames(param[1].data.d_string);
+        num_files   = g_strv_length(p_filenames);
+
+        // One mode for every file, or one per file
+        if ((param[2].data.d_int32 != 1) && (param[2].data.d_int32 != num_files)) {
+            g_strfreev(p_filenames);
+            return_values[0].data.d_status = GIMP_PDB_CALLING_ERROR;
+            return;
+        }
+
+        // Returned to the caller, so it outlives this call
+        p_images = g_new(gint32, (num_files > 0) ? num_files : 1);
+
+        // Failures are reported per file as -1 in the image list
+        batch_rom_bin_load(p_filenames,
+                           param[3].data.d_int32array, param[2].data.d_int32,
+                           p_images);
+
+        g_strfreev(p_filenames);
+
+        *nreturn_vals = 3;
+
+        return_values[1].type         = GIMP_PDB_INT32;
+        return_values[1].data.d_int32 = num_files;
+
+        return_values[2].type              = GIMP_PDB_INT32ARRAY;
+        return_values[2].data.d_int32array = p_images;
+    }
+    else if(!strcmp(name, BATCH_EXPORT_PROCEDURE))
+    {
+        // Check to make sure all parameters were supplied
+        if(nparams != 6) {
+            return_values[0].data.d_status = GIMP_PDB_CALLING_ERROR;
+            return;
+        }
+
+        // One mode for every image, or one per image
+        if ((param[4].data.d_int32 != 1) && (param[4].data.d_int32 != param[1].data.d_int32)) {
+            return_values[0].data.d_status = GIMP_PDB_CALLING_ERROR;
+            return;
+        }
+
+        if(0 != batch_rom_bin_export(param[2].data.d_int32array, param[1].data.d_int32,
+                                     param[3].data.d_string,
+                                     param[5].data.d_int32array, param[4].data.d_int32))
+            return_values[0].data.d_status = GIMP_PDB_EXECUTION_ERROR;
+    }
     else
         return_values[0].data.d_status = GIMP_PDB_CALLING_ERROR;
 }
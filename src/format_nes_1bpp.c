@@ -26,7 +26,6 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <libgimp/gimp.h>
 
 #define NES_PIXELS_PER_BYTE_1BPP           8    // 1 pixel = 1 bits, 8 pixels are spread across 1 bytes
 
@@ -88,8 +87,12 @@ static int bin_decode_image(rom_gfx_data * p_rom_gfx,
 {
     unsigned char pixdata;
     unsigned char * p_image_pixel;
-    long int      rom_offset;
-    long int      tile_size_in_bytes;
+    unsigned char * p_image_row;
+    unsigned char * p_tile_row;
+    int64_t       row_stride;
+    int64_t       pixel_stride;
+    int64_t       rom_offset;
+    int64_t       tile_size_in_bytes;
     unsigned char rom_ended;
 
     int x,y,ty,b;
@@ -107,13 +110,22 @@ static int bin_decode_image(rom_gfx_data * p_rom_gfx,
 
     // Set the output buffer at the start
     rom_offset = 0;
+    row_stride   = rom_bin_img_calc_appimg_row_stride(p_app_gfx);
+    pixel_stride = rom_bin_img_calc_appimg_pixel_stride(p_app_gfx);
     rom_ended = FALSE;
     tile_size_in_bytes = ((rom_attrib.TILE_PIXEL_WIDTH * rom_attrib.TILE_PIXEL_HEIGHT) / (8 / rom_attrib.BITS_PER_PIXEL));
 
     for (y=0; y < (p_app_gfx->height / rom_attrib.TILE_PIXEL_HEIGHT); y++) {
+
+        // Start of this row of tiles in the image buffer
+        p_tile_row = p_app_gfx->p_data + (y * rom_attrib.TILE_PIXEL_HEIGHT * row_stride);
+
         // Decode left-to-right
         for (x=0; x < (p_app_gfx->width / rom_attrib.TILE_PIXEL_WIDTH); x++) {
 
+            // Top-left pixel of the tile, each row below it is row_stride further
+            p_image_row = p_tile_row + (x * rom_attrib.TILE_PIXEL_WIDTH * pixel_stride);
+
             // Set a flag if there isn't enough rom image data left
             // to read a complete tile. This can happen if the number
             // of tiles and their size isn't an even multiple of the
@@ -133,7 +145,8 @@ static int bin_decode_image(rom_gfx_data * p_rom_gfx,
             for (ty=0; ty < rom_attrib.TILE_PIXEL_HEIGHT; ty++) {
 
                 // Set up the pointer to the pixel in the destination image buffer
-                p_image_pixel = romimg_calc_appimg_offset(x, y, ty, p_app_gfx, rom_attrib);
+                p_image_pixel = p_image_row;
+                p_image_row  += row_stride;
 
                 if (!rom_ended) {
                     // Read one byte and unpack the 8 horizontal pixels
@@ -143,10 +156,10 @@ static int bin_decode_image(rom_gfx_data * p_rom_gfx,
                 // Unpack the 8 horizontal pixels
                 for (b=0;b < NES_PIXELS_PER_BYTE_1BPP; b++) {
                     // pixel[0].n = b.0, pixel[1].n = b.1
-                  romimg_set_decoded_pixel_and_advance(&p_image_pixel,
-                                                         (pixdata >> 7) & 0x01,
-                                                         rom_ended,
-                                                         p_app_gfx);
+                  rom_bin_img_set_decoded_pixel_and_advance(&p_image_pixel,
+                                                              (pixdata >> 7) & 0x01,
+                                                              rom_ended,
+                                                              p_app_gfx);
 
                     // Upshift bits to prepare for the next pixel
                     pixdata <<= 1;
@@ -169,10 +182,14 @@ static int bin_encode_image(rom_gfx_data * p_rom_gfx,
 {
     unsigned char pixdata;
     unsigned char * p_image_pixel;
-    long int      rom_offset;
+    unsigned char * p_image_row;
+    unsigned char * p_tile_row;
+    int64_t       row_stride;
+    int64_t       pixel_stride;
+    int64_t       rom_offset;
     unsigned int  transparency_flag;
     unsigned int  empty_tile_count;
-    long int tile_size_bytes;
+    int64_t tile_size_bytes;
 
     int x,y,ty,b;
 
@@ -189,12 +206,21 @@ static int bin_encode_image(rom_gfx_data * p_rom_gfx,
 
     // Set the output buffer at the start
     rom_offset = 0;
+    row_stride   = rom_bin_img_calc_appimg_row_stride(p_app_gfx);
+    pixel_stride = rom_bin_img_calc_appimg_pixel_stride(p_app_gfx);
     empty_tile_count = 0;
 
     for (y=0; y < (p_app_gfx->height / rom_attrib.TILE_PIXEL_HEIGHT); y++) {
+
+        // Start of this row of tiles in the image buffer
+        p_tile_row = p_app_gfx->p_data + (y * rom_attrib.TILE_PIXEL_HEIGHT * row_stride);
+
         // Decode left-to-right
         for (x=0; x < (p_app_gfx->width / rom_attrib.TILE_PIXEL_WIDTH); x++) {
 
+            // Top-left pixel of the tile, each row below it is row_stride further
+            p_image_row = p_tile_row + (x * rom_attrib.TILE_PIXEL_WIDTH * pixel_stride);
+
             // Reset transparency_flag for the upcoming tile
             transparency_flag = 0;
 
@@ -202,7 +228,11 @@ static int bin_encode_image(rom_gfx_data * p_rom_gfx,
             for (ty=0; ty < rom_attrib.TILE_PIXEL_HEIGHT; ty++) {
 
                 // Set up the pointer to the pixel in the source image buffer
-                p_image_pixel = romimg_calc_appimg_offset(x, y, ty, p_app_gfx, rom_attrib);
+                p_image_pixel = p_image_row;
+                p_image_row  += row_stride;
+
+                // Log transparency for the whole tile row in one pass
+                rom_bin_img_log_transparent_row(p_image_pixel, &transparency_flag, p_app_gfx, &rom_attrib);
 
                 pixdata = 0;
 
@@ -212,9 +242,8 @@ static int bin_encode_image(rom_gfx_data * p_rom_gfx,
                     // b0.MSbit = pixel.1, b1.MSbit = pixel.0
                     pixdata = (pixdata << 1) |  ( (*p_image_pixel) & 0x01);
 
-                    // Log pixel transparency and advance to next pixel
-                    romimg_log_transparent_pixel(p_image_pixel, &transparency_flag, p_app_gfx);
-                    p_image_pixel += p_app_gfx->bytes_per_pixel;
+                    // Advance to next pixel
+                    p_image_pixel += pixel_stride;
                 } // End of tile-row encode
 
 
@@ -225,7 +254,7 @@ static int bin_encode_image(rom_gfx_data * p_rom_gfx,
                 rom_offset++;
             } // End of per-tile encode
 
-            romimg_log_transparent_tiles(transparency_flag, &empty_tile_count, p_app_gfx, rom_attrib);
+            rom_bin_img_log_transparent_tiles(transparency_flag, &empty_tile_count, p_app_gfx, &rom_attrib);
         }
     }
 
@@ -245,21 +274,39 @@ static int bin_encode_image(rom_gfx_data * p_rom_gfx,
 
 
 // TODO: centralize duplicated function/code
-int bin_decode_nes_1bpp(rom_gfx_data * p_rom_gfx,
-                        app_gfx_data * p_app_gfx,
-                        app_color_data * p_colorpal)
+const rom_gfx_attrib * rom_bin_fmt_attrib_nes_1bpp(void)
+{
+    return &rom_attrib;
+}
+
+
+int rom_bin_fmt_query_nes_1bpp(rom_gfx_data * p_rom_gfx,
+                               app_gfx_data * p_app_gfx)
+{
+    // Calculate width, height and surplus bytes without decoding
+    rom_bin_img_calc_decoded_size(p_rom_gfx->size, p_app_gfx, &rom_attrib);
+
+    // Return success
+    return 0;
+}
+
+
+int rom_bin_fmt_decode_nes_1bpp(rom_gfx_data * p_rom_gfx,
+                                app_gfx_data * p_app_gfx,
+                                app_color_data * p_colorpal)
 {
     // Calculate width and height
-    romimg_calc_decoded_size(p_rom_gfx->size, p_app_gfx, rom_attrib);
+    rom_bin_img_calc_decoded_size(p_rom_gfx->size, p_app_gfx, &rom_attrib);
 
 
     // Set aside any surplus bytes if present
-    if (0 != romimg_stash_surplus_bytes(p_app_gfx,
-                                        p_rom_gfx))
+    if (0 != rom_bin_img_stash_surplus_bytes(p_app_gfx,
+                                             p_rom_gfx))
         return -1;
 
-    // Allocate the incoming image buffer, abort if it fails
-    if (NULL == (p_app_gfx->p_data = malloc(p_app_gfx->width * p_app_gfx->height * p_app_gfx->bytes_per_pixel)) )
+    // Allocate the incoming image buffer (unless the caller
+    // supplied one), abort if it fails
+    if (0 != rom_bin_img_alloc_decoded_image(p_app_gfx))
         return -1;
 
 
@@ -268,17 +315,20 @@ int bin_decode_nes_1bpp(rom_gfx_data * p_rom_gfx,
                               p_app_gfx))
         return -1;
 
+    // Count the decoded and padding tiles
+    rom_bin_img_log_decoded_tiles(p_rom_gfx, p_app_gfx, &rom_attrib);
+
 
     // Set up info about the color map
     p_colorpal->size            = rom_attrib.DECODED_NUM_COLORS;
     p_colorpal->bytes_per_pixel = rom_attrib.DECODED_BYTES_PER_COLOR;
 
     // Allocate the color map buffer, abort if it fails
-    if (NULL == (p_colorpal->p_data = malloc(p_colorpal->size * p_colorpal->bytes_per_pixel)) )
+    if (NULL == (p_colorpal->p_data = rom_bin_img_alloc(p_app_gfx, p_colorpal->size * p_colorpal->bytes_per_pixel)) )
         return -1;
 
     // Read the color map data
-    if (0 != romimg_load_color_data(p_colorpal))
+    if (0 != rom_bin_img_load_color_data(p_colorpal))
         return -1;
 
 
@@ -288,17 +338,17 @@ int bin_decode_nes_1bpp(rom_gfx_data * p_rom_gfx,
 
 
 // TODO: centralize duplicated function/code
-int bin_encode_nes_1bpp(rom_gfx_data * p_rom_gfx,
-                        app_gfx_data * p_app_gfx)
+int rom_bin_fmt_encode_nes_1bpp(rom_gfx_data * p_rom_gfx,
+                                app_gfx_data * p_app_gfx)
 {
     // TODO: Warn if number of colors > expected
 
     // Set output file size based on Width, Height and bit packing
     // Calculate width and height
-    p_rom_gfx->size = romimg_calc_encoded_size(p_app_gfx, rom_attrib);
+    p_rom_gfx->size = rom_bin_img_calc_encoded_size(p_app_gfx, &rom_attrib);
 
     // Allocate the color map buffer, abort if it fails
-    if (NULL == (p_rom_gfx->p_data = malloc(p_rom_gfx->size)) )
+    if (NULL == (p_rom_gfx->p_data = rom_bin_img_alloc(p_app_gfx, p_rom_gfx->size)) )
         return -1;
 
 
@@ -309,8 +359,8 @@ int bin_encode_nes_1bpp(rom_gfx_data * p_rom_gfx,
 
 
     // Append any surplus bytes if present
-    if (0 != romimg_append_surplus_bytes(p_app_gfx,
-                                         p_rom_gfx))
+    if (0 != rom_bin_img_append_surplus_bytes(p_app_gfx,
+                                              p_rom_gfx))
         return -1;
 
     // Return success
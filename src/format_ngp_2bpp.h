@@ -19,5 +19,7 @@
 =======================================================================*/
 
 
-int bin_decode_ngpc_2bpp(rom_gfx_data *, app_gfx_data *, app_color_data *);
-int bin_encode_ngpc_2bpp(rom_gfx_data *, app_gfx_data *);
\ No newline at end of file
+const rom_gfx_attrib * rom_bin_fmt_attrib_ngpc_2bpp(void);
+int rom_bin_fmt_query_ngpc_2bpp(rom_gfx_data *, app_gfx_data *);
+int rom_bin_fmt_decode_ngpc_2bpp(rom_gfx_data *, app_gfx_data *, app_color_data *);
+int rom_bin_fmt_encode_ngpc_2bpp(rom_gfx_data *, app_gfx_data *);
\ No newline at end of file
@@ -19,6 +19,8 @@
 =======================================================================*/
 
 #include "lib_rom_bin.h"
+#include "rom_stats.h"
+#include "rom_utils.h"
 
 #include "format_nes_1bpp.h"
 #include "format_nes_2bpp.h"
@@ -39,50 +41,372 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <libgimp/gimp.h>
+#include <limits.h>
 
 
 
+// Arena allocations are rounded up to this so each buffer stays aligned
+#define ROM_BIN_ARENA_ALIGN      16
+#define ROM_BIN_ARENA_ALIGN_UP(n) (((n) + (ROM_BIN_ARENA_ALIGN - 1)) & ~((size_t)ROM_BIN_ARENA_ALIGN - 1))
+
+// Largest color map any mode decodes: 256 colors x R,G,B
+#define ROM_BIN_MAX_COLORPAL_BYTES  (256 * 3)
+
+
+static void * rom_bin_default_alloc(void * p_user, size_t size)
+{
+    return malloc(size);
+}
+
+static void rom_bin_default_free(void * p_user, void * p_mem)
+{
+    free(p_mem);
+}
+
+static rom_bin_allocator rom_bin_active_allocator = {
+    rom_bin_default_alloc,
+    rom_bin_default_free,
+    NULL
+};
+
+
+
+static const rom_gfx_attrib * (*function_map_attrib[])(void) =  {
+        [BIN_MODE_NES_1BPP]      = rom_bin_fmt_attrib_nes_1bpp,
+        [BIN_MODE_NES_2BPP]      = rom_bin_fmt_attrib_nes_2bpp,
+        [BIN_MODE_SNESGB_2BPP]   = rom_bin_fmt_attrib_snesgb_2bpp,
+        [BIN_MODE_NGPC_2BPP]     = rom_bin_fmt_attrib_ngpc_2bpp,
+
+        [BIN_MODE_SNES_3BPP]     = rom_bin_fmt_attrib_snes_3bpp,
+
+        [BIN_MODE_GBA_4BPP]      = rom_bin_fmt_attrib_gba_4bpp,
+        [BIN_MODE_SNES_4BPP]     = rom_bin_fmt_attrib_snes_4bpp,
+        [BIN_MODE_GGSMSWSC_4BPP] = rom_bin_fmt_attrib_ggsmswsc_4bpp,
+        [BIN_MODE_GENS_4BPP]     = rom_bin_fmt_attrib_gens_4bpp,
+
+        [BIN_MODE_GBA_8BPP]      = rom_bin_fmt_attrib_gba_8bpp,
+        [BIN_MODE_SNES_8BPP]     = rom_bin_fmt_attrib_snes_8bpp,
+};
+
+
+static int (*function_map_query[])(rom_gfx_data *,
+                                   app_gfx_data *) =  {
+        [BIN_MODE_NES_1BPP]      = rom_bin_fmt_query_nes_1bpp,
+        [BIN_MODE_NES_2BPP]      = rom_bin_fmt_query_nes_2bpp,
+        [BIN_MODE_SNESGB_2BPP]   = rom_bin_fmt_query_snesgb_2bpp,
+        [BIN_MODE_NGPC_2BPP]     = rom_bin_fmt_query_ngpc_2bpp,
+
+        [BIN_MODE_SNES_3BPP]     = rom_bin_fmt_query_snes_3bpp,
+
+        [BIN_MODE_GBA_4BPP]      = rom_bin_fmt_query_gba_4bpp,
+        [BIN_MODE_SNES_4BPP]     = rom_bin_fmt_query_snes_4bpp,
+        [BIN_MODE_GGSMSWSC_4BPP] = rom_bin_fmt_query_ggsmswsc_4bpp,
+        [BIN_MODE_GENS_4BPP]     = rom_bin_fmt_query_gens_4bpp,
+
+        [BIN_MODE_GBA_8BPP]      = rom_bin_fmt_query_gba_8bpp,
+        [BIN_MODE_SNES_8BPP]     = rom_bin_fmt_query_snes_8bpp,
+};
+
+
 static int (*function_map_decode[])(rom_gfx_data *,
                                     app_gfx_data *,
                                     app_color_data *) =  {
-        [BIN_MODE_NES_1BPP]      = bin_decode_nes_1bpp,
-        [BIN_MODE_NES_2BPP]      = bin_decode_nes_2bpp,
-        [BIN_MODE_SNESGB_2BPP]   = bin_decode_snesgb_2bpp,
-        [BIN_MODE_NGPC_2BPP]     = bin_decode_ngpc_2bpp,
+        [BIN_MODE_NES_1BPP]      = rom_bin_fmt_decode_nes_1bpp,
+        [BIN_MODE_NES_2BPP]      = rom_bin_fmt_decode_nes_2bpp,
+        [BIN_MODE_SNESGB_2BPP]   = rom_bin_fmt_decode_snesgb_2bpp,
+        [BIN_MODE_NGPC_2BPP]     = rom_bin_fmt_decode_ngpc_2bpp,
 
-        [BIN_MODE_SNES_3BPP]     = bin_decode_snes_3bpp,
+        [BIN_MODE_SNES_3BPP]     = rom_bin_fmt_decode_snes_3bpp,
 
-        [BIN_MODE_GBA_4BPP]      = bin_decode_gba_4bpp,
-        [BIN_MODE_SNES_4BPP]     = bin_decode_snes_4bpp,
-        [BIN_MODE_GGSMSWSC_4BPP] = bin_decode_ggsmswsc_4bpp,
-        [BIN_MODE_GENS_4BPP]     = bin_decode_gens_4bpp,
+        [BIN_MODE_GBA_4BPP]      = rom_bin_fmt_decode_gba_4bpp,
+        [BIN_MODE_SNES_4BPP]     = rom_bin_fmt_decode_snes_4bpp,
+        [BIN_MODE_GGSMSWSC_4BPP] = rom_bin_fmt_decode_ggsmswsc_4bpp,
+        [BIN_MODE_GENS_4BPP]     = rom_bin_fmt_decode_gens_4bpp,
 
-        [BIN_MODE_GBA_8BPP]      = bin_decode_gba_8bpp,
-        [BIN_MODE_SNES_8BPP]     = bin_decode_snes_8bpp,
+        [BIN_MODE_GBA_8BPP]      = rom_bin_fmt_decode_gba_8bpp,
+        [BIN_MODE_SNES_8BPP]     = rom_bin_fmt_decode_snes_8bpp,
 };
 
 
 static int (*function_map_encode[])(rom_gfx_data *,
                                     app_gfx_data *) =  {
-        [BIN_MODE_NES_1BPP]      = bin_encode_nes_1bpp,
-        [BIN_MODE_NES_2BPP]      = bin_encode_nes_2bpp,
-        [BIN_MODE_SNESGB_2BPP]   = bin_encode_snesgb_2bpp,
-        [BIN_MODE_NGPC_2BPP]     = bin_encode_ngpc_2bpp,
+        [BIN_MODE_NES_1BPP]      = rom_bin_fmt_encode_nes_1bpp,
+        [BIN_MODE_NES_2BPP]      = rom_bin_fmt_encode_nes_2bpp,
+        [BIN_MODE_SNESGB_2BPP]   = rom_bin_fmt_encode_snesgb_2bpp,
+        [BIN_MODE_NGPC_2BPP]     = rom_bin_fmt_encode_ngpc_2bpp,
 
-        [BIN_MODE_SNES_3BPP]     = bin_encode_snes_3bpp,
+        [BIN_MODE_SNES_3BPP]     = rom_bin_fmt_encode_snes_3bpp,
 
-        [BIN_MODE_GBA_4BPP]      = bin_encode_gba_4bpp,
-        [BIN_MODE_SNES_4BPP]     = bin_encode_snes_4bpp,
-        [BIN_MODE_GGSMSWSC_4BPP] = bin_encode_ggsmswsc_4bpp,
-        [BIN_MODE_GENS_4BPP]     = bin_encode_gens_4bpp,
+        [BIN_MODE_GBA_4BPP]      = rom_bin_fmt_encode_gba_4bpp,
+        [BIN_MODE_SNES_4BPP]     = rom_bin_fmt_encode_snes_4bpp,
+        [BIN_MODE_GGSMSWSC_4BPP] = rom_bin_fmt_encode_ggsmswsc_4bpp,
+        [BIN_MODE_GENS_4BPP]     = rom_bin_fmt_encode_gens_4bpp,
 
-        [BIN_MODE_GBA_8BPP]      = bin_encode_gba_8bpp,
-        [BIN_MODE_SNES_8BPP]     = bin_encode_snes_8bpp,
+        [BIN_MODE_GBA_8BPP]      = rom_bin_fmt_encode_gba_8bpp,
+        [BIN_MODE_SNES_8BPP]     = rom_bin_fmt_encode_snes_8bpp,
 };
 
 
 
+// Short names for each mode (command line tools, bindings)
+static const char * const mode_names[] = {
+        [BIN_MODE_NES_1BPP]      = "nes-1bpp",
+        [BIN_MODE_NES_2BPP]      = "nes-2bpp",
+        [BIN_MODE_SNESGB_2BPP]   = "snesgb-2bpp",
+        [BIN_MODE_NGPC_2BPP]     = "ngpc-2bpp",
+
+        [BIN_MODE_SNES_3BPP]     = "snes-3bpp",
+
+        [BIN_MODE_GBA_4BPP]      = "gba-4bpp",
+        [BIN_MODE_SNES_4BPP]     = "snes-4bpp",
+        [BIN_MODE_GGSMSWSC_4BPP] = "ggsmswsc-4bpp",
+        [BIN_MODE_GENS_4BPP]     = "gens-4bpp",
+
+        [BIN_MODE_GBA_8BPP]      = "gba-8bpp",
+        [BIN_MODE_SNES_8BPP]     = "snes-8bpp",
+};
+
+
+
+// Version the library was built as: major * 10000 + minor * 100 + patch
+int rom_bin_version(void)
+{
+    return (ROM_BIN_VERSION_MAJOR * 10000) +
+           (ROM_BIN_VERSION_MINOR * 100) +
+            ROM_BIN_VERSION_PATCH;
+}
+
+
+
+// Returns NULL for an unknown mode
+const char * rom_bin_mode_name(int image_mode)
+{
+    if ((image_mode >= 0) &&
+        (image_mode < BIN_MODE_LAST))
+        return mode_names[image_mode];
+
+    return NULL;
+}
+
+
+
+// Returns -1 for an unknown name
+int rom_bin_mode_from_name(const char * p_name)
+{
+    int c;
+
+    if (NULL == p_name)
+        return -1;
+
+    for (c = 0; c < BIN_MODE_LAST; c++)
+        if (0 == strcmp(p_name, mode_names[c]))
+            return c;
+
+    return -1;
+}
+
+
+
+// Tile size, bit depth and default image width of a mode,
+// NULL for an unknown mode
+const rom_gfx_attrib * rom_bin_mode_attrib(int image_mode)
+{
+    if ((image_mode >= 0) &&
+        (image_mode < BIN_MODE_LAST))
+        return function_map_attrib[image_mode]();
+
+    return NULL;
+}
+
+
+
+// Bytes of rom data per tile, as the decoder steps through it.
+// Tools use it to address single tiles and rows of tiles. -1 for an unknown mode
+int64_t rom_bin_tile_bytes(int image_mode)
+{
+    const rom_gfx_attrib * p_attrib = rom_bin_mode_attrib(image_mode);
+
+    if (NULL == p_attrib)
+        return -1;
+
+    return rom_bin_img_calc_tile_bytes(p_attrib);
+}
+
+
+
+// Install allocator hooks for all library allocations made outside of
+// an arena. Passing NULL restores the default malloc / free.
+void rom_bin_set_allocator(const rom_bin_allocator * p_allocator)
+{
+    if ((NULL == p_allocator) ||
+        (NULL == p_allocator->alloc) ||
+        (NULL == p_allocator->free)) {
+        rom_bin_active_allocator.alloc  = rom_bin_default_alloc;
+        rom_bin_active_allocator.free   = rom_bin_default_free;
+        rom_bin_active_allocator.p_user = NULL;
+    }
+    else
+        rom_bin_active_allocator = *p_allocator;
+}
+
+
+void * rom_bin_alloc(size_t size)
+{
+    return rom_bin_active_allocator.alloc(rom_bin_active_allocator.p_user, size);
+}
+
+
+void rom_bin_free(void * p_mem)
+{
+    if (p_mem)
+        rom_bin_active_allocator.free(rom_bin_active_allocator.p_user, p_mem);
+}
+
+
+
+void rom_bin_arena_init(rom_bin_arena * p_arena)
+{
+    p_arena->p_base = NULL;
+    p_arena->size   = 0;
+    p_arena->used   = 0;
+}
+
+
+// Make sure the arena can hold at least size bytes. An existing
+// reservation that is already large enough gets reused as-is.
+int rom_bin_arena_reserve(rom_bin_arena * p_arena, size_t size)
+{
+    p_arena->used = 0;
+
+    if ((NULL != p_arena->p_base) && (p_arena->size >= size))
+        return 0;
+
+    rom_bin_arena_release(p_arena);
+
+    if (NULL == (p_arena->p_base = rom_bin_alloc(size)) )
+        return -1;
+
+    p_arena->size = size;
+
+    // Return success
+    return 0;
+}
+
+
+void * rom_bin_arena_alloc(rom_bin_arena * p_arena, size_t size)
+{
+    void * p_mem;
+
+    size = ROM_BIN_ARENA_ALIGN_UP(size);
+
+    // Abort if it won't fit, the arena never grows behind the caller's back
+    if ((NULL == p_arena->p_base) || (size > (p_arena->size - p_arena->used)))
+        return NULL;
+
+    p_mem = p_arena->p_base + p_arena->used;
+    p_arena->used += size;
+
+    return p_mem;
+}
+
+
+// Drop all allocations but keep the reservation for the next operation
+void rom_bin_arena_reset(rom_bin_arena * p_arena)
+{
+    p_arena->used = 0;
+}
+
+
+void rom_bin_arena_release(rom_bin_arena * p_arena)
+{
+    rom_bin_free(p_arena->p_base);
+    rom_bin_arena_init(p_arena);
+}
+
+
+
+// Multiplies out a buffer size, failing instead of silently wrapping
+// around when it doesn't fit in 64 bits or in the platform's size_t
+int rom_bin_calc_alloc_size(uint64_t count, uint64_t elem_size, size_t * p_size)
+{
+    if ((elem_size != 0) && (count > (UINT64_MAX / elem_size)))
+        return -1;
+
+    if ((count * elem_size) > (uint64_t)SIZE_MAX)
+        return -1;
+
+    *p_size = (size_t)(count * elem_size);
+
+    // Return success
+    return 0;
+}
+
+
+// Adds up arena buffer sizes (each aligned), returns 0 on overflow
+static size_t rom_bin_sum_arena_sizes(const uint64_t * p_sizes, int count)
+{
+    uint64_t total = 0;
+    int      c;
+
+    for (c = 0; c < count; c++) {
+        if (p_sizes[c] > (UINT64_MAX - total - ROM_BIN_ARENA_ALIGN))
+            return 0;
+
+        total += ROM_BIN_ARENA_ALIGN_UP(p_sizes[c]);
+    }
+
+    if (total > (uint64_t)SIZE_MAX)
+        return 0;
+
+    return (size_t)total;
+}
+
+
+// Arena size needed to decode: raw rom data, decoded image, surplus bytes
+// and color map. The app struct must already hold mode and bytes per pixel.
+// Returns 0 if the rom can't be decoded or the size doesn't fit in memory.
+size_t rom_bin_calc_decode_arena_size(rom_gfx_data * p_rom_gfx,
+                                      app_gfx_data * p_app_gfx)
+{
+    app_gfx_data query_gfx;
+    uint64_t     sizes[4];
+
+    // Query on a copy so the caller's struct isn't changed
+    query_gfx = *p_app_gfx;
+
+    if (0 != rom_bin_decode_query(p_rom_gfx, &query_gfx))
+        return 0;
+
+    sizes[0] = p_rom_gfx->size;
+    sizes[1] = query_gfx.size;
+    sizes[2] = query_gfx.surplus_bytes_size;
+    sizes[3] = ROM_BIN_MAX_COLORPAL_BYTES;
+
+    return rom_bin_sum_arena_sizes(sizes, 4);
+}
+
+
+// Arena size needed to encode: app image, encoded rom data (at most one
+// byte per pixel) and the larger buffer it moves to when surplus bytes
+// get appended, plus the surplus bytes themselves.
+// Returns 0 if the size doesn't fit in memory.
+size_t rom_bin_calc_encode_arena_size(app_gfx_data * p_app_gfx)
+{
+    uint64_t pixels;
+    uint64_t sizes[4];
+
+    pixels = (uint64_t)p_app_gfx->width * p_app_gfx->height;
+
+    sizes[0] = pixels * p_app_gfx->bytes_per_pixel;
+    sizes[1] = pixels;
+    sizes[2] = pixels + p_app_gfx->surplus_bytes_size;
+    sizes[3] = p_app_gfx->surplus_bytes_size;
+
+    return rom_bin_sum_arena_sizes(sizes, 4);
+}
+
+
+
 void rom_bin_init_structs(rom_gfx_data * p_rom_gfx,
                           app_gfx_data * p_app_gfx,
                           app_color_data * p_colorpal)
@@ -91,9 +415,14 @@ void rom_bin_init_structs(rom_gfx_data * p_rom_gfx,
     p_app_gfx->width      = 0;
     p_app_gfx->height     = 0;
     p_app_gfx->p_data     = NULL;
+    p_app_gfx->data_owned_by_caller = FALSE;
+    p_app_gfx->row_stride   = 0;
+    p_app_gfx->pixel_stride = 0;
     p_app_gfx->size       = 0;
     p_app_gfx->p_surplus_bytes    = NULL;
     p_app_gfx->surplus_bytes_size = 0;
+    p_app_gfx->p_arena            = NULL;
+    p_app_gfx->p_stats            = NULL;
 
 
     p_colorpal->index           = 0;
@@ -108,16 +437,84 @@ void rom_bin_init_structs(rom_gfx_data * p_rom_gfx,
 
 
 
+// Frees every working buffer of an operation, including after a failed
+// decode or encode. The rom data is freed too, so it should come from
+// rom_bin_alloc() (or be set to NULL first if the caller owns it).
+// Caller supplied image buffers (rom_bin_decode_into) are left alone.
+//
+// With an arena everything is dropped at once by resetting it, the
+// reservation is kept for the next operation until the caller releases it.
+void rom_bin_free_structs(rom_gfx_data * p_rom_gfx,
+                          app_gfx_data * p_app_gfx,
+                          app_color_data * p_colorpal)
+{
+    if (NULL != p_app_gfx->p_arena) {
+        rom_bin_arena_reset(p_app_gfx->p_arena);
+    }
+    else {
+        rom_bin_free(p_rom_gfx->p_data);
+        rom_bin_free(p_app_gfx->p_surplus_bytes);
+        rom_bin_free(p_colorpal->p_data);
+
+        if (!p_app_gfx->data_owned_by_caller)
+            rom_bin_free(p_app_gfx->p_data);
+    }
+
+    p_rom_gfx->p_data          = NULL;
+    p_app_gfx->p_surplus_bytes = NULL;
+    p_colorpal->p_data         = NULL;
+    p_app_gfx->p_data          = NULL;
+}
+
+
+
+// Reports the decoded image width, height, surplus byte count and the
+// buffer size needed at packed strides (app size) without allocating anything
+int rom_bin_decode_query(rom_gfx_data * p_rom_gfx,
+                         app_gfx_data * p_app_gfx)
+{
+    // Call the matching query function
+    if ((p_app_gfx->image_mode >= 0) &&
+        (p_app_gfx->image_mode < BIN_MODE_LAST)) {
+
+        if (0 != function_map_query[ p_app_gfx->image_mode ](p_rom_gfx,
+                                                            p_app_gfx))
+            return -1;
+    }
+    else
+        return -1;
+
+    // A ROM too small for even one tile can't be decoded
+    if ((p_app_gfx->width == 0) || (p_app_gfx->height == 0))
+        return -1;
+
+    p_app_gfx->size = (int64_t)p_app_gfx->width * p_app_gfx->height * p_app_gfx->bytes_per_pixel;
+
+    // Return success
+    return 0;
+}
+
+
+
 int rom_bin_decode(rom_gfx_data * p_rom_gfx,
                    app_gfx_data * p_app_gfx,
                    app_color_data * p_colorpal)
 {
     // Call the matching decode function
-    if (p_app_gfx->image_mode < BIN_MODE_LAST) {
+    if ((p_app_gfx->image_mode >= 0) &&
+        (p_app_gfx->image_mode < BIN_MODE_LAST)) {
+
+        int status;
+
+        rom_stats_start(p_app_gfx->p_stats, ROM_STATS_TIME_DECODE);
+
+        status = function_map_decode[ p_app_gfx->image_mode ](p_rom_gfx,
+                                                              p_app_gfx,
+                                                              p_colorpal);
+
+        rom_stats_stop(p_app_gfx->p_stats, ROM_STATS_TIME_DECODE);
 
-        if (0 != function_map_decode[ p_app_gfx->image_mode ](p_rom_gfx,
-                                                             p_app_gfx,
-                                                             p_colorpal))
+        if (0 != status)
             return -1;
     }
     else
@@ -133,10 +530,19 @@ int rom_bin_encode(rom_gfx_data * p_rom_gfx,
                    app_gfx_data * p_app_gfx)
 {
     // Call the matching encode function
-    if (p_app_gfx->image_mode < BIN_MODE_LAST) {
+    if ((p_app_gfx->image_mode >= 0) &&
+        (p_app_gfx->image_mode < BIN_MODE_LAST)) {
 
-        if (0 != function_map_encode[ p_app_gfx->image_mode ](p_rom_gfx,
-                                                             p_app_gfx))
+        int status;
+
+        rom_stats_start(p_app_gfx->p_stats, ROM_STATS_TIME_ENCODE);
+
+        status = function_map_encode[ p_app_gfx->image_mode ](p_rom_gfx,
+                                                              p_app_gfx);
+
+        rom_stats_stop(p_app_gfx->p_stats, ROM_STATS_TIME_ENCODE);
+
+        if (0 != status)
             return -1;
     }
     else
@@ -146,3 +552,45 @@ int rom_bin_encode(rom_gfx_data * p_rom_gfx,
     // Return success
     return 0;
 }
+
+
+
+// Decodes into a caller owned buffer instead of allocating one.
+// The buffer must hold (height - 1) * row_stride + width * pixel_stride
+// bytes, with dimensions as reported by rom_bin_decode_query().
+// A stride of 0 selects the packed default.
+int rom_bin_decode_into(rom_gfx_data * p_rom_gfx,
+                        app_gfx_data * p_app_gfx,
+                        app_color_data * p_colorpal,
+                        unsigned char * p_dest,
+                        int64_t row_stride,
+                        int64_t pixel_stride)
+{
+    if (NULL == p_dest)
+        return -1;
+
+    // Get the dimensions to validate the strides against
+    if (0 != rom_bin_decode_query(p_rom_gfx,
+                                  p_app_gfx))
+        return -1;
+
+    if (pixel_stride == 0)
+        pixel_stride = p_app_gfx->bytes_per_pixel;
+
+    if (row_stride == 0)
+        row_stride = p_app_gfx->width * pixel_stride;
+
+    // Pixels and rows must not overlap
+    if ((pixel_stride < p_app_gfx->bytes_per_pixel) ||
+        (row_stride < ((int64_t)p_app_gfx->width * pixel_stride)))
+        return -1;
+
+    p_app_gfx->p_data       = p_dest;
+    p_app_gfx->data_owned_by_caller = TRUE;
+    p_app_gfx->row_stride   = row_stride;
+    p_app_gfx->pixel_stride = pixel_stride;
+
+    return rom_bin_decode(p_rom_gfx,
+                          p_app_gfx,
+                          p_colorpal);
+}
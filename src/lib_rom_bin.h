@@ -16,8 +16,6 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 =======================================================================*/
 
-#include <glib.h>
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -27,6 +25,20 @@
 #ifndef ROM_BIN_FILE_HEADER
 #define ROM_BIN_FILE_HEADER
 
+    // librombin version. The major number is the ABI version (soname),
+    // bump it for any change that breaks existing callers
+    #define ROM_BIN_VERSION_MAJOR 1
+    #define ROM_BIN_VERSION_MINOR 0
+    #define ROM_BIN_VERSION_PATCH 0
+
+    // The library doesn't depend on glib, but shares its boolean names
+    #ifndef TRUE
+        #define TRUE  1
+    #endif
+    #ifndef FALSE
+        #define FALSE 0
+    #endif
+
     // TODO: update naming convention
     enum rom_bin_modes {
         BIN_MODE_NES_1BPP,
@@ -56,12 +68,48 @@
         BIN_EXT_MODE_GBA,
     };
 
+    // Patch formats for rom_bin_make_patch()
+    enum rom_bin_patch_formats {
+        ROM_BIN_PATCH_IPS,
+        ROM_BIN_PATCH_BPS
+    };
+
+    // Console color formats, for rom_bin_find_palettes()
+    enum rom_bin_palette_formats {
+        ROM_BIN_PALETTE_BGR555,   // SNES, GBA
+        ROM_BIN_PALETTE_GENESIS,  // 9 bit CRAM
+        ROM_BIN_PALETTE_GG,       // 12 bit, also Neo Geo Pocket Color
+        ROM_BIN_PALETTE_SMS,      // 6 bit
+
+        ROM_BIN_PALETTE_LAST
+    };
+
     enum rom_bin_pixel_modes {
         BIN_BITDEPTH_INDEXED = 1,
         BIN_BITDEPTH_INDEXED_ALPHA = 2,
         BIN_BITDEPTH_LAST
     };
 
+    // Optional allocator hooks, used for every buffer the library
+    // allocates outside of an arena. Defaults to malloc / free.
+    typedef struct rom_bin_allocator {
+        void * (*alloc)(void * p_user, size_t size);
+        void   (*free)(void * p_user, void * p_mem);
+        void   * p_user;
+    } rom_bin_allocator;
+
+    // Per-operation arena: one reservation that serves all of the
+    // working buffers of a decode or encode, released all together.
+    // Can be reset and reused across operations (ex: batch processing)
+    typedef struct rom_bin_arena {
+        unsigned char * p_base;
+        size_t          size;
+        size_t          used;
+    } rom_bin_arena;
+
+    // Instrumentation, see rom_stats.h
+    struct rom_stats;
+
     // TODO: move these to lib_rom_bin.h
 
         typedef struct rom_gfx_attrib {
@@ -80,15 +128,21 @@
             unsigned int     width;
             unsigned int     height;
             unsigned char  * p_data;
+            unsigned char    data_owned_by_caller; // p_data was supplied by the caller, never freed here
             unsigned char    bytes_per_pixel;
-            int              size;
+            int64_t          row_stride;      // Bytes between image rows, 0 = width * bytes_per_pixel
+            int64_t          pixel_stride;    // Bytes between pixels in a row, 0 = bytes_per_pixel
+            int64_t          size;
 
-            long int         surplus_bytes_size;
+            int64_t          surplus_bytes_size;
             unsigned char  * p_surplus_bytes;
+
+            rom_bin_arena  * p_arena;         // Working buffers come from here if set
+            struct rom_stats * p_stats;       // Timings and counters, NULL when disabled
         }  app_gfx_data;
 
         typedef struct rom_gfx_data {
-            long int        size;
+            int64_t         size;
             unsigned char * p_data;
         } rom_gfx_data;
 
@@ -99,10 +153,59 @@
             unsigned char * p_data;
         } app_color_data;
 
+        // A block of a rom that looks like a palette
+        typedef struct rom_bin_palette_hit {
+            int64_t offset;
+            int     format;
+            int     num_colors;
+            int     score;      // 0 - 100
+        } rom_bin_palette_hit;
+
+    int          rom_bin_version(void);
+    const char * rom_bin_mode_name(int);
+    int          rom_bin_mode_from_name(const char *);
+
+    const rom_gfx_attrib * rom_bin_mode_attrib(int);
+    int64_t                rom_bin_tile_bytes(int);
+
+    void   rom_bin_set_allocator(const rom_bin_allocator *);
+    void * rom_bin_alloc(size_t);
+    void   rom_bin_free(void *);
+
+    void   rom_bin_arena_init(rom_bin_arena *);
+    int    rom_bin_arena_reserve(rom_bin_arena *, size_t);
+    void * rom_bin_arena_alloc(rom_bin_arena *, size_t);
+    void   rom_bin_arena_reset(rom_bin_arena *);
+    void   rom_bin_arena_release(rom_bin_arena *);
+
+    size_t rom_bin_calc_decode_arena_size(rom_gfx_data *, app_gfx_data *);
+    size_t rom_bin_calc_encode_arena_size(app_gfx_data *);
+
+    int    rom_bin_calc_alloc_size(uint64_t, uint64_t, size_t *);
+
     void rom_bin_init_structs(rom_gfx_data *, app_gfx_data *, app_color_data *);
+    void rom_bin_free_structs(rom_gfx_data *, app_gfx_data *, app_color_data *);
 
+    int rom_bin_decode_query(rom_gfx_data *, app_gfx_data *);
     int rom_bin_decode(rom_gfx_data *, app_gfx_data *, app_color_data *);
+    int rom_bin_decode_into(rom_gfx_data *, app_gfx_data *, app_color_data *,
+                            unsigned char *, int64_t, int64_t);
     int rom_bin_encode(rom_gfx_data *, app_gfx_data *);
 
+    int rom_bin_make_patch(int,
+                           const unsigned char *, int64_t,
+                           const unsigned char *, int64_t, int64_t,
+                           unsigned char **, int64_t *);
+
+    const char * rom_bin_palette_format_name(int);
+    int          rom_bin_palette_format_from_name(const char *);
+    int          rom_bin_palette_format_for_mode(int);
+    int64_t      rom_bin_palette_color_bytes(int);
+
+    int rom_bin_find_palettes(const unsigned char *, int64_t, int, int,
+                              rom_bin_palette_hit *, int);
+    int rom_bin_palette_decode(int, const unsigned char *, int64_t, app_color_data *);
+    int rom_bin_palette_parse(const char *, const unsigned char *, int64_t, app_color_data *);
+
 
 #endif // ROM_BIN_FILE_HEADER
\ No newline at end of file
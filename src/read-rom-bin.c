@@ -22,144 +22,309 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <libgimp/gimp.h>
 
-int read_rom_bin(const gchar * filename, int image_mode)
+// Get the file size without 32-bit ftell() truncation
+static int64_t read_rom_bin_file_size(FILE * file)
 {
-    int status = 1;
+    int64_t size;
+
+#ifdef _WIN32
+    _fseeki64(file, 0, SEEK_END);
+    size = _ftelli64(file);
+    _fseeki64(file, 0, SEEK_SET);
+#else
+    fseeko(file, 0, SEEK_END);
+    size = ftello(file);
+    fseeko(file, 0, SEEK_SET);
+#endif
+
+    return size;
+}
 
-    gint32 new_image_id,
-           new_layer_id;
-    GimpDrawable * drawable;
-    GimpPixelRgn rgn;
-    GimpParasite * parasite;
 
-    FILE * file;
 
+// Replaces the default colors with a palette saved next to the file
+// (ex: level.pal or a level.zst save state for level.bin), if any
+static void read_rom_bin_load_sidecar_palette(const gchar * filename, app_color_data * p_colorpal)
+{
+    static const gchar * const extensions[] = {
+        ".pal", ".act", ".gpl", ".zst", ".gs0", ".ss0"
+    };
+
+    gchar  * p_base;
+    gchar  * p_dot;
+    gchar  * p_path;
+    gchar  * p_contents;
+    gsize    length;
+    guint    c;
+
+    p_base = g_strdup(filename);
+    p_dot  = strrchr(p_base, '.');
+    if (p_dot && !strchr(p_dot, G_DIR_SEPARATOR))
+        *p_dot = '\0';
+
+    for (c = 0; c < G_N_ELEMENTS(extensions); c++) {
+        p_path = g_strconcat(p_base, extensions[c], NULL);
+
+        if ((0 != strcmp(p_path, filename)) &&
+            g_file_get_contents(p_path, &p_contents, &length, NULL)) {
+            int num_colors = rom_bin_palette_parse(p_path, (const unsigned char *)p_contents, (int64_t)length, p_colorpal);
+
+            g_free(p_contents);
+
+            if (num_colors > 0) {
+                g_free(p_path);
+                break;
+            }
+        }
+
+        g_free(p_path);
+    }
 
-    app_gfx_data   app_gfx;
-    app_color_data colorpal; // TODO: rename to app_colorpal?
-    rom_gfx_data   rom_gfx;
+    g_free(p_base);
+}
 
-    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
 
-    app_gfx.image_mode      = image_mode;
-    app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+
+// Reads and decodes the file into the job's buffers.
+// Makes no GIMP calls, so it is safe to run on a worker thread.
+int read_rom_bin_decode(const gchar * filename, int image_mode, read_rom_bin_job * p_job)
+{
+    int status = 1;
+
+    FILE * file;
+
+    size_t arena_size;
+
+    rom_bin_init_structs(&p_job->rom_gfx, &p_job->app_gfx, &p_job->colorpal);
+    rom_bin_arena_init(&p_job->arena);
+
+    p_job->app_gfx.image_mode      = image_mode;
+    p_job->app_gfx.bytes_per_pixel = BIN_BITDEPTH_INDEXED_ALPHA;
+    p_job->app_gfx.p_stats         = rom_stats_begin(&p_job->stats, "load", filename, image_mode);
+    rom_stats_set_status(p_job->app_gfx.p_stats, -1);
 
 
     // Try to open the file
+    rom_stats_start(p_job->app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+
     file = fopen(filename, "rb");
-    if(!file)
+    if(!file) {
+        read_rom_bin_job_free(p_job);
         return -1;
+    }
 
     // Get the file size
-    fseek(file, 0, SEEK_END);
-    rom_gfx.size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    p_job->rom_gfx.size = read_rom_bin_file_size(file);
+
+    // Reserve a single arena for the raw data, decoded image,
+    // surplus bytes and color map. Zero means it can't be decoded
+    // (or wouldn't fit in memory, sizes are overflow checked).
+    arena_size = rom_bin_calc_decode_arena_size(&p_job->rom_gfx, &p_job->app_gfx);
+
+    if ((p_job->rom_gfx.size <= 0) ||
+        (0 == arena_size) ||
+        (0 != rom_bin_arena_reserve(&p_job->arena, arena_size))) {
+        fclose(file);
+        read_rom_bin_job_free(p_job);
+        return -1;
+    }
+
+    p_job->app_gfx.p_arena = &p_job->arena;
 
     // Now prepare a buffer of that size
     // and read the data.
-    rom_gfx.p_data = malloc(rom_gfx.size);
-    fread(rom_gfx.p_data, rom_gfx.size, 1, file);
+    p_job->rom_gfx.p_data = rom_bin_arena_alloc(&p_job->arena, p_job->rom_gfx.size);
+
+    // Make sure the alloc and read succeeded
+    if ((p_job->rom_gfx.p_data == NULL) ||
+        (1 != fread(p_job->rom_gfx.p_data, p_job->rom_gfx.size, 1, file))) {
+        fclose(file);
+        read_rom_bin_job_free(p_job);
+        return -1;
+    }
 
     // Close the file
     fclose(file);
 
-    // Make sure the alloc succeeded
-    if(rom_gfx.p_data == NULL)
-        return -1;
+    rom_stats_stop(p_job->app_gfx.p_stats, ROM_STATS_TIME_FILE_READ);
+    rom_stats_add(p_job->app_gfx.p_stats, ROM_STATS_COUNT_BYTES_COPIED, p_job->rom_gfx.size);
 
 
-    // Perform the load procedure and free the raw data.
-    status = rom_bin_decode(&rom_gfx,
-                            &app_gfx,
-                            &colorpal);
-
-    free(rom_gfx.p_data);
+    // Perform the load procedure
+    status = rom_bin_decode(&p_job->rom_gfx,
+                            &p_job->app_gfx,
+                            &p_job->colorpal);
 
     // Check to make sure that the load was successful
     if (0 != status)
     {
-        printf("Image load failed \n");
+        // Frees every buffer of this load at once
+        read_rom_bin_job_free(p_job);
 
-        if (app_gfx.p_data)
-            free(app_gfx.p_data);
+        return -1;
+    }
 
-        if (colorpal.p_data)
-            free(colorpal.p_data);
+    read_rom_bin_load_sidecar_palette(filename, &p_job->colorpal);
 
-        printf("Image load failed: free complete \n");
+    // Return success
+    return 0;
+}
 
-        return -1;
+
+
+// Copies the decoded image into the layer
+static void read_rom_bin_set_pixels(gint32 layer_id, app_gfx_data * p_app_gfx)
+{
+#if GIMP_CHECK_VERSION(2,10,0)
+    GeglBuffer * buffer;
+    const Babl * format;
+    gint         tile_height = 0;
+    gint         y, rows;
+    int64_t      row_bytes;
+
+    buffer = gimp_drawable_get_buffer(layer_id);
+
+    // The layer's own (indexed + alpha) format, so GEGL copies without converting
+    format    = gimp_drawable_get_format(layer_id);
+    row_bytes = (int64_t)p_app_gfx->width * babl_format_get_bytes_per_pixel(format);
+
+    // Write in strips that line up with the buffer's tiles so
+    // each tile is only touched once
+    g_object_get(buffer, "tile-height", &tile_height, NULL);
+    if (tile_height <= 0)
+        tile_height = gimp_tile_height();
+
+    for (y = 0; y < p_app_gfx->height; y += rows) {
+        rows = MIN(tile_height, p_app_gfx->height - y);
+
+        gegl_buffer_set(buffer,
+                        GEGL_RECTANGLE(0, y, p_app_gfx->width, rows),
+                        0, format,
+                        p_app_gfx->p_data + (y * row_bytes),
+                        GEGL_AUTO_ROWSTRIDE);
     }
 
+    // Releasing the buffer flushes it to the layer
+    g_object_unref(buffer);
+#else
+    GimpDrawable * drawable;
+    GimpPixelRgn rgn;
+
+    // Get the drawable for the layer
+    drawable = gimp_drawable_get(layer_id);
+
+    // Get a pixel region from the layer
+    gimp_pixel_rgn_init(&rgn,
+                        drawable,
+                        0, 0,
+                        p_app_gfx->width, p_app_gfx->height,
+                        TRUE, FALSE);
+
+    gimp_pixel_rgn_set_rect(&rgn,
+                            p_app_gfx->p_data,
+                            0, 0,
+                            p_app_gfx->width, p_app_gfx->height);
+
+    // We're done with the drawable
+    gimp_drawable_flush(drawable);
+    gimp_drawable_detach(drawable);
+#endif
+}
+
+
+
+// Creates the GIMP image from a decoded job, main thread only
+int read_rom_bin_create_image(const gchar * filename, read_rom_bin_job * p_job)
+{
+    gint32 new_image_id,
+           new_layer_id;
+    GimpParasite * parasite;
+
+    app_gfx_data   * p_app_gfx  = &p_job->app_gfx;
+    app_color_data * p_colorpal = &p_job->colorpal;
 
 
     // Now create the new INDEXED image.
-    new_image_id = gimp_image_new(app_gfx.width, app_gfx.height, GIMP_INDEXED);
+    new_image_id = gimp_image_new(p_app_gfx->width, p_app_gfx->height, GIMP_INDEXED);
 
     // Create the new layer
     new_layer_id = gimp_layer_new(new_image_id,
                                   "Background",
-                                  app_gfx.width, app_gfx.height,
+                                  p_app_gfx->width, p_app_gfx->height,
                                   GIMP_INDEXEDA_IMAGE,
                                   100,
                                   GIMP_NORMAL_MODE);
 
-    // Get the drawable for the layer
-    drawable = gimp_drawable_get(new_layer_id);
+    // Set up the indexed color map
+    gimp_image_set_colormap(new_image_id, p_colorpal->p_data, p_colorpal->size);
 
+    // Now FINALLY set the pixel data
+    rom_stats_start(p_app_gfx->p_stats, ROM_STATS_TIME_TRANSFER);
 
-    // Set up the indexed color map
-    gimp_image_set_colormap(new_image_id, colorpal.p_data, colorpal.size);
+    read_rom_bin_set_pixels(new_layer_id, p_app_gfx);
 
-    // Get a pixel region from the layer
-    gimp_pixel_rgn_init(&rgn,
-                        drawable,
-                        0, 0,
-                        app_gfx.width, app_gfx.height,
-                        TRUE, FALSE);
+    rom_stats_stop(p_app_gfx->p_stats, ROM_STATS_TIME_TRANSFER);
+    rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_BYTES_COPIED, p_app_gfx->size);
 
-    // Now FINALLY set the pixel data
-    gimp_pixel_rgn_set_rect(&rgn,
-                            app_gfx.p_data,
-                            0, 0,
-                            app_gfx.width, app_gfx.height);
 
 
+    if ((p_app_gfx->surplus_bytes_size > 0) &&
+        (p_app_gfx->p_surplus_bytes != NULL)) {
 
-    if ((app_gfx.surplus_bytes_size > 0) &&
-        (app_gfx.p_surplus_bytes != NULL)) {
+        rom_stats_start(p_app_gfx->p_stats, ROM_STATS_TIME_PARASITE);
 
         // Store surplus (non-decodable) bytes from the rom into a gimp metadata parasite
          parasite = gimp_parasite_new("ROM-BIN-SURPLUS-BYTES",
                                        GIMP_PARASITE_PERSISTENT,
-                                       app_gfx.surplus_bytes_size,
-                                       app_gfx.p_surplus_bytes);
+                                       p_app_gfx->surplus_bytes_size,
+                                       p_app_gfx->p_surplus_bytes);
          gimp_image_attach_parasite(new_image_id, 
                                     parasite);
          gimp_parasite_free (parasite);
 
-        // Free the surplus bytes now that they are stored as a parasite
-        free(app_gfx.p_surplus_bytes);
+        rom_stats_stop(p_app_gfx->p_stats, ROM_STATS_TIME_PARASITE);
     }
 
 
-    // We're done with the drawable
-    gimp_drawable_flush(drawable);
-    gimp_drawable_detach(drawable);
-
-    // Free the image data
-    free(app_gfx.p_data);
-
-    // Free the color map data
-    free(colorpal.p_data);
-
     // Add the layer to the image
     gimp_image_insert_layer(new_image_id, new_layer_id, -1, 0);
 
     // Set the filename
     gimp_image_set_filename(new_image_id, filename);
 
+    rom_stats_set_status(p_app_gfx->p_stats, 0);
+
+    return new_image_id;
+}
+
+
+
+// Free the raw data, image data, surplus bytes and color map data,
+// reporting the stats for this load if enabled
+void read_rom_bin_job_free(read_rom_bin_job * p_job)
+{
+    rom_stats_end(p_job->app_gfx.p_stats);
+
+    rom_bin_free_structs(&p_job->rom_gfx, &p_job->app_gfx, &p_job->colorpal);
+    rom_bin_arena_release(&p_job->arena);
+}
+
+
+
+int read_rom_bin(const gchar * filename, int image_mode)
+{
+    int new_image_id;
+    read_rom_bin_job job;
+
+    if (0 != read_rom_bin_decode(filename, image_mode, &job))
+        return -1;
+
+    new_image_id = read_rom_bin_create_image(filename, &job);
+
+    read_rom_bin_job_free(&job);
+
     return new_image_id;
 }
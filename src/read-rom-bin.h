@@ -18,4 +18,26 @@
 
 #include <glib.h>
 
-int read_rom_bin(const gchar *, int);
+#include "lib_rom_bin.h"
+#include "rom_stats.h"
+
+#ifndef READ_ROM_BIN_FILE_HEADER
+#define READ_ROM_BIN_FILE_HEADER
+
+    // State for one load, split so the file read + decode can run
+    // on a worker thread and only the GIMP image creation on the main one
+    typedef struct read_rom_bin_job {
+        app_gfx_data   app_gfx;
+        app_color_data colorpal;
+        rom_gfx_data   rom_gfx;
+        rom_bin_arena  arena;
+        rom_stats      stats;
+    } read_rom_bin_job;
+
+    int  read_rom_bin_decode(const gchar *, int, read_rom_bin_job *);
+    int  read_rom_bin_create_image(const gchar *, read_rom_bin_job *);
+    void read_rom_bin_job_free(read_rom_bin_job *);
+
+    int read_rom_bin(const gchar *, int);
+
+#endif // READ_ROM_BIN_FILE_HEADER
@@ -0,0 +1,769 @@
+/*=======================================================================
+              ROM bin load / save plugin for the GIMP
+                 Copyright 2018 - X
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// Palette locator: finds blocks of a rom that read as a plausible color
+// palette in one of the consoles' color formats, so a decode can show the
+// game's own colors instead of the default ramps.
+//
+// Every format leaves some bits of each color unused (always zero), so
+// most of a rom fails validity quickly. That is checked 8 bytes at a
+// time against a mask, one color at a time only where the word fails.
+// Blocks inside a run of valid colors are then scored on what palettes
+// tend to look like: many distinct colors, ramps of close neighbouring
+// colors, color 0 black and repeated at the start of the next palette.
+// Overlapping candidates are reduced to the best scoring one.
+//
+// The colors can also come from outside the rom: palette files and the
+// color ram in emulator save states, see rom_bin_palette_parse().
+
+#include "lib_rom_bin.h"
+
+#include <string.h>
+
+// Blocks scoring below this aren't reported
+#define PALETTE_MIN_SCORE    50
+
+typedef struct palette_format {
+    const char    * p_name;
+    int             color_bytes;
+    int             max_level;       // Per channel
+    unsigned char   zero_bits[2];    // Bits of each color byte that are always clear
+} palette_format;
+
+static const palette_format palette_formats[] = {
+    // 0BBBBBGG GGGRRRRR, little endian (SNES, GBA)
+    [ROM_BIN_PALETTE_BGR555]  = { "bgr555",  2, 31, { 0x00, 0x80 } },
+    // 0000BBB0 GGG0RRR0, big endian (Genesis CRAM)
+    [ROM_BIN_PALETTE_GENESIS] = { "genesis", 2, 7,  { 0xF1, 0x11 } },
+    // 0000BBBB GGGGRRRR, little endian (Game Gear, Neo Geo Pocket Color)
+    [ROM_BIN_PALETTE_GG]      = { "gg",      2, 15, { 0x00, 0xF0 } },
+    // 00BBGGRR (Master System)
+    [ROM_BIN_PALETTE_SMS]     = { "sms",     1, 3,  { 0xC0, 0x00 } },
+};
+
+typedef struct palette_scan {
+    const unsigned char * p_data;
+    int64_t               size;
+    int                   format;
+    int                   num_colors;
+    int                   color_bytes;
+    uint64_t              word_mask;   // zero_bits repeated over 8 bytes
+
+    rom_bin_palette_hit * p_hits;      // Every block scoring high enough
+    int64_t               num_hits;
+    int64_t               max_hits;
+    int                   failed;
+
+    uint64_t              seen[65536 / 64];  // Distinct color bitmap
+} palette_scan;
+
+
+
+const char * rom_bin_palette_format_name(int format)
+{
+    if ((format >= 0) && (format < ROM_BIN_PALETTE_LAST))
+        return palette_formats[format].p_name;
+
+    return NULL;
+}
+
+
+
+// Returns -1 for an unknown name
+int rom_bin_palette_format_from_name(const char * p_name)
+{
+    int c;
+
+    if (NULL == p_name)
+        return -1;
+
+    for (c = 0; c < ROM_BIN_PALETTE_LAST; c++)
+        if (0 == strcmp(p_name, palette_formats[c].p_name))
+            return c;
+
+    return -1;
+}
+
+
+
+// The color format of the console an image mode is for,
+// -1 when it has no color ram (NES, Game Boy)
+int rom_bin_palette_format_for_mode(int image_mode)
+{
+    switch (image_mode) {
+        case BIN_MODE_SNES_3BPP:
+        case BIN_MODE_SNES_4BPP:
+        case BIN_MODE_SNES_8BPP:
+        case BIN_MODE_GBA_4BPP:
+        case BIN_MODE_GBA_8BPP:
+            return ROM_BIN_PALETTE_BGR555;
+
+        case BIN_MODE_GENS_4BPP:
+            return ROM_BIN_PALETTE_GENESIS;
+
+        case BIN_MODE_NGPC_2BPP:
+        case BIN_MODE_GGSMSWSC_4BPP:
+            return ROM_BIN_PALETTE_GG;
+    }
+
+    return -1;
+}
+
+
+
+int64_t rom_bin_palette_color_bytes(int format)
+{
+    if ((format >= 0) && (format < ROM_BIN_PALETTE_LAST))
+        return palette_formats[format].color_bytes;
+
+    return -1;
+}
+
+
+
+static unsigned int palette_raw(int format, const unsigned char * p_color)
+{
+    switch (format) {
+        case ROM_BIN_PALETTE_GENESIS:
+            return ((unsigned int)p_color[0] << 8) | p_color[1];
+
+        case ROM_BIN_PALETTE_SMS:
+            return p_color[0];
+    }
+
+    return p_color[0] | ((unsigned int)p_color[1] << 8);
+}
+
+
+
+static int palette_valid(int format, const unsigned char * p_color)
+{
+    const palette_format * p_format = &palette_formats[format];
+
+    if (p_color[0] & p_format->zero_bits[0])
+        return FALSE;
+
+    return (p_format->color_bytes == 1) || !(p_color[1] & p_format->zero_bits[1]);
+}
+
+
+
+// Red, green and blue in the format's own levels (0 - max_level)
+static void palette_levels(int format, unsigned int raw, int * p_levels)
+{
+    switch (format) {
+        case ROM_BIN_PALETTE_BGR555:
+            p_levels[0] = raw & 0x1F;
+            p_levels[1] = (raw >> 5) & 0x1F;
+            p_levels[2] = (raw >> 10) & 0x1F;
+            break;
+
+        case ROM_BIN_PALETTE_GENESIS:
+            p_levels[0] = (raw >> 1) & 0x07;
+            p_levels[1] = (raw >> 5) & 0x07;
+            p_levels[2] = (raw >> 9) & 0x07;
+            break;
+
+        case ROM_BIN_PALETTE_GG:
+            p_levels[0] = raw & 0x0F;
+            p_levels[1] = (raw >> 4) & 0x0F;
+            p_levels[2] = (raw >> 8) & 0x0F;
+            break;
+
+        default:
+            p_levels[0] = raw & 0x03;
+            p_levels[1] = (raw >> 2) & 0x03;
+            p_levels[2] = (raw >> 4) & 0x03;
+            break;
+    }
+}
+
+
+
+// 0 - 100, how much the colors at p_colors look like a palette
+static int palette_score(palette_scan * p_scan, const unsigned char * p_colors)
+{
+    const palette_format * p_format = &palette_formats[p_scan->format];
+    int                    n        = p_scan->num_colors;
+    int                    levels[2][3];
+    int                    low[3]  = { 255, 255, 255 };
+    int                    high[3] = { 0, 0, 0 };
+    int                    num_distinct = 0;
+    int                    num_close = 0;
+    int                    num_text = 0;
+    int                    num_channels = 0;
+    int                    score;
+    unsigned int           raw;
+    unsigned int           first_raw;
+    int64_t                next;
+    int                    c, ch;
+
+    // Text is valid in most formats (bytes below 0x80), rule it out
+    for (c = 0; c < n * p_scan->color_bytes; c++)
+        if ((p_colors[c] >= 0x20) && (p_colors[c] < 0x7F))
+            num_text++;
+
+    if (num_text * 10 > n * p_scan->color_bytes * 9)
+        return 0;
+
+    first_raw = palette_raw(p_scan->format, p_colors);
+
+    for (c = 0; c < n; c++) {
+        int * p_levels = levels[c & 1];
+        int * p_prev   = levels[(c & 1) ^ 1];
+
+        raw = palette_raw(p_scan->format, p_colors + (c * p_scan->color_bytes));
+
+        if (!(p_scan->seen[raw >> 6] & (1ull << (raw & 63)))) {
+            p_scan->seen[raw >> 6] |= 1ull << (raw & 63);
+            num_distinct++;
+        }
+
+        palette_levels(p_scan->format, raw, p_levels);
+
+        for (ch = 0; ch < 3; ch++) {
+            if (p_levels[ch] < low[ch])  low[ch]  = p_levels[ch];
+            if (p_levels[ch] > high[ch]) high[ch] = p_levels[ch];
+        }
+
+        // Neighbours within a quarter of the range on every channel, not
+        // counting color 0 (usually transparent, unrelated to the rest)
+        if (c >= 2) {
+            int step = 0;
+
+            for (ch = 0; ch < 3; ch++) {
+                int delta = p_levels[ch] - p_prev[ch];
+
+                if (delta < 0)
+                    delta = -delta;
+                if (delta > step)
+                    step = delta;
+            }
+
+            if ((step > 0) && (step * 4 <= p_format->max_level + 1))
+                num_close++;
+        }
+    }
+
+    // Only the words that were set are cleared
+    for (c = 0; c < n; c++) {
+        raw = palette_raw(p_scan->format, p_colors + (c * p_scan->color_bytes));
+        p_scan->seen[raw >> 6] = 0;
+    }
+
+    for (ch = 0; ch < 3; ch++)
+        if (high[ch] > low[ch])
+            num_channels++;
+
+    if ((num_distinct < 3) || (num_distinct * 4 < n) || (num_channels < 2))
+        return 0;
+
+    score = (n > 2) ? (num_close * 50) / (n - 2) : 0;
+    score += (num_distinct * 30) / n;
+
+    if (0 == first_raw)
+        score += 10;
+
+    // Palettes come in tables that share color 0 (transparent)
+    next = (p_colors - p_scan->p_data) + ((int64_t)n * p_scan->color_bytes);
+    if ((next + p_scan->color_bytes <= p_scan->size) &&
+        (palette_raw(p_scan->format, p_scan->p_data + next) == first_raw))
+        score += 10;
+
+    return score;
+}
+
+
+
+static void palette_add_hit(palette_scan * p_scan, int64_t offset, int score)
+{
+    rom_bin_palette_hit * p_hit;
+
+    if (p_scan->failed)
+        return;
+
+    if (p_scan->num_hits == p_scan->max_hits) {
+        int64_t               max_hits = (p_scan->max_hits) ? (p_scan->max_hits * 2) : 1024;
+        rom_bin_palette_hit * p_grown;
+
+        if (NULL == (p_grown = rom_bin_alloc((size_t)max_hits * sizeof(rom_bin_palette_hit)))) {
+            p_scan->failed = TRUE;
+            return;
+        }
+
+        if (p_scan->num_hits)
+            memcpy(p_grown, p_scan->p_hits, (size_t)p_scan->num_hits * sizeof(rom_bin_palette_hit));
+        rom_bin_free(p_scan->p_hits);
+
+        p_scan->p_hits   = p_grown;
+        p_scan->max_hits = max_hits;
+    }
+
+    p_hit = &p_scan->p_hits[p_scan->num_hits++];
+
+    p_hit->offset     = offset;
+    p_hit->format     = p_scan->format;
+    p_hit->num_colors = p_scan->num_colors;
+    p_hit->score      = score;
+}
+
+
+
+// Scores every block of a run of valid colors, [start, end) in colors
+// from the parity's first byte
+static void palette_run(palette_scan * p_scan, int parity, int64_t start, int64_t end)
+{
+    int     n = p_scan->num_colors;
+    int     min_changes = ((n / 4 > 3) ? (n / 4) : 3) - 1;
+    int     num_changes = 0;
+    int64_t c;
+
+    if (end - start < n)
+        return;
+
+    // Colors different from the one before. A block needs a few of them
+    // to hold enough distinct colors, which rules out blank areas cheaply
+    #define PALETTE_CHANGE(i) \
+        (palette_raw(p_scan->format, p_scan->p_data + parity + ((i) * p_scan->color_bytes)) != \
+         palette_raw(p_scan->format, p_scan->p_data + parity + (((i) - 1) * p_scan->color_bytes)))
+
+    for (c = start + 1; c < start + n; c++)
+        num_changes += PALETTE_CHANGE(c);
+
+    for (c = start; c + n <= end; c++) {
+        if (c > start)
+            num_changes += PALETTE_CHANGE(c + n - 1) - PALETTE_CHANGE(c);
+
+        if (num_changes >= min_changes) {
+            int64_t offset = parity + (c * p_scan->color_bytes);
+            int     score  = palette_score(p_scan, p_scan->p_data + offset);
+
+            if (score >= PALETTE_MIN_SCORE)
+                palette_add_hit(p_scan, offset, score);
+        }
+    }
+
+    #undef PALETTE_CHANGE
+}
+
+
+
+static void palette_scan_format(palette_scan * p_scan)
+{
+    const palette_format * p_format = &palette_formats[p_scan->format];
+    unsigned char          mask_bytes[8];
+    int                    step = 8 / p_format->color_bytes;
+    int                    parity;
+    int                    c;
+
+    p_scan->color_bytes = p_format->color_bytes;
+
+    // Same byte order as the data, so the word test is endian neutral
+    for (c = 0; c < 8; c++)
+        mask_bytes[c] = p_format->zero_bits[c % p_format->color_bytes];
+    memcpy(&p_scan->word_mask, mask_bytes, 8);
+
+    for (parity = 0; parity < p_format->color_bytes; parity++) {
+        int64_t num_colors = (p_scan->size - parity) / p_format->color_bytes;
+        int64_t run_start  = 0;
+        int64_t c_color    = 0;
+
+        while (c_color < num_colors) {
+            int64_t  pos = parity + (c_color * p_format->color_bytes);
+            uint64_t word;
+
+            // Four (or eight) colors at once while they're all valid
+            if (pos + 8 <= p_scan->size) {
+                memcpy(&word, p_scan->p_data + pos, 8);
+                if (0 == (word & p_scan->word_mask)) {
+                    c_color += step;
+                    continue;
+                }
+            }
+
+            if (!palette_valid(p_scan->format, p_scan->p_data + pos)) {
+                palette_run(p_scan, parity, run_start, c_color);
+                run_start = c_color + 1;
+            }
+
+            c_color++;
+        }
+
+        palette_run(p_scan, parity, run_start, num_colors);
+    }
+}
+
+
+
+static int palette_compare_hits(const void * p_a, const void * p_b)
+{
+    const rom_bin_palette_hit * p_hit_a = p_a;
+    const rom_bin_palette_hit * p_hit_b = p_b;
+
+    if (p_hit_a->score != p_hit_b->score)
+        return (p_hit_a->score > p_hit_b->score) ? -1 : 1;
+
+    if (p_hit_a->offset != p_hit_b->offset)
+        return (p_hit_a->offset < p_hit_b->offset) ? -1 : 1;
+
+    return (p_hit_a->format < p_hit_b->format) ? -1 : (p_hit_a->format > p_hit_b->format);
+}
+
+
+
+// Looks for palettes of num_colors colors in one format (-1 = all of
+// them). Up to max_hits of the best, non-overlapping, are stored in
+// p_hits from best to worst. Returns their count, -1 on failure
+int rom_bin_find_palettes(const unsigned char * p_data, int64_t size,
+                          int format, int num_colors,
+                          rom_bin_palette_hit * p_hits, int max_hits)
+{
+    palette_scan * p_scan;
+    int            num_found = 0;
+    int64_t        c;
+    int            f;
+
+    if ((NULL == p_data) || (NULL == p_hits) || (size < 0) || (max_hits < 0) ||
+        (format < -1) || (format >= ROM_BIN_PALETTE_LAST) ||
+        (num_colors < 2) || (num_colors > 256))
+        return -1;
+
+    // The distinct color bitmap is a bit large for the stack
+    if (NULL == (p_scan = rom_bin_alloc(sizeof(palette_scan))))
+        return -1;
+
+    memset(p_scan, 0, sizeof(palette_scan));
+    p_scan->p_data     = p_data;
+    p_scan->size       = size;
+    p_scan->num_colors = num_colors;
+
+    for (f = 0; f < ROM_BIN_PALETTE_LAST; f++)
+        if ((format == -1) || (format == f)) {
+            p_scan->format = f;
+            palette_scan_format(p_scan);
+        }
+
+    if (p_scan->failed) {
+        rom_bin_free(p_scan->p_hits);
+        rom_bin_free(p_scan);
+        return -1;
+    }
+
+    // Best first, then drop whatever overlaps a better one
+    // (shifted copies of the same block, other formats reading it)
+    if (p_scan->num_hits > 1)
+        qsort(p_scan->p_hits, (size_t)p_scan->num_hits, sizeof(rom_bin_palette_hit), palette_compare_hits);
+
+    for (c = 0; (c < p_scan->num_hits) && (num_found < max_hits); c++) {
+        const rom_bin_palette_hit * p_hit = &p_scan->p_hits[c];
+        int64_t                     end   = p_hit->offset + (p_hit->num_colors * rom_bin_palette_color_bytes(p_hit->format));
+        int                         h;
+
+        for (h = 0; h < num_found; h++) {
+            int64_t hit_end = p_hits[h].offset + (p_hits[h].num_colors * rom_bin_palette_color_bytes(p_hits[h].format));
+
+            if ((p_hit->offset < hit_end) && (p_hits[h].offset < end))
+                break;
+        }
+
+        if (h == num_found)
+            p_hits[num_found++] = *p_hit;
+    }
+
+    rom_bin_free(p_scan->p_hits);
+    rom_bin_free(p_scan);
+
+    return num_found;
+}
+
+
+
+// Fills a decoded color map from colors stored in a console's format,
+// as many as both hold. Returns -1 if there isn't a single color
+int rom_bin_palette_decode(int format, const unsigned char * p_data, int64_t size,
+                           app_color_data * p_colorpal)
+{
+    const palette_format * p_format;
+    int64_t                num_colors;
+    int                    levels[3];
+    int64_t                c;
+    int                    ch;
+
+    if ((format < 0) || (format >= ROM_BIN_PALETTE_LAST) ||
+        (NULL == p_data) || (NULL == p_colorpal->p_data) || (p_colorpal->bytes_per_pixel != 3))
+        return -1;
+
+    p_format   = &palette_formats[format];
+    num_colors = size / p_format->color_bytes;
+    if (num_colors > p_colorpal->size)
+        num_colors = p_colorpal->size;
+
+    if (num_colors <= 0)
+        return -1;
+
+    for (c = 0; c < num_colors; c++) {
+        palette_levels(format, palette_raw(format, p_data + (c * p_format->color_bytes)), levels);
+
+        // Full scale: the top level is 0xFF
+        for (ch = 0; ch < 3; ch++)
+            p_colorpal->p_data[(c * 3) + ch] =
+                (unsigned char)(((levels[ch] * 255) + (p_format->max_level / 2)) / p_format->max_level);
+    }
+
+    return 0;
+}
+
+
+
+// Palette files and emulator save states, for rom_bin_palette_parse()
+
+#define PALETTE_ZSNES_CGRAM   0x618   // 256 BGR555 colors
+#define PALETTE_GENS_CRAM     0x112   // 64 Genesis colors, little endian words
+#define PALETTE_MGBA_PALETTE  0x800   // 512 BGR555 colors, backgrounds first
+#define PALETTE_MGBA_SIZE     0x61000
+
+typedef struct palette_text {
+    const unsigned char * p_data;
+    int64_t               size;
+    int64_t               pos;
+} palette_text;
+
+
+
+static int palette_starts_with(const unsigned char * p_data, int64_t size, int64_t at, const char * p_magic)
+{
+    size_t len = strlen(p_magic);
+
+    return (at + (int64_t)len <= size) && (0 == memcmp(p_data + at, p_magic, len));
+}
+
+
+
+// Moves to the start of the next line
+static void palette_text_next_line(palette_text * p_text)
+{
+    while ((p_text->pos < p_text->size) && (p_text->p_data[p_text->pos] != '\n'))
+        p_text->pos++;
+
+    if (p_text->pos < p_text->size)
+        p_text->pos++;
+}
+
+
+
+// Reads a decimal number on the current line, FALSE if there isn't one
+static int palette_text_number(palette_text * p_text, int * p_value)
+{
+    int value  = 0;
+    int digits = 0;
+
+    while ((p_text->pos < p_text->size) &&
+           ((p_text->p_data[p_text->pos] == ' ') || (p_text->p_data[p_text->pos] == '\t')))
+        p_text->pos++;
+
+    while ((p_text->pos < p_text->size) &&
+           (p_text->p_data[p_text->pos] >= '0') && (p_text->p_data[p_text->pos] <= '9') && (digits < 6)) {
+        value = (value * 10) + (p_text->p_data[p_text->pos++] - '0');
+        digits++;
+    }
+
+    *p_value = value;
+
+    return digits > 0;
+}
+
+
+
+// "r g b" lines, as in JASC and GIMP palettes. Lines that don't start
+// with three numbers (comments, names, headers) are skipped
+static int palette_parse_text_colors(palette_text * p_text, int max_colors, app_color_data * p_colorpal)
+{
+    int num_colors = 0;
+    int rgb[3];
+
+    while ((p_text->pos < p_text->size) && (num_colors < p_colorpal->size) && (num_colors < max_colors)) {
+        if (palette_text_number(p_text, &rgb[0]) &&
+            palette_text_number(p_text, &rgb[1]) &&
+            palette_text_number(p_text, &rgb[2]) &&
+            (rgb[0] < 256) && (rgb[1] < 256) && (rgb[2] < 256)) {
+            p_colorpal->p_data[(num_colors * 3)]     = (unsigned char)rgb[0];
+            p_colorpal->p_data[(num_colors * 3) + 1] = (unsigned char)rgb[1];
+            p_colorpal->p_data[(num_colors * 3) + 2] = (unsigned char)rgb[2];
+            num_colors++;
+        }
+
+        palette_text_next_line(p_text);
+    }
+
+    return (num_colors > 0) ? num_colors : -1;
+}
+
+
+
+// R,G,B byte triplets with a stride (4 for RIFF palettes, which add a flags byte)
+static int palette_parse_triplets(const unsigned char * p_data, int64_t num_colors, int stride,
+                                  app_color_data * p_colorpal)
+{
+    int64_t c;
+
+    if (num_colors > p_colorpal->size)
+        num_colors = p_colorpal->size;
+
+    for (c = 0; c < num_colors; c++)
+        memcpy(p_colorpal->p_data + (c * 3), p_data + (c * stride), 3);
+
+    return (num_colors > 0) ? (int)num_colors : -1;
+}
+
+
+
+// Console colors stored somewhere in a file, as many as are there
+static int palette_parse_console(int format, const unsigned char * p_data, int64_t size,
+                                 int64_t at, int64_t length, app_color_data * p_colorpal)
+{
+    int64_t num_colors = length / palette_formats[format].color_bytes;
+
+    if (at + length > size)
+        return -1;
+
+    if (num_colors > p_colorpal->size)
+        num_colors = p_colorpal->size;
+
+    if (0 != rom_bin_palette_decode(format, p_data + at, length, p_colorpal))
+        return -1;
+
+    return (int)num_colors;
+}
+
+
+
+// Whether the file name ends in the extension, ignoring case
+static int palette_has_extension(const char * p_name, const char * p_ext)
+{
+    size_t name_len = (p_name) ? strlen(p_name) : 0;
+    size_t ext_len  = strlen(p_ext);
+    size_t c;
+
+    if (name_len < ext_len)
+        return 0;
+
+    for (c = 0; c < ext_len; c++) {
+        char ch = p_name[name_len - ext_len + c];
+
+        if (((ch >= 'A') && (ch <= 'Z') ? (char)(ch - 'A' + 'a') : ch) != p_ext[c])
+            return 0;
+    }
+
+    return 1;
+}
+
+
+
+// Fills a decoded color map from the contents of a palette file:
+//   JASC-PAL and GIMP (.gpl) text palettes, RIFF (Microsoft) palettes,
+//   ZSNES (.zst), Gens (.gs0) and mGBA (.ss0) save states,
+//   and for .pal / .act names only, Photoshop .act (768 bytes, 772
+//   with a color count) or up to 256 R,G,B byte triplets.
+// Formats are recognized by what the file holds. The name (may be NULL)
+// only keeps headerless data from being read as colors: a save state
+// name that doesn't hold a known save state is rejected, and raw
+// triplets need a palette name and a plausible size.
+// Returns the number of colors replaced, the rest are unchanged,
+// or -1 when there are none
+int rom_bin_palette_parse(const char * p_name, const unsigned char * p_data, int64_t size, app_color_data * p_colorpal)
+{
+    palette_text text;
+    int          num_colors;
+    int          save_state;
+
+    if ((NULL == p_data) || (size <= 0) || (NULL == p_colorpal->p_data) || (p_colorpal->bytes_per_pixel != 3))
+        return -1;
+
+    save_state = palette_has_extension(p_name, ".zst") || palette_has_extension(p_name, ".gs0") ||
+                 palette_has_extension(p_name, ".ss0");
+
+    text.p_data = p_data;
+    text.size   = size;
+    text.pos    = 0;
+
+    // JASC-PAL / 0100 / count, then the colors
+    if (!save_state && palette_starts_with(p_data, size, 0, "JASC-PAL")) {
+        palette_text_next_line(&text);
+        palette_text_next_line(&text);
+
+        if (!palette_text_number(&text, &num_colors))
+            return -1;
+        palette_text_next_line(&text);
+
+        return palette_parse_text_colors(&text, num_colors, p_colorpal);
+    }
+
+    if (!save_state && palette_starts_with(p_data, size, 0, "GIMP Palette")) {
+        palette_text_next_line(&text);
+
+        return palette_parse_text_colors(&text, 256, p_colorpal);
+    }
+
+    // RIFF / size / "PAL " / "data" / size / version (2) / count (2)
+    if (!save_state && palette_starts_with(p_data, size, 0, "RIFF") &&
+        palette_starts_with(p_data, size, 8, "PAL data") && (size >= 24)) {
+        int64_t count = p_data[22] | ((int64_t)p_data[23] << 8);
+
+        if (24 + (count * 4) > size)
+            count = (size - 24) / 4;
+
+        return palette_parse_triplets(p_data + 24, count, 4, p_colorpal);
+    }
+
+    if (palette_starts_with(p_data, size, 0, "ZSNES Save State File"))
+        return palette_parse_console(ROM_BIN_PALETTE_BGR555, p_data, size, PALETTE_ZSNES_CGRAM, 512, p_colorpal);
+
+    // Gens keeps CRAM in host (little endian) order
+    if (palette_starts_with(p_data, size, 0, "GST") && (size >= PALETTE_GENS_CRAM + 128)) {
+        unsigned char cram[128];
+        int           c;
+
+        for (c = 0; c < 128; c += 2) {
+            cram[c]     = p_data[PALETTE_GENS_CRAM + c + 1];
+            cram[c + 1] = p_data[PALETTE_GENS_CRAM + c];
+        }
+
+        return palette_parse_console(ROM_BIN_PALETTE_GENESIS, cram, 128, 0, 128, p_colorpal);
+    }
+
+    // mGBA: a 0x01000000 + version magic and a fixed size
+    if ((size >= PALETTE_MGBA_SIZE) && (p_data[3] == 0x01) && (p_data[2] == 0x00) && (p_data[1] == 0x00))
+        return palette_parse_console(ROM_BIN_PALETTE_BGR555, p_data, size, PALETTE_MGBA_PALETTE, 1024, p_colorpal);
+
+    // Anything else has no header to check
+    if (!palette_has_extension(p_name, ".pal") && !palette_has_extension(p_name, ".act"))
+        return -1;
+
+    // Photoshop: 256 colors, then optionally a big endian count and
+    // transparent index
+    if (size == 772) {
+        int64_t count = ((int64_t)p_data[768] << 8) | p_data[769];
+
+        return palette_parse_triplets(p_data, ((count > 0) && (count <= 256)) ? count : 256, 3, p_colorpal);
+    }
+
+    if ((size % 3) || (size > 256 * 3))
+        return -1;
+
+    return palette_parse_triplets(p_data, size / 3, 3, p_colorpal);
+}
@@ -0,0 +1,510 @@
+/*=======================================================================
+              ROM bin load / save plugin for the GIMP
+                 Copyright 2018 - X
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+// IPS / BPS patch output: the changes an encode makes to a rom, without
+// writing the whole rom.
+//
+// Only the encoded range is compared with the rom, so the cost follows
+// the size of the graphics, not of the rom. Unchanged stretches are
+// skipped a block at a time, then each changed run becomes a record
+// (literal, or run-length for repeated bytes). BPS also needs the CRC32
+// of the whole source and target, which is the one full pass over the rom.
+
+#include "lib_rom_bin.h"
+
+#include <string.h>
+
+// IPS offsets are 24 bits, records at most 64 KiB. A record can't start
+// at 0x454F46, its offset would read as the "EOF" marker
+#define PATCH_IPS_MAX_SIZE   0x1000000
+#define PATCH_IPS_MAX_RECORD 0xFFFF
+#define PATCH_IPS_EOF_OFFSET 0x454F46
+
+// Unchanged gaps shorter than this are cheaper inside the record than
+// as the header of a new one
+#define PATCH_MERGE_GAP      6
+
+// Repeated bytes become a run-length record from this many on
+#define PATCH_MIN_RLE        9
+
+// Unchanged data is skipped this many bytes at a time
+#define PATCH_BLOCK_SIZE     64
+
+typedef struct patch_input {
+    const unsigned char * p_source;
+    int64_t               source_size;
+    const unsigned char * p_data;       // Encoded graphics
+    int64_t               size;
+    int64_t               offset;       // Where p_data goes in the source
+    int64_t               same_limit;   // Past this, data has no source byte to match
+} patch_input;
+
+typedef struct patch_buffer {
+    unsigned char * p_data;
+    int64_t         size;
+    int64_t         capacity;
+    int             failed;
+} patch_buffer;
+
+
+
+static void patch_put(patch_buffer * p_buffer, const void * p_bytes, int64_t len)
+{
+    if (p_buffer->failed)
+        return;
+
+    if (p_buffer->size + len > p_buffer->capacity) {
+        int64_t         capacity = p_buffer->capacity * 2;
+        unsigned char * p_grown;
+
+        while (capacity < p_buffer->size + len)
+            capacity *= 2;
+
+        if (NULL == (p_grown = rom_bin_alloc((size_t)capacity))) {
+            p_buffer->failed = TRUE;
+            return;
+        }
+
+        memcpy(p_grown, p_buffer->p_data, (size_t)p_buffer->size);
+        rom_bin_free(p_buffer->p_data);
+
+        p_buffer->p_data   = p_grown;
+        p_buffer->capacity = capacity;
+    }
+
+    memcpy(p_buffer->p_data + p_buffer->size, p_bytes, (size_t)len);
+    p_buffer->size += len;
+}
+
+
+
+static void patch_put_byte(patch_buffer * p_buffer, unsigned char value)
+{
+    patch_put(p_buffer, &value, 1);
+}
+
+
+
+static int patch_same(const patch_input * p_in, int64_t pos)
+{
+    return (pos < p_in->same_limit) && (p_in->p_data[pos] == p_in->p_source[p_in->offset + pos]);
+}
+
+
+
+// Finds the next run of changed bytes at or after *p_pos, as [start, end)
+// in p_data. Runs separated by short unchanged gaps are merged.
+// Returns FALSE when there are no more changes
+static int patch_next_run(const patch_input * p_in, int64_t * p_pos, int64_t * p_start, int64_t * p_end)
+{
+    const unsigned char * p_source = p_in->p_source + p_in->offset;
+    int64_t               pos      = *p_pos;
+    int64_t               end;
+    int64_t               gap;
+    uint64_t              a;
+    uint64_t              b;
+
+    // Skip what didn't change, whole blocks first (memcmp is vectorized),
+    // then words, then bytes
+    while ((pos + PATCH_BLOCK_SIZE <= p_in->same_limit) &&
+           (0 == memcmp(p_in->p_data + pos, p_source + pos, PATCH_BLOCK_SIZE)))
+        pos += PATCH_BLOCK_SIZE;
+
+    while (pos + 8 <= p_in->same_limit) {
+        memcpy(&a, p_in->p_data + pos, 8);
+        memcpy(&b, p_source + pos, 8);
+        if (a != b)
+            break;
+        pos += 8;
+    }
+
+    while ((pos < p_in->size) && patch_same(p_in, pos))
+        pos++;
+
+    if (pos >= p_in->size) {
+        *p_pos = pos;
+        return FALSE;
+    }
+
+    *p_start = pos;
+
+    for (end = pos; ; ) {
+        while ((end < p_in->size) && !patch_same(p_in, end))
+            end++;
+
+        for (gap = end; (gap < p_in->size) && (gap - end < PATCH_MERGE_GAP) && patch_same(p_in, gap); gap++)
+            ;
+
+        if ((gap >= p_in->size) || (gap - end >= PATCH_MERGE_GAP))
+            break;
+
+        end = gap;
+    }
+
+    *p_end = end;
+    *p_pos = end;
+
+    return TRUE;
+}
+
+
+
+// Number of times p_data[pos] repeats, counted up to max
+static int64_t patch_repeat(const unsigned char * p_data, int64_t pos, int64_t end, int64_t max)
+{
+    int64_t len = 1;
+
+    while ((pos + len < end) && (len < max) && (p_data[pos + len] == p_data[pos]))
+        len++;
+
+    return len;
+}
+
+
+
+// Byte of the patched rom at an absolute offset
+static unsigned char patch_target_byte(const patch_input * p_in, int64_t at)
+{
+    if ((at >= p_in->offset) && (at < p_in->offset + p_in->size))
+        return p_in->p_data[at - p_in->offset];
+
+    return p_in->p_source[at];
+}
+
+
+
+static void patch_ips_header(patch_buffer * p_buffer, int64_t at, int64_t len)
+{
+    unsigned char header[5];
+
+    header[0] = (unsigned char)(at >> 16);
+    header[1] = (unsigned char)(at >> 8);
+    header[2] = (unsigned char)at;
+    header[3] = (unsigned char)(len >> 8);
+    header[4] = (unsigned char)len;
+
+    patch_put(p_buffer, header, 5);
+}
+
+
+
+// Splits a changed run into literal and run-length records
+static void patch_ips_run(const patch_input * p_in, patch_buffer * p_buffer, int64_t start, int64_t end)
+{
+    int64_t pos = start;
+    int64_t len;
+
+    while (pos < end) {
+        int64_t at = p_in->offset + pos;
+
+        // Can't start here, start one byte earlier with a 2 byte record
+        if (at == PATCH_IPS_EOF_OFFSET) {
+            patch_ips_header(p_buffer, at - 1, 2);
+            patch_put_byte(p_buffer, patch_target_byte(p_in, at - 1));
+            patch_put_byte(p_buffer, p_in->p_data[pos]);
+            pos++;
+            continue;
+        }
+
+        len = patch_repeat(p_in->p_data, pos, end, PATCH_IPS_MAX_RECORD);
+
+        if (len >= PATCH_MIN_RLE) {
+            unsigned char rle[3];
+
+            rle[0] = (unsigned char)(len >> 8);
+            rle[1] = (unsigned char)len;
+            rle[2] = p_in->p_data[pos];
+
+            patch_ips_header(p_buffer, at, 0);
+            patch_put(p_buffer, rle, 3);
+            pos += len;
+            continue;
+        }
+
+        // Literal up to the next repeat worth a record of its own
+        for (len = 1; (pos + len < end) && (len < PATCH_IPS_MAX_RECORD); len++)
+            if ((p_in->offset + pos + len == PATCH_IPS_EOF_OFFSET) ||
+                (patch_repeat(p_in->p_data, pos + len, end, PATCH_MIN_RLE) >= PATCH_MIN_RLE))
+                break;
+
+        patch_ips_header(p_buffer, at, len);
+        patch_put(p_buffer, p_in->p_data + pos, len);
+        pos += len;
+    }
+}
+
+
+
+static int patch_make_ips(const patch_input * p_in, patch_buffer * p_buffer)
+{
+    int64_t pos = 0;
+    int64_t start;
+    int64_t end;
+
+    // Whatever the graphics change has to be addressable
+    if (p_in->offset + p_in->size > PATCH_IPS_MAX_SIZE)
+        return -1;
+
+    patch_put(p_buffer, "PATCH", 5);
+
+    while (patch_next_run(p_in, &pos, &start, &end))
+        patch_ips_run(p_in, p_buffer, start, end);
+
+    patch_put(p_buffer, "EOF", 3);
+
+    return 0;
+}
+
+
+
+// Slicing-by-8 CRC32, the table is rebuilt for each patch (8 KiB, a few
+// microseconds) so there is no shared state between threads
+static void patch_crc32_init(uint32_t table[8][256])
+{
+    uint32_t crc;
+    int      c;
+    int      bit;
+    int      slice;
+
+    for (c = 0; c < 256; c++) {
+        crc = (uint32_t)c;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0);
+        table[0][c] = crc;
+    }
+
+    for (c = 0; c < 256; c++)
+        for (slice = 1; slice < 8; slice++)
+            table[slice][c] = (table[slice - 1][c] >> 8) ^ table[0][table[slice - 1][c] & 0xFF];
+}
+
+
+
+// Continues a CRC32, start with 0
+static uint32_t patch_crc32(uint32_t table[8][256], uint32_t crc, const unsigned char * p_data, int64_t len)
+{
+    crc = ~crc;
+
+    while (len >= 8) {
+        uint32_t low  = crc ^ ((uint32_t)p_data[0]       | ((uint32_t)p_data[1] << 8) |
+                               ((uint32_t)p_data[2] << 16) | ((uint32_t)p_data[3] << 24));
+        uint32_t high =         (uint32_t)p_data[4]       | ((uint32_t)p_data[5] << 8) |
+                               ((uint32_t)p_data[6] << 16) | ((uint32_t)p_data[7] << 24);
+
+        crc = table[7][low & 0xFF]          ^ table[6][(low >> 8) & 0xFF] ^
+              table[5][(low >> 16) & 0xFF]  ^ table[4][low >> 24] ^
+              table[3][high & 0xFF]         ^ table[2][(high >> 8) & 0xFF] ^
+              table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+
+        p_data += 8;
+        len    -= 8;
+    }
+
+    while (len-- > 0)
+        crc = (crc >> 8) ^ table[0][(crc ^ *p_data++) & 0xFF];
+
+    return ~crc;
+}
+
+
+
+static void patch_put_crc32(patch_buffer * p_buffer, uint32_t crc)
+{
+    unsigned char bytes[4];
+
+    bytes[0] = (unsigned char)crc;
+    bytes[1] = (unsigned char)(crc >> 8);
+    bytes[2] = (unsigned char)(crc >> 16);
+    bytes[3] = (unsigned char)(crc >> 24);
+
+    patch_put(p_buffer, bytes, 4);
+}
+
+
+
+// BPS variable length number
+static void patch_bps_number(patch_buffer * p_buffer, uint64_t value)
+{
+    for (;;) {
+        unsigned char bits = value & 0x7F;
+
+        value >>= 7;
+        if (0 == value) {
+            patch_put_byte(p_buffer, 0x80 | bits);
+            return;
+        }
+
+        patch_put_byte(p_buffer, bits);
+        value--;
+    }
+}
+
+
+
+enum patch_bps_actions {
+    PATCH_BPS_SOURCE_READ,
+    PATCH_BPS_TARGET_READ,
+    PATCH_BPS_SOURCE_COPY,
+    PATCH_BPS_TARGET_COPY
+};
+
+static void patch_bps_action(patch_buffer * p_buffer, int action, int64_t len)
+{
+    patch_bps_number(p_buffer, ((uint64_t)(len - 1) << 2) | (uint64_t)action);
+}
+
+
+
+// Repeats are one literal byte, then a copy of the target from that byte
+static void patch_bps_run(const patch_input * p_in, patch_buffer * p_buffer,
+                          int64_t start, int64_t end, int64_t * p_target_relative)
+{
+    int64_t pos = start;
+    int64_t len;
+    int64_t delta;
+
+    while (pos < end) {
+        len = patch_repeat(p_in->p_data, pos, end, end - pos);
+
+        if (len >= PATCH_MIN_RLE) {
+            patch_bps_action(p_buffer, PATCH_BPS_TARGET_READ, 1);
+            patch_put_byte(p_buffer, p_in->p_data[pos]);
+
+            delta = (p_in->offset + pos) - *p_target_relative;
+            patch_bps_action(p_buffer, PATCH_BPS_TARGET_COPY, len - 1);
+            patch_bps_number(p_buffer, ((uint64_t)((delta < 0) ? -delta : delta) << 1) | (delta < 0));
+
+            *p_target_relative = p_in->offset + pos + len - 1;
+            pos += len;
+            continue;
+        }
+
+        for (len = 1; pos + len < end; len++)
+            if (patch_repeat(p_in->p_data, pos + len, end, PATCH_MIN_RLE) >= PATCH_MIN_RLE)
+                break;
+
+        patch_bps_action(p_buffer, PATCH_BPS_TARGET_READ, len);
+        patch_put(p_buffer, p_in->p_data + pos, len);
+        pos += len;
+    }
+}
+
+
+
+static int patch_make_bps(const patch_input * p_in, patch_buffer * p_buffer)
+{
+    uint32_t table[8][256];
+    uint32_t crc;
+    int64_t  target_size = p_in->source_size;
+    int64_t  target_relative = 0;
+    int64_t  written = 0;           // Target bytes covered so far
+    int64_t  pos = 0;
+    int64_t  start;
+    int64_t  end;
+
+    if (p_in->offset + p_in->size > target_size)
+        target_size = p_in->offset + p_in->size;
+
+    patch_put(p_buffer, "BPS1", 4);
+    patch_bps_number(p_buffer, (uint64_t)p_in->source_size);
+    patch_bps_number(p_buffer, (uint64_t)target_size);
+    patch_bps_number(p_buffer, 0);  // No metadata
+
+    // Unchanged bytes are read from the source in one action
+    while (patch_next_run(p_in, &pos, &start, &end)) {
+        if (p_in->offset + start > written)
+            patch_bps_action(p_buffer, PATCH_BPS_SOURCE_READ, p_in->offset + start - written);
+
+        patch_bps_run(p_in, p_buffer, start, end, &target_relative);
+        written = p_in->offset + end;
+    }
+
+    if (target_size > written)
+        patch_bps_action(p_buffer, PATCH_BPS_SOURCE_READ, target_size - written);
+
+    // Source, target, then patch checksums. The target is the source
+    // with the graphics written over it
+    patch_crc32_init(table);
+
+    patch_put_crc32(p_buffer, patch_crc32(table, 0, p_in->p_source, p_in->source_size));
+
+    crc = patch_crc32(table, 0, p_in->p_source, p_in->offset);
+    crc = patch_crc32(table, crc, p_in->p_data, p_in->size);
+    if (p_in->offset + p_in->size < p_in->source_size)
+        crc = patch_crc32(table, crc, p_in->p_source + p_in->offset + p_in->size,
+                          p_in->source_size - (p_in->offset + p_in->size));
+    patch_put_crc32(p_buffer, crc);
+
+    if (!p_buffer->failed)
+        patch_put_crc32(p_buffer, patch_crc32(table, 0, p_buffer->p_data, p_buffer->size));
+
+    return 0;
+}
+
+
+
+// Makes a patch that writes p_data (ex: freshly encoded tiles) at offset
+// into the source rom. The data may run past the end of the source, but
+// must start inside it. The patch is allocated with rom_bin_alloc()
+int rom_bin_make_patch(int format,
+                       const unsigned char * p_source, int64_t source_size,
+                       const unsigned char * p_data, int64_t size, int64_t offset,
+                       unsigned char ** pp_patch, int64_t * p_patch_size)
+{
+    patch_input  input;
+    patch_buffer buffer;
+    int          status;
+
+    *pp_patch     = NULL;
+    *p_patch_size = 0;
+
+    if ((NULL == p_source) || (NULL == p_data) || (size <= 0) ||
+        (offset < 0) || (offset > source_size))
+        return -1;
+
+    input.p_source    = p_source;
+    input.source_size = source_size;
+    input.p_data      = p_data;
+    input.size        = size;
+    input.offset      = offset;
+    input.same_limit  = (source_size - offset < size) ? source_size - offset : size;
+
+    // Sized for a few records, grows as needed
+    buffer.size     = 0;
+    buffer.capacity = 4096;
+    buffer.failed   = FALSE;
+    if (NULL == (buffer.p_data = rom_bin_alloc((size_t)buffer.capacity)))
+        return -1;
+
+    if (format == ROM_BIN_PATCH_IPS)
+        status = patch_make_ips(&input, &buffer);
+    else if (format == ROM_BIN_PATCH_BPS)
+        status = patch_make_bps(&input, &buffer);
+    else
+        status = -1;
+
+    if ((0 != status) || buffer.failed) {
+        rom_bin_free(buffer.p_data);
+        return -1;
+    }
+
+    *pp_patch     = buffer.p_data;
+    *p_patch_size = buffer.size;
+
+    return 0;
+}
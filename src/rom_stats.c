@@ -0,0 +1,183 @@
+/*=======================================================================
+              ROM bin load / save plugin for the GIMP
+                 Copyright 2018 - X
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+#include "rom_stats.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#define ROM_STATS_ENV_VAR "ROM_BIN_STATS"
+
+// One JSON line, built before it's written so lines from parallel
+// jobs don't interleave. Long filenames are cut short to fit
+#define ROM_STATS_LINE_MAX      4096
+#define ROM_STATS_LINE_RESERVED 512
+
+// JSON names, in enum order
+static const char * const time_names[ROM_STATS_TIME_LAST] = {
+    "file_read", "decode", "encode", "transfer", "parasite", "file_write"
+};
+
+static const char * const count_names[ROM_STATS_COUNT_LAST] = {
+    "tiles", "empty_tiles", "surplus_bytes", "bytes_copied"
+};
+
+#ifndef ROM_BIN_NO_STATS
+// -1 until the environment has been checked. Atomic since the first
+// check can come from several worker threads at once
+static atomic_int stats_enabled = -1;
+#endif
+
+
+
+static int rom_stats_enabled(void)
+{
+#ifdef ROM_BIN_NO_STATS
+    return 0;
+#else
+    int enabled = atomic_load_explicit(&stats_enabled, memory_order_relaxed);
+
+    // Checked once. Racing threads would all store the same value
+    if (enabled == -1) {
+        enabled = (getenv(ROM_STATS_ENV_VAR) != NULL);
+        atomic_store_explicit(&stats_enabled, enabled, memory_order_relaxed);
+    }
+
+    return enabled;
+#endif
+}
+
+
+
+int64_t rom_stats_now_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER        counter;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    QueryPerformanceCounter(&counter);
+
+    return (int64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((int64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+#endif
+}
+
+
+
+// Starts collecting for one operation. Returns the stats to pass
+// along (ex: app_gfx_data.p_stats), or NULL when disabled
+rom_stats * rom_stats_begin(rom_stats * p_stats, const char * p_operation, const char * p_filename, int image_mode)
+{
+    if (!rom_stats_enabled())
+        return NULL;
+
+    memset(p_stats, 0, sizeof(rom_stats));
+
+    p_stats->p_operation = p_operation;
+    p_stats->p_filename  = p_filename;
+    p_stats->image_mode  = image_mode;
+
+    return p_stats;
+}
+
+
+
+// Appends to the line, dropping whatever doesn't fit
+static void rom_stats_append(char * p_line, size_t * p_len, const char * p_format, ...)
+{
+    va_list args;
+    int     written;
+
+    va_start(args, p_format);
+    written = vsnprintf(p_line + *p_len, ROM_STATS_LINE_MAX - *p_len, p_format, args);
+    va_end(args);
+
+    if (written > 0)
+        *p_len += ((size_t)written < ROM_STATS_LINE_MAX - *p_len) ? (size_t)written : (ROM_STATS_LINE_MAX - 1 - *p_len);
+}
+
+
+
+// Appends a string with JSON escaping, leaving room for the rest of the line
+static void rom_stats_append_string(char * p_line, size_t * p_len, const char * p_str)
+{
+    rom_stats_append(p_line, p_len, "\"");
+
+    for (; p_str && *p_str && (*p_len < ROM_STATS_LINE_MAX - ROM_STATS_LINE_RESERVED); p_str++) {
+        unsigned char c = (unsigned char)*p_str;
+
+        if ((c == '"') || (c == '\\'))
+            rom_stats_append(p_line, p_len, "\\%c", c);
+        else if (c < 0x20)
+            rom_stats_append(p_line, p_len, "\\u%04x", c);
+        else
+            p_line[(*p_len)++] = (char)c;
+    }
+
+    rom_stats_append(p_line, p_len, "\"");
+}
+
+
+
+// Prints the operation as one JSON line on stderr, in a single write.
+// Only the first call per rom_stats_begin() prints
+void rom_stats_end(rom_stats * p_stats)
+{
+    char   line[ROM_STATS_LINE_MAX];
+    size_t len = 0;
+    int    c;
+
+    if ((p_stats == NULL) || (p_stats->p_operation == NULL))
+        return;
+
+    rom_stats_append(line, &len, "{\"op\":\"%s\",\"file\":", p_stats->p_operation);
+    rom_stats_append_string(line, &len, p_stats->p_filename);
+    rom_stats_append(line, &len, ",\"mode\":%d,\"status\":%d", p_stats->image_mode, p_stats->status);
+
+    rom_stats_append(line, &len, ",\"time_us\":{");
+    for (c = 0; c < ROM_STATS_TIME_LAST; c++)
+        rom_stats_append(line, &len, "%s\"%s\":%" PRId64, (c) ? "," : "", time_names[c], p_stats->time_ns[c] / 1000);
+
+    rom_stats_append(line, &len, "},\"counts\":{");
+    for (c = 0; c < ROM_STATS_COUNT_LAST; c++)
+        rom_stats_append(line, &len, "%s\"%s\":%" PRId64, (c) ? "," : "", count_names[c], p_stats->count[c]);
+
+    rom_stats_append(line, &len, "}}\n");
+
+    fputs(line, stderr);
+
+    p_stats->p_operation = NULL;
+}
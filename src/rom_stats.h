@@ -0,0 +1,99 @@
+/*=======================================================================
+              ROM bin load / save plugin for the GIMP
+                 Copyright 2018 - X
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+=======================================================================*/
+
+
+#ifndef ROM_STATS_FILE_HEADER
+#define ROM_STATS_FILE_HEADER
+
+#include <stdint.h>
+
+    // Instrumentation, enabled by setting ROM_BIN_STATS in the environment.
+    // Each load / save prints one JSON line with its stage timings and
+    // counters to stderr. When disabled the stats pointer is NULL and
+    // every call below is a single inlined NULL test.
+    // Building with -DROM_BIN_NO_STATS empties the inlined calls and
+    // rom_stats_begin() always returns NULL, so nothing is collected.
+
+    typedef enum rom_stats_time {
+        ROM_STATS_TIME_FILE_READ,
+        ROM_STATS_TIME_DECODE,
+        ROM_STATS_TIME_ENCODE,
+        ROM_STATS_TIME_TRANSFER,    // Pixels to / from GIMP
+        ROM_STATS_TIME_PARASITE,    // Surplus bytes to / from GIMP
+        ROM_STATS_TIME_FILE_WRITE,
+
+        ROM_STATS_TIME_LAST
+    } rom_stats_time;
+
+    typedef enum rom_stats_count {
+        ROM_STATS_COUNT_TILES,
+        ROM_STATS_COUNT_EMPTY_TILES,
+        ROM_STATS_COUNT_SURPLUS_BYTES,
+        ROM_STATS_COUNT_BYTES_COPIED,
+
+        ROM_STATS_COUNT_LAST
+    } rom_stats_count;
+
+    typedef struct rom_stats {
+        const char * p_operation;     // NULL once reported
+        const char * p_filename;
+        int          image_mode;
+        int          status;
+        int64_t      time_ns[ROM_STATS_TIME_LAST];
+        int64_t      started_ns[ROM_STATS_TIME_LAST];
+        int64_t      count[ROM_STATS_COUNT_LAST];
+    } rom_stats;
+
+    rom_stats * rom_stats_begin(rom_stats *, const char *, const char *, int);
+    void        rom_stats_end(rom_stats *);
+
+    int64_t     rom_stats_now_ns(void);
+
+    static inline void rom_stats_start(rom_stats * p_stats, rom_stats_time stage)
+    {
+#ifndef ROM_BIN_NO_STATS
+        if (p_stats)
+            p_stats->started_ns[stage] = rom_stats_now_ns();
+#endif
+    }
+
+    static inline void rom_stats_stop(rom_stats * p_stats, rom_stats_time stage)
+    {
+#ifndef ROM_BIN_NO_STATS
+        if (p_stats)
+            p_stats->time_ns[stage] += rom_stats_now_ns() - p_stats->started_ns[stage];
+#endif
+    }
+
+    static inline void rom_stats_add(rom_stats * p_stats, rom_stats_count counter, int64_t value)
+    {
+#ifndef ROM_BIN_NO_STATS
+        if (p_stats)
+            p_stats->count[counter] += value;
+#endif
+    }
+
+    static inline void rom_stats_set_status(rom_stats * p_stats, int status)
+    {
+#ifndef ROM_BIN_NO_STATS
+        if (p_stats)
+            p_stats->status = status;
+#endif
+    }
+
+#endif // ROM_STATS_FILE_HEADER
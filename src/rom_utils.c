@@ -21,8 +21,47 @@
 
 #include <string.h>
 
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+
+    // Alpha is the second byte of each pixel, so every odd lane of the compare mask
+    #define ROMIMG_ALPHA_LANE_MASK_SSE2  0xAAAA
+#else
+    // Alpha is the second byte of each pixel, which lands in the
+    // upper byte of every 16 bit lane on little-endian machines
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        #define ROMIMG_ALPHA_LANE_MASK_U64  0x0080008000800080ULL
+    #else
+        #define ROMIMG_ALPHA_LANE_MASK_U64  0x8000800080008000ULL
+    #endif
+#endif
+
+
+void * rom_bin_img_alloc(app_gfx_data * p_app_gfx, int64_t size)
+{
+    // Refuse sizes the platform can't address instead of truncating them
+    if ((size < 0) || ((uint64_t)size > (uint64_t)SIZE_MAX))
+        return NULL;
+
+    // Working buffers come from the operation's arena when it has one,
+    // otherwise from the library allocator (malloc unless overridden)
+    if (NULL != p_app_gfx->p_arena)
+        return rom_bin_arena_alloc(p_app_gfx->p_arena, size);
+    else
+        return rom_bin_alloc(size);
+}
+
+
+void rom_bin_img_free(app_gfx_data * p_app_gfx, void * p_mem)
+{
+    // Arena buffers are only released all together with the arena
+    if (NULL == p_app_gfx->p_arena)
+        rom_bin_free(p_mem);
+}
+
 
-void romimg_log_transparent_tiles(unsigned int transparency_flag, unsigned int * p_empty_tile_count, app_gfx_data * p_app_gfx, rom_gfx_attrib rom_attrib)
+
+void rom_bin_img_log_transparent_tiles(unsigned int transparency_flag, unsigned int * p_empty_tile_count, app_gfx_data * p_app_gfx, const rom_gfx_attrib * p_rom_attrib)
 {
     // Transparent pixels in a tile indicate that this is
     // past the end of valid ROM data. This will get removed
@@ -30,23 +69,104 @@ void romimg_log_transparent_tiles(unsigned int transparency_flag, unsigned int *
     // This can happen if the number of tiles in a rom and
     // their size aren't an even multiple of the total image width
     if ((BIN_BITDEPTH_INDEXED_ALPHA == p_app_gfx->bytes_per_pixel)
-       && (transparency_flag >= (rom_attrib.TILE_PIXEL_HEIGHT * rom_attrib.TILE_PIXEL_WIDTH))) {
+       && (transparency_flag >= (p_rom_attrib->TILE_PIXEL_HEIGHT * p_rom_attrib->TILE_PIXEL_WIDTH))) {
         (*p_empty_tile_count)++;
+
+        rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_EMPTY_TILES, 1);
     }
+
+    // Called once per encoded tile
+    rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_TILES, 1);
 }
 
 
-void romimg_log_transparent_pixel(unsigned char * p_image_pixel, unsigned int * p_transparency_flag,  app_gfx_data * p_app_gfx)
+
+// Counts the tiles decoded from rom data and the transparent
+// padding tiles that fill out the last row of the image
+void rom_bin_img_log_decoded_tiles(rom_gfx_data * p_rom_gfx, app_gfx_data * p_app_gfx, const rom_gfx_attrib * p_rom_attrib)
 {
-    // Found a transparent pixel in the non-encoded image, so this
-    // tile may be past the end of valid ROM data. Flag for later
-    if ((BIN_BITDEPTH_INDEXED_ALPHA == p_app_gfx->bytes_per_pixel)
-        && (*(p_image_pixel + 1) == 0))
-        (*p_transparency_flag)++;
+    int64_t tile_size_bytes;
+    int64_t tiles;
+    int64_t image_tiles;
+
+    if (NULL == p_app_gfx->p_stats)
+        return;
+
+    tile_size_bytes = rom_bin_img_calc_tile_bytes(p_rom_attrib);
+    tiles           = p_rom_gfx->size / tile_size_bytes;
+    image_tiles     = ((int64_t)p_app_gfx->width  / p_rom_attrib->TILE_PIXEL_WIDTH)
+                    * ((int64_t)p_app_gfx->height / p_rom_attrib->TILE_PIXEL_HEIGHT);
+
+    rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_TILES, tiles);
+    rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_EMPTY_TILES, image_tiles - tiles);
+}
+
+
+void rom_bin_img_log_transparent_row(unsigned char * p_image_row, unsigned int * p_transparency_flag, app_gfx_data * p_app_gfx, const rom_gfx_attrib * p_rom_attrib)
+{
+    unsigned int c;
+
+    // Only images with an alpha mask can flag tiles as past the end of ROM data
+    if (BIN_BITDEPTH_INDEXED_ALPHA != p_app_gfx->bytes_per_pixel)
+        return;
+
+    // Count the transparent pixels in one tile row of the non-encoded image.
+    // If every pixel in the tile ends up transparent then this tile
+    // is past the end of valid ROM data. Flag for later.
+    //
+    // An 8 pixel row with alpha is 16 bytes: index, alpha, index, alpha...
+    // so the alpha bytes can be tested all at once instead of per pixel.
+    if ((8 == p_rom_attrib->TILE_PIXEL_WIDTH)
+        && (BIN_BITDEPTH_INDEXED_ALPHA == rom_bin_img_calc_appimg_pixel_stride(p_app_gfx))) {
+#if defined(__SSE2__)
+        // One load, one compare against zero, then keep only the alpha lanes
+        __m128i row_bytes  = _mm_loadu_si128((const __m128i *)p_image_row);
+        int     zero_mask  = _mm_movemask_epi8(_mm_cmpeq_epi8(row_bytes, _mm_setzero_si128()));
+
+        *p_transparency_flag += __builtin_popcount(zero_mask & ROMIMG_ALPHA_LANE_MASK_SSE2);
+#else
+        uint64_t row_words[2];
+        uint64_t zero_bytes;
+
+        memcpy(row_words, p_image_row, sizeof(row_words));
+
+        for (c = 0; c < 2; c++) {
+            // Sets the high bit of each byte which is zero (without
+            // carries spilling between bytes), then keeps alpha bytes only
+            zero_bytes = ~(((row_words[c] & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL)
+                           | row_words[c]);
+            zero_bytes &= ROMIMG_ALPHA_LANE_MASK_U64;
+
+            // Each remaining set bit is one transparent pixel
+            while (zero_bytes) {
+                zero_bytes &= (zero_bytes - 1);
+                (*p_transparency_flag)++;
+            }
+        }
+#endif
+        return;
+    }
+
+    // Generic tile widths and strides: check the alpha byte of each pixel
+    for (c = 0; c < p_rom_attrib->TILE_PIXEL_WIDTH; c++) {
+        if (*(p_image_row + (c * rom_bin_img_calc_appimg_pixel_stride(p_app_gfx)) + 1) == 0)
+            (*p_transparency_flag)++;
+    }
+}
+
+
+int64_t rom_bin_img_calc_appimg_pixel_stride(app_gfx_data * p_app_gfx)
+{
+    // Callers may supply their own pixel stride, for example when
+    // decoding into a buffer with extra channels. Otherwise pixels are packed.
+    if (p_app_gfx->pixel_stride > 0)
+        return p_app_gfx->pixel_stride;
+    else
+        return p_app_gfx->bytes_per_pixel;
 }
 
 
-void romimg_set_decoded_pixel_and_advance(unsigned char ** pp_image_pixel, unsigned char pixel_val, unsigned char is_transparent, app_gfx_data * p_app_gfx)
+void rom_bin_img_set_decoded_pixel_and_advance(unsigned char ** pp_image_pixel, unsigned char pixel_val, unsigned char is_transparent, app_gfx_data * p_app_gfx)
 {
     // Set the image pixel
     **pp_image_pixel = pixel_val;
@@ -61,26 +181,69 @@ void romimg_set_decoded_pixel_and_advance(unsigned char ** pp_image_pixel, unsig
     }
 
     // Advance to next pixel in the buffer factoring in bytes depth
-    *pp_image_pixel += p_app_gfx->bytes_per_pixel;
+    // (or the caller's pixel stride if it supplied the buffer)
+    *pp_image_pixel += rom_bin_img_calc_appimg_pixel_stride(p_app_gfx);
 }
 
 
-unsigned char * romimg_calc_appimg_offset(int x, int y, int tile_y, app_gfx_data * p_app_gfx, rom_gfx_attrib rom_attrib)
+int64_t rom_bin_img_calc_appimg_row_stride(app_gfx_data * p_app_gfx)
 {
-    // Calculate pointer location in image buffer based on x,y and tile y
-    return(p_app_gfx->p_data
-           + (p_app_gfx->bytes_per_pixel
-              * ( (((y * rom_attrib.TILE_PIXEL_HEIGHT) + tile_y) * p_app_gfx->width)
-                  + (x * rom_attrib.TILE_PIXEL_WIDTH)) ) );
+    // Callers may supply their own row stride, for example when
+    // decoding straight into a larger surface. Otherwise rows are packed.
+    if (p_app_gfx->row_stride > 0)
+        return p_app_gfx->row_stride;
+    else
+        return (int64_t)p_app_gfx->width * p_app_gfx->bytes_per_pixel;
 }
 
 
 
-long int romimg_calc_encoded_size(app_gfx_data * p_app_gfx, rom_gfx_attrib rom_attrib)
+int rom_bin_img_alloc_decoded_image(app_gfx_data * p_app_gfx)
 {
-    long int size;
+    size_t buffer_size;
+
+    // A caller supplied buffer is used as-is, it was
+    // already sized from the query dimensions
+    if (NULL != p_app_gfx->p_data) {
+        p_app_gfx->data_owned_by_caller = TRUE;
+        return 0;
+    }
+
+    // Otherwise allocate a packed buffer for the decoded image,
+    // failing if the pixel count overflows
+    p_app_gfx->row_stride   = 0;
+    p_app_gfx->pixel_stride = 0;
+
+    if (0 != rom_bin_calc_alloc_size((uint64_t)p_app_gfx->width * p_app_gfx->height,
+                                     p_app_gfx->bytes_per_pixel,
+                                     &buffer_size))
+        return -1;
+
+    p_app_gfx->size = (int64_t)buffer_size;
+
+    if (NULL == (p_app_gfx->p_data = rom_bin_img_alloc(p_app_gfx, p_app_gfx->size)) )
+        return -1;
+
+    // Return success
+    return 0;
+}
 
-    size = (p_app_gfx->width * p_app_gfx->height) / (8 / rom_attrib.BITS_PER_PIXEL);
+
+
+int64_t rom_bin_img_calc_tile_bytes(const rom_gfx_attrib * p_rom_attrib)
+{
+    // Multiply first: 8 / bits per pixel truncates for 3bpp
+    return ((p_rom_attrib->TILE_PIXEL_WIDTH * p_rom_attrib->TILE_PIXEL_HEIGHT)
+                * p_rom_attrib->BITS_PER_PIXEL) / 8;
+}
+
+
+
+int64_t rom_bin_img_calc_encoded_size(app_gfx_data * p_app_gfx, const rom_gfx_attrib * p_rom_attrib)
+{
+    int64_t size;
+
+    size = ((int64_t)p_app_gfx->width * p_app_gfx->height * p_rom_attrib->BITS_PER_PIXEL) / 8;
 
     return(size);
 }
@@ -90,7 +253,7 @@ long int romimg_calc_encoded_size(app_gfx_data * p_app_gfx, rom_gfx_attrib rom_a
 // TODO: Better handling for files that aren't even multipels of tile size (ex: .nes files)
 //       Could use transparent pixels to encoded/indicate non-file data (if entire tile == transparent: truncate)
 //       Add image width option to open dialog (128 default)
-void romimg_calc_decoded_size(long int file_size,  app_gfx_data * p_app_gfx, rom_gfx_attrib rom_attrib)
+void rom_bin_img_calc_decoded_size(int64_t file_size,  app_gfx_data * p_app_gfx, const rom_gfx_attrib * p_rom_attrib)
 {
     // NOTE: If tile count /size is not an even multiple of IMAGE_WIDTH_DEFAULT
     //       then two conditions arise which need handling
@@ -110,17 +273,24 @@ void romimg_calc_decoded_size(long int file_size,  app_gfx_data * p_app_gfx, rom
     // First calculate the number of tiles in the image
 
     // Tiles are NxN pixels. Calculate size factoring in pixel bit-packing.
-    int tile_size_bytes;
-    int tiles;
-    long int surplus_bytes_count;
+    int64_t tile_size_bytes;
+    int64_t tiles;
+    int64_t surplus_bytes_count;
 
-    tile_size_bytes = ((rom_attrib.TILE_PIXEL_WIDTH * rom_attrib.TILE_PIXEL_HEIGHT)
-                             / (8 / rom_attrib.BITS_PER_PIXEL));
+    tile_size_bytes = rom_bin_img_calc_tile_bytes(p_rom_attrib);
 
     // Calculate number of tiles, as well as number of bytes left over
     tiles = file_size / tile_size_bytes;
 
-    surplus_bytes_count = (long int) (file_size % tile_size_bytes);
+    surplus_bytes_count = (int64_t) (file_size % tile_size_bytes);
+
+    // Not even one tile: leave the image empty so the decode gets rejected
+    if (0 == tiles) {
+        p_app_gfx->width  = 0;
+        p_app_gfx->height = 0;
+        p_app_gfx->surplus_bytes_size = surplus_bytes_count;
+        return;
+    }
 
 
 
@@ -129,23 +299,23 @@ void romimg_calc_decoded_size(long int file_size,  app_gfx_data * p_app_gfx, rom
     // * Width: if less than N pixels wide worth of
     //          tiles then use cumulative tile width.
     //          Otherwise default to TILES * TILE_PIXEL_WIDTH)
-    if ((tiles * rom_attrib.TILE_PIXEL_WIDTH) < rom_attrib.IMAGE_WIDTH_DEFAULT) {
+    if ((tiles * p_rom_attrib->TILE_PIXEL_WIDTH) < p_rom_attrib->IMAGE_WIDTH_DEFAULT) {
         // Use number of tiles x size as the width
-        p_app_gfx->width = (tiles * rom_attrib.TILE_PIXEL_WIDTH);
+        p_app_gfx->width = (tiles * p_rom_attrib->TILE_PIXEL_WIDTH);
     }
     else
     {
         // TODO: It would be nice if width was selectable (as a multiple of tile width)
-        p_app_gfx->width = rom_attrib.IMAGE_WIDTH_DEFAULT;
+        p_app_gfx->width = p_rom_attrib->IMAGE_WIDTH_DEFAULT;
 
         // Try to avoid extremely tall and narrow images
         // 1:8 is a decent upper bound for width:height aspect ratio
         #define OPTIMAL_ASPECT_RATIO 8
         #define STEP_FACTOR      (2*2) // For every 2x increase in width there is a 2x decrease in height
 
-        long int tiles_per_row  = p_app_gfx->width / rom_attrib.TILE_PIXEL_WIDTH;
-        long int height         = (tiles / tiles_per_row) * rom_attrib.TILE_PIXEL_HEIGHT;
-             int aspect_ratio   = (height / p_app_gfx->width);
+        int64_t tiles_per_row  = p_app_gfx->width / p_rom_attrib->TILE_PIXEL_WIDTH;
+        int64_t height         = (tiles / tiles_per_row) * p_rom_attrib->TILE_PIXEL_HEIGHT;
+        int64_t aspect_ratio   = (height / p_app_gfx->width);
 
         int width_increase = 1;
         while (aspect_ratio >= (OPTIMAL_ASPECT_RATIO * 2)) {
@@ -157,35 +327,34 @@ void romimg_calc_decoded_size(long int file_size,  app_gfx_data * p_app_gfx, rom
 
     // * Height is a function of width, tile height and number of tiles
     //   Round up: Integer rounding up: (x + (n-1)) / n
-    p_app_gfx->height = (((tiles * rom_attrib.TILE_PIXEL_WIDTH) + (p_app_gfx->width - 1))
+    p_app_gfx->height = (((tiles * p_rom_attrib->TILE_PIXEL_WIDTH) + (p_app_gfx->width - 1))
                          / p_app_gfx->width);
 
     // Now scale up by the tile height
-    p_app_gfx->height *= rom_attrib.TILE_PIXEL_HEIGHT;
+    p_app_gfx->height *= p_rom_attrib->TILE_PIXEL_HEIGHT;
 
     // If there are extra bytes left over then flag them
     // as needing to be stored in metadata as a gimp parasite
     p_app_gfx->surplus_bytes_size = surplus_bytes_count;
-
-    printf("extra bytes %ld\n", p_app_gfx->surplus_bytes_size);
 }
 
 
 
-int romimg_stash_surplus_bytes(app_gfx_data * p_app_gfx, rom_gfx_data * p_rom_gfx)
+int rom_bin_img_stash_surplus_bytes(app_gfx_data * p_app_gfx, rom_gfx_data * p_rom_gfx)
 {
     if (p_app_gfx->surplus_bytes_size > 0) {
 
-        printf("Saving extra bytes %ld\n", p_app_gfx->surplus_bytes_size);
-
         // Set aside any surplus bytes at the end which weren't decoded as tiles
         // These will get attached to the gimp image as metadata parasite
-        if (NULL == (p_app_gfx->p_surplus_bytes = malloc(p_app_gfx->surplus_bytes_size)) )
+        if (NULL == (p_app_gfx->p_surplus_bytes = rom_bin_img_alloc(p_app_gfx, p_app_gfx->surplus_bytes_size)) )
             return -1;
 
         memcpy(p_app_gfx->p_surplus_bytes,
                p_rom_gfx->p_data + (p_rom_gfx->size - p_app_gfx->surplus_bytes_size),
                p_app_gfx->surplus_bytes_size);
+
+        rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_SURPLUS_BYTES, p_app_gfx->surplus_bytes_size);
+        rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_BYTES_COPIED,  p_app_gfx->surplus_bytes_size);
     }
 
     // Return success
@@ -193,25 +362,19 @@ int romimg_stash_surplus_bytes(app_gfx_data * p_app_gfx, rom_gfx_data * p_rom_gf
 }
 
 
-int romimg_append_surplus_bytes(app_gfx_data * p_app_gfx, rom_gfx_data * p_rom_gfx)
+int rom_bin_img_append_surplus_bytes(app_gfx_data * p_app_gfx, rom_gfx_data * p_rom_gfx)
 {
-    long int        new_size;
+    int64_t         new_size;
     unsigned char * p_new_rom_data = NULL;
 
     if (p_app_gfx->surplus_bytes_size > 0) {
 
-        printf("Appending extra bytes %ld\n", p_app_gfx->surplus_bytes_size);
-
         // Allocate a new buffer with the size of the others combined
         new_size = p_rom_gfx->size + p_app_gfx->surplus_bytes_size;
 
-        if (NULL == (p_new_rom_data = malloc(new_size)))
+        if (NULL == (p_new_rom_data = rom_bin_img_alloc(p_app_gfx, new_size)))
             return -1;
 
-        printf("Size:  rom=%ld, surplus=%ld, newrom=%ld\n", p_rom_gfx->size,
-                                                          p_app_gfx->surplus_bytes_size,
-                                                          new_size);
-
         // Copy the contents of the main buffer into the new one
         memcpy(p_new_rom_data,
                p_rom_gfx->p_data,
@@ -222,8 +385,11 @@ int romimg_append_surplus_bytes(app_gfx_data * p_app_gfx, rom_gfx_data * p_rom_g
                p_app_gfx->p_surplus_bytes,
                p_app_gfx->surplus_bytes_size);
 
+        rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_SURPLUS_BYTES, p_app_gfx->surplus_bytes_size);
+        rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_BYTES_COPIED,  new_size);
+
         // Free the old rom buffer
-        free(p_rom_gfx->p_data);
+        rom_bin_img_free(p_app_gfx, p_rom_gfx->p_data);
 
         // Swap the new buffer into the struct
         p_rom_gfx->p_data = p_new_rom_data;
@@ -236,7 +402,7 @@ int romimg_append_surplus_bytes(app_gfx_data * p_app_gfx, rom_gfx_data * p_rom_g
 
 
 
-int romimg_insert_color_to_map(unsigned char r, unsigned char g, unsigned char b, app_color_data * p_colorpal)
+int rom_bin_img_insert_color_to_map(unsigned char r, unsigned char g, unsigned char b, app_color_data * p_colorpal)
 {
     // Make sure space is available in the buffer
     if (( (p_colorpal->index) + 2) > (p_colorpal->size * p_colorpal->bytes_per_pixel))
@@ -252,8 +418,9 @@ int romimg_insert_color_to_map(unsigned char r, unsigned char g, unsigned char b
 
 
 
-// TODO: FEATURE: Consider trying to look for .pal file with name that matches .bin file and load it
-int romimg_load_color_data(app_color_data * p_colorpal)
+// Default colors. Loaders that know the file name replace them with a
+// palette stored next to it, see rom_bin_palette_parse()
+int rom_bin_img_load_color_data(app_color_data * p_colorpal)
 {
     int status = 0;
 
@@ -267,46 +434,46 @@ int romimg_load_color_data(app_color_data * p_colorpal)
 
     // 1BPP Default
     if (2 == p_colorpal->size) {
-        status += romimg_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0xFF, 0xFF, 0xFF, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xFF, 0xFF, 0xFF, p_colorpal);
     }
     else if (4 == p_colorpal->size) {
-        status += romimg_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0x8c, 0x63, 0x21, p_colorpal);
-        status += romimg_insert_color_to_map(0xAD, 0xB5, 0x31, p_colorpal);
-        status += romimg_insert_color_to_map(0xC6, 0xE7, 0x9C, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x8c, 0x63, 0x21, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xAD, 0xB5, 0x31, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xC6, 0xE7, 0x9C, p_colorpal);
     }
     else if (8 == p_colorpal->size) {
-        status += romimg_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0x8c, 0x63, 0x21, p_colorpal);
-        status += romimg_insert_color_to_map(0xAD, 0xB5, 0x31, p_colorpal);
-        status += romimg_insert_color_to_map(0xC6, 0xE7, 0x9C, p_colorpal);
-
-        status += romimg_insert_color_to_map(0xF8, 0xF8, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0xF8, 0xC0, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0xF8, 0x78, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0xF8, 0x00, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x8c, 0x63, 0x21, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xAD, 0xB5, 0x31, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xC6, 0xE7, 0x9C, p_colorpal);
+
+        status += rom_bin_img_insert_color_to_map(0xF8, 0xF8, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xF8, 0xC0, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xF8, 0x78, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xF8, 0x00, 0x00, p_colorpal);
     }
     else if (16 == p_colorpal->size) {
-        status += romimg_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0x8c, 0x63, 0x21, p_colorpal);
-        status += romimg_insert_color_to_map(0xAD, 0xB5, 0x31, p_colorpal);
-        status += romimg_insert_color_to_map(0xC6, 0xE7, 0x9C, p_colorpal);
-
-        status += romimg_insert_color_to_map(0xF8, 0xF8, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0xF8, 0xC0, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0xF8, 0x78, 0x00, p_colorpal);
-        status += romimg_insert_color_to_map(0xF8, 0x00, 0x00, p_colorpal);
-
-        status += romimg_insert_color_to_map(0xFA, 0xD3, 0x5A, p_colorpal);
-        status += romimg_insert_color_to_map(0x29, 0xA2, 0x29, p_colorpal);
-        status += romimg_insert_color_to_map(0x00, 0x78, 0x48, p_colorpal);
-        status += romimg_insert_color_to_map(0x00, 0x38, 0x39, p_colorpal);
-
-        status += romimg_insert_color_to_map(0xD8, 0xF0, 0xF8, p_colorpal);
-        status += romimg_insert_color_to_map(0xA8, 0xC0, 0xC8, p_colorpal);
-        status += romimg_insert_color_to_map(0x90, 0xA8, 0xB0, p_colorpal);
-        status += romimg_insert_color_to_map(0x60, 0x78, 0x90, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x8c, 0x63, 0x21, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xAD, 0xB5, 0x31, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xC6, 0xE7, 0x9C, p_colorpal);
+
+        status += rom_bin_img_insert_color_to_map(0xF8, 0xF8, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xF8, 0xC0, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xF8, 0x78, 0x00, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xF8, 0x00, 0x00, p_colorpal);
+
+        status += rom_bin_img_insert_color_to_map(0xFA, 0xD3, 0x5A, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x29, 0xA2, 0x29, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x00, 0x78, 0x48, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x00, 0x38, 0x39, p_colorpal);
+
+        status += rom_bin_img_insert_color_to_map(0xD8, 0xF0, 0xF8, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0xA8, 0xC0, 0xC8, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x90, 0xA8, 0xB0, p_colorpal);
+        status += rom_bin_img_insert_color_to_map(0x60, 0x78, 0x90, p_colorpal);
     }
     else if (256 == p_colorpal->size) {
 
@@ -314,25 +481,25 @@ int romimg_load_color_data(app_color_data * p_colorpal)
     // TODO: 256 colors - use #define
         int c;
         for (c=0; c < 256/16; c++) {
-            status += romimg_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
-            status += romimg_insert_color_to_map(0x8c, 0x63, 0x21, p_colorpal);
-            status += romimg_insert_color_to_map(0xAD, 0xB5, 0x31, p_colorpal);
-            status += romimg_insert_color_to_map(0xC6, 0xE7, 0x9C, p_colorpal);
-
-            status += romimg_insert_color_to_map(0xF8, 0xF8, 0x00, p_colorpal);
-            status += romimg_insert_color_to_map(0xF8, 0xC0, 0x00, p_colorpal);
-            status += romimg_insert_color_to_map(0xF8, 0x78, 0x00, p_colorpal);
-            status += romimg_insert_color_to_map(0xF8, 0x00, 0x00, p_colorpal);
-
-            status += romimg_insert_color_to_map(0xFA, 0xD3, 0x5A, p_colorpal);
-            status += romimg_insert_color_to_map(0x29, 0xA2, 0x29, p_colorpal);
-            status += romimg_insert_color_to_map(0x00, 0x78, 0x48, p_colorpal);
-            status += romimg_insert_color_to_map(0x00, 0x38, 0x39, p_colorpal);
-
-            status += romimg_insert_color_to_map(0xD8, 0xF0, 0xF8, p_colorpal);
-            status += romimg_insert_color_to_map(0xA8, 0xC0, 0xC8, p_colorpal);
-            status += romimg_insert_color_to_map(0x90, 0xA8, 0xB0, p_colorpal);
-            status += romimg_insert_color_to_map(0x60, 0x78, 0x90, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0x00, 0x00, 0x00, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0x8c, 0x63, 0x21, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0xAD, 0xB5, 0x31, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0xC6, 0xE7, 0x9C, p_colorpal);
+
+            status += rom_bin_img_insert_color_to_map(0xF8, 0xF8, 0x00, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0xF8, 0xC0, 0x00, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0xF8, 0x78, 0x00, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0xF8, 0x00, 0x00, p_colorpal);
+
+            status += rom_bin_img_insert_color_to_map(0xFA, 0xD3, 0x5A, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0x29, 0xA2, 0x29, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0x00, 0x78, 0x48, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0x00, 0x38, 0x39, p_colorpal);
+
+            status += rom_bin_img_insert_color_to_map(0xD8, 0xF0, 0xF8, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0xA8, 0xC0, 0xC8, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0x90, 0xA8, 0xB0, p_colorpal);
+            status += rom_bin_img_insert_color_to_map(0x60, 0x78, 0x90, p_colorpal);
         }
     }
 
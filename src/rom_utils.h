@@ -21,20 +21,28 @@
 #define ROM_UTILS_FILE_HEADER
 
 #include "lib_rom_bin.h"
+#include "rom_stats.h"
 
-    void romimg_log_transparent_tiles(unsigned int , unsigned int *, app_gfx_data *, rom_gfx_attrib);
-    void romimg_log_transparent_pixel(unsigned char *, unsigned int *,  app_gfx_data *);
-    void romimg_set_decoded_pixel_and_advance(unsigned char **, unsigned char, unsigned char, app_gfx_data *);
+    void * rom_bin_img_alloc(app_gfx_data *, int64_t);
+    void rom_bin_img_free(app_gfx_data *, void *);
 
-    unsigned char * romimg_calc_appimg_offset(int, int, int, app_gfx_data *, rom_gfx_attrib);
+    void rom_bin_img_log_transparent_tiles(unsigned int , unsigned int *, app_gfx_data *, const rom_gfx_attrib *);
+    void rom_bin_img_log_decoded_tiles(rom_gfx_data *, app_gfx_data *, const rom_gfx_attrib *);
+    void rom_bin_img_log_transparent_row(unsigned char *, unsigned int *, app_gfx_data *, const rom_gfx_attrib *);
+    void rom_bin_img_set_decoded_pixel_and_advance(unsigned char **, unsigned char, unsigned char, app_gfx_data *);
 
-    long int romimg_calc_encoded_size(app_gfx_data *, rom_gfx_attrib);
-    void romimg_calc_decoded_size(long int, app_gfx_data *, rom_gfx_attrib);
+    int64_t rom_bin_img_calc_appimg_row_stride(app_gfx_data *);
+    int64_t rom_bin_img_calc_appimg_pixel_stride(app_gfx_data *);
+    int rom_bin_img_alloc_decoded_image(app_gfx_data *);
 
-    int romimg_stash_surplus_bytes(app_gfx_data *, rom_gfx_data *);
-    int romimg_append_surplus_bytes(app_gfx_data *, rom_gfx_data *);
+    int64_t rom_bin_img_calc_tile_bytes(const rom_gfx_attrib *);
+    int64_t rom_bin_img_calc_encoded_size(app_gfx_data *, const rom_gfx_attrib *);
+    void rom_bin_img_calc_decoded_size(int64_t, app_gfx_data *, const rom_gfx_attrib *);
 
-    int romimg_insert_color_to_map(unsigned char, unsigned char, unsigned char, app_color_data *);
-    int romimg_load_color_data(app_color_data *);
+    int rom_bin_img_stash_surplus_bytes(app_gfx_data *, rom_gfx_data *);
+    int rom_bin_img_append_surplus_bytes(app_gfx_data *, rom_gfx_data *);
+
+    int rom_bin_img_insert_color_to_map(unsigned char, unsigned char, unsigned char, app_color_data *);
+    int rom_bin_img_load_color_data(app_color_data *);
 
 #endif // ROM_UTILS_FILE_HEADER
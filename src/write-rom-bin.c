@@ -25,39 +25,46 @@
 #include <string.h>
 #include <libgimp/gimp.h>
 
-int write_rom_bin(const gchar * filename, gint image_id, gint drawable_id, int image_mode)
+// Copies the drawable's pixels into the app image
+static void write_rom_bin_get_pixels(gint32 drawable_id, app_gfx_data * p_app_gfx)
 {
-    int status;
+#if GIMP_CHECK_VERSION(2,10,0)
+    GeglBuffer * buffer;
+    const Babl * format;
+    gint         tile_height = 0;
+    gint         y, rows;
+    int64_t      row_bytes;
+
+    buffer = gimp_drawable_get_buffer(drawable_id);
+
+    // The drawable's own (indexed) format, so GEGL copies without converting
+    format    = gimp_drawable_get_format(drawable_id);
+    row_bytes = (int64_t)p_app_gfx->width * p_app_gfx->bytes_per_pixel;
+
+    // Read in strips that line up with the buffer's tiles so
+    // each tile is only fetched once
+    g_object_get(buffer, "tile-height", &tile_height, NULL);
+    if (tile_height <= 0)
+        tile_height = gimp_tile_height();
+
+    for (y = 0; y < p_app_gfx->height; y += rows) {
+        rows = MIN(tile_height, p_app_gfx->height - y);
+
+        gegl_buffer_get(buffer,
+                        GEGL_RECTANGLE(0, y, p_app_gfx->width, rows),
+                        1.0, format,
+                        p_app_gfx->p_data + (y * row_bytes),
+                        GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+    }
 
+    g_object_unref(buffer);
+#else
     GimpDrawable * drawable;
     GimpPixelRgn rgn;
-    GimpParasite * img_parasite;
-
-    FILE * file;
-
-    status = 0; // Default to success
-
-    app_gfx_data   app_gfx;
-    app_color_data colorpal; // TODO: rename to app_colorpal?
-    rom_gfx_data   rom_gfx;
-
-    rom_bin_init_structs(&rom_gfx, &app_gfx, &colorpal);
-
-    app_gfx.image_mode = image_mode;
-
 
     // Get the drawable
     drawable = gimp_drawable_get(drawable_id);
 
-    // Get the Bytes Per Pixel of the incoming app image
-    app_gfx.bytes_per_pixel = (unsigned char)gimp_drawable_bpp(drawable_id);
-
-    // Abort if it's not 1 or 2 bytes per pixel
-    // TODO: handle both 1 (no alpha) and 2 (has alpha) byte-per-pixel mode
-    if (app_gfx.bytes_per_pixel >= BIN_BITDEPTH_LAST) {
-        return 0;
-    }
-
     // Get a pixel region from the layer
     gimp_pixel_rgn_init(&rgn,
                         drawable,
@@ -66,79 +73,177 @@ int write_rom_bin(const gchar * filename, gint image_id, gint drawable_id, int i
                         drawable->height,
                         FALSE, FALSE);
 
-
-    // Determine the array size for the app's image then allocate it
-    app_gfx.width   = drawable->width;
-    app_gfx.height  = drawable->height;
-    app_gfx.size    =  drawable->width * drawable->height * app_gfx.bytes_per_pixel;
-    app_gfx.p_data  = malloc(app_gfx.size);
-
-    // Get the image data
     gimp_pixel_rgn_get_rect(&rgn,
-                            app_gfx.p_data,
+                            p_app_gfx->p_data,
                             0, 0,
                             drawable->width,
                             drawable->height);
 
+    // Detach the drawable
+    gimp_drawable_detach(drawable);
+#endif
+}
+
+
+
+// Copies the drawable's pixels and any stashed surplus bytes into
+// the job's buffers, main thread only
+int write_rom_bin_get_image(gint image_id, gint drawable_id, int image_mode, write_rom_bin_job * p_job)
+{
+    GimpParasite * img_parasite;
+
+    app_gfx_data * p_app_gfx = &p_job->app_gfx;
+
+    rom_bin_init_structs(&p_job->rom_gfx, &p_job->app_gfx, &p_job->colorpal);
+    rom_bin_arena_init(&p_job->arena);
+
+    p_app_gfx->image_mode = image_mode;
+    p_app_gfx->p_stats    = rom_stats_begin(&p_job->stats, "save", NULL, image_mode);
+    rom_stats_set_status(p_app_gfx->p_stats, -1);
+
+
+    // Get the Bytes Per Pixel of the incoming app image
+    p_app_gfx->bytes_per_pixel = (unsigned char)gimp_drawable_bpp(drawable_id);
+
+    // Abort if it's not 1 or 2 bytes per pixel
+    // TODO: handle both 1 (no alpha) and 2 (has alpha) byte-per-pixel mode
+    if (p_app_gfx->bytes_per_pixel >= BIN_BITDEPTH_LAST) {
+        write_rom_bin_job_free(p_job);
+        return -1;
+    }
+
+    // Determine the array size for the app's image
+    p_app_gfx->width   = gimp_drawable_width(drawable_id);
+    p_app_gfx->height  = gimp_drawable_height(drawable_id);
+    p_app_gfx->size    = (int64_t)p_app_gfx->width * p_app_gfx->height * p_app_gfx->bytes_per_pixel;
 
 
     // TODO: move parasite metadata handling into a function?
+    rom_stats_start(p_app_gfx->p_stats, ROM_STATS_TIME_PARASITE);
+
     img_parasite = gimp_image_get_parasite(image_id,
                                            "ROM-BIN-SURPLUS-BYTES");
 
+    // Load surplus (non-encodable) bytes stashed in the gimp metadata parasite
+    if (img_parasite)
+        p_app_gfx->surplus_bytes_size = img_parasite->size;
+
+
+    // Reserve a single arena for the app image, surplus bytes
+    // and encoded rom data, then carve the app side buffers from it
+    if (0 != rom_bin_arena_reserve(&p_job->arena, rom_bin_calc_encode_arena_size(p_app_gfx))) {
+        if (img_parasite)
+            gimp_parasite_free(img_parasite);
+        write_rom_bin_job_free(p_job);
+        return -1;
+    }
+
+    p_app_gfx->p_arena = &p_job->arena;
+    p_app_gfx->p_data  = rom_bin_arena_alloc(&p_job->arena, p_app_gfx->size);
+
     if (img_parasite) {
-        printf("Found parasite size %d\n", img_parasite->size);
-
-        // Load surplus (non-encodable) bytes stashed in the gimp metadata parasite
-        app_gfx.surplus_bytes_size = img_parasite->size;
-
-        if (NULL == (app_gfx.p_surplus_bytes = malloc(app_gfx.surplus_bytes_size)) ) {
-            // TODO: handle and centralize freeing these buffers better
-            free(app_gfx.p_data);
-            free(app_gfx.p_surplus_bytes);
-            free(rom_gfx.p_data);
-            return 0;
-        }
-
-        memcpy(app_gfx.p_surplus_bytes,
-               (unsigned char *)img_parasite->data,
-               img_parasite->size);
+        p_app_gfx->p_surplus_bytes = rom_bin_arena_alloc(&p_job->arena, p_app_gfx->surplus_bytes_size);
+
+        if (p_app_gfx->p_surplus_bytes)
+            memcpy(p_app_gfx->p_surplus_bytes,
+                   (unsigned char *)img_parasite->data,
+                   img_parasite->size);
+
+        gimp_parasite_free(img_parasite);
     }
 
+    rom_stats_stop(p_app_gfx->p_stats, ROM_STATS_TIME_PARASITE);
 
+    if ((NULL == p_app_gfx->p_data) ||
+        ((p_app_gfx->surplus_bytes_size > 0) && (NULL == p_app_gfx->p_surplus_bytes))) {
+        write_rom_bin_job_free(p_job);
+        return -1;
+    }
 
-    status = rom_bin_encode(&rom_gfx,
-                            &app_gfx);
-    // TODO: Check colormap size and throw a warning if it's too large (4bpp vs 2bpp, etc)
-    if (status != 0) { };
 
+    // Get the image data
+    rom_stats_start(p_app_gfx->p_stats, ROM_STATS_TIME_TRANSFER);
 
-    // Free the image data
-    free(app_gfx.p_data);
-    free(app_gfx.p_surplus_bytes);
+    write_rom_bin_get_pixels(drawable_id, p_app_gfx);
 
-    // Detach the drawable
-    gimp_drawable_detach(drawable);
+    rom_stats_stop(p_app_gfx->p_stats, ROM_STATS_TIME_TRANSFER);
+    rom_stats_add(p_app_gfx->p_stats, ROM_STATS_COUNT_BYTES_COPIED, p_app_gfx->size);
 
-    // Make sure that the write was successful
-    if(rom_gfx.size == FALSE)
-    {
-        free(rom_gfx.p_data);
-        return 0;
-    }
+    // Return success
+    return 0;
+}
+
+
+
+// Encodes the job's image and writes it to the file.
+// Makes no GIMP calls, so it is safe to run on a worker thread.
+int write_rom_bin_encode(const gchar * filename, write_rom_bin_job * p_job)
+{
+    int status;
+
+    FILE * file;
+
+    // The output name is only known once the job gets here (batch export)
+    if (p_job->app_gfx.p_stats)
+        p_job->stats.p_filename = filename;
+
+    status = rom_bin_encode(&p_job->rom_gfx,
+                            &p_job->app_gfx);
+    // TODO: Check colormap size and throw a warning if it's too large (4bpp vs 2bpp, etc)
+
+    // Make sure that the encode was successful
+    if ((status != 0) || (p_job->rom_gfx.size == FALSE))
+        return -1;
 
     // Open the file
+    rom_stats_start(p_job->app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+
     file = fopen(filename, "wb");
-    if(!file)
-    {
-        free(rom_gfx.p_data);
-        return 0;
+    if(!file) {
+        rom_stats_stop(p_job->app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+        rom_stats_set_status(p_job->app_gfx.p_stats, -1);
+        return -1;
     }
 
     // Write the data and close it
-    fwrite(rom_gfx.p_data, rom_gfx.size, 1, file);
-    free(rom_gfx.p_data);
+    if (1 != fwrite(p_job->rom_gfx.p_data, p_job->rom_gfx.size, 1, file))
+        status = -1;
+
     fclose(file);
 
-    return 1;
+    rom_stats_stop(p_job->app_gfx.p_stats, ROM_STATS_TIME_FILE_WRITE);
+    rom_stats_add(p_job->app_gfx.p_stats, ROM_STATS_COUNT_BYTES_COPIED, p_job->rom_gfx.size);
+    rom_stats_set_status(p_job->app_gfx.p_stats, status);
+
+    return status;
+}
+
+
+
+// Free the app image, surplus bytes and rom data,
+// reporting the stats for this save if enabled
+void write_rom_bin_job_free(write_rom_bin_job * p_job)
+{
+    rom_stats_end(p_job->app_gfx.p_stats);
+
+    rom_bin_free_structs(&p_job->rom_gfx, &p_job->app_gfx, &p_job->colorpal);
+    rom_bin_arena_release(&p_job->arena);
+}
+
+
+
+int write_rom_bin(const gchar * filename, gint image_id, gint drawable_id, int image_mode)
+{
+    int status;
+    write_rom_bin_job job;
+
+    if (0 != write_rom_bin_get_image(image_id, drawable_id, image_mode, &job))
+        return 0;
+
+    status = write_rom_bin_encode(filename, &job);
+
+    // Frees every buffer of this export at once
+    write_rom_bin_job_free(&job);
+
+    return (status == 0);
 }
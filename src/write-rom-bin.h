@@ -18,4 +18,26 @@
 
 #include <glib.h>
 
-int write_rom_bin(const gchar *, gint, gint, int);
+#include "lib_rom_bin.h"
+#include "rom_stats.h"
+
+#ifndef WRITE_ROM_BIN_FILE_HEADER
+#define WRITE_ROM_BIN_FILE_HEADER
+
+    // State for one export, split so only fetching the pixels from
+    // GIMP runs on the main thread and the encode + write can run on a worker
+    typedef struct write_rom_bin_job {
+        app_gfx_data   app_gfx;
+        app_color_data colorpal;
+        rom_gfx_data   rom_gfx;
+        rom_bin_arena  arena;
+        rom_stats      stats;
+    } write_rom_bin_job;
+
+    int  write_rom_bin_get_image(gint, gint, int, write_rom_bin_job *);
+    int  write_rom_bin_encode(const gchar *, write_rom_bin_job *);
+    void write_rom_bin_job_free(write_rom_bin_job *);
+
+    int write_rom_bin(const gchar *, gint, gint, int);
+
+#endif // WRITE_ROM_BIN_FILE_HEADER